@@ -24,6 +24,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapiblend.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapivalue.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
@@ -33,6 +34,8 @@ struct _GstVaapiBlend
   GstObject parent_instance;
 
   GstVaapiDisplay *display;
+  /* Serializes the VA calls on the blend context */
+  GMutex lock;
 
   VAConfigID va_config;
   VAContextID va_context;
@@ -108,7 +111,7 @@ gst_vaapi_blend_finalize (GObject * object)
   if (!blend->display)
     goto bail;
 
-  GST_VAAPI_DISPLAY_LOCK (blend->display);
+  GST_VAAPI_DISPLAY_VA_LOCK (blend->display);
 
   if (blend->va_context != VA_INVALID_ID) {
     vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
@@ -117,16 +120,17 @@ gst_vaapi_blend_finalize (GObject * object)
   }
 
   if (blend->va_config != VA_INVALID_ID) {
-    vaDestroyConfig (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
-        blend->va_config);
+    gst_vaapi_display_release_config (blend->display, blend->va_config);
     blend->va_config = VA_INVALID_ID;
   }
 
-  GST_VAAPI_DISPLAY_UNLOCK (blend->display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (blend->display);
 
   gst_vaapi_display_replace (&blend->display, NULL);
 
 bail:
+  g_mutex_clear (&blend->lock);
+
   G_OBJECT_CLASS (gst_vaapi_blend_parent_class)->finalize (object);
 }
 
@@ -148,6 +152,7 @@ gst_vaapi_blend_class_init (GstVaapiBlendClass * klass)
 static void
 gst_vaapi_blend_init (GstVaapiBlend * blend)
 {
+  g_mutex_init (&blend->lock);
   blend->display = NULL;
   blend->va_config = VA_INVALID_ID;
   blend->va_context = VA_INVALID_ID;
@@ -159,17 +164,20 @@ gst_vaapi_blend_initialize (GstVaapiBlend * blend)
 {
   VAStatus status;
   VAProcPipelineCaps pipeline_caps = { 0, };
+  gint64 profile_start;
 
   if (!blend->display)
     return FALSE;
 
-  status = vaCreateConfig (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
-      VAProfileNone, VAEntrypointVideoProc, NULL, 0, &blend->va_config);
-  if (!vaapi_check_status (status, "vaCreateConfig() [VPP]"))
+  if (!gst_vaapi_display_acquire_config (blend->display, VAProfileNone,
+          VAEntrypointVideoProc, NULL, 0, &blend->va_config))
     return FALSE;
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateContext (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
       blend->va_config, 0, 0, 0, NULL, 0, &blend->va_context);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (blend->display),
+      GST_VAAPI_PROFILER_CREATE_CONTEXT, profile_start);
   if (!vaapi_check_status (status, "vaCreateContext() [VPP]"))
     return FALSE;
 
@@ -222,11 +230,15 @@ gst_vaapi_blend_process_unlocked (GstVaapiBlend * blend,
   VAStatus va_status;
   VADisplay va_display;
   GstVaapiBlendSurface *current;
+  gint64 profile_start;
 
   va_display = GST_VAAPI_DISPLAY_VADISPLAY (blend->display);
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaBeginPicture (va_display, blend->va_context,
       GST_VAAPI_SURFACE_ID (output));
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_BEGIN_PICTURE,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaBeginPicture()"))
     return FALSE;
 
@@ -282,13 +294,19 @@ gst_vaapi_blend_process_unlocked (GstVaapiBlend * blend,
 
     vaapi_unmap_buffer (va_display, id, NULL);
 
+    profile_start = gst_vaapi_profiler_begin ();
     va_status = vaRenderPicture (va_display, blend->va_context, &id, 1);
+    gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_RENDER_PICTURE,
+        profile_start);
     vaapi_destroy_buffer (va_display, &id);
     if (!vaapi_check_status (va_status, "vaRenderPicture()"))
       return FALSE;
   }
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaEndPicture (va_display, blend->va_context);
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_END_PICTURE,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaEndPicture()"))
     return FALSE;
 
@@ -318,9 +336,11 @@ gst_vaapi_blend_process (GstVaapiBlend * blend, GstVaapiSurface * output,
   g_return_val_if_fail (output != NULL, FALSE);
   g_return_val_if_fail (next != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (blend->display);
+  g_mutex_lock (&blend->lock);
+  GST_VAAPI_DISPLAY_VA_LOCK (blend->display);
   result = gst_vaapi_blend_process_unlocked (blend, output, next, user_data);
-  GST_VAAPI_DISPLAY_UNLOCK (blend->display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (blend->display);
+  g_mutex_unlock (&blend->lock);
 
   return result;
 }
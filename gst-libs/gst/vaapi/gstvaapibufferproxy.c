@@ -21,10 +21,12 @@
  */
 
 #include "sysdeps.h"
+#include <unistd.h>
 #include "gstvaapicompat.h"
 #include "gstvaapibufferproxy.h"
 #include "gstvaapibufferproxy_priv.h"
 #include "gstvaapisurface_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 
 #define DEBUG 1
@@ -45,10 +47,10 @@ gst_vaapi_buffer_proxy_acquire_handle (GstVaapiBufferProxy * proxy)
 
   display = GST_VAAPI_SURFACE_DISPLAY (GST_VAAPI_SURFACE (proxy->surface));
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaAcquireBufferHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       proxy->va_buf, &proxy->va_info);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaAcquireBufferHandle()"))
     return FALSE;
   if (proxy->va_info.mem_type != mem_type)
@@ -70,10 +72,10 @@ gst_vaapi_buffer_proxy_release_handle (GstVaapiBufferProxy * proxy)
 
   display = GST_VAAPI_SURFACE_DISPLAY (GST_VAAPI_SURFACE (proxy->surface));
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   va_status = vaReleaseBufferHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       proxy->va_buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (va_status, "vaReleaseBufferHandle()"))
     return FALSE;
   return TRUE;
@@ -84,6 +86,9 @@ gst_vaapi_buffer_proxy_finalize (GstVaapiBufferProxy * proxy)
 {
   gst_vaapi_buffer_proxy_release_handle (proxy);
 
+  if (proxy->owns_handle)
+    close ((gint) proxy->va_info.handle);
+
   /* Notify the user function that the object is now destroyed */
   if (proxy->destroy_func)
     proxy->destroy_func (proxy->destroy_data);
@@ -124,6 +129,9 @@ gst_vaapi_buffer_proxy_new (guintptr handle, guint type, gsize size,
   proxy->va_info.type = VAImageBufferType;
   proxy->va_info.mem_type = from_GstVaapiBufferMemoryType (proxy->type);
   proxy->va_info.mem_size = size;
+  proxy->modifier = DRM_FORMAT_MOD_INVALID;
+  proxy->num_planes = 0;
+  proxy->owns_handle = FALSE;
   if (!proxy->va_info.mem_type)
     goto error_unsupported_mem_type;
   return proxy;
@@ -157,6 +165,10 @@ gst_vaapi_buffer_proxy_new_from_surface (GstMiniObject * surface,
   proxy->va_buf = buf_id;
   memset (&proxy->va_info, 0, sizeof (proxy->va_info));
   proxy->va_info.mem_type = from_GstVaapiBufferMemoryType (proxy->type);
+  /* Derived images are always linear */
+  proxy->modifier = DRM_FORMAT_MOD_LINEAR;
+  proxy->num_planes = 0;
+  proxy->owns_handle = FALSE;
   if (!proxy->va_info.mem_type)
     goto error_unsupported_mem_type;
   if (!gst_vaapi_buffer_proxy_acquire_handle (proxy))
@@ -178,6 +190,61 @@ error_acquire_handle:
   }
 }
 
+/**
+ * gst_vaapi_buffer_proxy_new_from_export:
+ * @surface: the exported #GstVaapiSurface
+ * @fd: the DRM PRIME file descriptor
+ * @size: the size of the underlying DRM buffer
+ * @modifier: the DRM format modifier of the buffer
+ * @num_planes: the number of planes
+ * @offsets: the offset of each plane
+ * @strides: the pitch of each plane
+ *
+ * Creates a dma_buf #GstVaapiBufferProxy out of a surface exported
+ * with vaExportSurfaceHandle(). The proxy owns @fd, even on failure,
+ * and closes it when it is destroyed.
+ *
+ * Return value: the newly allocated #GstVaapiBufferProxy, or %NULL
+ */
+GstVaapiBufferProxy *
+gst_vaapi_buffer_proxy_new_from_export (GstMiniObject * surface, gint fd,
+    gsize size, guint64 modifier, guint num_planes, const gsize * offsets,
+    const gint * strides)
+{
+  GstVaapiBufferProxy *proxy;
+  guint i;
+
+  g_return_val_if_fail (surface != NULL, NULL);
+  g_return_val_if_fail (num_planes <= GST_VIDEO_MAX_PLANES, NULL);
+
+  proxy = (GstVaapiBufferProxy *)
+      gst_vaapi_mini_object_new (gst_vaapi_buffer_proxy_class ());
+  if (!proxy) {
+    close (fd);
+    return NULL;
+  }
+
+  proxy->surface = surface;
+  proxy->destroy_func = NULL;
+  proxy->destroy_data = NULL;
+  proxy->type = GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF;
+  proxy->va_buf = VA_INVALID_ID;
+  memset (&proxy->va_info, 0, sizeof (proxy->va_info));
+  proxy->va_info.handle = fd;
+  proxy->va_info.type = VAImageBufferType;
+  proxy->va_info.mem_type = from_GstVaapiBufferMemoryType (proxy->type);
+  proxy->va_info.mem_size = size;
+  proxy->owns_handle = TRUE;
+
+  proxy->modifier = modifier;
+  proxy->num_planes = num_planes;
+  for (i = 0; i < num_planes; i++) {
+    proxy->offsets[i] = offsets[i];
+    proxy->strides[i] = strides[i];
+  }
+  return proxy;
+}
+
 /**
  * gst_vaapi_buffer_proxy_ref:
  * @proxy: a #GstVaapiBufferProxy
@@ -295,3 +362,69 @@ gst_vaapi_buffer_proxy_release_data (GstVaapiBufferProxy * proxy)
     proxy->destroy_data = NULL;
   }
 }
+
+/**
+ * gst_vaapi_buffer_proxy_get_modifier:
+ * @proxy: a #GstVaapiBufferProxy
+ *
+ * Returns the DRM format modifier describing the tiling and the
+ * compression of the underlying buffer.
+ *
+ * Return value: the DRM format modifier, or DRM_FORMAT_MOD_INVALID if
+ *   it is unknown
+ */
+guint64
+gst_vaapi_buffer_proxy_get_modifier (GstVaapiBufferProxy * proxy)
+{
+  g_return_val_if_fail (proxy != NULL, DRM_FORMAT_MOD_INVALID);
+
+  return proxy->modifier;
+}
+
+/**
+ * gst_vaapi_buffer_proxy_get_num_planes:
+ * @proxy: a #GstVaapiBufferProxy
+ *
+ * Returns the number of planes the VA driver reported when the surface
+ * was exported, including the auxiliary planes of compressed layouts.
+ *
+ * Return value: the number of planes, or zero if the layout of the
+ *   underlying buffer is not known
+ */
+guint
+gst_vaapi_buffer_proxy_get_num_planes (GstVaapiBufferProxy * proxy)
+{
+  g_return_val_if_fail (proxy != NULL, 0);
+
+  return proxy->num_planes;
+}
+
+/**
+ * gst_vaapi_buffer_proxy_get_plane_layout:
+ * @proxy: a #GstVaapiBufferProxy
+ * @plane: the plane index
+ * @offset_ptr: (out) (optional): return location for the plane offset
+ * @stride_ptr: (out) (optional): return location for the plane pitch
+ *
+ * Retrieves the layout of @plane in the underlying buffer, as reported
+ * by the VA driver when the surface was exported. The layout of the
+ * buffers which were not exported with vaExportSurfaceHandle() is not
+ * known by the @proxy.
+ *
+ * Return value: %TRUE if the layout of @plane is known
+ */
+gboolean
+gst_vaapi_buffer_proxy_get_plane_layout (GstVaapiBufferProxy * proxy,
+    guint plane, gsize * offset_ptr, gint * stride_ptr)
+{
+  g_return_val_if_fail (proxy != NULL, FALSE);
+
+  if (plane >= proxy->num_planes)
+    return FALSE;
+
+  if (offset_ptr)
+    *offset_ptr = proxy->offsets[plane];
+  if (stride_ptr)
+    *stride_ptr = proxy->strides[plane];
+  return TRUE;
+}
@@ -101,6 +101,16 @@ gst_vaapi_buffer_proxy_get_size (GstVaapiBufferProxy * proxy);
 void
 gst_vaapi_buffer_proxy_release_data (GstVaapiBufferProxy * proxy);
 
+guint64
+gst_vaapi_buffer_proxy_get_modifier (GstVaapiBufferProxy * proxy);
+
+guint
+gst_vaapi_buffer_proxy_get_num_planes (GstVaapiBufferProxy * proxy);
+
+gboolean
+gst_vaapi_buffer_proxy_get_plane_layout (GstVaapiBufferProxy * proxy,
+    guint plane, gsize * offset_ptr, gint * stride_ptr);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_BUFFER_PROXY_H */
@@ -23,6 +23,7 @@
 #ifndef GST_VAAPI_BUFFER_PROXY_PRIV_H
 #define GST_VAAPI_BUFFER_PROXY_PRIV_H
 
+#include <gst/video/video.h>
 #include "gstvaapibufferproxy.h"
 #include "gstvaapiminiobject.h"
 
@@ -68,6 +69,13 @@ struct _GstVaapiBufferProxy {
   guint                 type;
   VABufferID            va_buf;
   VABufferInfo          va_info;
+
+  /* Layout of the surfaces exported with vaExportSurfaceHandle() */
+  guint64               modifier;
+  guint                 num_planes;
+  gsize                 offsets[GST_VIDEO_MAX_PLANES];
+  gint                  strides[GST_VIDEO_MAX_PLANES];
+  guint                 owns_handle:1;
 };
 
 G_GNUC_INTERNAL
@@ -75,6 +83,12 @@ GstVaapiBufferProxy *
 gst_vaapi_buffer_proxy_new_from_surface (GstMiniObject * surface,
     VABufferID buf_id, guint type, GDestroyNotify destroy_func, gpointer data);
 
+G_GNUC_INTERNAL
+GstVaapiBufferProxy *
+gst_vaapi_buffer_proxy_new_from_export (GstMiniObject * surface, gint fd,
+    gsize size, guint64 modifier, guint num_planes, const gsize * offsets,
+    const gint * strides);
+
 G_GNUC_INTERNAL
 guint
 from_GstVaapiBufferMemoryType (guint type);
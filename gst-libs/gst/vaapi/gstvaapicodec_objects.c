@@ -107,9 +107,386 @@ gst_vaapi_codec_object_new (const GstVaapiCodecObjectClass * object_class,
       param_size, 1, data, data_size, flags);
 }
 
+/* ------------------------------------------------------------------------- */
+/* --- VA Buffers Pool                                                   --- */
+/* ------------------------------------------------------------------------- */
+
+/* Maximum number of free VA buffers kept per (type, size) class */
+#define MAX_FREE_BUFFERS_PER_CLASS 32
+
+/* Minimum size class for slice data buffers */
+#define MIN_DATA_BUFFER_SIZE 4096
+
+/* Recycling VA buffers relies on vaRenderPicture() not destroying
+ * them implicitly, which is only guaranteed since VA-API 1.0 */
+#define USE_BUFFER_POOL VA_CHECK_VERSION(1,0,0)
+
+struct _GstVaapiCodecBufferPool
+{
+  GMutex mutex;
+  VADisplay va_display;
+  VAContextID va_context;
+  GHashTable *buffers;          /* VABufferID -> (guint64 *) key */
+  GHashTable *free_buffers;     /* (guint64 *) key -> GQueue of VABufferID */
+  guint64 hits;
+  guint64 misses;
+  guint64 va_calls;
+};
+
+/* Slice data buffers only need to be large enough, since the actual
+ * data size is conveyed through the slice parameters. Any other
+ * buffer needs to match the requested size */
+static inline gboolean
+buffer_type_is_sized (int type)
+{
+  return type == VASliceDataBufferType;
+}
+
+static guint
+buffer_size_class (int type, guint size)
+{
+  guint size_class;
+
+  if (!buffer_type_is_sized (type))
+    return size;
+
+  size_class = MIN_DATA_BUFFER_SIZE;
+  while (size_class < size && size_class < G_MAXUINT / 2)
+    size_class <<= 1;
+  return MAX (size_class, size);
+}
+
+static inline guint64
+buffer_key (int type, guint size, guint num_elements)
+{
+  return ((guint64) (type & 0xffff) << 48) |
+      ((guint64) (num_elements & 0xffff) << 32) | size;
+}
+
+static void
+free_buffers_queue_free (gpointer data)
+{
+  g_queue_free (data);
+}
+
+static void
+pool_destroy_free_buffers (GstVaapiCodecBufferPool * pool)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, pool->free_buffers);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GQueue *const queue = value;
+    VABufferID buf_id;
+
+    while (!g_queue_is_empty (queue)) {
+      buf_id = GPOINTER_TO_UINT (g_queue_pop_head (queue));
+      vaapi_destroy_buffer (pool->va_display, &buf_id);
+      pool->va_calls++;
+    }
+  }
+  g_hash_table_remove_all (pool->free_buffers);
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_new:
+ * @va_display: a VADisplay
+ *
+ * Creates a new pool of VA buffers, keyed by buffer type and size
+ * class, so that parameter and slice data buffers can be recycled
+ * across pictures instead of being created and destroyed for each
+ * of them.
+ *
+ * Return value: the newly allocated #GstVaapiCodecBufferPool
+ */
+GstVaapiCodecBufferPool *
+gst_vaapi_codec_buffer_pool_new (VADisplay va_display)
+{
+  GstVaapiCodecBufferPool *pool;
+
+  pool = g_slice_new0 (GstVaapiCodecBufferPool);
+  g_mutex_init (&pool->mutex);
+  pool->va_display = va_display;
+  pool->va_context = VA_INVALID_ID;
+  pool->buffers = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, g_free);
+  pool->free_buffers = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      g_free, free_buffers_queue_free);
+  return pool;
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_free:
+ * @pool: a #GstVaapiCodecBufferPool
+ *
+ * Destroys all the free VA buffers held in @pool, and @pool itself.
+ */
+void
+gst_vaapi_codec_buffer_pool_free (GstVaapiCodecBufferPool * pool)
+{
+  if (!pool)
+    return;
+
+  gst_vaapi_codec_buffer_pool_flush (pool);
+
+  GST_DEBUG ("buffer pool %p: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+      " misses", pool, pool->hits, pool->misses);
+
+  g_hash_table_unref (pool->free_buffers);
+  g_hash_table_unref (pool->buffers);
+  g_mutex_clear (&pool->mutex);
+  g_slice_free (GstVaapiCodecBufferPool, pool);
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_set_context:
+ * @pool: a #GstVaapiCodecBufferPool
+ * @va_context: the VA context new buffers are created for
+ *
+ * Binds @pool to @va_context. Buffers recycled for a previous VA
+ * context are destroyed.
+ */
+void
+gst_vaapi_codec_buffer_pool_set_context (GstVaapiCodecBufferPool * pool,
+    VAContextID va_context)
+{
+  g_return_if_fail (pool != NULL);
+
+  if (pool->va_context == va_context)
+    return;
+
+  gst_vaapi_codec_buffer_pool_flush (pool);
+  g_mutex_lock (&pool->mutex);
+  pool->va_context = va_context;
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_flush:
+ * @pool: a #GstVaapiCodecBufferPool
+ *
+ * Destroys all the free VA buffers held in @pool. Buffers currently
+ * in use are forgotten, and will be destroyed on release. This needs
+ * to be called before the underlying VA context is destroyed.
+ */
+void
+gst_vaapi_codec_buffer_pool_flush (GstVaapiCodecBufferPool * pool)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  pool_destroy_free_buffers (pool);
+  g_hash_table_remove_all (pool->buffers);
+  g_mutex_unlock (&pool->mutex);
+}
+
+static gboolean
+pool_create_buffer (GstVaapiCodecBufferPool * pool, int type, guint size,
+    guint size_class, guint num_elements, gconstpointer data,
+    VABufferID * buf_id_ptr)
+{
+  VABufferID buf_id;
+  gpointer buf;
+
+  /* Buffers of a larger size class cannot be initialized from data */
+  if (size_class == size || !data) {
+    pool->va_calls++;
+    return vaapi_create_n_elements_buffer (pool->va_display, pool->va_context,
+        type, size_class, data, buf_id_ptr, NULL, num_elements);
+  }
+
+  pool->va_calls += 3;
+  if (!vaapi_create_n_elements_buffer (pool->va_display, pool->va_context,
+          type, size_class, NULL, &buf_id, &buf, num_elements))
+    return FALSE;
+  memcpy (buf, data, size);
+  vaapi_unmap_buffer (pool->va_display, buf_id, NULL);
+  *buf_id_ptr = buf_id;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_acquire:
+ * @pool: a #GstVaapiCodecBufferPool
+ * @type: the VA buffer type
+ * @size: the size of one element, in bytes
+ * @num_elements: the number of elements
+ * @data: (allow-none): the data to initialize the buffer with
+ * @buf_id_ptr: (out): the VA buffer
+ * @mapped_data: (out) (allow-none): the mapped VA buffer contents
+ *
+ * Acquires a VA buffer of @type, either recycled from @pool or newly
+ * created, and initializes it with @data if not %NULL. If
+ * @mapped_data is not %NULL, the buffer is mapped.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_codec_buffer_pool_acquire (GstVaapiCodecBufferPool * pool,
+    int type, guint size, guint num_elements, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data)
+{
+  VABufferID buf_id = VA_INVALID_ID;
+  gboolean recycled = FALSE;
+  guint size_class;
+  guint64 key;
+  GQueue *queue;
+  gpointer buf;
+
+  g_return_val_if_fail (pool != NULL, FALSE);
+  g_return_val_if_fail (buf_id_ptr != NULL, FALSE);
+
+#if USE_BUFFER_POOL
+  size_class = buffer_size_class (type, size);
+#else
+  size_class = size;
+#endif
+  key = buffer_key (type, size_class, num_elements);
+
+  g_mutex_lock (&pool->mutex);
+  queue = g_hash_table_lookup (pool->free_buffers, &key);
+  if (queue && !g_queue_is_empty (queue)) {
+    buf_id = GPOINTER_TO_UINT (g_queue_pop_head (queue));
+    recycled = TRUE;
+    pool->hits++;
+  } else {
+    pool->misses++;
+    if (!pool_create_buffer (pool, type, size, size_class, num_elements, data,
+            &buf_id))
+      goto error;
+    data = NULL;
+  }
+
+  /* Recycled buffers need to be filled in through a mapping. Parameter
+     buffers are also cleared, since they are filled in field by field
+     and decoders only set the fields they use. Slice data is always
+     copied in full, and the tail of its size class is never read */
+  if (data || mapped_data) {
+    pool->va_calls++;
+    buf = vaapi_map_buffer (pool->va_display, buf_id);
+    if (!buf)
+      goto error;
+    if (recycled && !data && !buffer_type_is_sized (type))
+      memset (buf, 0, (gsize) size * num_elements);
+    if (data)
+      memcpy (buf, data, (gsize) size * num_elements);
+    if (mapped_data)
+      *mapped_data = buf;
+    else {
+      pool->va_calls++;
+      vaapi_unmap_buffer (pool->va_display, buf_id, NULL);
+    }
+  }
+
+#if USE_BUFFER_POOL
+  g_hash_table_insert (pool->buffers, GUINT_TO_POINTER (buf_id),
+      g_memdup2 (&key, sizeof (key)));
+#endif
+  g_mutex_unlock (&pool->mutex);
+
+  *buf_id_ptr = buf_id;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    if (buf_id != VA_INVALID_ID) {
+      pool->va_calls++;
+      vaapi_destroy_buffer (pool->va_display, &buf_id);
+    }
+    g_mutex_unlock (&pool->mutex);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_release:
+ * @pool: a #GstVaapiCodecBufferPool
+ * @buf_id_ptr: the VA buffer to release
+ * @mapped_data_ptr: (allow-none): the mapped VA buffer contents, if any
+ *
+ * Unmaps the VA buffer if @mapped_data_ptr points to mapped data,
+ * and returns it to @pool for later reuse. Buffers that were not
+ * acquired from @pool, or that cannot be kept, are destroyed.
+ * *@buf_id_ptr is reset to VA_INVALID_ID.
+ */
+void
+gst_vaapi_codec_buffer_pool_release (GstVaapiCodecBufferPool * pool,
+    VABufferID * buf_id_ptr, gpointer * mapped_data_ptr)
+{
+  VABufferID buf_id;
+  guint64 *key;
+  GQueue *queue;
+
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (buf_id_ptr != NULL);
+
+  buf_id = *buf_id_ptr;
+  if (buf_id == VA_INVALID_ID)
+    return;
+  *buf_id_ptr = VA_INVALID_ID;
+
+  g_mutex_lock (&pool->mutex);
+  if (mapped_data_ptr && *mapped_data_ptr) {
+    pool->va_calls++;
+    vaapi_unmap_buffer (pool->va_display, buf_id, mapped_data_ptr);
+  }
+
+  key = g_hash_table_lookup (pool->buffers, GUINT_TO_POINTER (buf_id));
+  if (!key)
+    goto destroy;
+  g_hash_table_steal (pool->buffers, GUINT_TO_POINTER (buf_id));
+
+  queue = g_hash_table_lookup (pool->free_buffers, key);
+  if (!queue) {
+    queue = g_queue_new ();
+    g_hash_table_insert (pool->free_buffers, key, queue);
+  } else {
+    g_free (key);
+    if (queue->length >= MAX_FREE_BUFFERS_PER_CLASS)
+      goto destroy;
+  }
+
+  /* Recycle buffers in FIFO order to give the driver as much time as
+     possible to be done with them */
+  g_queue_push_tail (queue, GUINT_TO_POINTER (buf_id));
+  g_mutex_unlock (&pool->mutex);
+  return;
+
+destroy:
+  pool->va_calls++;
+  vaapi_destroy_buffer (pool->va_display, &buf_id);
+  g_mutex_unlock (&pool->mutex);
+}
+
+/**
+ * gst_vaapi_codec_buffer_pool_get_stats:
+ * @pool: a #GstVaapiCodecBufferPool
+ * @hits_ptr: (out) (allow-none): the number of recycled buffers
+ * @misses_ptr: (out) (allow-none): the number of created buffers
+ * @va_calls_ptr: (out) (allow-none): the number of VA calls issued
+ *
+ * Retrieves the recycling statistics of @pool.
+ */
+void
+gst_vaapi_codec_buffer_pool_get_stats (GstVaapiCodecBufferPool * pool,
+    guint64 * hits_ptr, guint64 * misses_ptr, guint64 * va_calls_ptr)
+{
+  g_return_if_fail (pool != NULL);
+
+  g_mutex_lock (&pool->mutex);
+  if (hits_ptr)
+    *hits_ptr = pool->hits;
+  if (misses_ptr)
+    *misses_ptr = pool->misses;
+  if (va_calls_ptr)
+    *va_calls_ptr = pool->va_calls;
+  g_mutex_unlock (&pool->mutex);
+}
+
 #define GET_DECODER(obj)    GST_VAAPI_DECODER_CAST((obj)->parent_instance.codec)
-#define GET_VA_DISPLAY(obj) GET_DECODER(obj)->va_display
-#define GET_VA_CONTEXT(obj) GET_DECODER(obj)->va_context
+#define GET_BUFFER_POOL(obj) GET_DECODER(obj)->context->buffers_pool
 
 /* ------------------------------------------------------------------------- */
 /* --- Inverse Quantization Matrices                                     --- */
@@ -120,8 +497,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiIqMatrix, gst_vaapi_iq_matrix);
 void
 gst_vaapi_iq_matrix_destroy (GstVaapiIqMatrix * iq_matrix)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (iq_matrix), &iq_matrix->param_id);
-  iq_matrix->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (iq_matrix),
+      &iq_matrix->param_id, &iq_matrix->param);
 }
 
 gboolean
@@ -129,9 +506,9 @@ gst_vaapi_iq_matrix_create (GstVaapiIqMatrix * iq_matrix,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   iq_matrix->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (iq_matrix),
-      GET_VA_CONTEXT (iq_matrix), VAIQMatrixBufferType,
-      args->param_size, args->param, &iq_matrix->param_id, &iq_matrix->param);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (iq_matrix),
+      VAIQMatrixBufferType, args->param_size, 1, args->param,
+      &iq_matrix->param_id, &iq_matrix->param);
 }
 
 GstVaapiIqMatrix *
@@ -156,8 +533,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiBitPlane, gst_vaapi_bitplane);
 void
 gst_vaapi_bitplane_destroy (GstVaapiBitPlane * bitplane)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (bitplane), &bitplane->data_id);
-  bitplane->data = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (bitplane),
+      &bitplane->data_id, (void **) &bitplane->data);
 }
 
 gboolean
@@ -165,9 +542,9 @@ gst_vaapi_bitplane_create (GstVaapiBitPlane * bitplane,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   bitplane->data_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (bitplane),
-      GET_VA_CONTEXT (bitplane), VABitPlaneBufferType, args->param_size,
-      args->param, &bitplane->data_id, (void **) &bitplane->data);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (bitplane),
+      VABitPlaneBufferType, args->param_size, 1, args->param,
+      &bitplane->data_id, (void **) &bitplane->data);
 }
 
 
@@ -193,8 +570,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiHuffmanTable, gst_vaapi_huffman_table);
 void
 gst_vaapi_huffman_table_destroy (GstVaapiHuffmanTable * huf_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (huf_table), &huf_table->param_id);
-  huf_table->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (huf_table),
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 gboolean
@@ -202,9 +579,9 @@ gst_vaapi_huffman_table_create (GstVaapiHuffmanTable * huf_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   huf_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (huf_table),
-      GET_VA_CONTEXT (huf_table), VAHuffmanTableBufferType, args->param_size,
-      args->param, &huf_table->param_id, (void **) &huf_table->param);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (huf_table),
+      VAHuffmanTableBufferType, args->param_size, 1, args->param,
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 GstVaapiHuffmanTable *
@@ -226,8 +603,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiProbabilityTable,
 void
 gst_vaapi_probability_table_destroy (GstVaapiProbabilityTable * prob_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (prob_table), &prob_table->param_id);
-  prob_table->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (prob_table),
+      &prob_table->param_id, &prob_table->param);
 }
 
 gboolean
@@ -235,10 +612,9 @@ gst_vaapi_probability_table_create (GstVaapiProbabilityTable * prob_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   prob_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (prob_table),
-      GET_VA_CONTEXT (prob_table),
-      VAProbabilityBufferType,
-      args->param_size, args->param, &prob_table->param_id, &prob_table->param);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (prob_table),
+      VAProbabilityBufferType, args->param_size, 1, args->param,
+      &prob_table->param_id, &prob_table->param);
 }
 
 GstVaapiProbabilityTable *
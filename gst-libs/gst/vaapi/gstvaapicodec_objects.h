@@ -37,6 +37,7 @@ typedef struct _GstVaapiIqMatrix                GstVaapiIqMatrix;
 typedef struct _GstVaapiBitPlane                GstVaapiBitPlane;
 typedef struct _GstVaapiHuffmanTable            GstVaapiHuffmanTable;
 typedef struct _GstVaapiProbabilityTable        GstVaapiProbabilityTable;
+typedef struct _GstVaapiCodecBufferPool         GstVaapiCodecBufferPool;
 
 /* ------------------------------------------------------------------------- */
 /* --- Base Codec Object                                                 --- */
@@ -123,6 +124,43 @@ gst_vaapi_codec_object_new_with_param_num (const GstVaapiCodecObjectClass *
   gst_vaapi_mini_object_replace ((GstVaapiMiniObject **) (old_object_ptr), \
       GST_VAAPI_MINI_OBJECT (new_object))
 
+/* ------------------------------------------------------------------------- */
+/* --- VA Buffers Pool                                                   --- */
+/* ------------------------------------------------------------------------- */
+
+G_GNUC_INTERNAL
+GstVaapiCodecBufferPool *
+gst_vaapi_codec_buffer_pool_new (VADisplay va_display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_codec_buffer_pool_free (GstVaapiCodecBufferPool * pool);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_codec_buffer_pool_set_context (GstVaapiCodecBufferPool * pool,
+    VAContextID va_context);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_codec_buffer_pool_flush (GstVaapiCodecBufferPool * pool);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_codec_buffer_pool_acquire (GstVaapiCodecBufferPool * pool,
+    int type, guint size, guint num_elements, gconstpointer data,
+    VABufferID * buf_id_ptr, gpointer * mapped_data);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_codec_buffer_pool_release (GstVaapiCodecBufferPool * pool,
+    VABufferID * buf_id_ptr, gpointer * mapped_data_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_codec_buffer_pool_get_stats (GstVaapiCodecBufferPool * pool,
+    guint64 * hits_ptr, guint64 * misses_ptr, guint64 * va_calls_ptr);
+
 /* ------------------------------------------------------------------------- */
 /* --- Inverse Quantization Matrices                                     --- */
 /* ------------------------------------------------------------------------- */
@@ -25,6 +25,7 @@
 #include "gstvaapicodedbuffer.h"
 #include "gstvaapicodedbuffer_priv.h"
 #include "gstvaapiencoder_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 
 #define DEBUG 1
@@ -38,11 +39,11 @@ coded_buffer_create (GstVaapiCodedBuffer * buf, guint buf_size,
   VABufferID buf_id;
   gboolean success;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   success = vaapi_create_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CONTEXT_ID (context), VAEncCodedBufferType, buf_size,
       NULL, &buf_id, NULL);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!success)
     return FALSE;
 
@@ -61,9 +62,9 @@ coded_buffer_free (GstVaapiCodedBuffer * buf)
   GST_DEBUG ("coded buffer %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (buf_id));
 
   if (buf_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     vaapi_destroy_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display), &buf_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     GST_VAAPI_CODED_BUFFER_ID (buf) = VA_INVALID_ID;
   }
 
@@ -80,11 +81,11 @@ coded_buffer_map (GstVaapiCodedBuffer * buf)
   if (buf->segment_list)
     return TRUE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   buf->segment_list =
       vaapi_map_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CODED_BUFFER_ID (buf));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   return buf->segment_list != NULL;
 }
 
@@ -96,10 +97,10 @@ coded_buffer_unmap (GstVaapiCodedBuffer * buf)
   if (!buf->segment_list)
     return;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   vaapi_unmap_buffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_CODED_BUFFER_ID (buf), (void **) &buf->segment_list);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
 }
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstVaapiCodedBuffer, gst_vaapi_coded_buffer);
@@ -254,3 +254,68 @@ gst_vaapi_coded_buffer_proxy_set_user_data (GstVaapiCodedBufferProxy * proxy,
 
   coded_buffer_proxy_set_user_data (proxy, user_data, destroy_func);
 }
+
+/* Keeps the coded buffer mapped, and the proxy alive, until all the
+   memories wrapping its segments are released */
+typedef struct
+{
+  gint ref_count;
+  GstVaapiCodedBufferProxy *proxy;
+} CodedBufferMapping;
+
+static void
+coded_buffer_mapping_unref (CodedBufferMapping * mapping)
+{
+  if (!g_atomic_int_dec_and_test (&mapping->ref_count))
+    return;
+
+  gst_vaapi_coded_buffer_unmap (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER
+      (mapping->proxy));
+  gst_vaapi_coded_buffer_proxy_unref (mapping->proxy);
+  g_slice_free (CodedBufferMapping, mapping);
+}
+
+/**
+ * gst_vaapi_coded_buffer_proxy_wrap_buffer:
+ * @proxy: a #GstVaapiCodedBufferProxy
+ *
+ * Creates a #GstBuffer with one #GstMemory per segment of the
+ * underlying coded buffer, without copying the data. The memories are
+ * read-only since they map the driver coded buffer. The coded buffer
+ * stays mapped, and @proxy referenced, until all those memories are
+ * released; only then the coded buffer returns to its pool.
+ *
+ * Return value: the newly allocated #GstBuffer, or %NULL on error
+ */
+GstBuffer *
+gst_vaapi_coded_buffer_proxy_wrap_buffer (GstVaapiCodedBufferProxy * proxy)
+{
+  VACodedBufferSegment *segment;
+  CodedBufferMapping *mapping;
+  GstBuffer *buffer;
+  GstMemory *mem;
+
+  g_return_val_if_fail (proxy != NULL, NULL);
+
+  if (!gst_vaapi_coded_buffer_map (GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy),
+          &segment))
+    return NULL;
+
+  mapping = g_slice_new (CodedBufferMapping);
+  mapping->ref_count = 1;
+  mapping->proxy = gst_vaapi_coded_buffer_proxy_ref (proxy);
+
+  buffer = gst_buffer_new ();
+  for (; segment != NULL; segment = segment->next) {
+    if (segment->size == 0)
+      continue;
+
+    g_atomic_int_inc (&mapping->ref_count);
+    mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, segment->buf,
+        segment->size, 0, segment->size, mapping,
+        (GDestroyNotify) coded_buffer_mapping_unref);
+    gst_buffer_append_memory (buffer, mem);
+  }
+  coded_buffer_mapping_unref (mapping);
+  return buffer;
+}
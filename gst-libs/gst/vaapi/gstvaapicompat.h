@@ -38,4 +38,15 @@
 #include <va/va_compat.h>
 #include <va/va_drmcommon.h>
 
+/* drm_fourcc.h is only available along with libdrm */
+#if USE_DRM
+#include <drm_fourcc.h>
+#endif
+#ifndef DRM_FORMAT_MOD_LINEAR
+#define DRM_FORMAT_MOD_LINEAR 0ULL
+#endif
+#ifndef DRM_FORMAT_MOD_INVALID
+#define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
+#endif
+
 #endif /* GST_VAAPI_COMPAT_H */
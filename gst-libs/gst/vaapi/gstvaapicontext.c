@@ -30,12 +30,14 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapicontext.h"
+#include "gstvaapicodec_objects.h"
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapisurfacepool.h"
 #include "gstvaapisurfaceproxy.h"
 #include "gstvaapivideopool_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 
 /* Define default VA surface chroma format to YUV 4:2:0 */
 #define DEFAULT_CHROMA_TYPE (GST_VAAPI_CHROMA_TYPE_YUV420)
@@ -157,23 +159,22 @@ context_destroy (GstVaapiContext * context)
   context_id = GST_VAAPI_CONTEXT_ID (context);
   GST_DEBUG ("context 0x%08x / config 0x%08x", context_id, context->va_config);
 
+  /* VA buffers are bound to the VA context */
+  if (context->buffers_pool)
+    gst_vaapi_codec_buffer_pool_flush (context->buffers_pool);
+
   if (context_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
         context_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyContext()"))
       GST_WARNING ("failed to destroy context 0x%08x", context_id);
     GST_VAAPI_CONTEXT_ID (context) = VA_INVALID_ID;
   }
 
   if (context->va_config != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
-    status = vaDestroyConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
-        context->va_config);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
-    if (!vaapi_check_status (status, "vaDestroyConfig()"))
-      GST_WARNING ("failed to destroy config 0x%08x", context->va_config);
+    gst_vaapi_display_release_config (display, context->va_config);
     context->va_config = VA_INVALID_ID;
   }
 
@@ -254,6 +255,7 @@ context_create (GstVaapiContext * context)
   gboolean success = FALSE;
   guint i;
   gint num_surfaces = 0;
+  gint64 profile_start;
 
   if (!context->surfaces && !context_create_surfaces (context))
     goto cleanup;
@@ -283,15 +285,19 @@ context_create (GstVaapiContext * context)
     num_surfaces = surfaces->len;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateContext (GST_VAAPI_DISPLAY_VADISPLAY (display),
       context->va_config, cip->width, cip->height, VA_PROGRESSIVE,
       surfaces_data, num_surfaces, &context_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_CREATE_CONTEXT, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateContext()"))
     goto cleanup;
 
   GST_VAAPI_CONTEXT_ID (context) = context_id;
+  gst_vaapi_codec_buffer_pool_set_context (context->buffers_pool, context_id);
   success = TRUE;
 
 cleanup:
@@ -306,7 +312,6 @@ config_create (GstVaapiContext * context)
   const GstVaapiContextInfo *const cip = &context->info;
   GstVaapiDisplay *const display = GST_VAAPI_CONTEXT_DISPLAY (context);
   VAConfigAttrib attribs[7], *attrib;
-  VAStatus status;
   guint value, va_chroma_format, attrib_index;
 
   /* Reset profile and entrypoint */
@@ -414,12 +419,8 @@ config_create (GstVaapiContext * context)
       break;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
-  status = vaCreateConfig (GST_VAAPI_DISPLAY_VADISPLAY (display),
-      context->va_profile, context->va_entrypoint, attribs, attrib_index,
-      &context->va_config);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
-  if (!vaapi_check_status (status, "vaCreateConfig()"))
+  if (!gst_vaapi_display_acquire_config (display, context->va_profile,
+          context->va_entrypoint, attribs, attrib_index, &context->va_config))
     goto cleanup;
 
   return TRUE;
@@ -509,6 +510,8 @@ gst_vaapi_context_new (GstVaapiDisplay * display,
   g_atomic_int_set (&context->ref_count, 1);
   context->surfaces = NULL;
   context->surfaces_pool = NULL;
+  context->buffers_pool =
+      gst_vaapi_codec_buffer_pool_new (GST_VAAPI_DISPLAY_VADISPLAY (display));
 
   gst_vaapi_context_init (context, cip);
 
@@ -782,6 +785,7 @@ gst_vaapi_context_unref (GstVaapiContext * context)
   if (g_atomic_int_dec_and_test (&context->ref_count)) {
     context_destroy (context);
     context_destroy_surfaces (context);
+    gst_vaapi_codec_buffer_pool_free (context->buffers_pool);
     gst_vaapi_display_replace (&context->display, NULL);
     g_slice_free (GstVaapiContext, context);
   }
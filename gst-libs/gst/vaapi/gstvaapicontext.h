@@ -111,6 +111,7 @@ struct _GstVaapiContext
   VAConfigID va_config;
   GPtrArray *surfaces;
   GstVaapiVideoPool *surfaces_pool;
+  struct _GstVaapiCodecBufferPool *buffers_pool;
   gboolean reset_on_resize;
   GstVaapiConfigSurfaceAttributes *attribs;
   GstVideoFormat preferred_format;
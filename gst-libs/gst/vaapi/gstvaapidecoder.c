@@ -31,8 +31,11 @@
 #include "gstvaapicompat.h"
 #include "gstvaapidecoder.h"
 #include "gstvaapidecoder_priv.h"
+#include "gstvaapicodec_objects.h"
+#include "gstvaapidecoder_objects.h"
 #include "gstvaapiparser_frame.h"
 #include "gstvaapisurfaceproxy_priv.h"
+#include "gstvaapitrace.h"
 #include "gstvaapiutils.h"
 
 #define DEBUG 1
@@ -49,6 +52,8 @@ static GParamSpec *g_properties[N_PROPERTIES] = { NULL, };
 G_DEFINE_TYPE (GstVaapiDecoder, gst_vaapi_decoder, GST_TYPE_OBJECT);
 
 static void drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame);
+static inline void push_frame (GstVaapiDecoder * decoder,
+    GstVideoCodecFrame * frame);
 
 static void
 parser_state_reset (GstVaapiParserState * ps)
@@ -65,6 +70,7 @@ parser_state_reset (GstVaapiParserState * ps)
     ps->next_unit_pending = FALSE;
   }
 
+  ps->decode_frame = NULL;
   ps->current_frame_number = 0;
   ps->input_offset1 = ps->input_offset2 = 0;
   ps->at_eos = FALSE;
@@ -161,6 +167,7 @@ do_parse (GstVaapiDecoder * decoder,
   GstVaapiParserFrame *frame;
   GstVaapiDecoderUnit *unit;
   GstVaapiDecoderStatus status;
+  gint64 trace_start;
 
   *got_unit_size_ptr = 0;
   *got_frame_ptr = FALSE;
@@ -186,8 +193,11 @@ do_parse (GstVaapiDecoder * decoder,
   gst_vaapi_decoder_unit_init (unit);
 
   ps->current_frame = base_frame;
+  trace_start = gst_vaapi_trace_begin ();
   status = GST_VAAPI_DECODER_GET_CLASS (decoder)->parse (decoder,
       adapter, at_eos, unit);
+  gst_vaapi_trace_end (trace_start, "parse", base_frame->system_frame_number,
+      GST_VAAPI_TRACE_NO_SURFACE);
   if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
     if (at_eos && frame->units->len > 0 &&
         status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
@@ -280,12 +290,16 @@ do_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * base_frame)
   GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiParserFrame *const frame = base_frame->user_data;
   GstVaapiDecoderStatus status;
+  gint64 trace_start;
 
-  ps->current_frame = base_frame;
+  ps->decode_frame = base_frame;
 
+  trace_start = gst_vaapi_trace_begin ();
   gst_vaapi_parser_frame_ref (frame);
   status = do_decode_1 (decoder, frame);
   gst_vaapi_parser_frame_unref (frame);
+  gst_vaapi_trace_end (trace_start, "decode", base_frame->system_frame_number,
+      GST_VAAPI_TRACE_NO_SURFACE);
 
   switch ((guint) status) {
     case GST_VAAPI_DECODER_STATUS_DROP_FRAME:
@@ -296,8 +310,80 @@ do_decode (GstVaapiDecoder * decoder, GstVideoCodecFrame * base_frame)
   return status;
 }
 
+static void
+push_input_buffer (GstVaapiParserState * ps, GstBuffer * buffer)
+{
+  ps->at_eos = GST_BUFFER_IS_EOS (buffer);
+  if (!ps->at_eos)
+    gst_adapter_push (ps->input_adapter, buffer);
+  else
+    gst_buffer_unref (buffer);
+}
+
+/* Takes all the units of the current frame out of the output adapter.
+   If they are contiguous regions of a single memory, which is the
+   case for packetized input aligned on access units, the frame buffer
+   shares that memory instead of concatenating the units */
+static GstBuffer *
+take_frame_buffer (GstVaapiDecoder * decoder, GstAdapter * adapter)
+{
+  const gsize size = gst_adapter_available (adapter);
+  GstBufferList *list;
+  GstBuffer *buffer, *first_buffer;
+  GstMemory *first_mem, *prev_mem, *mem;
+  gsize offset = 0;
+  guint i, n;
+
+  if (gst_adapter_available_fast (adapter) >= size)
+    return gst_adapter_take_buffer (adapter, size);
+
+  list = gst_adapter_get_buffer_list (adapter, size);
+  if (!list)
+    goto copy;
+
+  n = gst_buffer_list_length (list);
+  first_buffer = gst_buffer_list_get (list, 0);
+  first_mem = prev_mem = NULL;
+  for (i = 0; i < n; i++) {
+    GstBuffer *const buf = gst_buffer_list_get (list, i);
+    gsize mem_offset;
+
+    if (gst_buffer_n_memory (buf) != 1)
+      break;
+    mem = gst_buffer_peek_memory (buf, 0);
+    if (mem->size != gst_buffer_get_size (buf))
+      break;
+    if (prev_mem) {
+      if (!gst_memory_is_span (prev_mem, mem, &mem_offset))
+        break;
+      if (prev_mem == first_mem)
+        offset = mem_offset;
+    } else
+      first_mem = mem;
+    prev_mem = mem;
+  }
+  if (i < n) {
+    gst_buffer_list_unref (list);
+    goto copy;
+  }
+
+  buffer = gst_buffer_new ();
+  gst_buffer_copy_into (buffer, first_buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+  gst_buffer_append_memory (buffer,
+      gst_memory_share (first_mem->parent, offset, size));
+  gst_buffer_list_unref (list);
+  gst_adapter_flush (adapter, size);
+  return buffer;
+
+copy:
+  GST_VAAPI_DECODER_ADD_BYTES_COPIED (decoder, size);
+  return gst_adapter_take_buffer (adapter, size);
+}
+
+/* Parses queued input until a complete frame is found. On success,
+   *out_frame_ptr holds that frame, or NULL if more data is needed */
 static GstVaapiDecoderStatus
-decode_step (GstVaapiDecoder * decoder)
+parse_step (GstVaapiDecoder * decoder, GstVideoCodecFrame ** out_frame_ptr)
 {
   GstVaapiParserState *const ps = &decoder->parser_state;
   GstVaapiDecoderStatus status;
@@ -305,18 +391,17 @@ decode_step (GstVaapiDecoder * decoder)
   gboolean got_frame;
   guint got_unit_size, input_size;
 
+  *out_frame_ptr = NULL;
+
   /* Fill adapter with all buffers we have in the queue */
   for (;;) {
     buffer = pop_buffer (decoder);
     if (!buffer)
       break;
-
-    ps->at_eos = GST_BUFFER_IS_EOS (buffer);
-    if (!ps->at_eos)
-      gst_adapter_push (ps->input_adapter, buffer);
+    push_input_buffer (ps, buffer);
   }
 
-  /* Parse and decode all decode units */
+  /* Parse all decode units of the next frame */
   input_size = gst_adapter_available (ps->input_adapter);
   if (input_size == 0) {
     if (ps->at_eos)
@@ -354,13 +439,9 @@ decode_step (GstVaapiDecoder * decoder)
 
     if (got_frame) {
       ps->current_frame->input_buffer =
-          gst_adapter_take_buffer (ps->output_adapter,
-          gst_adapter_available (ps->output_adapter));
+          take_frame_buffer (decoder, ps->output_adapter);
 
-      status = do_decode (decoder, ps->current_frame);
-      GST_DEBUG ("decode frame (status = %d)", status);
-
-      gst_video_codec_frame_unref (ps->current_frame);
+      *out_frame_ptr = ps->current_frame;
       ps->current_frame = NULL;
       break;
     }
@@ -368,6 +449,331 @@ decode_step (GstVaapiDecoder * decoder)
   return status;
 }
 
+static GstVaapiDecoderStatus
+decode_step (GstVaapiDecoder * decoder)
+{
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+
+  status = parse_step (decoder, &frame);
+  if (!frame)
+    return status;
+
+  status = do_decode (decoder, frame);
+  GST_DEBUG ("decode frame (status = %d)", status);
+
+  decoder->parser_state.decode_frame = NULL;
+  gst_video_codec_frame_unref (frame);
+  return status;
+}
+
+/* A job of the submit thread, in decode order: either a picture to
+   submit to the hardware, or a frame to output once all the pictures
+   queued before it were submitted */
+typedef struct
+{
+  GstVaapiPicture *picture;
+  VASurfaceID surface_id;
+  gint frame_number;
+  GstVideoCodecFrame *frame;
+} PipelineJob;
+
+static void
+pipeline_job_free (PipelineJob * job)
+{
+  gst_vaapi_picture_replace (&job->picture, NULL);
+  if (job->frame)
+    gst_video_codec_frame_unref (job->frame);
+  g_slice_free (PipelineJob, job);
+}
+
+static inline void
+pipeline_set_error_unlocked (GstVaapiDecoder * decoder,
+    GstVaapiDecoderStatus status)
+{
+  if (decoder->pipeline_error == GST_VAAPI_DECODER_STATUS_SUCCESS)
+    decoder->pipeline_error = status;
+}
+
+/* Queues a job for the submit thread, if called from the decode
+   thread. Otherwise, the pipeline is idle or stopped and the caller
+   handles the job itself */
+static gboolean
+pipeline_queue_job (GstVaapiDecoder * decoder, GstVaapiPicture * picture,
+    VASurfaceID surface_id, gint frame_number, GstVideoCodecFrame * frame)
+{
+  PipelineJob *job;
+
+  if (!decoder->decode_thread || g_thread_self () != decoder->decode_thread)
+    return FALSE;
+
+  job = g_slice_new0 (PipelineJob);
+  if (picture)
+    job->picture = gst_vaapi_picture_ref (picture);
+  job->surface_id = surface_id;
+  job->frame_number = frame_number;
+  if (frame)
+    job->frame = gst_video_codec_frame_ref (frame);
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  while (picture && g_queue_get_length (&decoder->submit_jobs) >=
+      decoder->pipeline_depth && !decoder->pipeline_stopping)
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  g_queue_push_tail (&decoder->submit_jobs, job);
+  g_cond_broadcast (&decoder->pipeline_cond);
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return TRUE;
+}
+
+/* Waits for the submit thread to issue all the queued VA calls, e.g.
+   before the VA context is reset, if called from the decode thread */
+static void
+pipeline_wait_submitted (GstVaapiDecoder * decoder)
+{
+  if (!decoder->decode_thread || g_thread_self () != decoder->decode_thread)
+    return;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  while ((!g_queue_is_empty (&decoder->submit_jobs) || decoder->submit_busy)
+      && !decoder->pipeline_stopping)
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  g_mutex_unlock (&decoder->pipeline_lock);
+}
+
+/* Decode thread of the pipelined mode: parses input buffers into
+   frames and decodes them. The codec state is only ever accessed
+   from this thread, the VA pictures are submitted by the submit
+   thread */
+static gpointer
+pipeline_decode_thread (gpointer data)
+{
+  GstVaapiDecoder *const decoder = data;
+  GstVaapiParserState *const ps = &decoder->parser_state;
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+  GstBuffer *buffer;
+  gboolean stopping;
+
+  for (;;) {
+    status = parse_step (decoder, &frame);
+    if (frame) {
+      status = do_decode (decoder, frame);
+      GST_DEBUG ("decode frame (status = %d)", status);
+
+      ps->decode_frame = NULL;
+      gst_video_codec_frame_unref (frame);
+
+      g_mutex_lock (&decoder->pipeline_lock);
+      if (status != GST_VAAPI_DECODER_STATUS_SUCCESS)
+        pipeline_set_error_unlocked (decoder, status);
+      stopping = decoder->pipeline_stopping;
+      g_mutex_unlock (&decoder->pipeline_lock);
+      if (stopping)
+        break;
+      continue;
+    }
+    if (status == GST_VAAPI_DECODER_STATUS_SUCCESS)
+      continue;
+    if (status != GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA)
+      break;
+
+    /* Wait for more input */
+    g_mutex_lock (&decoder->pipeline_lock);
+    decoder->decode_waiting = TRUE;
+    g_cond_broadcast (&decoder->pipeline_cond);
+    g_mutex_unlock (&decoder->pipeline_lock);
+
+    buffer = g_async_queue_pop (decoder->buffers);
+
+    g_mutex_lock (&decoder->pipeline_lock);
+    decoder->decode_waiting = FALSE;
+    stopping = decoder->pipeline_stopping;
+    g_mutex_unlock (&decoder->pipeline_lock);
+    if (stopping) {
+      gst_buffer_unref (buffer);
+      break;
+    }
+    push_input_buffer (ps, buffer);
+  }
+
+  GST_DEBUG ("decode thread exits (status = %d)", status);
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  decoder->decode_status = status;
+  decoder->decode_done = TRUE;
+  g_cond_broadcast (&decoder->pipeline_cond);
+  g_mutex_unlock (&decoder->pipeline_lock);
+  return NULL;
+}
+
+/* Submit thread of the pipelined mode: issues the VA calls of the
+   decoded pictures and outputs the frames, in decode order */
+static gpointer
+pipeline_submit_thread (gpointer data)
+{
+  GstVaapiDecoder *const decoder = data;
+  PipelineJob *job;
+  gboolean success;
+
+  for (;;) {
+    g_mutex_lock (&decoder->pipeline_lock);
+    while (g_queue_is_empty (&decoder->submit_jobs) &&
+        !decoder->pipeline_stopping)
+      g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+    job = NULL;
+    if (!decoder->pipeline_stopping)
+      job = g_queue_pop_head (&decoder->submit_jobs);
+    decoder->submit_busy = (job != NULL);
+    g_cond_broadcast (&decoder->pipeline_cond);
+    g_mutex_unlock (&decoder->pipeline_lock);
+    if (!job)
+      break;
+
+    success = TRUE;
+    if (job->picture)
+      success = gst_vaapi_picture_submit (job->picture, job->surface_id,
+          job->frame_number);
+    if (job->frame)
+      push_frame (decoder, job->frame);
+    pipeline_job_free (job);
+
+    g_mutex_lock (&decoder->pipeline_lock);
+    if (!success)
+      pipeline_set_error_unlocked (decoder,
+          GST_VAAPI_DECODER_STATUS_ERROR_UNKNOWN);
+    decoder->submit_busy = FALSE;
+    g_cond_broadcast (&decoder->pipeline_cond);
+    g_mutex_unlock (&decoder->pipeline_lock);
+  }
+  return NULL;
+}
+
+static void
+pipeline_stop (GstVaapiDecoder * decoder)
+{
+  PipelineJob *job;
+
+  if (!decoder->decode_thread && !decoder->submit_thread)
+    return;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  decoder->pipeline_stopping = TRUE;
+  g_cond_broadcast (&decoder->pipeline_cond);
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  /* Wake up the decode thread if it is waiting for input */
+  push_buffer (decoder, NULL);
+
+  if (decoder->decode_thread) {
+    g_thread_join (decoder->decode_thread);
+    decoder->decode_thread = NULL;
+  }
+  if (decoder->submit_thread) {
+    g_thread_join (decoder->submit_thread);
+    decoder->submit_thread = NULL;
+  }
+
+  while ((job = g_queue_pop_head (&decoder->submit_jobs)) != NULL)
+    pipeline_job_free (job);
+}
+
+static gboolean
+pipeline_start (GstVaapiDecoder * decoder)
+{
+  if (decoder->decode_thread)
+    return TRUE;
+
+  GST_DEBUG ("start pipelined decoding (depth %u)", decoder->pipeline_depth);
+
+  decoder->decode_status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  decoder->pipeline_error = GST_VAAPI_DECODER_STATUS_SUCCESS;
+  decoder->pipeline_stopping = FALSE;
+  decoder->decode_waiting = FALSE;
+  decoder->decode_done = FALSE;
+  decoder->submit_busy = FALSE;
+
+  decoder->submit_thread = g_thread_try_new ("vaapi-submit",
+      pipeline_submit_thread, decoder, NULL);
+  if (!decoder->submit_thread)
+    goto error;
+
+  decoder->decode_thread = g_thread_try_new ("vaapi-decode",
+      pipeline_decode_thread, decoder, NULL);
+  if (!decoder->decode_thread)
+    goto error;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    GST_ERROR ("failed to create decoding threads");
+    pipeline_stop (decoder);
+    return FALSE;
+  }
+}
+
+/* Checks whether all queued input was decoded and submitted */
+static inline gboolean
+pipeline_is_idle_unlocked (GstVaapiDecoder * decoder)
+{
+  if (!g_queue_is_empty (&decoder->submit_jobs) || decoder->submit_busy)
+    return FALSE;
+  if (decoder->decode_done)
+    return TRUE;
+  return decoder->decode_waiting &&
+      g_async_queue_length (decoder->buffers) <= 0;
+}
+
+static void
+pipeline_wait_idle (GstVaapiDecoder * decoder)
+{
+  if (!decoder->decode_thread)
+    return;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  while (!pipeline_is_idle_unlocked (decoder))
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  g_mutex_unlock (&decoder->pipeline_lock);
+}
+
+/* Waits for the next decoded frame, or until the pipeline ran out of
+   input data */
+static GstVaapiDecoderStatus
+pipeline_pop_frame (GstVaapiDecoder * decoder,
+    GstVideoCodecFrame ** out_frame_ptr)
+{
+  GstVaapiDecoderStatus status;
+  GstVideoCodecFrame *frame;
+
+  *out_frame_ptr = NULL;
+  if (!pipeline_start (decoder))
+    return GST_VAAPI_DECODER_STATUS_ERROR_ALLOCATION_FAILED;
+
+  g_mutex_lock (&decoder->pipeline_lock);
+  for (;;) {
+    frame = pop_frame (decoder, 0);
+    if (frame) {
+      status = GST_VAAPI_DECODER_STATUS_SUCCESS;
+      break;
+    }
+    if (decoder->pipeline_error != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+      status = decoder->pipeline_error;
+      decoder->pipeline_error = GST_VAAPI_DECODER_STATUS_SUCCESS;
+      break;
+    }
+    if (pipeline_is_idle_unlocked (decoder)) {
+      status = decoder->decode_done ? decoder->decode_status :
+          GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA;
+      break;
+    }
+    g_cond_wait (&decoder->pipeline_cond, &decoder->pipeline_lock);
+  }
+  g_mutex_unlock (&decoder->pipeline_lock);
+
+  *out_frame_ptr = frame;
+  return status;
+}
+
 static void
 drop_frame (GstVaapiDecoder * decoder, GstVideoCodecFrame * frame)
 {
@@ -459,6 +865,10 @@ gst_vaapi_decoder_finalize (GObject * object)
 {
   GstVaapiDecoder *const decoder = GST_VAAPI_DECODER (object);
 
+  pipeline_stop (decoder);
+  g_mutex_clear (&decoder->pipeline_lock);
+  g_cond_clear (&decoder->pipeline_cond);
+
   gst_video_codec_state_unref (decoder->codec_state);
   decoder->codec_state = NULL;
 
@@ -566,6 +976,7 @@ static void
 gst_vaapi_decoder_init (GstVaapiDecoder * decoder)
 {
   GstVideoCodecState *codec_state;
+  const gchar *env;
 
   parser_state_init (&decoder->parser_state);
 
@@ -575,9 +986,18 @@ gst_vaapi_decoder_init (GstVaapiDecoder * decoder)
 
   decoder->va_context = VA_INVALID_ID;
   decoder->codec_state = codec_state;
+  env = g_getenv ("GST_VAAPI_BATCH_SLICES");
+  decoder->batch_slices = env && g_ascii_strtoull (env, NULL, 10) != 0;
   decoder->buffers = g_async_queue_new_full ((GDestroyNotify) gst_buffer_unref);
   decoder->frames = g_async_queue_new_full ((GDestroyNotify)
       gst_video_codec_frame_unref);
+
+  g_mutex_init (&decoder->pipeline_lock);
+  g_cond_init (&decoder->pipeline_cond);
+  g_queue_init (&decoder->submit_jobs);
+  env = g_getenv ("GST_VAAPI_DECODER_PIPELINE");
+  if (env)
+    decoder->pipeline_depth = MIN (g_ascii_strtoull (env, NULL, 10), 64);
 }
 
 /**
@@ -714,6 +1134,9 @@ gst_vaapi_decoder_get_caps (GstVaapiDecoder * decoder)
 gboolean
 gst_vaapi_decoder_put_buffer (GstVaapiDecoder * decoder, GstBuffer * buf)
 {
+  gint64 trace_start;
+  gboolean success;
+
   g_return_val_if_fail (decoder != NULL, FALSE);
 
   if (buf) {
@@ -721,7 +1144,12 @@ gst_vaapi_decoder_put_buffer (GstVaapiDecoder * decoder, GstBuffer * buf)
       return TRUE;
     buf = gst_buffer_ref (buf);
   }
-  return push_buffer (decoder, buf);
+
+  trace_start = gst_vaapi_trace_begin ();
+  success = push_buffer (decoder, buf);
+  gst_vaapi_trace_end (trace_start, "put_buffer", GST_VAAPI_TRACE_NO_FRAME,
+      GST_VAAPI_TRACE_NO_SURFACE);
+  return success;
 }
 
 /**
@@ -751,7 +1179,10 @@ gst_vaapi_decoder_get_surface (GstVaapiDecoder * decoder,
       GST_VAAPI_DECODER_STATUS_ERROR_INVALID_PARAMETER);
 
   do {
-    frame = pop_frame (decoder, 0);
+    if (decoder->pipeline_depth > 0)
+      status = pipeline_pop_frame (decoder, &frame);
+    else
+      frame = pop_frame (decoder, 0);
     while (frame) {
       if (!GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY (frame)) {
         GstVaapiSurfaceProxy *const proxy = frame->user_data;
@@ -764,7 +1195,8 @@ gst_vaapi_decoder_get_surface (GstVaapiDecoder * decoder,
       gst_video_codec_frame_unref (frame);
       frame = pop_frame (decoder, 0);
     }
-    status = decode_step (decoder);
+    if (decoder->pipeline_depth == 0)
+      status = decode_step (decoder);
   } while (status == GST_VAAPI_DECODER_STATUS_SUCCESS);
 
   *out_proxy_ptr = NULL;
@@ -971,18 +1403,51 @@ gboolean
 gst_vaapi_decoder_ensure_context (GstVaapiDecoder * decoder,
     GstVaapiContextInfo * cip)
 {
+  const GstVideoInfo *const vip = &decoder->codec_state->info;
+  GstVaapiContextInfo info;
+  gboolean resized;
+  gint64 start_time;
+
+  /* The queued pictures are to be submitted to the current context */
+  pipeline_wait_submitted (decoder);
+
+  resized = decoder->context && (GST_VIDEO_INFO_WIDTH (vip) != cip->width
+      || GST_VIDEO_INFO_HEIGHT (vip) != cip->height);
   gst_vaapi_decoder_set_picture_size (decoder, cip->width, cip->height);
 
   cip->usage = GST_VAAPI_CONTEXT_USAGE_DECODE;
+
+  info = *cip;
+  if (decoder->reserve_surfaces) {
+    decoder->reserved_width = MAX (decoder->reserved_width,
+        MAX (decoder->reserve_max_width, cip->width));
+    decoder->reserved_height = MAX (decoder->reserved_height,
+        MAX (decoder->reserve_max_height, cip->height));
+    info.width = decoder->reserved_width;
+    info.height = decoder->reserved_height;
+  }
+
+  start_time = g_get_monotonic_time ();
   if (decoder->context) {
-    if (!gst_vaapi_context_reset (decoder->context, cip))
+    if (!gst_vaapi_context_reset (decoder->context, &info))
       return FALSE;
   } else {
-    decoder->context = gst_vaapi_context_new (decoder->display, cip);
+    decoder->context = gst_vaapi_context_new (decoder->display, &info);
     if (!decoder->context)
       return FALSE;
   }
   decoder->va_context = gst_vaapi_context_get_id (decoder->context);
+
+  if (resized) {
+    const gint64 stall = g_get_monotonic_time () - start_time;
+
+    decoder->num_resizes++;
+    decoder->resize_stall_last = stall;
+    decoder->resize_stall_total += stall;
+    GST_INFO ("resolution switch to %ux%u took %" G_GINT64_FORMAT " us "
+        "(%ux%u surfaces)", cip->width, cip->height, stall, info.width,
+        info.height);
+  }
   return TRUE;
 }
 
@@ -990,9 +1455,25 @@ void
 gst_vaapi_decoder_push_frame (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * frame)
 {
+  /* In pipelined mode, the frame is output once its picture and all
+     the pictures it depends on were submitted */
+  if (pipeline_queue_job (decoder, NULL, VA_INVALID_SURFACE, 0, frame))
+    return;
   push_frame (decoder, frame);
 }
 
+/* Hands the VA calls of @picture over to the submit thread, in
+   pipelined mode. Returns FALSE if the caller is to submit @picture
+   itself */
+gboolean
+gst_vaapi_decoder_queue_picture (GstVaapiDecoder * decoder,
+    struct _GstVaapiPicture * picture, VASurfaceID surface_id,
+    gint frame_number)
+{
+  return pipeline_queue_job (decoder, picture, surface_id, frame_number,
+      NULL);
+}
+
 GstVaapiDecoderStatus
 gst_vaapi_decoder_parse (GstVaapiDecoder * decoder,
     GstVideoCodecFrame * base_frame, GstAdapter * adapter, gboolean at_eos,
@@ -1039,6 +1520,9 @@ gst_vaapi_decoder_flush (GstVaapiDecoder * decoder)
 
   klass = GST_VAAPI_DECODER_GET_CLASS (decoder);
 
+  /* Make sure all queued frames were submitted first */
+  pipeline_wait_idle (decoder);
+
   if (klass->flush)
     return klass->flush (decoder);
 
@@ -1061,6 +1545,8 @@ gst_vaapi_decoder_reset (GstVaapiDecoder * decoder)
 
   GST_DEBUG ("Resetting decoder");
 
+  pipeline_stop (decoder);
+
   if (klass->reset) {
     ret = klass->reset (decoder);
   } else {
@@ -1211,3 +1697,334 @@ gst_vaapi_decoder_get_surface_attributes (GstVaapiDecoder * decoder,
     *mem_types = attribs.mem_types;
   return attribs.formats;
 }
+
+/**
+ * gst_vaapi_decoder_set_slice_batching:
+ * @decoder: a #GstVaapiDecoder
+ * @batch_slices: %TRUE to submit all slices of a picture at once
+ *
+ * If @batch_slices is %TRUE, the slice data of a whole picture is
+ * gathered into a single VA slice data buffer, the slice parameters
+ * into a single n-element VA slice parameter buffer, and both are
+ * submitted with one vaRenderPicture() call. Otherwise, each slice
+ * gets its own pair of VA buffers and its own vaRenderPicture() call.
+ *
+ * The default value can be overridden with the GST_VAAPI_BATCH_SLICES
+ * environment variable, set to a non-zero number. The change takes effect on the next created
+ * slices.
+ */
+void
+gst_vaapi_decoder_set_slice_batching (GstVaapiDecoder * decoder,
+    gboolean batch_slices)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->batch_slices = batch_slices;
+}
+
+/**
+ * gst_vaapi_decoder_get_slice_batching:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Return value: %TRUE if all slices of a picture are submitted at once
+ */
+gboolean
+gst_vaapi_decoder_get_slice_batching (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  return decoder->batch_slices;
+}
+
+/**
+ * gst_vaapi_decoder_get_va_call_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @last_picture_ptr: (out) (allow-none): the number of VA calls issued
+ *   for the last submitted picture
+ * @total_ptr: (out) (allow-none): the total number of VA calls issued
+ *   for picture decoding
+ * @num_pictures_ptr: (out) (allow-none): the number of submitted pictures
+ *
+ * Retrieves the number of libva calls (buffer creation, mapping,
+ * rendering and destruction, begin/end picture) issued by the
+ * @decoder to submit pictures to the hardware.
+ */
+void
+gst_vaapi_decoder_get_va_call_stats (GstVaapiDecoder * decoder,
+    guint * last_picture_ptr, guint64 * total_ptr, guint64 * num_pictures_ptr)
+{
+  g_return_if_fail (decoder != NULL);
+
+  if (last_picture_ptr)
+    *last_picture_ptr = decoder->va_calls_last_picture;
+  if (total_ptr)
+    *total_ptr = decoder->va_calls_mark;
+  if (num_pictures_ptr)
+    *num_pictures_ptr = decoder->va_pictures;
+}
+
+/**
+ * gst_vaapi_decoder_get_buffer_pool_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @hits_ptr: (out) (allow-none): the number of recycled VA buffers
+ * @misses_ptr: (out) (allow-none): the number of newly created VA buffers
+ *
+ * Retrieves how many VA parameter and slice data buffers were
+ * recycled from, or had to be created by, the VA buffers pool of
+ * the @decoder context.
+ *
+ * Return value: %TRUE if @decoder has a context, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_decoder_get_buffer_pool_stats (GstVaapiDecoder * decoder,
+    guint64 * hits_ptr, guint64 * misses_ptr)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (!decoder->context)
+    return FALSE;
+
+  gst_vaapi_codec_buffer_pool_get_stats (decoder->context->buffers_pool,
+      hits_ptr, misses_ptr, NULL);
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_decoder_get_copy_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @last_picture_ptr: (out) (allow-none): the number of bytes copied
+ *   for the last submitted picture
+ * @total_ptr: (out) (allow-none): the total number of bytes copied
+ *
+ * Retrieves the amount of bitstream data copied by the @decoder,
+ * i.e. while assembling the input frames and while uploading the
+ * slice data to VA buffers.
+ */
+void
+gst_vaapi_decoder_get_copy_stats (GstVaapiDecoder * decoder,
+    guint * last_picture_ptr, guint64 * total_ptr)
+{
+  g_return_if_fail (decoder != NULL);
+
+  if (last_picture_ptr)
+    *last_picture_ptr = decoder->bytes_copied_last_picture;
+  if (total_ptr)
+    *total_ptr = decoder->bytes_copied_mark;
+}
+
+/* Accounts the VA calls issued and the bytes copied since the
+ * previous picture to the picture that was just submitted */
+void
+gst_vaapi_decoder_mark_picture_va_calls (GstVaapiDecoder * decoder)
+{
+  guint va_calls, bytes_copied;
+  guint64 pool_va_calls = 0;
+
+  /* The counters wrap around, only their increments matter */
+  va_calls = (guint) g_atomic_int_get (&decoder->va_calls);
+  decoder->va_calls_last_picture = va_calls - decoder->va_calls_seen;
+  decoder->va_calls_seen = va_calls;
+
+  /* VA buffers are managed by the context buffers pool */
+  if (decoder->context) {
+    gst_vaapi_codec_buffer_pool_get_stats (decoder->context->buffers_pool,
+        NULL, NULL, &pool_va_calls);
+    if (pool_va_calls < decoder->pool_va_calls_seen)
+      decoder->pool_va_calls_seen = 0;
+    decoder->va_calls_last_picture +=
+        (guint) (pool_va_calls - decoder->pool_va_calls_seen);
+    decoder->pool_va_calls_seen = pool_va_calls;
+  }
+  decoder->va_calls_mark += decoder->va_calls_last_picture;
+  decoder->va_pictures++;
+
+  bytes_copied = (guint) g_atomic_int_get (&decoder->bytes_copied);
+  decoder->bytes_copied_last_picture =
+      bytes_copied - decoder->bytes_copied_seen;
+  decoder->bytes_copied_seen = bytes_copied;
+  decoder->bytes_copied_mark += decoder->bytes_copied_last_picture;
+
+  GST_DEBUG ("%u VA calls and %u bytes copied for picture #%" G_GUINT64_FORMAT,
+      decoder->va_calls_last_picture, decoder->bytes_copied_last_picture,
+      decoder->va_pictures);
+}
+
+/**
+ * gst_vaapi_decoder_set_pipeline_depth:
+ * @decoder: a #GstVaapiDecoder
+ * @depth: the maximum number of decoded pictures waiting for
+ *   submission, or zero to disable pipelined decoding
+ *
+ * Enables or disables pipelined decoding for frames decoded through
+ * gst_vaapi_decoder_get_surface(). In pipelined mode, the bitstream
+ * is parsed and decoded in a dedicated thread, which queues up to
+ * @depth pictures, while another thread issues their VA calls. This
+ * overlaps bitstream parsing and picture setup with VA submission.
+ *
+ * The default value can be overridden with the GST_VAAPI_DECODER_PIPELINE
+ * environment variable. The decoding mode cannot be changed while
+ * the pipeline threads are running, i.e. after the first call to
+ * gst_vaapi_decoder_get_surface() and until gst_vaapi_decoder_reset().
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_decoder_set_pipeline_depth (GstVaapiDecoder * decoder, guint depth)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (decoder->decode_thread) {
+    if ((depth > 0) != (decoder->pipeline_depth > 0))
+      return FALSE;
+    g_mutex_lock (&decoder->pipeline_lock);
+    decoder->pipeline_depth = depth;
+    g_cond_broadcast (&decoder->pipeline_cond);
+    g_mutex_unlock (&decoder->pipeline_lock);
+    return TRUE;
+  }
+
+  decoder->pipeline_depth = depth;
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_decoder_get_pipeline_depth:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Return value: the maximum number of decoded pictures queued for
+ *   submission, or zero if pipelined decoding is disabled
+ */
+guint
+gst_vaapi_decoder_get_pipeline_depth (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, 0);
+
+  return decoder->pipeline_depth;
+}
+
+/**
+ * gst_vaapi_decoder_set_surface_reservation:
+ * @decoder: a #GstVaapiDecoder
+ * @reserve: %TRUE to keep the surfaces across downward resolution
+ *   switches
+ * @max_width: the width to reserve surfaces for, or zero
+ * @max_height: the height to reserve surfaces for, or zero
+ *
+ * In surface reservation mode, the VA context and its surfaces are
+ * allocated for the largest resolution seen so far, and at least for
+ * @max_width x @max_height. A switch to a smaller resolution, as
+ * frequently happens with adaptive streaming, then keeps both the
+ * context and the surfaces, and the decoded pictures are described by
+ * the crop rectangle of their surface proxy. Only switches above the
+ * reserved size tear down the context.
+ *
+ * This is to be set before the decoder creates its VA context.
+ */
+void
+gst_vaapi_decoder_set_surface_reservation (GstVaapiDecoder * decoder,
+    gboolean reserve, guint max_width, guint max_height)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->reserve_surfaces = reserve;
+  decoder->reserve_max_width = max_width;
+  decoder->reserve_max_height = max_height;
+}
+
+/**
+ * gst_vaapi_decoder_get_surface_reservation:
+ * @decoder: a #GstVaapiDecoder
+ * @max_width_ptr: (out) (optional): return location for the reserved
+ *   width
+ * @max_height_ptr: (out) (optional): return location for the reserved
+ *   height
+ *
+ * Retrieves the surface reservation settings. Once the VA context is
+ * created, the reserved size is the actual size of the surfaces.
+ *
+ * Return value: %TRUE if surface reservation is enabled
+ */
+gboolean
+gst_vaapi_decoder_get_surface_reservation (GstVaapiDecoder * decoder,
+    guint * max_width_ptr, guint * max_height_ptr)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  if (max_width_ptr) {
+    *max_width_ptr = MAX (decoder->reserve_max_width,
+        decoder->reserved_width);
+  }
+  if (max_height_ptr) {
+    *max_height_ptr = MAX (decoder->reserve_max_height,
+        decoder->reserved_height);
+  }
+  return decoder->reserve_surfaces;
+}
+
+/**
+ * gst_vaapi_decoder_get_resize_stats:
+ * @decoder: a #GstVaapiDecoder
+ * @num_resizes_ptr: (out) (optional): return location for the number
+ *   of resolution switches
+ * @last_stall_ptr: (out) (optional): return location for the time
+ *   spent setting up the VA context for the last switch, in
+ *   microseconds
+ * @total_stall_ptr: (out) (optional): return location for the time
+ *   spent setting up the VA context for all the switches, in
+ *   microseconds
+ *
+ * Retrieves the cost of the resolution switches. This accounts for
+ * the teardown and reallocation of the VA context and surfaces, but
+ * not for the renegotiation with downstream elements.
+ */
+void
+gst_vaapi_decoder_get_resize_stats (GstVaapiDecoder * decoder,
+    guint * num_resizes_ptr, gint64 * last_stall_ptr,
+    gint64 * total_stall_ptr)
+{
+  g_return_if_fail (decoder != NULL);
+
+  if (num_resizes_ptr)
+    *num_resizes_ptr = decoder->num_resizes;
+  if (last_stall_ptr)
+    *last_stall_ptr = decoder->resize_stall_last;
+  if (total_stall_ptr)
+    *total_stall_ptr = decoder->resize_stall_total;
+}
+
+/**
+ * gst_vaapi_decoder_set_low_latency:
+ * @decoder: a #GstVaapiDecoder
+ * @low_latency: %TRUE to output frames as soon as possible
+ *
+ * In low latency mode, the decoded frames are output as soon as they
+ * can be displayed in order, instead of waiting for the DPB bumping
+ * process of the codec to release them. This may output frames out
+ * of order with streams whose picture order counts are not contiguous,
+ * hence violate the codec spec.
+ *
+ * Codecs without frame reordering, or whose pictures are output when
+ * they are decoded, such as VP9 and AV1 ones, are not affected.
+ */
+void
+gst_vaapi_decoder_set_low_latency (GstVaapiDecoder * decoder,
+    gboolean low_latency)
+{
+  g_return_if_fail (decoder != NULL);
+
+  decoder->low_latency = low_latency;
+}
+
+/**
+ * gst_vaapi_decoder_get_low_latency:
+ * @decoder: a #GstVaapiDecoder
+ *
+ * Return value: %TRUE if the low latency mode is enabled
+ */
+gboolean
+gst_vaapi_decoder_get_low_latency (GstVaapiDecoder * decoder)
+{
+  g_return_val_if_fail (decoder != NULL, FALSE);
+
+  return decoder->low_latency;
+}
@@ -141,6 +141,50 @@ gst_vaapi_decoder_get_surface_attributes (GstVaapiDecoder * decoder,
     gint * min_width, gint * min_height, gint * max_width, gint * max_height,
     guint * mem_types);
 
+void
+gst_vaapi_decoder_set_slice_batching (GstVaapiDecoder * decoder,
+    gboolean batch_slices);
+
+gboolean
+gst_vaapi_decoder_get_slice_batching (GstVaapiDecoder * decoder);
+
+void
+gst_vaapi_decoder_get_va_call_stats (GstVaapiDecoder * decoder,
+    guint * last_picture_ptr, guint64 * total_ptr, guint64 * num_pictures_ptr);
+
+gboolean
+gst_vaapi_decoder_get_buffer_pool_stats (GstVaapiDecoder * decoder,
+    guint64 * hits_ptr, guint64 * misses_ptr);
+
+void
+gst_vaapi_decoder_get_copy_stats (GstVaapiDecoder * decoder,
+    guint * last_picture_ptr, guint64 * total_ptr);
+
+gboolean
+gst_vaapi_decoder_set_pipeline_depth (GstVaapiDecoder * decoder, guint depth);
+
+guint
+gst_vaapi_decoder_get_pipeline_depth (GstVaapiDecoder * decoder);
+
+void
+gst_vaapi_decoder_set_surface_reservation (GstVaapiDecoder * decoder,
+    gboolean reserve, guint max_width, guint max_height);
+
+gboolean
+gst_vaapi_decoder_get_surface_reservation (GstVaapiDecoder * decoder,
+    guint * max_width_ptr, guint * max_height_ptr);
+
+void
+gst_vaapi_decoder_get_resize_stats (GstVaapiDecoder * decoder,
+    guint * num_resizes_ptr, gint64 * last_stall_ptr, gint64 * total_stall_ptr);
+
+void
+gst_vaapi_decoder_set_low_latency (GstVaapiDecoder * decoder,
+    gboolean low_latency);
+
+gboolean
+gst_vaapi_decoder_get_low_latency (GstVaapiDecoder * decoder);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDecoder, gst_object_unref)
 
 G_END_DECLS
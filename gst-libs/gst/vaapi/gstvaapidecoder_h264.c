@@ -556,7 +556,6 @@ struct _GstVaapiDecoderH264Private
   guint progressive_sequence:1;
   guint top_field_first:1;
 
-  gboolean force_low_latency;
   gboolean base_only;
 
   GstVaapiStereo3DInfo stereo_info;
@@ -1764,7 +1763,7 @@ decode_current_picture (GstVaapiDecoderH264 * decoder)
   if (!dpb_add (decoder, picture))
     goto error;
 
-  if (priv->force_low_latency)
+  if (GST_VAAPI_DECODER_CAST (decoder)->low_latency)
     dpb_output_ready_frames (decoder);
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
@@ -4974,7 +4973,7 @@ gst_vaapi_decoder_h264_set_base_only (GstVaapiDecoderH264 * decoder,
  * release them.
  *
  * This violate the H.264 specification but it is useful for some live
- * sources.
+ * sources. This is the same as gst_vaapi_decoder_set_low_latency().
  **/
 void
 gst_vaapi_decoder_h264_set_low_latency (GstVaapiDecoderH264 * decoder,
@@ -4982,7 +4981,8 @@ gst_vaapi_decoder_h264_set_low_latency (GstVaapiDecoderH264 * decoder,
 {
   g_return_if_fail (decoder != NULL);
 
-  decoder->priv.force_low_latency = force_low_latency;
+  gst_vaapi_decoder_set_low_latency (GST_VAAPI_DECODER_CAST (decoder),
+      force_low_latency);
 }
 
 /**
@@ -4997,7 +4997,7 @@ gst_vaapi_decoder_h264_get_low_latency (GstVaapiDecoderH264 * decoder)
 {
   g_return_val_if_fail (decoder != NULL, FALSE);
 
-  return decoder->priv.force_low_latency;
+  return gst_vaapi_decoder_get_low_latency (GST_VAAPI_DECODER_CAST (decoder));
 }
 
 /**
@@ -380,6 +380,7 @@ struct _GstVaapiDecoderH265Private
 
   guint32 SpsMaxLatencyPictures;
   gint32 WpOffsetHalfRangeC;
+  gint32 last_output_poc;       // POC of the last output picture in the CVS
 
   guint nal_length_size;
 
@@ -411,6 +412,8 @@ struct _GstVaapiDecoderH265Private
   guint new_bitstream:1;
   guint prev_nal_is_eos:1;      /*previous nal type is EOS */
   guint associated_irap_NoRaslOutputFlag:1;
+  guint has_last_output_poc:1;
+  guint wait_leading_pictures:1;        /* IRAP leading pictures may follow */
 };
 
 /**
@@ -706,6 +709,8 @@ dpb_output (GstVaapiDecoderH265 * decoder, GstVaapiFrameStore * fs)
     return FALSE;
 
   picture->output_needed = FALSE;
+  decoder->priv.last_output_poc = picture->poc;
+  decoder->priv.has_last_output_poc = TRUE;
   return gst_vaapi_picture_output (GST_VAAPI_PICTURE_CAST (picture));
 }
 
@@ -827,6 +832,35 @@ dpb_flush (GstVaapiDecoderH265 * decoder)
   /* Output any frame remaining in DPB */
   while (dpb_bump (decoder, NULL));
   dpb_clear (decoder, TRUE);
+  decoder->priv.has_last_output_poc = FALSE;
+  decoder->priv.wait_leading_pictures = FALSE;
+}
+
+/* Low latency mode: outputs the pictures following the last output
+   one in POC order right away, instead of waiting for the C.5.2
+   bumping conditions driven by sps_max_num_reorder_pics[] and
+   sps_max_latency_increase_plus1[]. This is the fastest output order
+   for streams without reordering, or with contiguous POC values.
+
+   Since PicOrderCntVal restarts from an IRAP picture, nothing is
+   output early while its leading pictures, which precede it in output
+   order, may still be decoded */
+static void
+dpb_output_ready_pictures (GstVaapiDecoderH265 * decoder)
+{
+  GstVaapiDecoderH265Private *const priv = &decoder->priv;
+  GstVaapiPictureH265 *found_picture;
+
+  if (priv->wait_leading_pictures)
+    return;
+
+  while (dpb_find_lowest_poc (decoder, &found_picture) >= 0) {
+    if (priv->has_last_output_poc
+        && found_picture->poc != priv->last_output_poc + 1)
+      break;
+    if (!dpb_bump (decoder, NULL))
+      break;
+  }
 }
 
 static gint
@@ -950,6 +984,16 @@ dpb_init (GstVaapiDecoderH265 * decoder, GstVaapiPictureH265 * picture,
     }
   }
 
+  /* PicOrderCntVal restarts from the IRAP picture. All its leading
+     pictures precede the trailing ones in decoding order, and there
+     are none if the stream has no reordering (7.4.2.2, 7.4.3.2.1) */
+  if (nal_is_irap (pi->nalu.type) && picture->NoRaslOutputFlag) {
+    priv->has_last_output_poc = FALSE;
+    priv->wait_leading_pictures =
+        sps->max_num_reorder_pics[sps->max_sub_layers_minus1] > 0;
+  } else if (!nal_is_radl (pi->nalu.type) && !nal_is_rasl (pi->nalu.type))
+    priv->wait_leading_pictures = FALSE;
+
   return TRUE;
 }
 
@@ -1384,6 +1428,8 @@ decode_current_picture (GstVaapiDecoderH265 * decoder)
   if (!dpb_add (decoder, picture))
     goto error;
 
+  if (GST_VAAPI_DECODER_CAST (decoder)->low_latency)
+    dpb_output_ready_pictures (decoder);
   gst_vaapi_picture_replace (&priv->current_picture, NULL);
   return GST_VAAPI_DECODER_STATUS_SUCCESS;
 
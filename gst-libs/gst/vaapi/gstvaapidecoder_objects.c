@@ -27,8 +27,10 @@
 #include "gstvaapidecoder_objects.h"
 #include "gstvaapidecoder_priv.h"
 #include "gstvaapisurfaceproxy_priv.h"
+#include "gstvaapitrace.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -37,6 +39,7 @@
 #define GET_CONTEXT(obj)    GET_DECODER(obj)->context
 #define GET_VA_DISPLAY(obj) GET_DECODER(obj)->va_display
 #define GET_VA_CONTEXT(obj) GET_DECODER(obj)->va_context
+#define GET_BUFFER_POOL(obj) GET_CONTEXT(obj)->buffers_pool
 
 static inline void
 gst_video_codec_frame_clear (GstVideoCodecFrame ** frame_ptr)
@@ -79,8 +82,8 @@ gst_vaapi_picture_destroy (GstVaapiPicture * picture)
   picture->surface_id = VA_INVALID_ID;
   picture->surface = NULL;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (picture), &picture->param_id);
-  picture->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (picture),
+      &picture->param_id, &picture->param);
 
   gst_video_codec_frame_clear (&picture->frame);
   gst_vaapi_picture_replace (&picture->parent_picture, NULL);
@@ -151,13 +154,26 @@ gst_vaapi_picture_create (GstVaapiPicture * picture,
 
     picture->structure = GST_VAAPI_PICTURE_STRUCTURE_FRAME;
     GST_VAAPI_PICTURE_FLAG_SET (picture, GST_VAAPI_PICTURE_FLAG_FF);
+
+    /* Reserved surfaces may be larger than the picture. Codecs with
+       their own cropping info override this crop rectangle */
+    if (GET_DECODER (picture)->reserve_surfaces) {
+      const GstVideoInfo *const vip =
+          &GET_DECODER (picture)->codec_state->info;
+
+      picture->crop_rect.x = 0;
+      picture->crop_rect.y = 0;
+      picture->crop_rect.width = GST_VIDEO_INFO_WIDTH (vip);
+      picture->crop_rect.height = GST_VIDEO_INFO_HEIGHT (vip);
+      picture->has_crop_rect = TRUE;
+    }
   }
   picture->surface = GST_VAAPI_SURFACE_PROXY_SURFACE (picture->proxy);
   picture->surface_id = GST_VAAPI_SURFACE_PROXY_SURFACE_ID (picture->proxy);
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (picture),
-      GET_VA_CONTEXT (picture), VAPictureParameterBufferType,
-      args->param_size, args->param, &picture->param_id, &picture->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (picture),
+      VAPictureParameterBufferType, args->param_size, 1, args->param,
+      &picture->param_id, &picture->param);
   if (!success)
     return FALSE;
   picture->param_size = args->param_size;
@@ -225,100 +241,321 @@ gst_vaapi_picture_add_slice (GstVaapiPicture * picture, GstVaapiSlice * slice)
   g_ptr_array_add (picture->slices, slice);
 }
 
+/* The buffer is returned to the pool after vaEndPicture(), see
+   release_picture_buffers() */
 static gboolean
-do_decode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
+do_decode (GstVaapiDecoder * decoder, VABufferID * buf_id, void **buf_ptr)
 {
+  VADisplay const dpy = decoder->va_display;
   VAStatus status;
+  gint64 profile_start;
 
   vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
-  status = vaRenderPicture (dpy, ctx, buf_id, 1);
+  profile_start = gst_vaapi_profiler_begin ();
+  status = vaRenderPicture (dpy, decoder->va_context, buf_id, 1);
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_RENDER_PICTURE,
+      profile_start);
+  GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 2);
+  return vaapi_check_status (status, "vaRenderPicture()");
+}
+
+/* Checks whether all slices of the picture can be submitted at once */
+static gboolean
+can_batch_slices (GstVaapiPicture * picture)
+{
+  GstVaapiSlice *slice;
+  guint i, param_size = 0;
+
+  for (i = 0; i < picture->slices->len; i++) {
+    slice = g_ptr_array_index (picture->slices, i);
+    if (!slice->is_batched)
+      return FALSE;
+
+    /* Per-slice Huffman tables need to be submitted in between slices */
+    if (slice->huf_table)
+      return FALSE;
+
+    if (i == 0)
+      param_size = slice->param_size;
+    else if (slice->param_size != param_size)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Gathers all slice parameters into a single n-element VA slice
+ * parameter buffer, and all slice data into a single VA slice data
+ * buffer, with the slice data offsets rebased accordingly */
+static gboolean
+create_batched_slices (GstVaapiPicture * picture, VABufferID va_buffers[2])
+{
+  GstVaapiDecoder *const decoder = GET_DECODER (picture);
+  GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (picture);
+  VADisplay const va_display = decoder->va_display;
+  GstVaapiSlice *slice;
+  guchar *params, *data;
+  guint i, j, param_size, param_num = 0, data_size = 0, data_offset = 0;
+
+  slice = g_ptr_array_index (picture->slices, 0);
+  param_size = slice->param_size;
+
+  for (i = 0; i < picture->slices->len; i++) {
+    slice = g_ptr_array_index (picture->slices, i);
+    param_num += slice->param_num;
+    data_size += slice->data_size;
+  }
+
+  if (!gst_vaapi_codec_buffer_pool_acquire (pool, VASliceParameterBufferType,
+          param_size, param_num, NULL, &va_buffers[0], (gpointer *) & params))
+    return FALSE;
+  if (!gst_vaapi_codec_buffer_pool_acquire (pool, VASliceDataBufferType,
+          data_size, 1, NULL, &va_buffers[1], (gpointer *) & data))
+    goto error;
+
+  for (i = 0; i < picture->slices->len; i++) {
+    slice = g_ptr_array_index (picture->slices, i);
+
+    memcpy (params, slice->param, slice->param_size * slice->param_num);
+    for (j = 0; j < slice->param_num; j++) {
+      VASliceParameterBufferBase *const slice_param =
+          (VASliceParameterBufferBase *) (params + j * param_size);
+      slice_param->slice_data_offset += data_offset;
+    }
+    params += slice->param_size * slice->param_num;
+
+    memcpy (data + data_offset, slice->data, slice->data_size);
+    data_offset += slice->data_size;
+  }
+  GST_VAAPI_DECODER_ADD_BYTES_COPIED (decoder, data_size);
+
+  GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 2);
+  vaapi_unmap_buffer (va_display, va_buffers[0], NULL);
+  vaapi_unmap_buffer (va_display, va_buffers[1], NULL);
+
+  GST_DEBUG ("batched %u slices (%u params, %u bytes)", picture->slices->len,
+      param_num, data_size);
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    gst_vaapi_codec_buffer_pool_release (pool, &va_buffers[0],
+        (gpointer *) & params);
+    return FALSE;
+  }
+}
+
+static gboolean
+do_decode_slices_batched (GstVaapiPicture * picture, VABufferID va_buffers[2])
+{
+  GstVaapiDecoder *const decoder = GET_DECODER (picture);
+  VAStatus status;
+  gint64 profile_start;
+
+  if (!create_batched_slices (picture, va_buffers))
+    return FALSE;
+
+  profile_start = gst_vaapi_profiler_begin ();
+  status = vaRenderPicture (decoder->va_display, decoder->va_context,
+      va_buffers, 2);
+  gst_vaapi_profiler_end (decoder->va_display,
+      GST_VAAPI_PROFILER_RENDER_PICTURE, profile_start);
+  GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 1);
   if (!vaapi_check_status (status, "vaRenderPicture()"))
     return FALSE;
+  return TRUE;
+}
+
+static gboolean
+do_decode_slices (GstVaapiPicture * picture)
+{
+  GstVaapiDecoder *const decoder = GET_DECODER (picture);
+  GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (picture);
+  VADisplay const va_display = decoder->va_display;
+  GstVaapiHuffmanTable *huf_table;
+  VAStatus status;
+  guint i;
+  gint64 profile_start;
 
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
+  for (i = 0; i < picture->slices->len; i++) {
+    GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
+    VABufferID va_buffers[2];
+
+    huf_table = slice->huf_table;
+    if (huf_table && !do_decode (decoder,
+            &huf_table->param_id, (void **) &huf_table->param))
+      return FALSE;
+
+    /* Slices created while batching was enabled still need their own
+       VA buffers if the picture as a whole cannot be batched */
+    if (slice->is_batched) {
+      if (!gst_vaapi_codec_buffer_pool_acquire (pool,
+              VASliceParameterBufferType, slice->param_size, slice->param_num,
+              slice->param, &slice->param_id, NULL))
+        return FALSE;
+      if (!gst_vaapi_codec_buffer_pool_acquire (pool, VASliceDataBufferType,
+              slice->data_size, 1, slice->data, &slice->data_id, NULL))
+        return FALSE;
+      GST_VAAPI_DECODER_ADD_BYTES_COPIED (decoder, slice->data_size);
+    } else {
+      vaapi_unmap_buffer (va_display, slice->param_id, NULL);
+      GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 1);
+    }
+    va_buffers[0] = slice->param_id;
+    va_buffers[1] = slice->data_id;
+
+    profile_start = gst_vaapi_profiler_begin ();
+    status = vaRenderPicture (va_display, decoder->va_context, va_buffers, 2);
+    gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_RENDER_PICTURE,
+        profile_start);
+    GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 1);
+    if (!vaapi_check_status (status, "vaRenderPicture()"))
+      return FALSE;
+  }
   return TRUE;
 }
 
+/* Returns the VA buffers submitted for the picture to the pool, once
+   the driver is done with the picture, so that no recycled buffer is
+   handed out before vaEndPicture() */
+static void
+release_picture_buffers (GstVaapiPicture * picture,
+    VABufferID batch_buffers[2])
+{
+  GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (picture);
+  guint i;
+
+  gst_vaapi_codec_buffer_pool_release (pool, &picture->param_id, NULL);
+  if (picture->iq_matrix)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->iq_matrix->param_id,
+        NULL);
+  if (picture->bitplane)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->bitplane->data_id,
+        NULL);
+  if (picture->huf_table)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->huf_table->param_id,
+        NULL);
+  if (picture->prob_table)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->prob_table->param_id,
+        NULL);
+
+  for (i = 0; i < 2; i++)
+    gst_vaapi_codec_buffer_pool_release (pool, &batch_buffers[i], NULL);
+
+  for (i = 0; i < picture->slices->len; i++) {
+    GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
+
+    if (slice->huf_table)
+      gst_vaapi_codec_buffer_pool_release (pool, &slice->huf_table->param_id,
+          NULL);
+    gst_vaapi_codec_buffer_pool_release (pool, &slice->param_id, NULL);
+    gst_vaapi_codec_buffer_pool_release (pool, &slice->data_id, NULL);
+  }
+}
+
+/* Issues the VA calls decoding the picture into surface_id. This runs
+   in the submit thread in pipelined mode, hence it must not look at
+   the codec state, nor at picture->frame which is cleared on output */
 gboolean
-gst_vaapi_picture_decode_with_surface_id (GstVaapiPicture * picture,
-    VASurfaceID surface_id)
+gst_vaapi_picture_submit (GstVaapiPicture * picture, VASurfaceID surface_id,
+    gint frame_number)
 {
+  GstVaapiDecoder *decoder;
   GstVaapiIqMatrix *iq_matrix;
   GstVaapiBitPlane *bitplane;
   GstVaapiHuffmanTable *huf_table;
   GstVaapiProbabilityTable *prob_table;
+  VABufferID batch_buffers[2] = { VA_INVALID_ID, VA_INVALID_ID };
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
-  guint i;
+  gboolean success = FALSE;
+  gint64 trace_start;
+  gint64 profile_start;
 
   g_return_val_if_fail (GST_VAAPI_IS_PICTURE (picture), FALSE);
   g_return_val_if_fail (surface_id != VA_INVALID_SURFACE, FALSE);
 
+  decoder = GET_DECODER (picture);
   va_display = GET_VA_DISPLAY (picture);
   va_context = GET_VA_CONTEXT (picture);
 
   GST_DEBUG ("decode picture 0x%08x", surface_id);
 
+  trace_start = gst_vaapi_trace_begin ();
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaBeginPicture (va_display, va_context, surface_id);
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_BEGIN_PICTURE,
+      profile_start);
+  GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 1);
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
-  if (!do_decode (va_display, va_context, &picture->param_id, &picture->param))
-    return FALSE;
+  if (!do_decode (decoder, &picture->param_id, &picture->param))
+    goto cleanup;
 
   iq_matrix = picture->iq_matrix;
-  if (iq_matrix && !do_decode (va_display, va_context,
+  if (iq_matrix && !do_decode (decoder,
           &iq_matrix->param_id, &iq_matrix->param))
-    return FALSE;
+    goto cleanup;
 
   bitplane = picture->bitplane;
-  if (bitplane && !do_decode (va_display, va_context,
+  if (bitplane && !do_decode (decoder,
           &bitplane->data_id, (void **) &bitplane->data))
-    return FALSE;
+    goto cleanup;
 
   huf_table = picture->huf_table;
-  if (huf_table && !do_decode (va_display, va_context,
+  if (huf_table && !do_decode (decoder,
           &huf_table->param_id, (void **) &huf_table->param))
-    return FALSE;
+    goto cleanup;
 
   prob_table = picture->prob_table;
-  if (prob_table && !do_decode (va_display, va_context,
+  if (prob_table && !do_decode (decoder,
           &prob_table->param_id, (void **) &prob_table->param))
-    return FALSE;
+    goto cleanup;
 
-  for (i = 0; i < picture->slices->len; i++) {
-    GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
-    VABufferID va_buffers[2];
-
-    huf_table = slice->huf_table;
-    if (huf_table && !do_decode (va_display, va_context,
-            &huf_table->param_id, (void **) &huf_table->param))
-      return FALSE;
-
-    vaapi_unmap_buffer (va_display, slice->param_id, NULL);
-    va_buffers[0] = slice->param_id;
-    va_buffers[1] = slice->data_id;
-
-    status = vaRenderPicture (va_display, va_context, va_buffers, 2);
-    if (!vaapi_check_status (status, "vaRenderPicture()"))
-      return FALSE;
-  }
+  if (picture->slices->len > 0 && can_batch_slices (picture))
+    success = do_decode_slices_batched (picture, batch_buffers);
+  else
+    success = do_decode_slices (picture);
+  if (!success)
+    goto cleanup;
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaEndPicture (va_display, va_context);
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_END_PICTURE,
+      profile_start);
+  GST_VAAPI_DECODER_ADD_VA_CALLS (decoder, 1);
+  success = vaapi_check_status (status, "vaEndPicture()");
+  gst_vaapi_trace_end (trace_start, "submit", frame_number, surface_id);
+
+cleanup:
+  release_picture_buffers (picture, batch_buffers);
+  gst_vaapi_decoder_mark_picture_va_calls (decoder);
+  return success;
+}
 
-  for (i = 0; i < picture->slices->len; i++) {
-    GstVaapiSlice *const slice = g_ptr_array_index (picture->slices, i);
+gboolean
+gst_vaapi_picture_decode_with_surface_id (GstVaapiPicture * picture,
+    VASurfaceID surface_id)
+{
+  GstVaapiDecoder *decoder;
+  gint frame_number;
 
-    vaapi_destroy_buffer (va_display, &slice->param_id);
-    vaapi_destroy_buffer (va_display, &slice->data_id);
-  }
+  g_return_val_if_fail (GST_VAAPI_IS_PICTURE (picture), FALSE);
+  g_return_val_if_fail (surface_id != VA_INVALID_SURFACE, FALSE);
 
-  if (!vaapi_check_status (status, "vaEndPicture()"))
-    return FALSE;
-  return TRUE;
+  decoder = GET_DECODER (picture);
+  frame_number = picture->frame ? (gint) picture->frame->system_frame_number :
+      GST_VAAPI_TRACE_NO_FRAME;
+
+  /* In pipelined mode, submission errors are reported when the
+     decoded frames are retrieved */
+  if (gst_vaapi_decoder_queue_picture (decoder, picture, surface_id,
+          frame_number))
+    return TRUE;
+  return gst_vaapi_picture_submit (picture, surface_id, frame_number);
 }
 
 gboolean
@@ -443,15 +680,81 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiSlice, gst_vaapi_slice);
 void
 gst_vaapi_slice_destroy (GstVaapiSlice * slice)
 {
-  VADisplay const va_display = GET_VA_DISPLAY (slice);
+  GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (slice);
 
   gst_vaapi_codec_object_replace (&slice->huf_table, NULL);
 
-  vaapi_destroy_buffer (va_display, &slice->data_id);
-  vaapi_destroy_buffer (va_display, &slice->param_id);
+  gst_vaapi_codec_buffer_pool_release (pool, &slice->data_id, NULL);
+
+  if (slice->is_batched) {
+    gst_vaapi_codec_buffer_pool_release (pool, &slice->param_id, NULL);
+    g_free (slice->param);
+    if (slice->input_buffer) {
+      gst_buffer_unmap (slice->input_buffer, &slice->input_map);
+      gst_buffer_replace (&slice->input_buffer, NULL);
+    } else
+      g_free (slice->data);
+    slice->data = NULL;
+  } else {
+    gst_vaapi_codec_buffer_pool_release (pool, &slice->param_id,
+        &slice->param);
+  }
   slice->param = NULL;
 }
 
+/* Keeps the input buffer of the frame being decoded mapped, if the
+ * slice data lies in there, so that it can be referenced in place */
+static gboolean
+slice_map_input_buffer (GstVaapiSlice * slice, const guchar * data,
+    guint data_size)
+{
+  GstVideoCodecFrame *const frame =
+      GST_VAAPI_DECODER_CODEC_FRAME (GET_DECODER (slice));
+  GstBuffer *buffer;
+
+  if (!frame || !frame->input_buffer)
+    return FALSE;
+
+  /* Mapping a buffer made of several memories would copy them */
+  buffer = frame->input_buffer;
+  if (gst_buffer_n_memory (buffer) != 1)
+    return FALSE;
+
+  if (!gst_buffer_map (buffer, &slice->input_map, GST_MAP_READ))
+    return FALSE;
+  if (data < slice->input_map.data ||
+      data + data_size > slice->input_map.data + slice->input_map.size) {
+    gst_buffer_unmap (buffer, &slice->input_map);
+    return FALSE;
+  }
+  slice->input_buffer = gst_buffer_ref (buffer);
+  return TRUE;
+}
+
+static gboolean
+slice_create_batched (GstVaapiSlice * slice,
+    const GstVaapiCodecObjectConstructorArgs * args)
+{
+  const gsize param_size = (gsize) args->param_size * args->param_num;
+
+  slice->is_batched = TRUE;
+  slice->param = g_malloc0 (param_size);
+  if (args->param)
+    memcpy (slice->param, args->param, param_size);
+
+  if (args->data_size > 0) {
+    if (slice_map_input_buffer (slice, args->data, args->data_size))
+      slice->data = (guchar *) args->data;
+    else {
+      slice->data = g_malloc (args->data_size);
+      memcpy (slice->data, args->data, args->data_size);
+      GST_VAAPI_DECODER_ADD_BYTES_COPIED (GET_DECODER (slice),
+          args->data_size);
+    }
+  }
+  return TRUE;
+}
+
 gboolean
 gst_vaapi_slice_create (GstVaapiSlice * slice,
     const GstVaapiCodecObjectConstructorArgs * args)
@@ -461,17 +764,29 @@ gst_vaapi_slice_create (GstVaapiSlice * slice,
 
   slice->param_id = VA_INVALID_ID;
   slice->data_id = VA_INVALID_ID;
-
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice), GET_VA_CONTEXT (slice),
-      VASliceDataBufferType, args->data_size, args->data, &slice->data_id,
-      NULL);
-  if (!success)
-    return FALSE;
+  slice->input_buffer = NULL;
 
   g_assert (args->param_num >= 1);
-  success = vaapi_create_n_elements_buffer (GET_VA_DISPLAY (slice),
-      GET_VA_CONTEXT (slice), VASliceParameterBufferType, args->param_size,
-      args->param, &slice->param_id, &slice->param, args->param_num);
+  slice->param_size = args->param_size;
+  slice->param_num = args->param_num;
+  slice->data_size = args->data_size;
+
+  if (GET_DECODER (slice)->batch_slices) {
+    success = slice_create_batched (slice, args);
+  } else {
+    GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (slice);
+
+    success = gst_vaapi_codec_buffer_pool_acquire (pool,
+        VASliceDataBufferType, args->data_size, 1, args->data,
+        &slice->data_id, NULL);
+    if (!success)
+      return FALSE;
+    GST_VAAPI_DECODER_ADD_BYTES_COPIED (GET_DECODER (slice), args->data_size);
+
+    success = gst_vaapi_codec_buffer_pool_acquire (pool,
+        VASliceParameterBufferType, args->param_size, args->param_num,
+        args->param, &slice->param_id, &slice->param);
+  }
   if (!success)
     return FALSE;
 
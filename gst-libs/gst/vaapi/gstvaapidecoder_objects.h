@@ -201,6 +201,11 @@ gboolean
 gst_vaapi_picture_decode_with_surface_id (GstVaapiPicture * picture,
     VASurfaceID surface_id);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_picture_submit (GstVaapiPicture * picture, VASurfaceID surface_id,
+    gint frame_number);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_picture_output (GstVaapiPicture * picture);
@@ -242,6 +247,16 @@ struct _GstVaapiSlice
   /*< private >*/
   GstVaapiCodecObject parent_instance;
 
+  /* Batched slices: parameters and data are kept in system memory
+     until the whole picture is submitted */
+  guint param_size;
+  guint param_num;
+  guchar *data;
+  guint data_size;
+  guint is_batched:1;
+  GstBuffer *input_buffer;
+  GstMapInfo input_map;
+
   /*< public >*/
   VABufferID param_id;
   VABufferID data_id;
@@ -124,7 +124,7 @@ typedef struct _GstVaapiDecoderClass GstVaapiDecoderClass;
  */
 #undef  GST_VAAPI_DECODER_CODEC_FRAME
 #define GST_VAAPI_DECODER_CODEC_FRAME(decoder) \
-    GST_VAAPI_PARSER_STATE(decoder)->current_frame
+    GST_VAAPI_PARSER_STATE(decoder)->decode_frame
 
 /**
  * GST_VAAPI_DECODER_WIDTH:
@@ -148,6 +148,30 @@ typedef struct _GstVaapiDecoderClass GstVaapiDecoderClass;
 #define GST_VAAPI_DECODER_HEIGHT(decoder) \
     GST_VAAPI_DECODER_CODEC_STATE(decoder)->info.height
 
+/**
+ * GST_VAAPI_DECODER_ADD_VA_CALLS:
+ * @decoder: a #GstVaapiDecoder
+ * @n: the number of VA calls
+ *
+ * Accounts @n libva calls issued on behalf of @decoder.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DECODER_ADD_VA_CALLS(decoder, n) \
+    g_atomic_int_add (&GST_VAAPI_DECODER_CAST(decoder)->va_calls, (n))
+
+/**
+ * GST_VAAPI_DECODER_ADD_BYTES_COPIED:
+ * @decoder: a #GstVaapiDecoder
+ * @n: the number of bytes
+ *
+ * Accounts @n bytes of bitstream data copied by @decoder while
+ * assembling input frames or submitting pictures.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#define GST_VAAPI_DECODER_ADD_BYTES_COPIED(decoder, n) \
+    g_atomic_int_add (&GST_VAAPI_DECODER_CAST(decoder)->bytes_copied, \
+        (gint) (n))
+
 /* End-of-Stream buffer */
 #define GST_BUFFER_FLAG_EOS (GST_BUFFER_FLAG_LAST + 0)
 
@@ -167,6 +191,9 @@ typedef struct _GstVaapiParserState GstVaapiParserState;
 struct _GstVaapiParserState
 {
   GstVideoCodecFrame *current_frame;
+  /* The frame being decoded. parse_step() hands the frame over
+     before it is decoded, so this is no longer current_frame */
+  GstVideoCodecFrame *decode_frame;
   guint32 current_frame_number;
   GstAdapter *current_adapter;
   GstAdapter *input_adapter;
@@ -200,6 +227,60 @@ struct _GstVaapiDecoder
   GstVaapiParserState parser_state;
   GstVaapiDecoderStateChangedFunc codec_state_changed_func;
   gpointer codec_state_changed_data;
+
+  /* Submit all slices of a picture in a single vaRenderPicture() call */
+  gboolean batch_slices;
+
+  /* VA calls and bitstream copies statistics. The counters are
+     updated atomically from both threads in pipelined mode, and the
+     per picture marks only by the thread submitting pictures. VA
+     buffers calls are accounted by the context buffers pool */
+  gint va_calls;
+  guint va_calls_seen;
+  guint64 pool_va_calls_seen;
+  guint64 va_calls_mark;
+  guint64 va_pictures;
+  guint va_calls_last_picture;
+  gint bytes_copied;
+  guint bytes_copied_seen;
+  guint64 bytes_copied_mark;
+  guint bytes_copied_last_picture;
+
+  /* Pipelined decode mode: a decode thread parses and decodes the
+     frames, and queues at most pipeline_depth pictures for a submit
+     thread, which issues their VA calls. Everything below is
+     protected by pipeline_lock */
+  guint pipeline_depth;
+  GThread *decode_thread;
+  GThread *submit_thread;
+  GMutex pipeline_lock;
+  GCond pipeline_cond;
+  GQueue submit_jobs;
+  GstVaapiDecoderStatus decode_status;
+  GstVaapiDecoderStatus pipeline_error;
+  guint pipeline_stopping:1;
+  guint decode_waiting:1;
+  guint decode_done:1;
+  guint submit_busy:1;
+
+  /* Surface reservation: the VA context and its surfaces are sized
+     for the largest picture seen so far, or at least for
+     reserve_max_width x reserve_max_height, so that downward
+     resolution switches only change the crop rectangle */
+  gboolean reserve_surfaces;
+  guint reserve_max_width;
+  guint reserve_max_height;
+  guint reserved_width;
+  guint reserved_height;
+
+  /* Output decoded frames as soon as they can be displayed in order,
+     instead of following the DPB bumping rules of the codec */
+  gboolean low_latency;
+
+  /* Resolution switches statistics, in microseconds */
+  guint num_resizes;
+  gint64 resize_stall_last;
+  gint64 resize_stall_total;
 };
 
 /**
@@ -270,6 +351,16 @@ G_GNUC_INTERNAL
 GstVaapiDecoderStatus
 gst_vaapi_decoder_decode_codec_data (GstVaapiDecoder * decoder);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_decoder_mark_picture_va_calls (GstVaapiDecoder * decoder);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_decoder_queue_picture (GstVaapiDecoder * decoder,
+    struct _GstVaapiPicture * picture, VASurfaceID surface_id,
+    gint frame_number);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DECODER_PRIV_H */
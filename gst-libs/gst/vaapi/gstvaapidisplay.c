@@ -48,6 +48,12 @@ GST_DEBUG_CATEGORY (gst_debug_vaapi_display);
         "vaapidisplay", 0, "VA-API Display");           \
     GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi, "vaapi", 0, "VA-API helper");
 
+/* Environment variable enabling the VA calls profiler */
+#define PROFILE_VA_ENV "GST_VAAPI_PROFILE_VA"
+
+/* Environment variable forcing the VA calls to be serialized */
+#define SERIALIZE_VA_ENV "GST_VAAPI_SERIALIZE_VA"
+
 G_DEFINE_TYPE_WITH_CODE (GstVaapiDisplay, gst_vaapi_display, GST_TYPE_OBJECT,
     _do_init);
 
@@ -457,6 +463,197 @@ find_property_id (const gchar * name)
   return 0;
 }
 
+/* Queries the VA profiles, or retrieves them from the capabilities
+   cache. @profiles holds at least vaMaxNumProfiles() elements */
+static gboolean
+query_config_profiles (GstVaapiDisplay * display, VAProfile * profiles,
+    gint * num_profiles_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gint *values;
+  guint num_values;
+  gint i, n;
+  VAStatus status;
+
+  if (gst_vaapi_display_cache_lookup (priv->cache, "profiles", &values,
+          &num_values)) {
+    n = MIN ((gint) num_values, vaMaxNumProfiles (priv->display));
+    for (i = 0; i < n; i++)
+      profiles[i] = values[i];
+    g_free (values);
+    *num_profiles_ptr = n;
+    return TRUE;
+  }
+
+  n = 0;
+  status = vaQueryConfigProfiles (priv->display, profiles, &n);
+  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+    return FALSE;
+
+  values = g_new (gint, n);
+  for (i = 0; i < n; i++)
+    values[i] = profiles[i];
+  gst_vaapi_display_cache_store (priv->cache, "profiles", values, n);
+  g_free (values);
+
+  *num_profiles_ptr = n;
+  return TRUE;
+}
+
+/* Queries the VA entrypoints for @profile, or retrieves them from the
+   capabilities cache. @entrypoints holds at least
+   vaMaxNumEntrypoints() elements */
+static gboolean
+query_config_entrypoints (GstVaapiDisplay * display, VAProfile profile,
+    VAEntrypoint * entrypoints, gint * num_entrypoints_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gchar name[32];
+  gint *values;
+  guint num_values;
+  gint i, n;
+  VAStatus status;
+
+  g_snprintf (name, sizeof (name), "entrypoints-%d", profile);
+  if (gst_vaapi_display_cache_lookup (priv->cache, name, &values,
+          &num_values)) {
+    n = MIN ((gint) num_values, vaMaxNumEntrypoints (priv->display));
+    for (i = 0; i < n; i++)
+      entrypoints[i] = values[i];
+    g_free (values);
+    *num_entrypoints_ptr = n;
+    return TRUE;
+  }
+
+  n = 0;
+  status = vaQueryConfigEntrypoints (priv->display, profile, entrypoints, &n);
+  if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+    return FALSE;
+
+  values = g_new (gint, n);
+  for (i = 0; i < n; i++)
+    values[i] = entrypoints[i];
+  gst_vaapi_display_cache_store (priv->cache, name, values, n);
+  g_free (values);
+
+  *num_entrypoints_ptr = n;
+  return TRUE;
+}
+
+/* VAImageFormat fields, as recorded in the capabilities cache */
+#define NUM_FORMAT_VALUES 8
+
+static void
+format_to_cache_values (const VAImageFormat * va_format, gint * values)
+{
+  values[0] = va_format->fourcc;
+  values[1] = va_format->byte_order;
+  values[2] = va_format->bits_per_pixel;
+  values[3] = va_format->depth;
+  values[4] = va_format->red_mask;
+  values[5] = va_format->green_mask;
+  values[6] = va_format->blue_mask;
+  values[7] = va_format->alpha_mask;
+}
+
+static void
+format_from_cache_values (VAImageFormat * va_format, const gint * values)
+{
+  memset (va_format, 0, sizeof (*va_format));
+  va_format->fourcc = values[0];
+  va_format->byte_order = values[1];
+  va_format->bits_per_pixel = values[2];
+  va_format->depth = values[3];
+  va_format->red_mask = values[4];
+  va_format->green_mask = values[5];
+  va_format->blue_mask = values[6];
+  va_format->alpha_mask = values[7];
+}
+
+/* Queries the VA image formats, or retrieves them from the
+   capabilities cache. @formats holds at least vaMaxNumImageFormats()
+   elements */
+static gboolean
+query_image_formats (GstVaapiDisplay * display, VAImageFormat * formats,
+    gint * num_formats_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  gint *values;
+  guint num_values;
+  gint i, n;
+  VAStatus status;
+
+  if (gst_vaapi_display_cache_lookup (priv->cache, "image-formats", &values,
+          &num_values)) {
+    n = MIN ((gint) (num_values / NUM_FORMAT_VALUES),
+        vaMaxNumImageFormats (priv->display));
+    for (i = 0; i < n; i++)
+      format_from_cache_values (&formats[i], &values[i * NUM_FORMAT_VALUES]);
+    g_free (values);
+    *num_formats_ptr = n;
+    return TRUE;
+  }
+
+  n = 0;
+  status = vaQueryImageFormats (priv->display, formats, &n);
+  if (!vaapi_check_status (status, "vaQueryImageFormats()"))
+    return FALSE;
+
+  values = g_new (gint, n * NUM_FORMAT_VALUES);
+  for (i = 0; i < n; i++)
+    format_to_cache_values (&formats[i], &values[i * NUM_FORMAT_VALUES]);
+  gst_vaapi_display_cache_store (priv->cache, "image-formats", values,
+      n * NUM_FORMAT_VALUES);
+  g_free (values);
+
+  *num_formats_ptr = n;
+  return TRUE;
+}
+
+/* Queries the VA subpicture formats and flags, or retrieves them from
+   the capabilities cache. @formats and @flags hold at least
+   vaMaxNumSubpictureFormats() elements */
+static gboolean
+query_subpicture_formats (GstVaapiDisplay * display, VAImageFormat * formats,
+    guint * flags, guint * num_formats_ptr)
+{
+  GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  const guint num_entry_values = NUM_FORMAT_VALUES + 1;
+  gint *values;
+  guint i, n, num_values;
+  VAStatus status;
+
+  if (gst_vaapi_display_cache_lookup (priv->cache, "subpicture-formats",
+          &values, &num_values)) {
+    n = MIN (num_values / num_entry_values,
+        (guint) vaMaxNumSubpictureFormats (priv->display));
+    for (i = 0; i < n; i++) {
+      format_from_cache_values (&formats[i], &values[i * num_entry_values]);
+      flags[i] = values[i * num_entry_values + NUM_FORMAT_VALUES];
+    }
+    g_free (values);
+    *num_formats_ptr = n;
+    return TRUE;
+  }
+
+  n = 0;
+  status = vaQuerySubpictureFormats (priv->display, formats, flags, &n);
+  if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
+    return FALSE;
+
+  values = g_new (gint, n * num_entry_values);
+  for (i = 0; i < n; i++) {
+    format_to_cache_values (&formats[i], &values[i * num_entry_values]);
+    values[i * num_entry_values + NUM_FORMAT_VALUES] = flags[i];
+  }
+  gst_vaapi_display_cache_store (priv->cache, "subpicture-formats", values,
+      n * num_entry_values);
+  g_free (values);
+
+  *num_formats_ptr = n;
+  return TRUE;
+}
+
 /* Initialize VA profiles (decoders, encoders) */
 static gboolean
 ensure_profiles (GstVaapiDisplay * display)
@@ -464,8 +661,8 @@ ensure_profiles (GstVaapiDisplay * display)
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAProfile *profiles = NULL;
   VAEntrypoint *entrypoints = NULL;
+  GstVaapiDisplayCacheSnapshot *snapshot = NULL;
   gint i, j, n, num_entrypoints;
-  VAStatus status;
   gboolean success = FALSE;
 
   GST_VAAPI_DISPLAY_LOCK (display);
@@ -496,8 +693,7 @@ ensure_profiles (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryConfigProfiles (priv->display, profiles, &n);
-  if (!vaapi_check_status (status, "vaQueryConfigProfiles()"))
+  if (!query_config_profiles (display, profiles, &n))
     goto cleanup;
 
   GST_DEBUG ("%d profiles", n);
@@ -514,9 +710,8 @@ ensure_profiles (GstVaapiDisplay * display)
     if (!config.profile)
       continue;
 
-    status = vaQueryConfigEntrypoints (priv->display,
-        profiles[i], entrypoints, &num_entrypoints);
-    if (!vaapi_check_status (status, "vaQueryConfigEntrypoints()"))
+    if (!query_config_entrypoints (display, profiles[i], entrypoints,
+            &num_entrypoints))
       continue;
 
     for (j = 0; j < num_entrypoints; j++)
@@ -546,20 +741,21 @@ ensure_profiles (GstVaapiDisplay * display)
   g_ptr_array_sort (priv->encoders, compare_profiles);
 
   /* Video processing API */
-  status = vaQueryConfigEntrypoints (priv->display, VAProfileNone,
-      entrypoints, &num_entrypoints);
-  if (vaapi_check_status (status, "vaQueryEntrypoints() [VAProfileNone]")) {
+  if (query_config_entrypoints (display, VAProfileNone, entrypoints,
+          &num_entrypoints)) {
     for (j = 0; j < num_entrypoints; j++) {
       if (entrypoints[j] == VAEntrypointVideoProc)
         priv->has_vpp = TRUE;
     }
   }
+  snapshot = gst_vaapi_display_cache_snapshot (priv->cache);
   success = TRUE;
 
 cleanup:
   g_free (profiles);
   g_free (entrypoints);
   GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_display_cache_snapshot_save (snapshot);
   return success;
 }
 
@@ -652,7 +848,7 @@ ensure_image_formats (GstVaapiDisplay * display)
 {
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
-  VAStatus status;
+  GstVaapiDisplayCacheSnapshot *snapshot = NULL;
   gint i, n, max_images;
   gboolean success = FALSE;
 
@@ -673,9 +869,9 @@ ensure_image_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQueryImageFormats (priv->display, formats, &n);
-  if (!vaapi_check_status (status, "vaQueryImageFormats()"))
+  if (!query_image_formats (display, formats, &n))
     goto cleanup;
+  snapshot = gst_vaapi_display_cache_snapshot (priv->cache);
 
   /* XXX(victor): Force RGBA in i965 display formats.
    *
@@ -716,6 +912,7 @@ ensure_image_formats (GstVaapiDisplay * display)
 cleanup:
   g_free (formats);
   GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_display_cache_snapshot_save (snapshot);
   return success;
 }
 
@@ -726,7 +923,7 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
   GstVaapiDisplayPrivate *const priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
   VAImageFormat *formats = NULL;
   unsigned int *flags = NULL;
-  VAStatus status;
+  GstVaapiDisplayCacheSnapshot *snapshot = NULL;
   guint i, n;
   gboolean success = FALSE;
 
@@ -751,9 +948,9 @@ ensure_subpicture_formats (GstVaapiDisplay * display)
     goto cleanup;
 
   n = 0;
-  status = vaQuerySubpictureFormats (priv->display, formats, flags, &n);
-  if (!vaapi_check_status (status, "vaQuerySubpictureFormats()"))
+  if (!query_subpicture_formats (display, formats, flags, &n))
     goto cleanup;
+  snapshot = gst_vaapi_display_cache_snapshot (priv->cache);
 
   GST_DEBUG ("%d subpicture formats", n);
   for (i = 0; i < n; i++) {
@@ -769,6 +966,7 @@ cleanup:
   g_free (formats);
   g_free (flags);
   GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_display_cache_snapshot_save (snapshot);
   return success;
 }
 
@@ -895,6 +1093,280 @@ gst_vaapi_display_ensure_screen_resolution (GstVaapiDisplay * display)
   priv->got_scrres = TRUE;
 }
 
+/* Number of unused VA configs kept around for the next contexts */
+#define MAX_IDLE_CONFIGS 4
+
+typedef struct _GstVaapiConfigEntry GstVaapiConfigEntry;
+struct _GstVaapiConfigEntry
+{
+  VAConfigID id;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  VAConfigAttrib *attribs;
+  guint num_attribs;
+  guint ref_count;
+  GstVaapiConfigSurfaceAttributes *surface_attribs;
+};
+
+/* VA configs belong to the VA display, hence are shared with the
+   displays wrapping the same one */
+static inline GstVaapiDisplayPrivate *
+get_configs_private (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  return priv;
+}
+
+static void
+config_entry_destroy (GstVaapiDisplayPrivate * priv,
+    GstVaapiConfigEntry * entry)
+{
+  VAStatus status;
+
+  GST_DEBUG ("destroy config 0x%08x", entry->id);
+
+  status = vaDestroyConfig (priv->display, entry->id);
+  if (!vaapi_check_status (status, "vaDestroyConfig()"))
+    GST_WARNING ("failed to destroy config 0x%08x", entry->id);
+
+  gst_vaapi_config_surface_attributes_free (entry->surface_attribs);
+  g_free (entry->attribs);
+  g_slice_free (GstVaapiConfigEntry, entry);
+}
+
+static GstVaapiConfigEntry *
+find_config_entry (GstVaapiDisplayPrivate * priv, VAConfigID config)
+{
+  GstVaapiConfigEntry *entry;
+  guint i;
+
+  if (!priv->configs)
+    return NULL;
+
+  for (i = 0; i < priv->configs->len; i++) {
+    entry = g_ptr_array_index (priv->configs, i);
+    if (entry->id == config)
+      return entry;
+  }
+  return NULL;
+}
+
+static void
+destroy_configs (GstVaapiDisplayPrivate * priv)
+{
+  guint i;
+
+  if (!priv->configs)
+    return;
+
+  for (i = 0; i < priv->configs->len; i++) {
+    GstVaapiConfigEntry *const entry = g_ptr_array_index (priv->configs, i);
+
+    if (entry->ref_count > 0)
+      GST_WARNING ("config 0x%08x is still in use", entry->id);
+    config_entry_destroy (priv, entry);
+  }
+  g_clear_pointer (&priv->configs, g_ptr_array_unref);
+}
+
+/**
+ * gst_vaapi_display_acquire_config:
+ * @display: a #GstVaapiDisplay
+ * @profile: a VA profile
+ * @entrypoint: a VA entrypoint
+ * @attribs: the VA config attributes
+ * @num_attribs: the number of @attribs
+ * @config_ptr: return location for the VA config
+ *
+ * Returns a VA config for @profile, @entrypoint and @attribs. The
+ * config is shared with all the users that asked for the very same
+ * parameters, and it is only created if there is none yet. The config
+ * is to be released with gst_vaapi_display_release_config().
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_display_acquire_config (GstVaapiDisplay * display,
+    VAProfile profile, VAEntrypoint entrypoint,
+    const VAConfigAttrib * attribs, guint num_attribs,
+    VAConfigID * config_ptr)
+{
+  GstVaapiDisplayPrivate *priv;
+  GstVaapiConfigEntry *entry;
+  VAConfigID config;
+  VAStatus status;
+  gint64 profile_start;
+  guint i;
+
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY (display), FALSE);
+  g_return_val_if_fail (attribs != NULL || num_attribs == 0, FALSE);
+  g_return_val_if_fail (config_ptr != NULL, FALSE);
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  priv = get_configs_private (display);
+
+  if (!priv->configs)
+    priv->configs = g_ptr_array_new ();
+
+  for (i = 0; i < priv->configs->len; i++) {
+    entry = g_ptr_array_index (priv->configs, i);
+    if (entry->profile != profile || entry->entrypoint != entrypoint)
+      continue;
+    if (entry->num_attribs != num_attribs)
+      continue;
+    if (num_attribs > 0 && memcmp (entry->attribs, attribs,
+            num_attribs * sizeof (*attribs)) != 0)
+      continue;
+    goto done;
+  }
+
+  profile_start = gst_vaapi_profiler_begin ();
+  status = vaCreateConfig (priv->display, profile, entrypoint,
+      (VAConfigAttrib *) attribs, num_attribs, &config);
+  gst_vaapi_profiler_end (priv->display, GST_VAAPI_PROFILER_CREATE_CONFIG,
+      profile_start);
+  if (!vaapi_check_status (status, "vaCreateConfig()"))
+    goto error;
+
+  GST_DEBUG ("new config 0x%08x", config);
+
+  entry = g_slice_new0 (GstVaapiConfigEntry);
+  entry->id = config;
+  entry->profile = profile;
+  entry->entrypoint = entrypoint;
+  entry->attribs = g_memdup2 (attribs, num_attribs * sizeof (*attribs));
+  entry->num_attribs = num_attribs;
+  g_ptr_array_add (priv->configs, entry);
+
+done:
+  entry->ref_count++;
+  *config_ptr = entry->id;
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    GST_VAAPI_DISPLAY_UNLOCK (display);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_display_release_config:
+ * @display: a #GstVaapiDisplay
+ * @config: a VA config returned by gst_vaapi_display_acquire_config()
+ *
+ * Releases a reference to @config. The config is kept around once
+ * unused, so that the next context set up with the same parameters
+ * reuses it, until there are more than a few of them.
+ */
+void
+gst_vaapi_display_release_config (GstVaapiDisplay * display,
+    VAConfigID config)
+{
+  GstVaapiDisplayPrivate *priv;
+  GstVaapiConfigEntry *entry;
+  guint i, num_idle;
+
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY (display));
+
+  if (config == VA_INVALID_ID)
+    return;
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  priv = get_configs_private (display);
+
+  entry = find_config_entry (priv, config);
+  if (!entry || entry->ref_count == 0) {
+    GST_WARNING ("unknown config 0x%08x", config);
+    goto done;
+  }
+  if (--entry->ref_count > 0)
+    goto done;
+
+  /* keep the most recently used idle configs last */
+  g_ptr_array_remove (priv->configs, entry);
+  g_ptr_array_add (priv->configs, entry);
+
+  num_idle = 0;
+  for (i = 0; i < priv->configs->len; i++) {
+    entry = g_ptr_array_index (priv->configs, i);
+    if (entry->ref_count == 0)
+      num_idle++;
+  }
+
+  for (i = 0; i < priv->configs->len && num_idle > MAX_IDLE_CONFIGS;) {
+    entry = g_ptr_array_index (priv->configs, i);
+    if (entry->ref_count > 0) {
+      i++;
+      continue;
+    }
+    g_ptr_array_remove_index (priv->configs, i);
+    config_entry_destroy (priv, entry);
+    num_idle--;
+  }
+
+done:
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+}
+
+/**
+ * gst_vaapi_display_lookup_config_surface_attributes:
+ * @display: a #GstVaapiDisplay
+ * @config: a VA config
+ *
+ * Looks up the surface attributes recorded for @config with
+ * gst_vaapi_display_store_config_surface_attributes().
+ *
+ * Return value: (transfer full): a copy of the surface attributes, or
+ *   %NULL if there are none
+ */
+GstVaapiConfigSurfaceAttributes *
+gst_vaapi_display_lookup_config_surface_attributes (GstVaapiDisplay * display,
+    VAConfigID config)
+{
+  GstVaapiConfigSurfaceAttributes *attribs = NULL;
+  GstVaapiConfigEntry *entry;
+
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY (display), NULL);
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  entry = find_config_entry (get_configs_private (display), config);
+  if (entry && entry->surface_attribs)
+    attribs = gst_vaapi_config_surface_attributes_copy (entry->surface_attribs);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return attribs;
+}
+
+/**
+ * gst_vaapi_display_store_config_surface_attributes:
+ * @display: a #GstVaapiDisplay
+ * @config: a VA config
+ * @attribs: the surface attributes of @config
+ *
+ * Records a copy of @attribs for the next lookups, provided @config
+ * was returned by gst_vaapi_display_acquire_config().
+ */
+void
+gst_vaapi_display_store_config_surface_attributes (GstVaapiDisplay * display,
+    VAConfigID config, const GstVaapiConfigSurfaceAttributes * attribs)
+{
+  GstVaapiConfigEntry *entry;
+
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY (display));
+  g_return_if_fail (attribs != NULL);
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  entry = find_config_entry (get_configs_private (display), config);
+  if (entry && !entry->surface_attribs)
+    entry->surface_attribs = gst_vaapi_config_surface_attributes_copy (attribs);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+}
+
 static void
 gst_vaapi_display_destroy (GstVaapiDisplay * display)
 {
@@ -907,8 +1379,23 @@ gst_vaapi_display_destroy (GstVaapiDisplay * display)
   g_clear_pointer (&priv->image_formats, g_array_unref);
   g_clear_pointer (&priv->subpicture_formats, g_array_unref);
   g_clear_pointer (&priv->properties, g_array_unref);
+  g_clear_pointer (&priv->cache, gst_vaapi_display_cache_free);
+
+  if (!priv->parent && priv->lock_count > 0) {
+    GST_INFO_OBJECT (display, "display lock: %" G_GUINT64_FORMAT
+        " acquisitions, %" G_GUINT64_FORMAT " contended", priv->lock_count,
+        priv->lock_contended_count);
+  }
+
+  if (priv->profiler) {
+    gchar *const report = gst_vaapi_profiler_get_report (priv->profiler);
+    GST_INFO_OBJECT (display, "VA calls profile:\n%s", report);
+    g_free (report);
+    g_clear_pointer (&priv->profiler, gst_vaapi_profiler_release);
+  }
 
   if (priv->display) {
+    destroy_configs (priv);
     if (!priv->parent)
       vaTerminate (priv->display);
     priv->display = NULL;
@@ -970,6 +1457,16 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
   if (!priv->parent) {
     if (!vaapi_initialize (priv->display))
       return FALSE;
+    if (g_getenv (PROFILE_VA_ENV))
+      priv->profiler = gst_vaapi_profiler_acquire (priv->display);
+
+    /* The VA/X11 drivers may issue requests on the X11 connection from
+       any VA call, and Xlib is not thread-safe */
+    priv->serialize_va = g_getenv (SERIALIZE_VA_ENV) != NULL ||
+        klass->display_type == GST_VAAPI_DISPLAY_TYPE_X11 ||
+        klass->display_type == GST_VAAPI_DISPLAY_TYPE_GLX;
+    GST_DEBUG_OBJECT (display, "VA calls are %sserialized",
+        priv->serialize_va ? "" : "not ");
   }
 
   GST_INFO_OBJECT (display, "new display addr=%p", display);
@@ -978,6 +1475,9 @@ gst_vaapi_display_create (GstVaapiDisplay * display,
 
   set_driver_quirks (display);
 
+  priv->cache =
+      gst_vaapi_display_cache_new (priv->display_name, priv->vendor_string);
+
   if (!ensure_image_formats (display)) {
     gst_vaapi_display_destroy (display);
     return FALSE;
@@ -993,7 +1493,13 @@ gst_vaapi_display_lock_default (GstVaapiDisplay * display)
 
   if (priv->parent)
     priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
-  g_rec_mutex_lock (&priv->mutex);
+
+  /* The statistics are updated with the lock held */
+  if (!g_rec_mutex_trylock (&priv->mutex)) {
+    g_rec_mutex_lock (&priv->mutex);
+    priv->lock_contended_count++;
+  }
+  priv->lock_count++;
 }
 
 static void
@@ -1336,6 +1842,86 @@ gst_vaapi_display_unlock (GstVaapiDisplay * display)
     klass->unlock (display);
 }
 
+/**
+ * gst_vaapi_display_va_lock:
+ * @display: a #GstVaapiDisplay
+ *
+ * Locks @display if the VA calls issued on it have to be serialized.
+ * See GST_VAAPI_DISPLAY_VA_LOCK().
+ */
+void
+gst_vaapi_display_va_lock (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_if_fail (display != NULL);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  if (priv->serialize_va)
+    gst_vaapi_display_lock (display);
+}
+
+/**
+ * gst_vaapi_display_va_unlock:
+ * @display: a #GstVaapiDisplay
+ *
+ * Unlocks @display after gst_vaapi_display_va_lock().
+ */
+void
+gst_vaapi_display_va_unlock (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_if_fail (display != NULL);
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+  if (priv->serialize_va)
+    gst_vaapi_display_unlock (display);
+}
+
+/**
+ * gst_vaapi_display_get_lock_stats:
+ * @display: a #GstVaapiDisplay
+ * @count_ptr: (out) (optional): return location for the number of
+ *   times the display lock was acquired
+ * @contended_ptr: (out) (optional): return location for the number of
+ *   times a thread had to wait for the display lock
+ *
+ * Retrieves the contention statistics of the display lock, which is
+ * shared by all the displays created from the same VA display. The
+ * statistics are only maintained by the default lock implementation.
+ *
+ * This function is thread safe.
+ */
+void
+gst_vaapi_display_get_lock_stats (GstVaapiDisplay * display,
+    guint64 * count_ptr, guint64 * contended_ptr)
+{
+  GstVaapiDisplayPrivate *priv;
+  guint64 count, contended;
+
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY (display));
+
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->parent)
+    priv = GST_VAAPI_DISPLAY_GET_PRIVATE (priv->parent);
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  /* Do not account for this very acquisition */
+  count = priv->lock_count - 1;
+  contended = priv->lock_contended_count;
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+
+  if (count_ptr)
+    *count_ptr = count;
+  if (contended_ptr)
+    *contended_ptr = contended;
+}
+
 /**
  * gst_vaapi_display_sync:
  * @display: a #GstVaapiDisplay
@@ -2168,3 +2754,74 @@ gst_vaapi_display_has_driver_quirks (GstVaapiDisplay * display, guint quirks)
 
   return (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->driver_quirks & quirks);
 }
+
+/**
+ * gst_vaapi_display_set_va_profiling:
+ * @display: a #GstVaapiDisplay
+ * @enabled: %TRUE to profile the VA calls
+ *
+ * Enables or disables the profiling of the VA calls issued on
+ * @display, and on the displays sharing its VA display. The number of
+ * calls, the cumulative time and a latency histogram are recorded per
+ * VA entrypoint, and logged when @display is destroyed. Profiling is
+ * enabled by default if the GST_VAAPI_PROFILE_VA environment variable
+ * is set.
+ *
+ * This function is thread safe.
+ */
+void
+gst_vaapi_display_set_va_profiling (GstVaapiDisplay * display,
+    gboolean enabled)
+{
+  GstVaapiDisplayPrivate *priv;
+
+  g_return_if_fail (GST_VAAPI_IS_DISPLAY (display));
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (enabled && !priv->profiler)
+    priv->profiler = gst_vaapi_profiler_acquire (priv->display);
+  else if (!enabled && priv->profiler)
+    g_clear_pointer (&priv->profiler, gst_vaapi_profiler_release);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+}
+
+/**
+ * gst_vaapi_display_get_va_profiling:
+ * @display: a #GstVaapiDisplay
+ *
+ * Return value: %TRUE if the VA calls issued on @display are profiled
+ */
+gboolean
+gst_vaapi_display_get_va_profiling (GstVaapiDisplay * display)
+{
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY (display), FALSE);
+
+  return GST_VAAPI_DISPLAY_GET_PRIVATE (display)->profiler != NULL;
+}
+
+/**
+ * gst_vaapi_display_get_va_profile_report:
+ * @display: a #GstVaapiDisplay
+ *
+ * Formats the statistics of the VA calls issued on @display since the
+ * profiling was enabled, one line per VA entrypoint.
+ *
+ * Return value: (transfer full) (nullable): the newly allocated
+ *   report, or %NULL if profiling is disabled
+ */
+gchar *
+gst_vaapi_display_get_va_profile_report (GstVaapiDisplay * display)
+{
+  GstVaapiDisplayPrivate *priv;
+  gchar *report = NULL;
+
+  g_return_val_if_fail (GST_VAAPI_IS_DISPLAY (display), NULL);
+
+  GST_VAAPI_DISPLAY_LOCK (display);
+  priv = GST_VAAPI_DISPLAY_GET_PRIVATE (display);
+  if (priv->profiler)
+    report = gst_vaapi_profiler_get_report (priv->profiler);
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  return report;
+}
@@ -286,6 +286,20 @@ gst_vaapi_display_reset_texture_map (GstVaapiDisplay * display);
 gboolean
 gst_vaapi_display_has_driver_quirks (GstVaapiDisplay * display, guint quirks);
 
+void
+gst_vaapi_display_set_va_profiling (GstVaapiDisplay * display,
+    gboolean enabled);
+
+gboolean
+gst_vaapi_display_get_va_profiling (GstVaapiDisplay * display);
+
+gchar *
+gst_vaapi_display_get_va_profile_report (GstVaapiDisplay * display);
+
+void
+gst_vaapi_display_get_lock_stats (GstVaapiDisplay * display,
+    guint64 * count_ptr, guint64 * contended_ptr);
+
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GstVaapiDisplay, gst_object_unref)
 
 G_END_DECLS
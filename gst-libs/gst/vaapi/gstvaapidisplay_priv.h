@@ -30,6 +30,9 @@
 #include <gst/vaapi/gstvaapitexture.h>
 #include <gst/vaapi/gstvaapitexturemap.h>
 #include "gstvaapiminiobject.h"
+#include "gstvaapidisplaycache.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapiutils_core.h"
 
 G_BEGIN_DECLS
 
@@ -107,6 +110,42 @@ typedef enum _GstVaapiDisplayInitType           GstVaapiDisplayInitType;
 #define GST_VAAPI_DISPLAY_HAS_VPP(display) \
   gst_vaapi_display_has_video_processing (GST_VAAPI_DISPLAY_CAST (display))
 
+/**
+ * GST_VAAPI_DISPLAY_CACHE:
+ * @display: a #GstVaapiDisplay
+ *
+ * Macro that evaluates to the capabilities cache of @display, or
+ * %NULL if it is disabled.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_DISPLAY_CACHE
+#define GST_VAAPI_DISPLAY_CACHE(display) \
+  (GST_VAAPI_DISPLAY_GET_PRIVATE (display)->cache)
+
+/**
+ * GST_VAAPI_DISPLAY_VA_LOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Locks @display around a VA call that only involves objects owned by
+ * the caller (surfaces, images, buffers, contexts). libva is
+ * thread-safe for such calls, so this only takes the display lock if
+ * the VA calls have to be serialized, e.g. because the VA driver may
+ * issue requests on a non thread-safe X11 connection.
+ */
+#undef  GST_VAAPI_DISPLAY_VA_LOCK
+#define GST_VAAPI_DISPLAY_VA_LOCK(display) \
+  gst_vaapi_display_va_lock (GST_VAAPI_DISPLAY_CAST (display))
+
+/**
+ * GST_VAAPI_DISPLAY_VA_UNLOCK:
+ * @display: a #GstVaapiDisplay
+ *
+ * Unlocks @display after GST_VAAPI_DISPLAY_VA_LOCK().
+ */
+#undef  GST_VAAPI_DISPLAY_VA_UNLOCK
+#define GST_VAAPI_DISPLAY_VA_UNLOCK(display) \
+  gst_vaapi_display_va_unlock (GST_VAAPI_DISPLAY_CAST (display))
+
 struct _GstVaapiDisplayPrivate
 {
   GstVaapiDisplay *parent;
@@ -127,10 +166,16 @@ struct _GstVaapiDisplayPrivate
   GArray *subpicture_formats;
   GArray *properties;
   gchar *vendor_string;
+  GstVaapiDisplayCache *cache;
+  GPtrArray *configs;
+  GstVaapiProfiler *profiler;
+  guint64 lock_count;
+  guint64 lock_contended_count;
   guint use_foreign_display:1;
   guint has_vpp:1;
   guint has_profiles:1;
   guint got_scrres:1;
+  guint serialize_va:1;
   guint driver_quirks;
 };
 
@@ -206,6 +251,36 @@ GstVaapiDisplay *
 gst_vaapi_display_config (GstVaapiDisplay * display,
     GstVaapiDisplayInitType init_type, gpointer init_value);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_acquire_config (GstVaapiDisplay * display,
+    VAProfile profile, VAEntrypoint entrypoint,
+    const VAConfigAttrib * attribs, guint num_attribs,
+    VAConfigID * config_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_release_config (GstVaapiDisplay * display,
+    VAConfigID config);
+
+G_GNUC_INTERNAL
+GstVaapiConfigSurfaceAttributes *
+gst_vaapi_display_lookup_config_surface_attributes (GstVaapiDisplay * display,
+    VAConfigID config);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_store_config_surface_attributes (GstVaapiDisplay * display,
+    VAConfigID config, const GstVaapiConfigSurfaceAttributes * attribs);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_va_lock (GstVaapiDisplay * display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_va_unlock (GstVaapiDisplay * display);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_DISPLAY_PRIV_H */
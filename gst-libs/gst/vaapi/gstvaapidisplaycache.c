@@ -0,0 +1,460 @@
+/*
+ *  gstvaapidisplaycache.c - VA display capabilities cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The capabilities cache records the answers of the VA driver to the
+ * queries issued when a display is set up (profiles, entrypoints,
+ * image and subpicture formats, surface attributes per config), so
+ * that the next displays opened on the same device, possibly in
+ * another process, do not have to query the driver again.
+ *
+ * The cache lives in a single key file under the user cache
+ * directory, with one group per device node. Each group carries an
+ * identity string built from the device node, the driver vendor
+ * string, and the path and modification time of every VA driver
+ * libva could load. Any mismatch discards the whole group.
+ */
+
+#include "sysdeps.h"
+#include <glib/gstdio.h>
+#ifdef __linux__
+# include <sys/stat.h>
+# include <sys/sysmacros.h>
+#endif
+#include "gstvaapicompat.h"
+#include "gstvaapidisplaycache.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#define CACHE_DISABLE_ENV "GST_VAAPI_DISABLE_CAPS_CACHE"
+#define CACHE_FILE_NAME "vaapi-capabilities.cache"
+#define CACHE_IDENTITY_KEY "identity"
+
+struct _GstVaapiDisplayCache
+{
+  gchar *filename;
+  gchar *group;
+  gchar *identity;
+  GKeyFile *keyfile;
+  gboolean dirty;
+};
+
+struct _GstVaapiDisplayCacheSnapshot
+{
+  gchar *filename;
+  gchar *group;
+  GKeyFile *keyfile;
+};
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Appends path and mtime of all the VA drivers libva may load, in
+ * the same locations gstvaapi.c tracks as plugin dependencies */
+static void
+append_drivers_identity (GString * identity)
+{
+  const gchar *drivers_path;
+  gchar **dirs;
+  guint i, j;
+
+  drivers_path = g_getenv ("LIBVA_DRIVERS_PATH");
+  if (!drivers_path)
+    drivers_path = VA_DRIVERS_PATH;
+
+  dirs = g_strsplit (drivers_path, G_SEARCHPATH_SEPARATOR_S, 0);
+  for (i = 0; dirs[i]; i++) {
+    GPtrArray *names;
+    const gchar *name;
+    GDir *dir;
+
+    dir = g_dir_open (dirs[i], 0, NULL);
+    if (!dir)
+      continue;
+
+    names = g_ptr_array_new_with_free_func (g_free);
+    while ((name = g_dir_read_name (dir))) {
+      if (g_str_has_suffix (name, "_drv_video.so"))
+        g_ptr_array_add (names, g_strdup (name));
+    }
+    g_dir_close (dir);
+
+    /* directory order is unspecified */
+    g_ptr_array_sort (names, compare_strings);
+
+    for (j = 0; j < names->len; j++) {
+      gchar *const path = g_build_filename (dirs[i],
+          g_ptr_array_index (names, j), NULL);
+      GStatBuf st;
+
+      if (g_stat (path, &st) == 0) {
+        g_string_append_printf (identity, ";%s:%" G_GINT64_FORMAT, path,
+            (gint64) st.st_mtime);
+      }
+      g_free (path);
+    }
+    g_ptr_array_unref (names);
+  }
+  g_strfreev (dirs);
+}
+
+/* Appends the bus ID of the DRM device, e.g. the PCI slot of the GPU,
+ * since device nodes are numbered in probe order and may point to
+ * another GPU after a reboot */
+static void
+append_device_identity (GString * identity, const gchar * device)
+{
+#ifdef __linux__
+  struct stat st;
+  gchar *link, *target, *bus_id;
+
+  if (stat (device, &st) != 0 || !S_ISCHR (st.st_mode))
+    return;
+
+  link = g_strdup_printf ("/sys/dev/char/%u:%u/device",
+      major (st.st_rdev), minor (st.st_rdev));
+  target = g_file_read_link (link, NULL);
+  g_free (link);
+  if (!target)
+    return;
+
+  bus_id = g_path_get_basename (target);
+  g_string_append_printf (identity, ";%s", bus_id);
+  g_free (bus_id);
+  g_free (target);
+#endif
+}
+
+static gchar *
+get_identity (const gchar * device, const gchar * vendor)
+{
+  GString *identity;
+
+  identity = g_string_new (PACKAGE_VERSION ";" VA_VERSION_S);
+  g_string_append_printf (identity, ";%s;%s;%s", device, vendor,
+      GST_STR_NULL (g_getenv ("LIBVA_DRIVER_NAME")));
+  append_device_identity (identity, device);
+  append_drivers_identity (identity);
+  return g_string_free (identity, FALSE);
+}
+
+/* Key file group names cannot hold brackets nor control characters */
+static gboolean
+is_valid_group_name (const gchar * name)
+{
+  const gchar *p;
+
+  for (p = name; *p; p++) {
+    if (*p == '[' || *p == ']' || g_ascii_iscntrl (*p))
+      return FALSE;
+  }
+  return p != name;
+}
+
+/**
+ * gst_vaapi_display_cache_new:
+ * @device: the device node, or display name, the VA display runs on
+ * @vendor: the VA driver vendor string
+ *
+ * Opens the capabilities cache for @device. The entries recorded for
+ * @device are dropped if they were produced by another driver.
+ *
+ * The cache is disabled when the GST_VAAPI_DISABLE_CAPS_CACHE
+ * environment variable is set, or when @device is unknown, as it is
+ * for foreign VA displays.
+ *
+ * Return value: the newly allocated #GstVaapiDisplayCache, or %NULL
+ *   if the cache is disabled
+ */
+GstVaapiDisplayCache *
+gst_vaapi_display_cache_new (const gchar * device, const gchar * vendor)
+{
+  GstVaapiDisplayCache *cache;
+  gchar *identity;
+
+  if (g_getenv (CACHE_DISABLE_ENV))
+    return NULL;
+  if (!device || !vendor || !is_valid_group_name (device))
+    return NULL;
+
+  cache = g_slice_new0 (GstVaapiDisplayCache);
+  cache->filename = g_build_filename (g_get_user_cache_dir (),
+      "gstreamer-" GST_API_VERSION_S, CACHE_FILE_NAME, NULL);
+  cache->group = g_strdup (device);
+  cache->identity = get_identity (device, vendor);
+  cache->keyfile = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (cache->keyfile, cache->filename,
+          G_KEY_FILE_NONE, NULL))
+    GST_DEBUG ("no capabilities cache at %s", cache->filename);
+
+  identity = g_key_file_get_string (cache->keyfile, cache->group,
+      CACHE_IDENTITY_KEY, NULL);
+  if (g_strcmp0 (identity, cache->identity) != 0) {
+    GST_INFO ("capabilities cache miss for %s", device);
+    g_key_file_remove_group (cache->keyfile, cache->group, NULL);
+    g_key_file_set_string (cache->keyfile, cache->group, CACHE_IDENTITY_KEY,
+        cache->identity);
+  } else {
+    GST_INFO ("capabilities cache hit for %s", device);
+  }
+  g_free (identity);
+
+  return cache;
+}
+
+/**
+ * gst_vaapi_display_cache_free:
+ * @cache: a #GstVaapiDisplayCache
+ *
+ * Releases @cache. Unsaved entries are lost.
+ */
+void
+gst_vaapi_display_cache_free (GstVaapiDisplayCache * cache)
+{
+  if (!cache)
+    return;
+
+  g_key_file_free (cache->keyfile);
+  g_free (cache->identity);
+  g_free (cache->group);
+  g_free (cache->filename);
+  g_slice_free (GstVaapiDisplayCache, cache);
+}
+
+/**
+ * gst_vaapi_display_cache_lookup:
+ * @cache: a #GstVaapiDisplayCache, or %NULL
+ * @name: the entry name
+ * @values_ptr: return location for the newly allocated values
+ * @num_values_ptr: return location for the number of values
+ *
+ * Looks up the integer values recorded under @name. An entry may be
+ * recorded with no values at all, in which case *@values_ptr is set
+ * to %NULL. The values are to be released with g_free().
+ *
+ * Return value: %TRUE if @name was found, %FALSE otherwise
+ */
+gboolean
+gst_vaapi_display_cache_lookup (GstVaapiDisplayCache * cache,
+    const gchar * name, gint ** values_ptr, guint * num_values_ptr)
+{
+  gchar *value, **tokens;
+  gint *values = NULL;
+  guint i, num_values;
+
+  g_return_val_if_fail (name != NULL, FALSE);
+  g_return_val_if_fail (values_ptr != NULL, FALSE);
+  g_return_val_if_fail (num_values_ptr != NULL, FALSE);
+
+  if (!cache)
+    return FALSE;
+
+  value = g_key_file_get_value (cache->keyfile, cache->group, name, NULL);
+  if (!value)
+    return FALSE;
+
+  tokens = g_strsplit (value, ";", 0);
+  g_free (value);
+
+  /* entries are ';'-terminated, hence the trailing empty token */
+  num_values = g_strv_length (tokens);
+  if (num_values > 0 && tokens[num_values - 1][0] == '\0')
+    num_values--;
+
+  if (num_values > 0) {
+    values = g_new (gint, num_values);
+    for (i = 0; i < num_values; i++) {
+      gchar *end;
+
+      values[i] = g_ascii_strtoll (tokens[i], &end, 10);
+      if (end == tokens[i] || *end != '\0')
+        goto error;
+    }
+  }
+  g_strfreev (tokens);
+
+  *values_ptr = values;
+  *num_values_ptr = num_values;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    GST_WARNING ("invalid capabilities cache entry %s", name);
+    g_strfreev (tokens);
+    g_free (values);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_vaapi_display_cache_store:
+ * @cache: a #GstVaapiDisplayCache, or %NULL
+ * @name: the entry name
+ * @values: the values to record
+ * @num_values: the number of @values
+ *
+ * Records @values under @name. The entry only reaches the disk once
+ * a snapshot of @cache is saved.
+ */
+void
+gst_vaapi_display_cache_store (GstVaapiDisplayCache * cache,
+    const gchar * name, const gint * values, guint num_values)
+{
+  GString *value;
+  guint i;
+
+  g_return_if_fail (name != NULL);
+  g_return_if_fail (values != NULL || num_values == 0);
+
+  if (!cache)
+    return;
+
+  value = g_string_new (NULL);
+  for (i = 0; i < num_values; i++)
+    g_string_append_printf (value, "%d;", values[i]);
+  g_key_file_set_value (cache->keyfile, cache->group, name, value->str);
+  g_string_free (value, TRUE);
+  cache->dirty = TRUE;
+}
+
+/**
+ * gst_vaapi_display_cache_snapshot:
+ * @cache: a #GstVaapiDisplayCache, or %NULL
+ *
+ * Copies the entries of @cache if some were recorded since the last
+ * snapshot. This only touches memory, so that it can be called with
+ * the display lock held, whereas the copy is written to the disk
+ * later on with gst_vaapi_display_cache_snapshot_save().
+ *
+ * Return value: the newly allocated #GstVaapiDisplayCacheSnapshot, or
+ *   %NULL if there is nothing to write
+ */
+GstVaapiDisplayCacheSnapshot *
+gst_vaapi_display_cache_snapshot (GstVaapiDisplayCache * cache)
+{
+  GstVaapiDisplayCacheSnapshot *snapshot;
+  gchar **keys;
+  guint i;
+
+  if (!cache || !cache->dirty)
+    return NULL;
+
+  snapshot = g_slice_new (GstVaapiDisplayCacheSnapshot);
+  snapshot->filename = g_strdup (cache->filename);
+  snapshot->group = g_strdup (cache->group);
+  snapshot->keyfile = g_key_file_new ();
+
+  keys = g_key_file_get_keys (cache->keyfile, cache->group, NULL, NULL);
+  for (i = 0; keys && keys[i]; i++) {
+    gchar *const value = g_key_file_get_value (cache->keyfile, cache->group,
+        keys[i], NULL);
+
+    g_key_file_set_value (snapshot->keyfile, snapshot->group, keys[i], value);
+    g_free (value);
+  }
+  g_strfreev (keys);
+
+  /* a failed save is not retried for every new entry either */
+  cache->dirty = FALSE;
+  return snapshot;
+}
+
+static void
+snapshot_free (GstVaapiDisplayCacheSnapshot * snapshot)
+{
+  g_key_file_free (snapshot->keyfile);
+  g_free (snapshot->group);
+  g_free (snapshot->filename);
+  g_slice_free (GstVaapiDisplayCacheSnapshot, snapshot);
+}
+
+/**
+ * gst_vaapi_display_cache_snapshot_save:
+ * @snapshot: (transfer full): a #GstVaapiDisplayCacheSnapshot, or %NULL
+ *
+ * Writes @snapshot to the disk, then releases it. The groups of the
+ * other devices are re-read first, so that concurrent processes only
+ * ever lose the entries they both wrote.
+ *
+ * This performs file I/O and must not be called with the display
+ * lock held.
+ *
+ * Return value: %TRUE on success, or if there was nothing to write
+ */
+gboolean
+gst_vaapi_display_cache_snapshot_save (GstVaapiDisplayCacheSnapshot * snapshot)
+{
+  GKeyFile *keyfile = NULL;
+  gchar **keys = NULL, *dirname = NULL;
+  GError *error = NULL;
+  gboolean success = FALSE;
+  guint i;
+
+  if (!snapshot)
+    return TRUE;
+
+  keyfile = g_key_file_new ();
+  g_key_file_load_from_file (keyfile, snapshot->filename, G_KEY_FILE_NONE,
+      NULL);
+  g_key_file_remove_group (keyfile, snapshot->group, NULL);
+
+  keys = g_key_file_get_keys (snapshot->keyfile, snapshot->group, NULL, NULL);
+  for (i = 0; keys && keys[i]; i++) {
+    gchar *const value = g_key_file_get_value (snapshot->keyfile,
+        snapshot->group, keys[i], NULL);
+
+    g_key_file_set_value (keyfile, snapshot->group, keys[i], value);
+    g_free (value);
+  }
+
+  dirname = g_path_get_dirname (snapshot->filename);
+  if (g_mkdir_with_parents (dirname, 0755) < 0)
+    goto error_create_directory;
+  if (!g_key_file_save_to_file (keyfile, snapshot->filename, &error))
+    goto error_save_file;
+
+  GST_DEBUG ("saved capabilities cache to %s", snapshot->filename);
+  success = TRUE;
+
+done:
+  g_free (dirname);
+  g_strfreev (keys);
+  g_key_file_free (keyfile);
+  snapshot_free (snapshot);
+  return success;
+
+  /* ERRORS */
+error_create_directory:
+  {
+    GST_WARNING ("failed to create capabilities cache directory %s", dirname);
+    goto done;
+  }
+error_save_file:
+  {
+    GST_WARNING ("failed to save capabilities cache: %s", error->message);
+    g_clear_error (&error);
+    goto done;
+  }
+}
@@ -0,0 +1,58 @@
+/*
+ *  gstvaapidisplaycache.h - VA display capabilities cache
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_DISPLAY_CACHE_H
+#define GST_VAAPI_DISPLAY_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiDisplayCache GstVaapiDisplayCache;
+typedef struct _GstVaapiDisplayCacheSnapshot GstVaapiDisplayCacheSnapshot;
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCache *
+gst_vaapi_display_cache_new (const gchar * device, const gchar * vendor);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_cache_free (GstVaapiDisplayCache * cache);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_cache_lookup (GstVaapiDisplayCache * cache,
+    const gchar * name, gint ** values_ptr, guint * num_values_ptr);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_display_cache_store (GstVaapiDisplayCache * cache,
+    const gchar * name, const gint * values, guint num_values);
+
+G_GNUC_INTERNAL
+GstVaapiDisplayCacheSnapshot *
+gst_vaapi_display_cache_snapshot (GstVaapiDisplayCache * cache);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_display_cache_snapshot_save (GstVaapiDisplayCacheSnapshot * snapshot);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_DISPLAY_CACHE_H */
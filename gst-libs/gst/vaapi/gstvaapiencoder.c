@@ -29,11 +29,19 @@
 #include "gstvaapidisplay_priv.h"
 #include "gstvaapiutils.h"
 #include "gstvaapiutils_core.h"
+#include "gstvaapitrace.h"
 #include "gstvaapivalue.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
 
+/* Number of coded buffers when async-depth is not set */
+#define DEFAULT_CODEDBUF_CAPACITY 5
+
+/* The coded buffers pool grows up to this size while downstream holds
+   exported coded buffers */
+#define MAX_CODEDBUF_CAPACITY 32
+
 gboolean
 gst_vaapi_encoder_ensure_param_quality_level (GstVaapiEncoder * encoder,
     GstVaapiEncPicture * picture)
@@ -257,17 +265,28 @@ gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder)
   GstVaapiCodedBufferPool *const pool =
       GST_VAAPI_CODED_BUFFER_POOL (encoder->codedbuf_pool);
   GstVaapiCodedBufferProxy *codedbuf_proxy;
+  guint capacity;
 
   g_mutex_lock (&encoder->mutex);
-  do {
+  for (;;) {
     codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
     if (codedbuf_proxy)
       break;
 
+    /* Grow the pool rather than wait while downstream holds exported
+       coded buffers, since they could be released late */
+    capacity = gst_vaapi_video_pool_get_capacity (encoder->codedbuf_pool);
+    if (encoder->num_codedbuf_exported > 0 && capacity > 0 &&
+        capacity < MAX_CODEDBUF_CAPACITY) {
+      GST_INFO ("%u coded buffers held downstream, growing pool to %u",
+          encoder->num_codedbuf_exported, capacity + 1);
+      gst_vaapi_video_pool_set_capacity (encoder->codedbuf_pool, capacity + 1);
+      continue;
+    }
+
     /* Wait for a free coded buffer to become available */
     g_cond_wait (&encoder->codedbuf_free, &encoder->mutex);
-    codedbuf_proxy = gst_vaapi_coded_buffer_proxy_new_from_pool (pool);
-  } while (0);
+  }
   g_mutex_unlock (&encoder->mutex);
   if (!codedbuf_proxy)
     return NULL;
@@ -277,6 +296,56 @@ gst_vaapi_encoder_create_coded_buffer (GstVaapiEncoder * encoder)
   return codedbuf_proxy;
 }
 
+/* Same as _coded_buffer_proxy_released_notify() for coded buffers
+   exported downstream, which hold a reference to the encoder: the
+   coded buffer is mapped from the encoder VA context, which must not
+   be destroyed before */
+static void
+_coded_buffer_proxy_exported_notify (GstVaapiEncoder * encoder)
+{
+  g_mutex_lock (&encoder->mutex);
+  encoder->num_codedbuf_exported--;
+  g_cond_signal (&encoder->codedbuf_free);
+  g_mutex_unlock (&encoder->mutex);
+  gst_object_unref (encoder);
+}
+
+/**
+ * gst_vaapi_encoder_export_coded_buffer:
+ * @encoder: a #GstVaapiEncoder
+ * @codedbuf_proxy: a #GstVaapiCodedBufferProxy obtained from @encoder
+ *
+ * Wraps the segments of @codedbuf_proxy into a #GstBuffer, without
+ * copying them. The memories are read-only, and keep @encoder alive.
+ * The coded buffer returns to the @encoder pool once all of them are
+ * released. If downstream holds them long enough to starve the
+ * encoder, the pool is grown.
+ *
+ * Return value: the newly allocated #GstBuffer, or %NULL on error
+ */
+GstBuffer *
+gst_vaapi_encoder_export_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy)
+{
+  GstBuffer *buffer;
+
+  g_return_val_if_fail (encoder != NULL, NULL);
+  g_return_val_if_fail (codedbuf_proxy != NULL, NULL);
+
+  buffer = gst_vaapi_coded_buffer_proxy_wrap_buffer (codedbuf_proxy);
+  if (!buffer)
+    return NULL;
+
+  gst_vaapi_coded_buffer_proxy_set_destroy_notify (codedbuf_proxy,
+      (GDestroyNotify) _coded_buffer_proxy_exported_notify,
+      gst_object_ref (encoder));
+
+  g_mutex_lock (&encoder->mutex);
+  encoder->num_codedbuf_exported++;
+  g_mutex_unlock (&encoder->mutex);
+  return buffer;
+}
+
 /* Notifies gst_vaapi_encoder_create_surface() that a new surface is free */
 static void
 _surface_proxy_released_notify (GstVaapiEncoder * encoder)
@@ -311,9 +380,88 @@ gst_vaapi_encoder_create_surface (GstVaapiEncoder * encoder)
   return proxy;
 }
 
+/* A coded buffer whose picture was processed by the hardware */
+typedef struct
+{
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+  gboolean success;
+} GstVaapiEncoderOutput;
+
+static void
+output_free (GstVaapiEncoderOutput * output)
+{
+  gst_vaapi_coded_buffer_proxy_unref (output->codedbuf_proxy);
+  g_slice_free (GstVaapiEncoderOutput, output);
+}
+
+/* Waits for the completion of the submitted pictures, in submission
+   order, and makes their coded buffers available to the output. The
+   encoder itself is pushed into the queue to stop the thread */
+static gpointer
+sync_thread_func (GstVaapiEncoder * encoder)
+{
+  GstVaapiCodedBufferProxy *codedbuf_proxy;
+  GstVaapiEncPicture *picture;
+  GstVaapiEncoderOutput *output;
+  gint64 trace_start;
+
+  for (;;) {
+    codedbuf_proxy = g_async_queue_pop (encoder->codedbuf_queue);
+    if (codedbuf_proxy == (gpointer) encoder)
+      break;
+
+    output = g_slice_new (GstVaapiEncoderOutput);
+    output->codedbuf_proxy = codedbuf_proxy;
+    picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
+    trace_start = gst_vaapi_trace_begin ();
+    output->success = gst_vaapi_surface_sync (picture->surface);
+    gst_vaapi_trace_end (trace_start, "coded_wait",
+        picture->frame->system_frame_number, picture->surface_id);
+
+    g_mutex_lock (&encoder->output_mutex);
+    g_queue_push_tail (&encoder->output_queue, output);
+    encoder->num_in_flight--;
+    GST_LOG ("frame %u completed, %u in flight", picture->frame_num,
+        encoder->num_in_flight);
+    g_cond_broadcast (&encoder->output_cond);
+    g_mutex_unlock (&encoder->output_mutex);
+  }
+  return NULL;
+}
+
+static gboolean
+sync_thread_start (GstVaapiEncoder * encoder)
+{
+  GError *error = NULL;
+
+  if (encoder->sync_thread)
+    return TRUE;
+
+  encoder->sync_thread = g_thread_try_new ("vaapi-encsync",
+      (GThreadFunc) sync_thread_func, encoder, &error);
+  if (!encoder->sync_thread) {
+    GST_ERROR ("failed to create sync thread: %s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+sync_thread_stop (GstVaapiEncoder * encoder)
+{
+  if (!encoder->sync_thread)
+    return;
+
+  g_async_queue_push (encoder->codedbuf_queue, encoder);
+  g_thread_join (encoder->sync_thread);
+  encoder->sync_thread = NULL;
+}
+
 /* Create a coded buffer proxy where the picture is going to be
  * decoded, the subclass encode vmethod is called and, if it doesn't
- * fail, the coded buffer is pushed into the async queue */
+ * fail, the coded buffer is pushed into the async queue, for the
+ * sync thread to wait for its completion */
 static GstVaapiEncoderStatus
 gst_vaapi_encoder_encode_and_queue (GstVaapiEncoder * encoder,
     GstVaapiEncPicture * picture)
@@ -321,12 +469,31 @@ gst_vaapi_encoder_encode_and_queue (GstVaapiEncoder * encoder,
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVaapiCodedBufferProxy *codedbuf_proxy;
   GstVaapiEncoderStatus status;
+  gint64 trace_start;
+
+  if (!sync_thread_start (encoder))
+    return GST_VAAPI_ENCODER_STATUS_ERROR_ALLOCATION_FAILED;
 
   codedbuf_proxy = gst_vaapi_encoder_create_coded_buffer (encoder);
   if (!codedbuf_proxy)
     goto error_create_coded_buffer;
 
+  /* Bound the number of pictures submitted to the hardware */
+  g_mutex_lock (&encoder->output_mutex);
+  while (encoder->max_in_flight > 0 &&
+      encoder->num_in_flight >= encoder->max_in_flight)
+    g_cond_wait (&encoder->output_cond, &encoder->output_mutex);
+  encoder->num_in_flight++;
+  encoder->peak_in_flight = MAX (encoder->peak_in_flight,
+      encoder->num_in_flight);
+  encoder->sum_in_flight += encoder->num_in_flight;
+  encoder->num_submitted++;
+  g_mutex_unlock (&encoder->output_mutex);
+
+  trace_start = gst_vaapi_trace_begin ();
   status = klass->encode (encoder, picture, codedbuf_proxy);
+  gst_vaapi_trace_end (trace_start, "encode",
+      picture->frame->system_frame_number, picture->surface_id);
   if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
     goto error_encode;
 
@@ -335,6 +502,11 @@ gst_vaapi_encoder_encode_and_queue (GstVaapiEncoder * encoder,
   g_async_queue_push (encoder->codedbuf_queue, codedbuf_proxy);
   encoder->num_codedbuf_queued++;
 
+  /* Wake up an output waiting for the next submission */
+  g_mutex_lock (&encoder->output_mutex);
+  g_cond_broadcast (&encoder->output_cond);
+  g_mutex_unlock (&encoder->output_mutex);
+
   return status;
 
   /* ERRORS */
@@ -346,32 +518,416 @@ error_create_coded_buffer:
 error_encode:
   {
     GST_ERROR ("failed to encode frame (status = %d)", status);
+    g_mutex_lock (&encoder->output_mutex);
+    encoder->num_in_flight--;
+    g_cond_broadcast (&encoder->output_cond);
+    g_mutex_unlock (&encoder->output_mutex);
     gst_vaapi_coded_buffer_proxy_unref (codedbuf_proxy);
     return status;
   }
 }
 
+/* ------------------------------------------------------------------------- */
+/* --- Lookahead                                                         --- */
+/* ------------------------------------------------------------------------- */
+
+/* Luma is analysed on a thumbnail sampled from the input surface */
+#define LOOKAHEAD_THUMB_WIDTH   GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_WIDTH
+#define LOOKAHEAD_THUMB_HEIGHT  GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_HEIGHT
+#define LOOKAHEAD_THUMB_SIZE    (LOOKAHEAD_THUMB_WIDTH * LOOKAHEAD_THUMB_HEIGHT)
+#define LOOKAHEAD_HIST_BINS     GST_VAAPI_ENCODER_LOOKAHEAD_HIST_BINS
+
+/* A frame is a scene cut if its luma histogram changed by this much
+   (in percent), or if its mean absolute difference with the previous
+   frame is both above the minimum and several times the recent
+   average */
+#define LOOKAHEAD_CUT_HIST_DIFF 50
+#define LOOKAHEAD_CUT_SAD_MIN   24
+#define LOOKAHEAD_CUT_SAD_RATIO 3
+
+/* Don't report cuts closer than that, e.g. for flashes */
+#define LOOKAHEAD_CUT_MIN_DISTANCE 4
+
+/* Above this mean absolute difference, motion is too high for B-frames
+   to pay off */
+#define LOOKAHEAD_BFRAME_MAX_SAD 12
+
+struct _GstVaapiEncoderLookaheadFrame
+{
+  GstVideoCodecFrame *frame;
+  guint sad;                    /* mean absolute luma difference */
+  gboolean scene_cut;
+};
+
+static void
+lookahead_frame_free (GstVaapiEncoderLookaheadFrame * laf)
+{
+  gst_video_codec_frame_unref (laf->frame);
+  g_slice_free (GstVaapiEncoderLookaheadFrame, laf);
+}
+
+/* Downscales the surface with VPP to twice the thumbnail size, so that
+   only a few KB are read back instead of the whole picture. Returns
+   NULL if VPP is not available, the thumbnail is then sampled from
+   the full size surface */
+static GstVaapiSurface *
+lookahead_downscale_surface (GstVaapiEncoder * encoder,
+    GstVaapiSurface * surface)
+{
+  GstVaapiFilterStatus status;
+
+  if (encoder->lookahead_no_vpp)
+    return NULL;
+
+  if (!encoder->lookahead_filter) {
+    if (!gst_vaapi_display_has_video_processing (encoder->display))
+      goto error_no_vpp;
+    encoder->lookahead_filter = gst_vaapi_filter_new (encoder->display);
+    if (!encoder->lookahead_filter)
+      goto error_no_vpp;
+    gst_vaapi_filter_set_scaling (encoder->lookahead_filter,
+        GST_VAAPI_SCALE_METHOD_FAST);
+
+    encoder->lookahead_surface =
+        gst_vaapi_surface_new_with_format (encoder->display,
+        GST_VIDEO_FORMAT_NV12, 2 * LOOKAHEAD_THUMB_WIDTH,
+        2 * LOOKAHEAD_THUMB_HEIGHT, 0);
+    if (!encoder->lookahead_surface)
+      goto error_no_vpp;
+  }
+
+  status = gst_vaapi_filter_process (encoder->lookahead_filter, surface,
+      encoder->lookahead_surface, 0);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_no_vpp;
+  return encoder->lookahead_surface;
+
+  /* ERRORS */
+error_no_vpp:
+  {
+    GST_INFO ("cannot downscale with VPP, analyzing full size surfaces");
+    encoder->lookahead_no_vpp = TRUE;
+    gst_vaapi_filter_replace (&encoder->lookahead_filter, NULL);
+    gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_surface,
+        NULL);
+    return NULL;
+  }
+}
+
+/* Maps the surface contents, deriving an image if possible, or reading
+   it back into a cached one otherwise */
+static GstVaapiImage *
+lookahead_map_surface (GstVaapiEncoder * encoder, GstVaapiSurface * surface)
+{
+  GstVaapiImage *image;
+  guint width, height;
+
+  image = gst_vaapi_surface_derive_image (surface);
+  if (!image) {
+    gst_vaapi_surface_get_size (surface, &width, &height);
+    image = encoder->lookahead_image;
+    if (!image || gst_vaapi_image_get_width (image) != width ||
+        gst_vaapi_image_get_height (image) != height ||
+        gst_vaapi_image_get_format (image) !=
+        gst_vaapi_surface_get_format (surface)) {
+      gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_image,
+          NULL);
+      encoder->lookahead_image = gst_vaapi_image_new (encoder->display,
+          gst_vaapi_surface_get_format (surface), width, height);
+      image = encoder->lookahead_image;
+      if (!image)
+        return NULL;
+    }
+    if (!gst_vaapi_surface_get_image (surface, image))
+      return NULL;
+    gst_mini_object_ref (GST_MINI_OBJECT_CAST (image));
+  }
+
+  if (!gst_vaapi_image_map (image)) {
+    gst_vaapi_image_unref (image);
+    return NULL;
+  }
+  return image;
+}
+
+/* Samples a downscaled luma plane, averaging 2x2 pixels per sample */
+static gboolean
+lookahead_get_thumbnail (GstVaapiEncoder * encoder, GstVaapiSurface * surface,
+    guint8 * thumb)
+{
+  const GstVideoFormatInfo *finfo;
+  GstVaapiSurface *small_surface;
+  GstVaapiImage *image;
+  const guint8 *plane;
+  guint x, y, tx, ty, width, height, pitch, pstride, offset;
+
+  small_surface = lookahead_downscale_surface (encoder, surface);
+  image = lookahead_map_surface (encoder,
+      small_surface ? small_surface : surface);
+  if (!image)
+    return FALSE;
+
+  finfo = gst_video_format_get_info (gst_vaapi_image_get_format (image));
+  plane = gst_vaapi_image_get_plane (image,
+      GST_VIDEO_FORMAT_INFO_PLANE (finfo, 0));
+  pitch = gst_vaapi_image_get_pitch (image,
+      GST_VIDEO_FORMAT_INFO_PLANE (finfo, 0));
+  pstride = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, 0);
+  offset = GST_VIDEO_FORMAT_INFO_POFFSET (finfo, 0);
+
+  /* Only keep the most significant byte of high bit depth samples */
+  if (GST_VIDEO_FORMAT_INFO_BITS (finfo) > 8)
+    offset += 1;
+
+  /* Each sample averages 2x2 pixels */
+  gst_vaapi_image_get_size (image, &width, &height);
+  if (width < 2 || height < 2)
+    goto error_too_small;
+
+  for (ty = 0; ty < LOOKAHEAD_THUMB_HEIGHT; ty++) {
+    y = MIN (ty * height / LOOKAHEAD_THUMB_HEIGHT, height - 2);
+    for (tx = 0; tx < LOOKAHEAD_THUMB_WIDTH; tx++) {
+      const guint8 *p;
+
+      x = MIN (tx * width / LOOKAHEAD_THUMB_WIDTH, width - 2);
+      p = plane + y * pitch + x * pstride + offset;
+      *thumb++ = (p[0] + p[pstride] + p[pitch] + p[pitch + pstride] + 2) >> 2;
+    }
+  }
+
+  gst_vaapi_image_unmap (image);
+  gst_vaapi_image_unref (image);
+  return TRUE;
+
+  /* ERRORS */
+error_too_small:
+  {
+    GST_DEBUG ("image of %ux%u is too small to be analyzed", width, height);
+    gst_vaapi_image_unmap (image);
+    gst_vaapi_image_unref (image);
+    return FALSE;
+  }
+}
+
+static void
+lookahead_get_histogram (const guint8 * thumb, guint * hist)
+{
+  guint i;
+
+  memset (hist, 0, LOOKAHEAD_HIST_BINS * sizeof (*hist));
+  for (i = 0; i < LOOKAHEAD_THUMB_SIZE; i++)
+    hist[thumb[i] * LOOKAHEAD_HIST_BINS / 256]++;
+}
+
+/* Computes the statistics of the new frame against the previous one,
+   and decides whether it starts a new scene */
+static void
+lookahead_analyze_frame (GstVaapiEncoder * encoder,
+    GstVaapiEncoderLookaheadFrame * laf)
+{
+  GstVaapiSurfaceProxy *const proxy =
+      gst_video_codec_frame_get_user_data (laf->frame);
+  guint8 thumb[LOOKAHEAD_THUMB_SIZE];
+  guint hist[LOOKAHEAD_HIST_BINS];
+  guint i, sad = 0, hist_diff = 0;
+
+  if (!proxy || !lookahead_get_thumbnail (encoder,
+          gst_vaapi_surface_proxy_get_surface (proxy), thumb)) {
+    GST_WARNING ("failed to analyze frame %u", laf->frame->system_frame_number);
+    return;
+  }
+  lookahead_get_histogram (thumb, hist);
+
+  if (encoder->lookahead_has_prev) {
+    for (i = 0; i < LOOKAHEAD_THUMB_SIZE; i++)
+      sad += ABS ((gint) thumb[i] - (gint) encoder->lookahead_prev_thumb[i]);
+    for (i = 0; i < LOOKAHEAD_HIST_BINS; i++)
+      hist_diff += ABS ((gint) hist[i] -
+          (gint) encoder->lookahead_prev_hist[i]);
+
+    laf->sad = sad / LOOKAHEAD_THUMB_SIZE;
+    hist_diff = hist_diff * 100 / (2 * LOOKAHEAD_THUMB_SIZE);
+
+    encoder->lookahead_since_cut++;
+    if (encoder->lookahead_since_cut >= LOOKAHEAD_CUT_MIN_DISTANCE &&
+        (hist_diff >= LOOKAHEAD_CUT_HIST_DIFF ||
+            (laf->sad >= LOOKAHEAD_CUT_SAD_MIN &&
+                laf->sad >= LOOKAHEAD_CUT_SAD_RATIO *
+                encoder->lookahead_avg_sad))) {
+      laf->scene_cut = TRUE;
+      encoder->lookahead_since_cut = 0;
+    }
+
+    /* Running average of the motion, restarted at each scene */
+    if (laf->scene_cut)
+      encoder->lookahead_avg_sad = 0;
+    else if (encoder->lookahead_avg_sad == 0)
+      encoder->lookahead_avg_sad = laf->sad;
+    else
+      encoder->lookahead_avg_sad = (7 * encoder->lookahead_avg_sad +
+          laf->sad + 4) / 8;
+  }
+
+  GST_LOG ("frame %u: sad %u, histogram difference %u%%%s",
+      laf->frame->system_frame_number, laf->sad, hist_diff,
+      laf->scene_cut ? ", scene cut" : "");
+
+  memcpy (encoder->lookahead_prev_thumb, thumb, sizeof (thumb));
+  memcpy (encoder->lookahead_prev_hist, hist, sizeof (hist));
+  encoder->lookahead_has_prev = TRUE;
+}
+
+/* Queues @frame for analysis, and returns the oldest frame once the
+   lookahead window is full, or NULL otherwise */
+static GstVaapiEncoderLookaheadFrame *
+lookahead_push_frame (GstVaapiEncoder * encoder, GstVideoCodecFrame * frame)
+{
+  GstVaapiEncoderLookaheadFrame *laf;
+
+  laf = g_slice_new0 (GstVaapiEncoderLookaheadFrame);
+  laf->frame = gst_video_codec_frame_ref (frame);
+  lookahead_analyze_frame (encoder, laf);
+  g_queue_push_tail (&encoder->lookahead_queue, laf);
+
+  if (g_queue_get_length (&encoder->lookahead_queue) <=
+      encoder->lookahead_depth)
+    return NULL;
+  return g_queue_pop_head (&encoder->lookahead_queue);
+}
+
+static void
+lookahead_clear (GstVaapiEncoder * encoder)
+{
+  g_queue_foreach (&encoder->lookahead_queue, (GFunc) lookahead_frame_free,
+      NULL);
+  g_queue_clear (&encoder->lookahead_queue);
+  encoder->lookahead_has_prev = FALSE;
+  encoder->lookahead_since_cut = 0;
+  encoder->lookahead_avg_sad = 0;
+}
+
 /**
- * gst_vaapi_encoder_put_frame:
+ * gst_vaapi_encoder_lookahead_is_scene_cut:
  * @encoder: a #GstVaapiEncoder
- * @frame: a #GstVideoCodecFrame
+ * @frame: the #GstVideoCodecFrame being reordered
  *
- * Queues a #GstVideoCodedFrame to the HW encoder. The encoder holds
- * an extra reference to the @frame.
+ * Checks whether the lookahead stage detected that @frame starts a
+ * new scene, in which case the subclass should encode it as a key
+ * frame. Only valid from the reordering vmethod.
+ *
+ * Return value: %TRUE if @frame is a scene cut
+ */
+gboolean
+gst_vaapi_encoder_lookahead_is_scene_cut (GstVaapiEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstVaapiEncoderLookaheadFrame *const laf = encoder->lookahead_cur;
+
+  return frame && laf && laf->frame == frame && laf->scene_cut;
+}
+
+/**
+ * gst_vaapi_encoder_lookahead_get_num_bframes:
+ * @encoder: a #GstVaapiEncoder
+ * @max_bframes: the maximum number of B-frames per mini-GOP
+ *
+ * Determines how many B-frames the mini-GOP starting with the frame
+ * being reordered should use, so that high motion frames are encoded
+ * as P-frames instead. Frames past the lookahead window are assumed to
+ * be suitable B-frames. Only valid from the reordering vmethod.
+ *
+ * Return value: the number of B-frames, at most @max_bframes
+ */
+guint
+gst_vaapi_encoder_lookahead_get_num_bframes (GstVaapiEncoder * encoder,
+    guint max_bframes)
+{
+  GstVaapiEncoderLookaheadFrame *laf = encoder->lookahead_cur;
+  GList *l = encoder->lookahead_queue.head;
+  guint num_bframes;
+
+  if (!laf)
+    return max_bframes;
+
+  for (num_bframes = 0; num_bframes < max_bframes; num_bframes++) {
+    if (!laf)
+      return max_bframes;
+    if (laf->sad > LOOKAHEAD_BFRAME_MAX_SAD ||
+        (num_bframes > 0 && laf->scene_cut))
+      break;
+    laf = l ? l->data : NULL;
+    l = l ? l->next : NULL;
+  }
+  return num_bframes;
+}
+
+/**
+ * gst_vaapi_encoder_set_lookahead_depth:
+ * @encoder: a #GstVaapiEncoder
+ * @depth: the number of frames analysed ahead, or 0 to disable
+ *
+ * Sets the number of frames queued and analysed before reordering,
+ * to detect scene cuts and adapt the number of B-frames. This adds
+ * @depth frames of latency.
+ *
+ * This can only be changed before encoding started.
  *
  * Return value: a #GstVaapiEncoderStatus
  */
 GstVaapiEncoderStatus
-gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
-    GstVideoCodecFrame * frame)
+gst_vaapi_encoder_set_lookahead_depth (GstVaapiEncoder * encoder, guint depth)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  if (encoder->lookahead_depth != depth && encoder->num_codedbuf_queued > 0)
+    goto error_operation_failed;
+
+  encoder->lookahead_depth = depth;
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_operation_failed:
+  {
+    GST_ERROR ("could not change lookahead depth after encoding started");
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
+/**
+ * gst_vaapi_encoder_get_lookahead_depth:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Return value: the number of frames analysed ahead of encoding,
+ *   i.e. the latency added by the lookahead stage, in frames.
+ */
+guint
+gst_vaapi_encoder_get_lookahead_depth (GstVaapiEncoder * encoder)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  return encoder->lookahead_depth;
+}
+
+/* Runs @frame through the reordering stage of the subclass, and submits
+   the resulting pictures. @laf holds its lookahead statistics, if any */
+static GstVaapiEncoderStatus
+gst_vaapi_encoder_reorder_frame (GstVaapiEncoder * encoder,
+    GstVideoCodecFrame * frame, GstVaapiEncoderLookaheadFrame * laf)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
   GstVaapiEncoderStatus status;
   GstVaapiEncPicture *picture;
+  gint64 trace_start;
 
+  encoder->lookahead_cur = laf;
   for (;;) {
     picture = NULL;
+    trace_start = gst_vaapi_trace_begin ();
     status = klass->reordering (encoder, frame, &picture);
+    gst_vaapi_trace_end (trace_start, "reorder", picture ?
+        (gint) picture->frame->system_frame_number : frame ?
+        (gint) frame->system_frame_number : GST_VAAPI_TRACE_NO_FRAME,
+        GST_VAAPI_TRACE_NO_SURFACE);
     if (status == GST_VAAPI_ENCODER_STATUS_NO_SURFACE)
       break;
     if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
@@ -384,21 +940,53 @@ gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
     /* Try again with any pending reordered frame now available for encoding */
     frame = NULL;
   }
+  encoder->lookahead_cur = NULL;
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
   /* ERRORS */
 error_reorder_frame:
   {
     GST_ERROR ("failed to process reordered frames");
+    encoder->lookahead_cur = NULL;
     return status;
   }
 error_encode:
   {
     gst_vaapi_enc_picture_unref (picture);
+    encoder->lookahead_cur = NULL;
     return status;
   }
 }
 
+/**
+ * gst_vaapi_encoder_put_frame:
+ * @encoder: a #GstVaapiEncoder
+ * @frame: a #GstVideoCodecFrame
+ *
+ * Queues a #GstVideoCodedFrame to the HW encoder. The encoder holds
+ * an extra reference to the @frame.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_put_frame (GstVaapiEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstVaapiEncoderLookaheadFrame *laf;
+  GstVaapiEncoderStatus status;
+
+  if (encoder->lookahead_depth == 0)
+    return gst_vaapi_encoder_reorder_frame (encoder, frame, NULL);
+
+  laf = lookahead_push_frame (encoder, frame);
+  if (!laf)
+    return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  status = gst_vaapi_encoder_reorder_frame (encoder, laf->frame, laf);
+  lookahead_frame_free (laf);
+  return status;
+}
+
 /**
  * gst_vaapi_encoder_get_buffer_with_timeout:
  * @encoder: a #GstVaapiEncoder
@@ -411,6 +999,12 @@ error_encode:
  * after usage. Otherwise, @GST_VAAPI_DECODER_STATUS_ERROR_NO_BUFFER
  * is returned if no coded buffer is available so far (timeout).
  *
+ * Coded buffers are returned in submission order, as soon as the
+ * hardware completed them. If a frame was already submitted, this
+ * function waits for its completion regardless of @timeout, which only
+ * bounds the wait for a new submission. A @timeout of %G_MAXUINT64
+ * waits until a frame is submitted, or the encoder is set flushing.
+ *
  * The parent frame is available as a #GstVideoCodecFrame attached to
  * the user-data anchor of the output coded buffer. Ownership of the
  * frame is transferred to the coded buffer.
@@ -421,18 +1015,44 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout)
 {
+  GstVaapiEncoderOutput *output;
   GstVaapiEncPicture *picture;
   GstVaapiCodedBufferProxy *codedbuf_proxy;
-
-  codedbuf_proxy = g_async_queue_timeout_pop (encoder->codedbuf_queue, timeout);
-  if (!codedbuf_proxy)
+  gint64 end_time = 0, trace_start;
+  gboolean success;
+
+  if (timeout > 0 && timeout != G_MAXUINT64)
+    end_time = g_get_monotonic_time () + timeout;
+
+  trace_start = gst_vaapi_trace_begin ();
+  g_mutex_lock (&encoder->output_mutex);
+  while (g_queue_is_empty (&encoder->output_queue)) {
+    if (encoder->num_in_flight > 0)
+      g_cond_wait (&encoder->output_cond, &encoder->output_mutex);
+    else if (encoder->flushing || timeout == 0)
+      break;
+    else if (timeout == G_MAXUINT64)
+      g_cond_wait (&encoder->output_cond, &encoder->output_mutex);
+    else if (!g_cond_wait_until (&encoder->output_cond,
+            &encoder->output_mutex, end_time))
+      break;
+  }
+  output = g_queue_pop_head (&encoder->output_queue);
+  g_mutex_unlock (&encoder->output_mutex);
+  if (!output)
     return GST_VAAPI_ENCODER_STATUS_NO_BUFFER;
 
-  /* Wait for completion of all operations and report any error that occurred */
-  picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
-  if (!gst_vaapi_surface_sync (picture->surface))
+  codedbuf_proxy = output->codedbuf_proxy;
+  success = output->success;
+  g_slice_free (GstVaapiEncoderOutput, output);
+
+  /* Report any error that occurred */
+  if (!success)
     goto error_invalid_buffer;
 
+  picture = gst_vaapi_coded_buffer_proxy_get_user_data (codedbuf_proxy);
+  gst_vaapi_trace_end (trace_start, "output_wait",
+      picture->frame->system_frame_number, picture->surface_id);
   gst_vaapi_coded_buffer_proxy_set_user_data (codedbuf_proxy,
       gst_video_codec_frame_ref (picture->frame),
       (GDestroyNotify) gst_video_codec_frame_unref);
@@ -451,6 +1071,64 @@ error_invalid_buffer:
   }
 }
 
+/**
+ * gst_vaapi_encoder_set_flushing:
+ * @encoder: a #GstVaapiEncoder
+ * @flushing: whether the output shall stop waiting for new frames
+ *
+ * While flushing, gst_vaapi_encoder_get_buffer_with_timeout() only
+ * waits for frames that were already submitted, and returns
+ * immediately otherwise. This is used to unblock an output thread
+ * before stopping it.
+ */
+void
+gst_vaapi_encoder_set_flushing (GstVaapiEncoder * encoder, gboolean flushing)
+{
+  g_return_if_fail (encoder != NULL);
+
+  g_mutex_lock (&encoder->output_mutex);
+  encoder->flushing = flushing;
+  g_cond_broadcast (&encoder->output_cond);
+  g_mutex_unlock (&encoder->output_mutex);
+}
+
+/**
+ * gst_vaapi_encoder_set_max_in_flight:
+ * @encoder: a #GstVaapiEncoder
+ * @max_in_flight: the maximum number of frames being encoded, or 0
+ *
+ * Limits the number of frames submitted to the hardware whose
+ * encoding is not complete yet. Lower values reduce latency, higher
+ * values let the hardware process several frames in parallel. Zero
+ * means the depth is only bounded by the number of coded buffers.
+ */
+void
+gst_vaapi_encoder_set_max_in_flight (GstVaapiEncoder * encoder,
+    guint max_in_flight)
+{
+  g_return_if_fail (encoder != NULL);
+
+  g_mutex_lock (&encoder->output_mutex);
+  encoder->max_in_flight = max_in_flight;
+  g_cond_broadcast (&encoder->output_cond);
+  g_mutex_unlock (&encoder->output_mutex);
+}
+
+/**
+ * gst_vaapi_encoder_get_max_in_flight:
+ * @encoder: a #GstVaapiEncoder
+ *
+ * Return value: the maximum number of frames being encoded, or 0 if
+ *   unbounded.
+ */
+guint
+gst_vaapi_encoder_get_max_in_flight (GstVaapiEncoder * encoder)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  return encoder->max_in_flight;
+}
+
 static inline gboolean
 _get_pending_reordered (GstVaapiEncoder * encoder,
     GstVaapiEncPicture ** picture, gpointer * state)
@@ -474,10 +1152,23 @@ GstVaapiEncoderStatus
 gst_vaapi_encoder_flush (GstVaapiEncoder * encoder)
 {
   GstVaapiEncoderClass *const klass = GST_VAAPI_ENCODER_GET_CLASS (encoder);
+  GstVaapiEncoderLookaheadFrame *laf;
   GstVaapiEncPicture *picture;
   GstVaapiEncoderStatus status;
   gpointer iter = NULL;
 
+  /* Frames still in the lookahead window are analysed against fewer
+     frames ahead */
+  while ((laf = g_queue_pop_head (&encoder->lookahead_queue)) != NULL) {
+    status = gst_vaapi_encoder_reorder_frame (encoder, laf->frame, laf);
+    lookahead_frame_free (laf);
+    if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+      lookahead_clear (encoder);
+      return status;
+    }
+  }
+  lookahead_clear (encoder);
+
   picture = NULL;
   while (_get_pending_reordered (encoder, &picture, &iter)) {
     if (!picture)
@@ -786,7 +1477,7 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
   GstVaapiEncoderStatus status;
   GstVaapiVideoPool *pool;
-  guint codedbuf_size, target_percentage;
+  guint codedbuf_size, codedbuf_capacity, target_percentage;
   guint fps_d, fps_n;
   guint quality_level_max = 0;
 
@@ -849,17 +1540,26 @@ gst_vaapi_encoder_reconfigure_internal (GstVaapiEncoder * encoder)
 #endif
   }
 
+  /* One coded buffer per frame in flight, plus the one being output */
+  codedbuf_capacity = encoder->async_depth > 0 ?
+      encoder->async_depth + 1 : DEFAULT_CODEDBUF_CAPACITY;
   codedbuf_size = encoder->codedbuf_pool ?
       gst_vaapi_coded_buffer_pool_get_buffer_size (GST_VAAPI_CODED_BUFFER_POOL
-      (encoder)) : 0;
+      (encoder->codedbuf_pool)) : 0;
   if (codedbuf_size != encoder->codedbuf_size) {
     pool = gst_vaapi_coded_buffer_pool_new (encoder, encoder->codedbuf_size);
     if (!pool)
       goto error_alloc_codedbuf_pool;
-    gst_vaapi_video_pool_set_capacity (pool, 5);
     gst_vaapi_video_pool_replace (&encoder->codedbuf_pool, pool);
     gst_vaapi_video_pool_unref (pool);
   }
+  gst_vaapi_video_pool_set_capacity (encoder->codedbuf_pool,
+      codedbuf_capacity);
+  gst_vaapi_encoder_set_max_in_flight (encoder, encoder->async_depth);
+
+  GST_INFO ("async depth %u: %u coded buffers, %u surfaces",
+      encoder->async_depth, codedbuf_capacity,
+      encoder->context_info.ref_frames);
   return GST_VAAPI_ENCODER_STATUS_SUCCESS;
 
   /* ERRORS */
@@ -1179,6 +1879,65 @@ error_operation_failed:
   }
 }
 
+/**
+ * gst_vaapi_encoder_set_async_depth:
+ * @encoder: a #GstVaapiEncoder
+ * @async_depth: the number of frames encoded at once, or 0
+ *
+ * Sets the number of frames that can be submitted to the hardware
+ * before waiting for the oldest one to complete. The coded buffers
+ * pool, the reconstructed surfaces pool and the in-flight queue are
+ * all sized from it. Zero keeps the codec defaults.
+ *
+ * This can only be changed before encoding started.
+ *
+ * Return value: a #GstVaapiEncoderStatus
+ */
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_async_depth (GstVaapiEncoder * encoder,
+    guint async_depth)
+{
+  g_return_val_if_fail (encoder != NULL, 0);
+
+  if (encoder->async_depth != async_depth && encoder->num_codedbuf_queued > 0)
+    goto error_operation_failed;
+
+  encoder->async_depth = async_depth;
+  return GST_VAAPI_ENCODER_STATUS_SUCCESS;
+
+  /* ERRORS */
+error_operation_failed:
+  {
+    GST_ERROR ("could not change async depth after encoding started");
+    return GST_VAAPI_ENCODER_STATUS_ERROR_OPERATION_FAILED;
+  }
+}
+
+/**
+ * gst_vaapi_encoder_get_in_flight_stats:
+ * @encoder: a #GstVaapiEncoder
+ * @peak_ptr: return location for the peak number of frames in flight
+ * @average_ptr: return location for the average number of frames in
+ *   flight, sampled at each submission
+ *
+ * Reports the encode depth actually achieved so far.
+ */
+void
+gst_vaapi_encoder_get_in_flight_stats (GstVaapiEncoder * encoder,
+    guint * peak_ptr, gdouble * average_ptr)
+{
+  g_return_if_fail (encoder != NULL);
+
+  g_mutex_lock (&encoder->output_mutex);
+  if (peak_ptr)
+    *peak_ptr = encoder->peak_in_flight;
+  if (average_ptr) {
+    *average_ptr = encoder->num_submitted > 0 ?
+        (gdouble) encoder->sum_in_flight / encoder->num_submitted : 0.0;
+  }
+  g_mutex_unlock (&encoder->output_mutex);
+}
+
 G_DEFINE_ABSTRACT_TYPE (GstVaapiEncoder, gst_vaapi_encoder, GST_TYPE_OBJECT);
 
 /**
@@ -1192,6 +1951,7 @@ G_DEFINE_ABSTRACT_TYPE (GstVaapiEncoder, gst_vaapi_encoder, GST_TYPE_OBJECT);
  * @ENCODER_PROP_DEFAULT_ROI_VALUE: The default delta qp to apply
  *   to each region of interest.
  * @ENCODER_PROP_TRELLIS: Use trellis quantization method (gboolean).
+ * @ENCODER_PROP_ASYNC_DEPTH: Number of frames encoded at once (uint).
  *
  * The set of configurable properties for the encoder.
  */
@@ -1204,6 +1964,7 @@ enum
   ENCODER_PROP_QUALITY_LEVEL,
   ENCODER_PROP_DEFAULT_ROI_VALUE,
   ENCODER_PROP_TRELLIS,
+  ENCODER_PROP_ASYNC_DEPTH,
   ENCODER_N_PROPERTIES
 };
 
@@ -1250,6 +2011,10 @@ gst_vaapi_encoder_set_property (GObject * object, guint prop_id,
       status =
           gst_vaapi_encoder_set_trellis (encoder, g_value_get_boolean (value));
       break;
+    case ENCODER_PROP_ASYNC_DEPTH:
+      status =
+          gst_vaapi_encoder_set_async_depth (encoder, g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1288,6 +2053,9 @@ gst_vaapi_encoder_get_property (GObject * object, guint prop_id,
     case ENCODER_PROP_TRELLIS:
       g_value_set_boolean (value, encoder->trellis);
       break;
+    case ENCODER_PROP_ASYNC_DEPTH:
+      g_value_set_uint (value, encoder->async_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1307,6 +2075,11 @@ gst_vaapi_encoder_init (GstVaapiEncoder * encoder)
 
   encoder->codedbuf_queue = g_async_queue_new_full ((GDestroyNotify)
       gst_vaapi_coded_buffer_proxy_unref);
+
+  g_mutex_init (&encoder->output_mutex);
+  g_cond_init (&encoder->output_cond);
+  g_queue_init (&encoder->output_queue);
+  g_queue_init (&encoder->lookahead_queue);
 }
 
 /* Base encoder cleanup (internal) */
@@ -1315,6 +2088,18 @@ gst_vaapi_encoder_finalize (GObject * object)
 {
   GstVaapiEncoder *encoder = GST_VAAPI_ENCODER (object);
 
+  lookahead_clear (encoder);
+  gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_image,
+      NULL);
+  gst_mini_object_replace ((GstMiniObject **) & encoder->lookahead_surface,
+      NULL);
+  gst_vaapi_filter_replace (&encoder->lookahead_filter, NULL);
+
+  /* Wait for the pictures still processed by the hardware */
+  sync_thread_stop (encoder);
+  g_queue_foreach (&encoder->output_queue, (GFunc) output_free, NULL);
+  g_queue_clear (&encoder->output_queue);
+
   if (encoder->context)
     gst_vaapi_context_unref (encoder->context);
   encoder->context = NULL;
@@ -1334,6 +2119,8 @@ gst_vaapi_encoder_finalize (GObject * object)
   g_cond_clear (&encoder->surface_free);
   g_cond_clear (&encoder->codedbuf_free);
   g_mutex_clear (&encoder->mutex);
+  g_cond_clear (&encoder->output_cond);
+  g_mutex_clear (&encoder->output_mutex);
 
   G_OBJECT_CLASS (gst_vaapi_encoder_parent_class)->finalize (object);
 }
@@ -1446,6 +2233,21 @@ gst_vaapi_encoder_class_init (GstVaapiEncoderClass * klass)
       FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoder:async-depth:
+   *
+   * The number of frames submitted to the hardware before waiting for
+   * the oldest one to complete. Low values reduce latency, e.g. 1 for
+   * live streams, while higher values improve throughput. 0 keeps the
+   * codec defaults.
+   */
+  properties[ENCODER_PROP_ASYNC_DEPTH] =
+      g_param_spec_uint ("async-depth",
+      "Async Depth",
+      "Number of frames encoded at once (0: codec default)",
+      0, 16, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_N_PROPERTIES,
       properties);
 }
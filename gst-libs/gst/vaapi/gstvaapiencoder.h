@@ -173,10 +173,39 @@ gst_vaapi_encoder_set_quality_level (GstVaapiEncoder * encoder,
 GstVaapiEncoderStatus
 gst_vaapi_encoder_set_trellis (GstVaapiEncoder * encoder, gboolean trellis);
 
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_async_depth (GstVaapiEncoder * encoder,
+    guint async_depth);
+
+void
+gst_vaapi_encoder_get_in_flight_stats (GstVaapiEncoder * encoder,
+    guint * peak_ptr, gdouble * average_ptr);
+
+GstVaapiEncoderStatus
+gst_vaapi_encoder_set_lookahead_depth (GstVaapiEncoder * encoder,
+    guint depth);
+
+guint
+gst_vaapi_encoder_get_lookahead_depth (GstVaapiEncoder * encoder);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_get_buffer_with_timeout (GstVaapiEncoder * encoder,
     GstVaapiCodedBufferProxy ** out_codedbuf_proxy_ptr, guint64 timeout);
 
+void
+gst_vaapi_encoder_set_flushing (GstVaapiEncoder * encoder, gboolean flushing);
+
+void
+gst_vaapi_encoder_set_max_in_flight (GstVaapiEncoder * encoder,
+    guint max_in_flight);
+
+guint
+gst_vaapi_encoder_get_max_in_flight (GstVaapiEncoder * encoder);
+
+GstBuffer *
+gst_vaapi_encoder_export_coded_buffer (GstVaapiEncoder * encoder,
+    GstVaapiCodedBufferProxy * codedbuf_proxy);
+
 GstVaapiEncoderStatus
 gst_vaapi_encoder_flush (GstVaapiEncoder * encoder);
 
@@ -180,6 +180,7 @@ typedef struct _GstVaapiH264ViewReorderPool
   guint cur_frame_num;
   guint cur_present_index;
   gboolean prev_frame_is_ref;   /* previous frame is ref or not */
+  guint num_bframes;            /* number of B-frames in this mini-GOP */
 } GstVaapiH264ViewReorderPool;
 
 static inline gboolean
@@ -780,6 +781,10 @@ struct _GstVaapiEncoderH264
   GstBuffer *subset_sps_data;
   GstBuffer *pps_data;
 
+  /* Packed SPS and PPS, reused until their parameters change */
+  GstVaapiH26xPackedHeaderCache packed_sps;
+  GstVaapiH26xPackedHeaderCache packed_pps;
+
   guint bitrate_bits;           // bitrate (bits)
   guint cpb_length;             // length of CPB buffer (ms)
   guint cpb_length_bits;        // length of CPB buffer (bits)
@@ -1482,6 +1487,15 @@ bs_error:
   }
 }
 
+/* The parameters the packed SPS is generated from */
+typedef struct
+{
+  VAEncSequenceParameterBufferH264 seq_param;
+  VAEncMiscParameterHRD hrd_params;
+  GstVaapiProfile profile;
+  GstVaapiRateControl rate_control;
+} PackedSequenceHeaderKey;
+
 /* Adds the supplied sequence header (SPS) to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
@@ -1494,17 +1508,15 @@ add_packed_sequence_header (GstVaapiEncoderH264 * encoder,
   VAEncPackedHeaderParameterBuffer packed_seq_param = { 0 };
   const VAEncSequenceParameterBufferH264 *const seq_param = sequence->param;
   GstVaapiProfile profile = encoder->profile;
+  PackedSequenceHeaderKey key;
 
   VAEncMiscParameterHRD hrd_params;
   guint32 data_bit_size;
-  guint8 *data;
+  guint data_size;
+  const guint8 *data;
 
   fill_hrd_params (encoder, &hrd_params);
 
-  gst_bit_writer_init_with_size (&bs, 128, FALSE);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
-  bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_SPS);
-
   /* Set High profile for encoding the MVC base view. Otherwise, some
      traditional decoder cannot recognize MVC profile streams with
      only the base view in there */
@@ -1512,12 +1524,29 @@ add_packed_sequence_header (GstVaapiEncoderH264 * encoder,
       profile == GST_VAAPI_PROFILE_H264_STEREO_HIGH)
     profile = GST_VAAPI_PROFILE_H264_HIGH;
 
-  bs_write_sps (&bs, seq_param, profile, base_encoder->rate_control,
-      &hrd_params);
-
-  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  memset (&key, 0, sizeof (key));
+  memcpy (&key.seq_param, seq_param, sizeof (key.seq_param));
+  key.hrd_params.buffer_size = hrd_params.buffer_size;
+  key.hrd_params.initial_buffer_fullness = hrd_params.initial_buffer_fullness;
+  key.profile = profile;
+  key.rate_control = base_encoder->rate_control;
+
+  data = gst_vaapi_utils_h26x_packed_header_cache_lookup (&encoder->packed_sps,
+      &key, sizeof (key), &data_size);
+  if (!data) {
+    gst_bit_writer_init_with_size (&bs, 128, FALSE);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_SPS);
+    bs_write_sps (&bs, seq_param, profile, base_encoder->rate_control,
+        &hrd_params);
+    g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+
+    data_size = GST_BIT_WRITER_BIT_SIZE (&bs) / 8;
+    data = gst_vaapi_utils_h26x_packed_header_cache_store (&encoder->packed_sps,
+        &key, sizeof (key), GST_BIT_WRITER_DATA (&bs), data_size);
+    gst_bit_writer_reset (&bs);
+  }
+  data_bit_size = data_size * 8;
 
   packed_seq_param.type = VAEncPackedHeaderSequence;
   packed_seq_param.bit_length = data_bit_size;
@@ -1533,7 +1562,6 @@ add_packed_sequence_header (GstVaapiEncoderH264 * encoder,
 
   /* store sps data */
   _check_sps_pps_status (encoder, data + 4, data_bit_size / 8 - 4);
-  gst_bit_writer_reset (&bs);
   return TRUE;
 
   /* ERRORS */
@@ -1599,6 +1627,14 @@ bs_error:
   }
 }
 
+/* The parameters the packed PPS is generated from, i.e. the picture
+   parameters that do not change from one picture to another */
+typedef struct
+{
+  VAEncPictureParameterBufferH264 pic_param;
+  GstVaapiProfile profile;
+} PackedPictureHeaderKey;
+
 /* Adds the supplied picture header (PPS) to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
@@ -1609,16 +1645,42 @@ add_packed_picture_header (GstVaapiEncoderH264 * encoder,
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_pic_param = { 0 };
   const VAEncPictureParameterBufferH264 *const pic_param = picture->param;
+  PackedPictureHeaderKey key;
   guint32 data_bit_size;
-  guint8 *data;
-
-  gst_bit_writer_init_with_size (&bs, 128, FALSE);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
-  bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_PPS);
-  bs_write_pps (&bs, pic_param, encoder->profile);
-  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  guint data_size;
+  const guint8 *data;
+
+  memset (&key, 0, sizeof (key));
+  key.pic_param.pic_parameter_set_id = pic_param->pic_parameter_set_id;
+  key.pic_param.seq_parameter_set_id = pic_param->seq_parameter_set_id;
+  key.pic_param.pic_init_qp = pic_param->pic_init_qp;
+  key.pic_param.num_ref_idx_l0_active_minus1 =
+      pic_param->num_ref_idx_l0_active_minus1;
+  key.pic_param.num_ref_idx_l1_active_minus1 =
+      pic_param->num_ref_idx_l1_active_minus1;
+  key.pic_param.chroma_qp_index_offset = pic_param->chroma_qp_index_offset;
+  key.pic_param.second_chroma_qp_index_offset =
+      pic_param->second_chroma_qp_index_offset;
+  key.pic_param.pic_fields.value = pic_param->pic_fields.value;
+  key.pic_param.pic_fields.bits.idr_pic_flag = 0;
+  key.pic_param.pic_fields.bits.reference_pic_flag = 0;
+  key.profile = encoder->profile;
+
+  data = gst_vaapi_utils_h26x_packed_header_cache_lookup (&encoder->packed_pps,
+      &key, sizeof (key), &data_size);
+  if (!data) {
+    gst_bit_writer_init_with_size (&bs, 128, FALSE);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, GST_H264_NAL_REF_IDC_HIGH, GST_H264_NAL_PPS);
+    bs_write_pps (&bs, pic_param, encoder->profile);
+    g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+
+    data_size = GST_BIT_WRITER_BIT_SIZE (&bs) / 8;
+    data = gst_vaapi_utils_h26x_packed_header_cache_store (&encoder->packed_pps,
+        &key, sizeof (key), GST_BIT_WRITER_DATA (&bs), data_size);
+    gst_bit_writer_reset (&bs);
+  }
+  data_bit_size = data_size * 8;
 
   packed_pic_param.type = VAEncPackedHeaderPicture;
   packed_pic_param.bit_length = data_bit_size;
@@ -1634,7 +1696,6 @@ add_packed_picture_header (GstVaapiEncoderH264 * encoder,
 
   /* store pps data */
   _check_sps_pps_status (encoder, data + 4, data_bit_size / 8 - 4);
-  gst_bit_writer_reset (&bs);
   return TRUE;
 
   /* ERRORS */
@@ -3180,7 +3241,7 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
   GstVaapiEncoderH264 *const encoder = GST_VAAPI_ENCODER_H264 (base_encoder);
   GstVaapiH264ViewReorderPool *reorder_pool = NULL;
   GstVaapiEncPicture *picture;
-  gboolean is_idr = FALSE;
+  gboolean is_idr = FALSE, is_scene_cut;
 
   *output = NULL;
 
@@ -3236,6 +3297,12 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
   is_idr = (reorder_pool->frame_index == 0 ||
       reorder_pool->frame_index >= encoder->idr_period);
 
+  /* scene cuts start a new GOP */
+  is_scene_cut = !encoder->is_mvc &&
+      gst_vaapi_encoder_lookahead_is_scene_cut (base_encoder, frame);
+  if (is_scene_cut)
+    is_idr = TRUE;
+
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
       (reorder_pool->frame_index %
@@ -3280,20 +3347,33 @@ gst_vaapi_encoder_h264_reordering (GstVaapiEncoder * base_encoder,
 
   /* new p/b frames coming */
   ++reorder_pool->frame_index;
+
+  /* the lookahead may shorten the mini-GOP in high motion scenes,
+     hierarchical-b needs all of it for its temporal layers */
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES &&
+      g_queue_is_empty (&reorder_pool->reorder_frame_list)) {
+    reorder_pool->num_bframes = encoder->num_bframes;
+    if (!encoder->is_mvc && encoder->prediction_type !=
+        GST_VAAPI_ENCODER_H264_PREDICTION_HIERARCHICAL_B)
+      reorder_pool->num_bframes =
+          gst_vaapi_encoder_lookahead_get_num_bframes (base_encoder,
+          encoder->num_bframes);
+  }
+
   if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES &&
       g_queue_get_length (&reorder_pool->reorder_frame_list) <
-      encoder->num_bframes) {
+      reorder_pool->num_bframes) {
     g_queue_push_tail (&reorder_pool->reorder_frame_list, picture);
     return GST_VAAPI_ENCODER_STATUS_NO_SURFACE;
   }
 
   set_p_frame (picture, encoder);
 
-  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES) {
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H264_REORD_WAIT_FRAMES &&
+      !g_queue_is_empty (&reorder_pool->reorder_frame_list)) {
     g_queue_foreach (&reorder_pool->reorder_frame_list, (GFunc) set_b_frame,
         encoder);
     reorder_pool->reorder_state = GST_VAAPI_ENC_H264_REORD_DUMP_FRAMES;
-    g_assert (!g_queue_is_empty (&reorder_pool->reorder_frame_list));
   }
 
 end:
@@ -3315,7 +3395,7 @@ set_context_info (GstVaapiEncoder * base_encoder)
 {
   GstVaapiEncoderH264 *const encoder = GST_VAAPI_ENCODER_H264 (base_encoder);
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
-  const guint DEFAULT_SURFACES_COUNT = 3;
+  const guint num_surfaces = GST_VAAPI_ENCODER_ASYNC_SURFACES (encoder, 3);
 
   /* Maximum sizes for common headers (in bits) */
   enum
@@ -3331,7 +3411,7 @@ set_context_info (GstVaapiEncoder * base_encoder)
     return GST_VAAPI_ENCODER_STATUS_ERROR_UNSUPPORTED_PROFILE;
 
   base_encoder->num_ref_frames = (encoder->num_ref_frames
-      + (encoder->num_bframes > 0 ? 1 : 0) + DEFAULT_SURFACES_COUNT)
+      + (encoder->num_bframes > 0 ? 1 : 0) + num_surfaces)
       * encoder->num_views;
 
   /* Only YUV 4:2:0 formats are supported for now. This means that we
@@ -3466,6 +3546,8 @@ gst_vaapi_encoder_h264_finalize (GObject * object)
   gst_buffer_replace (&encoder->sps_data, NULL);
   gst_buffer_replace (&encoder->subset_sps_data, NULL);
   gst_buffer_replace (&encoder->pps_data, NULL);
+  gst_vaapi_utils_h26x_packed_header_cache_clear (&encoder->packed_sps);
+  gst_vaapi_utils_h26x_packed_header_cache_clear (&encoder->packed_pps);
 
   /* reference list info de-init */
   for (i = 0; i < MAX_NUM_VIEWS; i++) {
@@ -3573,6 +3655,7 @@ get_view_ids (GstVaapiEncoderH264 * const encoder, GValue * value)
  * @ENCODER_H264_PROP_PREDICTION_TYPE: Reference picture selection modes
  * @ENCODER_H264_PROP_MAX_QP: Maximal quantizer value (uint).
  * @ENCODER_H264_PROP_QUALITY_FACTOR: Factor for ICQ/QVBR bitrate control mode.
+ * @ENCODER_H264_PROP_LOOKAHEAD: Number of frames analysed ahead (uint).
  *
  * The set of H.264 encoder specific configurable properties.
  */
@@ -3599,6 +3682,7 @@ enum
   ENCODER_H264_PROP_PREDICTION_TYPE,
   ENCODER_H264_PROP_MAX_QP,
   ENCODER_H264_PROP_QUALITY_FACTOR,
+  ENCODER_H264_PROP_LOOKAHEAD,
   ENCODER_H264_N_PROPERTIES
 };
 
@@ -3682,6 +3766,16 @@ gst_vaapi_encoder_h264_set_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       encoder->quality_factor = g_value_get_uint (value);
       break;
+    case ENCODER_H264_PROP_LOOKAHEAD:{
+      GstVaapiEncoderStatus status;
+
+      status = gst_vaapi_encoder_set_lookahead_depth (base_encoder,
+          g_value_get_uint (value));
+      if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+        GST_WARNING_OBJECT (object, "failed to set the lookahead depth, "
+            "error is %d", status);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3758,6 +3852,10 @@ gst_vaapi_encoder_h264_get_property (GObject * object, guint prop_id,
     case ENCODER_H264_PROP_QUALITY_FACTOR:
       g_value_set_uint (value, encoder->quality_factor);
       break;
+    case ENCODER_H264_PROP_LOOKAHEAD:
+      g_value_set_uint (value,
+          gst_vaapi_encoder_get_lookahead_depth (base_encoder));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -4059,6 +4157,22 @@ gst_vaapi_encoder_h264_class_init (GstVaapiEncoderH264Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH264:lookahead:
+   *
+   * The number of frames analysed before encoding, to insert key
+   * frames at scene cuts and to use fewer B-frames in high motion
+   * scenes. This adds as many frames of latency. 0 disables the
+   * lookahead.
+   */
+  properties[ENCODER_H264_PROP_LOOKAHEAD] =
+      g_param_spec_uint ("lookahead",
+      "Lookahead",
+      "Number of frames analysed ahead for scene cuts and adaptive "
+      "B-frames (0: disabled)", 0, 60, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H264_N_PROPERTIES,
       properties);
 
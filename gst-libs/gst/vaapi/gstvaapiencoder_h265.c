@@ -82,6 +82,7 @@ typedef struct _GstVaapiH265ReorderPool
   guint reorder_state;
   guint frame_index;
   guint cur_present_index;
+  guint num_bframes;            /* number of B-frames in this mini-GOP */
 } GstVaapiH265ReorderPool;
 
 /* ------------------------------------------------------------------------- */
@@ -143,6 +144,9 @@ struct _GstVaapiEncoderH265
   GstBuffer *sps_data;
   GstBuffer *pps_data;
 
+  /* Packed PPS, reused until its parameters change */
+  GstVaapiH26xPackedHeaderCache packed_pps;
+
   guint bitrate_bits;           // bitrate (bits)
   guint cpb_length;             // length of CPB buffer (ms)
   guint cpb_length_bits;        // length of CPB buffer (bits)
@@ -1641,6 +1645,14 @@ bs_error:
   }
 }
 
+/* The parameters the packed PPS is generated from, i.e. the picture
+   parameters that do not change from one picture to another */
+typedef struct
+{
+  VAEncPictureParameterBufferHEVC pic_param;
+  gboolean is_scc;
+} PackedPictureHeaderKey;
+
 /* Adds the supplied picture header (PPS) to the list of packed
    headers to pass down as-is to the encoder */
 static gboolean
@@ -1651,16 +1663,50 @@ add_packed_picture_header (GstVaapiEncoderH265 * encoder,
   GstBitWriter bs;
   VAEncPackedHeaderParameterBuffer packed_pic_param = { 0 };
   const VAEncPictureParameterBufferHEVC *const pic_param = picture->param;
+  PackedPictureHeaderKey key;
   guint32 data_bit_size;
-  guint8 *data;
-
-  gst_bit_writer_init_with_size (&bs, 128, FALSE);
-  WRITE_UINT32 (&bs, 0x00000001, 32);   /* start code */
-  bs_write_nal_header (&bs, GST_H265_NAL_PPS);
-  bs_write_pps (&bs, h265_is_scc (encoder), pic_param);
-  g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
-  data_bit_size = GST_BIT_WRITER_BIT_SIZE (&bs);
-  data = GST_BIT_WRITER_DATA (&bs);
+  guint data_size;
+  const guint8 *data;
+
+  memset (&key, 0, sizeof (key));
+  key.pic_param.diff_cu_qp_delta_depth = pic_param->diff_cu_qp_delta_depth;
+  key.pic_param.log2_parallel_merge_level_minus2 =
+      pic_param->log2_parallel_merge_level_minus2;
+  key.pic_param.num_ref_idx_l0_default_active_minus1 =
+      pic_param->num_ref_idx_l0_default_active_minus1;
+  key.pic_param.num_ref_idx_l1_default_active_minus1 =
+      pic_param->num_ref_idx_l1_default_active_minus1;
+  key.pic_param.num_tile_columns_minus1 = pic_param->num_tile_columns_minus1;
+  key.pic_param.num_tile_rows_minus1 = pic_param->num_tile_rows_minus1;
+  key.pic_param.pic_init_qp = pic_param->pic_init_qp;
+  key.pic_param.pps_cb_qp_offset = pic_param->pps_cb_qp_offset;
+  key.pic_param.pps_cr_qp_offset = pic_param->pps_cr_qp_offset;
+  key.pic_param.pic_fields.value = pic_param->pic_fields.value;
+  key.pic_param.pic_fields.bits.idr_pic_flag = 0;
+  key.pic_param.pic_fields.bits.coding_type = 0;
+  key.pic_param.pic_fields.bits.reference_pic_flag = 0;
+  key.pic_param.pic_fields.bits.no_output_of_prior_pics_flag = 0;
+#if VA_CHECK_VERSION(1,8,0)
+  key.pic_param.scc_fields.bits.pps_curr_pic_ref_enabled_flag =
+      pic_param->scc_fields.bits.pps_curr_pic_ref_enabled_flag;
+#endif
+  key.is_scc = h265_is_scc (encoder);
+
+  data = gst_vaapi_utils_h26x_packed_header_cache_lookup (&encoder->packed_pps,
+      &key, sizeof (key), &data_size);
+  if (!data) {
+    gst_bit_writer_init_with_size (&bs, 128, FALSE);
+    WRITE_UINT32 (&bs, 0x00000001, 32); /* start code */
+    bs_write_nal_header (&bs, GST_H265_NAL_PPS);
+    bs_write_pps (&bs, key.is_scc, pic_param);
+    g_assert (GST_BIT_WRITER_BIT_SIZE (&bs) % 8 == 0);
+
+    data_size = GST_BIT_WRITER_BIT_SIZE (&bs) / 8;
+    data = gst_vaapi_utils_h26x_packed_header_cache_store (&encoder->packed_pps,
+        &key, sizeof (key), GST_BIT_WRITER_DATA (&bs), data_size);
+    gst_bit_writer_reset (&bs);
+  }
+  data_bit_size = data_size * 8;
 
   packed_pic_param.type = VAEncPackedHeaderPicture;
   packed_pic_param.bit_length = data_bit_size;
@@ -1676,7 +1722,6 @@ add_packed_picture_header (GstVaapiEncoderH265 * encoder,
 
   /* store pps data */
   _check_vps_sps_pps_status (encoder, data + 4, data_bit_size / 8 - 4);
-  gst_bit_writer_reset (&bs);
   return TRUE;
 
   /* ERRORS */
@@ -3262,6 +3307,10 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
   is_idr = (reorder_pool->frame_index == 0 ||
       reorder_pool->frame_index >= encoder->idr_period);
 
+  /* scene cuts start a new GOP */
+  if (gst_vaapi_encoder_lookahead_is_scene_cut (base_encoder, frame))
+    is_idr = TRUE;
+
   /* check key frames */
   if (is_idr || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame) ||
       (reorder_pool->frame_index %
@@ -3292,20 +3341,28 @@ gst_vaapi_encoder_h265_reordering (GstVaapiEncoder * base_encoder,
 
   /* new p/b frames coming */
   ++reorder_pool->frame_index;
+
+  /* the lookahead may shorten the mini-GOP in high motion scenes */
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES &&
+      g_queue_is_empty (&reorder_pool->reorder_frame_list))
+    reorder_pool->num_bframes =
+        gst_vaapi_encoder_lookahead_get_num_bframes (base_encoder,
+        encoder->num_bframes);
+
   if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES &&
       g_queue_get_length (&reorder_pool->reorder_frame_list) <
-      encoder->num_bframes) {
+      reorder_pool->num_bframes) {
     g_queue_push_tail (&reorder_pool->reorder_frame_list, picture);
     return GST_VAAPI_ENCODER_STATUS_NO_SURFACE;
   }
 
   set_p_frame (picture, encoder);
 
-  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES) {
+  if (reorder_pool->reorder_state == GST_VAAPI_ENC_H265_REORD_WAIT_FRAMES &&
+      !g_queue_is_empty (&reorder_pool->reorder_frame_list)) {
     g_queue_foreach (&reorder_pool->reorder_frame_list, (GFunc) set_b_frame,
         encoder);
     reorder_pool->reorder_state = GST_VAAPI_ENC_H265_REORD_DUMP_FRAMES;
-    g_assert (!g_queue_is_empty (&reorder_pool->reorder_frame_list));
   }
 
 end:
@@ -3323,7 +3380,7 @@ set_context_info (GstVaapiEncoder * base_encoder)
 {
   GstVaapiEncoderH265 *const encoder = GST_VAAPI_ENCODER_H265 (base_encoder);
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
-  const guint DEFAULT_SURFACES_COUNT = 3;
+  const guint num_surfaces = GST_VAAPI_ENCODER_ASYNC_SURFACES (encoder, 3);
 
   /* FIXME: Using only a rough approximation for bitstream headers.
    * Not taken into account: ScalingList, RefPicListModification,
@@ -3360,7 +3417,7 @@ set_context_info (GstVaapiEncoder * base_encoder)
   GST_VAAPI_ENCODER_CAST (encoder)->profile = encoder->profile;
 
   base_encoder->num_ref_frames = (encoder->num_ref_frames
-      + (encoder->num_bframes > 0 ? 1 : 0) + DEFAULT_SURFACES_COUNT);
+      + (encoder->num_bframes > 0 ? 1 : 0) + num_surfaces);
 
   /* Only YUV 4:2:0 formats are supported for now. */
   base_encoder->codedbuf_size += GST_ROUND_UP_16 (vip->width) *
@@ -3486,6 +3543,7 @@ gst_vaapi_encoder_h265_finalize (GObject * object)
   gst_buffer_replace (&encoder->vps_data, NULL);
   gst_buffer_replace (&encoder->sps_data, NULL);
   gst_buffer_replace (&encoder->pps_data, NULL);
+  gst_vaapi_utils_h26x_packed_header_cache_clear (&encoder->packed_pps);
 
   /* reference list info de-init */
   ref_pool = &encoder->ref_pool;
@@ -3528,6 +3586,7 @@ gst_vaapi_encoder_h265_finalize (GObject * object)
  * @ENCODER_H265_PROP_QP_IB: Difference of QP between I and B frame.
  * @ENCODER_H265_PROP_LOW_DELAY_B: use low delay b feature.
  * @ENCODER_H265_PROP_MAX_QP: Maximal quantizer value (uint).
+ * @ENCODER_H265_PROP_LOOKAHEAD: Number of frames analysed ahead (uint).
  *
  * The set of H.265 encoder specific configurable properties.
  */
@@ -3551,6 +3610,7 @@ enum
   ENCODER_H265_PROP_QUALITY_FACTOR,
   ENCODER_H265_PROP_NUM_TILE_COLS,
   ENCODER_H265_PROP_NUM_TILE_ROWS,
+  ENCODER_H265_PROP_LOOKAHEAD,
   ENCODER_H265_N_PROPERTIES
 };
 
@@ -3629,6 +3689,16 @@ gst_vaapi_encoder_h265_set_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       encoder->num_tile_rows = g_value_get_uint (value);
       break;
+    case ENCODER_H265_PROP_LOOKAHEAD:{
+      GstVaapiEncoderStatus status;
+
+      status = gst_vaapi_encoder_set_lookahead_depth (base_encoder,
+          g_value_get_uint (value));
+      if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS)
+        GST_WARNING_OBJECT (object, "failed to set the lookahead depth, "
+            "error is %d", status);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3692,6 +3762,10 @@ gst_vaapi_encoder_h265_get_property (GObject * object, guint prop_id,
     case ENCODER_H265_PROP_NUM_TILE_ROWS:
       g_value_set_uint (value, encoder->num_tile_rows);
       break;
+    case ENCODER_H265_PROP_LOOKAHEAD:
+      g_value_set_uint (value,
+          gst_vaapi_encoder_get_lookahead_depth (base_encoder));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -3926,6 +4000,22 @@ gst_vaapi_encoder_h265_class_init (GstVaapiEncoderH265Class * klass)
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
       GST_VAAPI_PARAM_ENCODER_EXPOSURE);
 
+  /**
+   * GstVaapiEncoderH265:lookahead:
+   *
+   * The number of frames analysed before encoding, to insert key
+   * frames at scene cuts and to use fewer B-frames in high motion
+   * scenes. This adds as many frames of latency. 0 disables the
+   * lookahead.
+   */
+  properties[ENCODER_H265_PROP_LOOKAHEAD] =
+      g_param_spec_uint ("lookahead",
+      "Lookahead",
+      "Number of frames analysed ahead for scene cuts and adaptive "
+      "B-frames (0: disabled)", 0, 60, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
+      GST_VAAPI_PARAM_ENCODER_EXPOSURE);
+
   g_object_class_install_properties (object_class, ENCODER_H265_N_PROPERTIES,
       properties);
 
@@ -670,7 +670,8 @@ set_context_info (GstVaapiEncoder * base_encoder)
   if (!ensure_hw_profile (encoder))
     return GST_VAAPI_ENCODER_STATUS_ERROR_UNSUPPORTED_PROFILE;
 
-  base_encoder->num_ref_frames = 2;
+  base_encoder->num_ref_frames = 2 +
+      GST_VAAPI_ENCODER_ASYNC_SURFACES (base_encoder, 0);
 
   /* Only YUV 4:2:0 formats are supported for now. This means that we
      have a limit of 4608 bits per macroblock. */
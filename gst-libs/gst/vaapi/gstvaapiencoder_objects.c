@@ -26,6 +26,7 @@
 #include "gstvaapisurfaceproxy_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -33,6 +34,7 @@
 #define GET_ENCODER(obj)    GST_VAAPI_ENCODER_CAST((obj)->parent_instance.codec)
 #define GET_VA_DISPLAY(obj) GET_ENCODER(obj)->va_display
 #define GET_VA_CONTEXT(obj) GET_ENCODER(obj)->va_context
+#define GET_BUFFER_POOL(obj) GET_ENCODER(obj)->context->buffers_pool
 
 /* ------------------------------------------------------------------------- */
 /* --- Encoder Packed Header                                             --- */
@@ -44,8 +46,10 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncPackedHeader,
 void
 gst_vaapi_enc_packed_header_destroy (GstVaapiEncPackedHeader * header)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->param_id);
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->data_id);
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (header),
+      &header->param_id, &header->param);
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (header),
+      &header->data_id, &header->data);
   header->param = NULL;
   header->data = NULL;
 }
@@ -59,20 +63,18 @@ gst_vaapi_enc_packed_header_create (GstVaapiEncPackedHeader * header,
   header->param_id = VA_INVALID_ID;
   header->data_id = VA_INVALID_ID;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
-      VAEncPackedHeaderParameterBufferType,
-      args->param_size, args->param, &header->param_id, &header->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (header),
+      VAEncPackedHeaderParameterBufferType, args->param_size, 1, args->param,
+      &header->param_id, &header->param);
   if (!success)
     return FALSE;
 
   if (!args->data_size)
     return TRUE;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
-      VAEncPackedHeaderDataBufferType,
-      args->data_size, args->data, &header->data_id, &header->data);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (header),
+      VAEncPackedHeaderDataBufferType, args->data_size, 1, args->data,
+      &header->data_id, &header->data);
   if (!success)
     return FALSE;
   return TRUE;
@@ -95,13 +97,13 @@ gst_vaapi_enc_packed_header_set_data (GstVaapiEncPackedHeader * header,
 {
   gboolean success;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (header), &header->data_id);
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (header),
+      &header->data_id, &header->data);
   header->data = NULL;
 
-  success = vaapi_create_buffer (GET_VA_DISPLAY (header),
-      GET_VA_CONTEXT (header),
-      VAEncPackedHeaderDataBufferType,
-      data_size, data, &header->data_id, &header->data);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (header),
+      VAEncPackedHeaderDataBufferType, data_size, 1, data,
+      &header->data_id, &header->data);
   if (!success)
     return FALSE;
   return TRUE;
@@ -116,8 +118,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncSequence, gst_vaapi_enc_sequence);
 void
 gst_vaapi_enc_sequence_destroy (GstVaapiEncSequence * sequence)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (sequence), &sequence->param_id);
-  sequence->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (sequence),
+      &sequence->param_id, &sequence->param);
 }
 
 gboolean
@@ -127,10 +129,9 @@ gst_vaapi_enc_sequence_create (GstVaapiEncSequence * sequence,
   gboolean success;
 
   sequence->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (sequence),
-      GET_VA_CONTEXT (sequence),
-      VAEncSequenceParameterBufferType,
-      args->param_size, args->param, &sequence->param_id, &sequence->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (sequence),
+      VAEncSequenceParameterBufferType, args->param_size, 1, args->param,
+      &sequence->param_id, &sequence->param);
   if (!success)
     return FALSE;
   return TRUE;
@@ -161,8 +162,8 @@ gst_vaapi_enc_slice_destroy (GstVaapiEncSlice * slice)
     slice->packed_headers = NULL;
   }
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (slice), &slice->param_id);
-  slice->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (slice),
+      &slice->param_id, &slice->param);
 }
 
 gboolean
@@ -172,10 +173,9 @@ gst_vaapi_enc_slice_create (GstVaapiEncSlice * slice,
   gboolean success;
 
   slice->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (slice),
-      GET_VA_CONTEXT (slice),
-      VAEncSliceParameterBufferType,
-      args->param_size, args->param, &slice->param_id, &slice->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (slice),
+      VAEncSliceParameterBufferType, args->param_size, 1, args->param,
+      &slice->param_id, &slice->param);
   if (!success)
     return FALSE;
 
@@ -207,8 +207,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncMiscParam, gst_vaapi_enc_misc_param);
 void
 gst_vaapi_enc_misc_param_destroy (GstVaapiEncMiscParam * misc)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (misc), &misc->param_id);
-  misc->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (misc),
+      &misc->param_id, &misc->param);
   misc->data = NULL;
 }
 
@@ -219,10 +219,9 @@ gst_vaapi_enc_misc_param_create (GstVaapiEncMiscParam * misc,
   gboolean success;
 
   misc->param_id = VA_INVALID_ID;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (misc),
-      GET_VA_CONTEXT (misc),
-      VAEncMiscParameterBufferType,
-      args->param_size, args->param, &misc->param_id, &misc->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (misc),
+      VAEncMiscParameterBufferType, args->param_size, 1, args->param,
+      &misc->param_id, &misc->param);
   if (!success)
     return FALSE;
   return TRUE;
@@ -258,8 +257,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncQMatrix, gst_vaapi_enc_q_matrix);
 void
 gst_vaapi_enc_q_matrix_destroy (GstVaapiEncQMatrix * q_matrix)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (q_matrix), &q_matrix->param_id);
-  q_matrix->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (q_matrix),
+      &q_matrix->param_id, &q_matrix->param);
 }
 
 gboolean
@@ -267,9 +266,9 @@ gst_vaapi_enc_q_matrix_create (GstVaapiEncQMatrix * q_matrix,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   q_matrix->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (q_matrix),
-      GET_VA_CONTEXT (q_matrix), VAQMatrixBufferType,
-      args->param_size, args->param, &q_matrix->param_id, &q_matrix->param);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (q_matrix),
+      VAQMatrixBufferType, args->param_size, 1, args->param,
+      &q_matrix->param_id, &q_matrix->param);
 }
 
 GstVaapiEncQMatrix *
@@ -295,8 +294,8 @@ GST_VAAPI_CODEC_DEFINE_TYPE (GstVaapiEncHuffmanTable,
 void
 gst_vaapi_enc_huffman_table_destroy (GstVaapiEncHuffmanTable * huf_table)
 {
-  vaapi_destroy_buffer (GET_VA_DISPLAY (huf_table), &huf_table->param_id);
-  huf_table->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (huf_table),
+      &huf_table->param_id, &huf_table->param);
 }
 
 gboolean
@@ -304,9 +303,9 @@ gst_vaapi_enc_huffman_table_create (GstVaapiEncHuffmanTable * huf_table,
     const GstVaapiCodecObjectConstructorArgs * args)
 {
   huf_table->param_id = VA_INVALID_ID;
-  return vaapi_create_buffer (GET_VA_DISPLAY (huf_table),
-      GET_VA_CONTEXT (huf_table), VAHuffmanTableBufferType, args->param_size,
-      args->param, &huf_table->param_id, (void **) &huf_table->param);
+  return gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (huf_table),
+      VAHuffmanTableBufferType, args->param_size, 1, args->param,
+      &huf_table->param_id, (void **) &huf_table->param);
 }
 
 GstVaapiEncHuffmanTable *
@@ -353,8 +352,8 @@ gst_vaapi_enc_picture_destroy (GstVaapiEncPicture * picture)
   picture->surface_id = VA_INVALID_ID;
   picture->surface = NULL;
 
-  vaapi_destroy_buffer (GET_VA_DISPLAY (picture), &picture->param_id);
-  picture->param = NULL;
+  gst_vaapi_codec_buffer_pool_release (GET_BUFFER_POOL (picture),
+      &picture->param_id, &picture->param);
 
   if (picture->frame) {
     gst_video_codec_frame_unref (picture->frame);
@@ -388,10 +387,9 @@ gst_vaapi_enc_picture_create (GstVaapiEncPicture * picture,
 
   picture->param_id = VA_INVALID_ID;
   picture->param_size = args->param_size;
-  success = vaapi_create_buffer (GET_VA_DISPLAY (picture),
-      GET_VA_CONTEXT (picture),
-      VAEncPictureParameterBufferType,
-      args->param_size, args->param, &picture->param_id, &picture->param);
+  success = gst_vaapi_codec_buffer_pool_acquire (GET_BUFFER_POOL (picture),
+      VAEncPictureParameterBufferType, args->param_size, 1, args->param,
+      &picture->param_id, &picture->param);
   if (!success)
     return FALSE;
   picture->param_size = args->param_size;
@@ -479,20 +477,70 @@ gst_vaapi_enc_slice_add_packed_header (GstVaapiEncSlice * slice,
   g_ptr_array_add (slice->packed_headers, gst_vaapi_codec_object_ref (header));
 }
 
+/* The buffer is returned to the pool after vaEndPicture(), see
+   release_picture_buffers() */
 static gboolean
 do_encode (VADisplay dpy, VAContextID ctx, VABufferID * buf_id, void **buf_ptr)
 {
   VAStatus status;
+  gint64 profile_start;
 
   vaapi_unmap_buffer (dpy, *buf_id, buf_ptr);
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaRenderPicture (dpy, ctx, buf_id, 1);
-  if (!vaapi_check_status (status, "vaRenderPicture()"))
-    return FALSE;
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_RENDER_PICTURE,
+      profile_start);
+  return vaapi_check_status (status, "vaRenderPicture()");
+}
 
-  /* XXX: vaRenderPicture() is meant to destroy the VA buffer implicitly */
-  vaapi_destroy_buffer (dpy, buf_id);
-  return TRUE;
+static void
+release_packed_headers (GstVaapiCodecBufferPool * pool, GPtrArray * headers)
+{
+  guint i;
+
+  for (i = 0; i < headers->len; i++) {
+    GstVaapiEncPackedHeader *const header = g_ptr_array_index (headers, i);
+
+    gst_vaapi_codec_buffer_pool_release (pool, &header->param_id, NULL);
+    gst_vaapi_codec_buffer_pool_release (pool, &header->data_id, NULL);
+  }
+}
+
+/* Returns the VA buffers submitted for the picture to the pool, once
+   the driver is done with the picture, so that no recycled buffer is
+   handed out before vaEndPicture() */
+static void
+release_picture_buffers (GstVaapiEncPicture * picture)
+{
+  GstVaapiCodecBufferPool *const pool = GET_BUFFER_POOL (picture);
+  guint i;
+
+  if (picture->sequence)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->sequence->param_id,
+        NULL);
+  if (picture->q_matrix)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->q_matrix->param_id,
+        NULL);
+  if (picture->huf_table)
+    gst_vaapi_codec_buffer_pool_release (pool, &picture->huf_table->param_id,
+        NULL);
+  release_packed_headers (pool, picture->packed_headers);
+  gst_vaapi_codec_buffer_pool_release (pool, &picture->param_id, NULL);
+
+  for (i = 0; i < picture->misc_params->len; i++) {
+    GstVaapiEncMiscParam *const misc =
+        g_ptr_array_index (picture->misc_params, i);
+
+    gst_vaapi_codec_buffer_pool_release (pool, &misc->param_id, NULL);
+  }
+
+  for (i = 0; i < picture->slices->len; i++) {
+    GstVaapiEncSlice *const slice = g_ptr_array_index (picture->slices, i);
+
+    release_packed_headers (pool, slice->packed_headers);
+    gst_vaapi_codec_buffer_pool_release (pool, &slice->param_id, NULL);
+  }
 }
 
 gboolean
@@ -504,7 +552,9 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   VADisplay va_display;
   VAContextID va_context;
   VAStatus status;
+  gboolean success = FALSE;
   guint i;
+  gint64 profile_start;
 
   g_return_val_if_fail (picture != NULL, FALSE);
   g_return_val_if_fail (picture->surface_id != VA_INVALID_SURFACE, FALSE);
@@ -514,7 +564,10 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
 
   GST_DEBUG ("encode picture 0x%08x", picture->surface_id);
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaBeginPicture (va_display, va_context, picture->surface_id);
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_BEGIN_PICTURE,
+      profile_start);
   if (!vaapi_check_status (status, "vaBeginPicture()"))
     return FALSE;
 
@@ -522,19 +575,19 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
   sequence = picture->sequence;
   if (sequence && !do_encode (va_display, va_context,
           &sequence->param_id, &sequence->param))
-    return FALSE;
+    goto cleanup;
 
   /* Submit Quantization matrix */
   q_matrix = picture->q_matrix;
   if (q_matrix && !do_encode (va_display, va_context,
           &q_matrix->param_id, &q_matrix->param))
-    return FALSE;
+    goto cleanup;
 
   /* Submit huffman table */
   huf_table = picture->huf_table;
   if (huf_table && !do_encode (va_display, va_context,
           &huf_table->param_id, (void **) &huf_table->param))
-    return FALSE;
+    goto cleanup;
 
   /* Submit Packed Headers */
   for (i = 0; i < picture->packed_headers->len; i++) {
@@ -543,19 +596,19 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
     if (!do_encode (va_display, va_context,
             &header->param_id, &header->param) ||
         !do_encode (va_display, va_context, &header->data_id, &header->data))
-      return FALSE;
+      goto cleanup;
   }
 
   /* Submit Picture parameter */
   if (!do_encode (va_display, va_context, &picture->param_id, &picture->param))
-    return FALSE;
+    goto cleanup;
 
   /* Submit Misc Params */
   for (i = 0; i < picture->misc_params->len; i++) {
     GstVaapiEncMiscParam *const misc =
         g_ptr_array_index (picture->misc_params, i);
     if (!do_encode (va_display, va_context, &misc->param_id, &misc->param))
-      return FALSE;
+      goto cleanup;
   }
 
   /* Submit Slice parameters */
@@ -570,14 +623,19 @@ gst_vaapi_enc_picture_encode (GstVaapiEncPicture * picture)
       if (!do_encode (va_display, va_context,
               &header->param_id, &header->param) ||
           !do_encode (va_display, va_context, &header->data_id, &header->data))
-        return FALSE;
+        goto cleanup;
     }
     if (!do_encode (va_display, va_context, &slice->param_id, &slice->param))
-      return FALSE;
+      goto cleanup;
   }
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaEndPicture (va_display, va_context);
-  if (!vaapi_check_status (status, "vaEndPicture()"))
-    return FALSE;
-  return TRUE;
+  gst_vaapi_profiler_end (va_display, GST_VAAPI_PROFILER_END_PICTURE,
+      profile_start);
+  success = vaapi_check_status (status, "vaEndPicture()");
+
+cleanup:
+  release_picture_buffers (picture);
+  return success;
 }
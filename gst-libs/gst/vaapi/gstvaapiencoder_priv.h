@@ -27,6 +27,8 @@
 #include <gst/vaapi/gstvaapiencoder.h>
 #include <gst/vaapi/gstvaapiencoder_objects.h>
 #include <gst/vaapi/gstvaapicontext.h>
+#include <gst/vaapi/gstvaapiimage.h>
+#include <gst/vaapi/gstvaapifilter.h>
 #include <gst/vaapi/gstvaapivideopool.h>
 #include <gst/video/gstvideoutils.h>
 #include <gst/vaapi/gstvaapivalue.h>
@@ -175,6 +177,21 @@ G_BEGIN_DECLS
 #define GST_VAAPI_ENCODER_QUALITY_LEVEL(encoder) \
   (GST_VAAPI_ENCODER_CAST (encoder)->va_quality_level.quality_level)
 
+/**
+ * GST_VAAPI_ENCODER_ASYNC_SURFACES:
+ * @encoder: a #GstVaapiEncoder
+ * @default_count: the number of surfaces used when async-depth is unset
+ *
+ * Macro that evaluates to the number of reconstructed surfaces to
+ * allocate on top of the reference frames, so that async-depth frames
+ * can be encoded at once.
+ * This is an internal macro that does not do any run-time type check.
+ */
+#undef  GST_VAAPI_ENCODER_ASYNC_SURFACES
+#define GST_VAAPI_ENCODER_ASYNC_SURFACES(encoder, default_count) \
+  (GST_VAAPI_ENCODER_CAST (encoder)->async_depth > 0 ? \
+   GST_VAAPI_ENCODER_CAST (encoder)->async_depth : (default_count))
+
 /**
  * GST_VAAPI_ENCODER_VA_RATE_CONTROL:
  * @encoder: a #GstVaapiEncoder
@@ -218,8 +235,14 @@ G_BEGIN_DECLS
 #define GST_VAAPI_TYPE_ENCODER_MBBRC \
   (gst_vaapi_encoder_mbbrc_get_type ())
 
+/* Size of the luma thumbnails and histograms analysed by the lookahead */
+#define GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_WIDTH  64
+#define GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_HEIGHT 36
+#define GST_VAAPI_ENCODER_LOOKAHEAD_HIST_BINS    32
+
 typedef struct _GstVaapiEncoderClass GstVaapiEncoderClass;
 typedef struct _GstVaapiEncoderClassData GstVaapiEncoderClassData;
+typedef struct _GstVaapiEncoderLookaheadFrame GstVaapiEncoderLookaheadFrame;
 
 struct _GstVaapiEncoder
 {
@@ -259,6 +282,39 @@ struct _GstVaapiEncoder
   GstVaapiVideoPool *codedbuf_pool;
   GAsyncQueue *codedbuf_queue;
   guint32 num_codedbuf_queued;
+  guint num_codedbuf_exported;
+
+  /* completion tracking: the sync thread waits for the submitted
+     pictures in order, and moves them to the output queue */
+  GThread *sync_thread;
+  GMutex output_mutex;
+  GCond output_cond;
+  GQueue output_queue;
+  guint num_in_flight;
+  guint max_in_flight;
+  gboolean flushing;
+
+  /* frames submitted at once, 0 for the codec defaults */
+  guint async_depth;
+  guint peak_in_flight;
+  guint64 sum_in_flight;
+  guint64 num_submitted;
+
+  /* lookahead: frames analysed before reordering, to detect scene
+     cuts and adapt the number of B-frames */
+  guint lookahead_depth;
+  GQueue lookahead_queue;
+  GstVaapiEncoderLookaheadFrame *lookahead_cur;
+  GstVaapiImage *lookahead_image;
+  GstVaapiFilter *lookahead_filter;
+  GstVaapiSurface *lookahead_surface;
+  gboolean lookahead_no_vpp;
+  guint8 lookahead_prev_thumb[GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_WIDTH *
+      GST_VAAPI_ENCODER_LOOKAHEAD_THUMB_HEIGHT];
+  guint lookahead_prev_hist[GST_VAAPI_ENCODER_LOOKAHEAD_HIST_BINS];
+  gboolean lookahead_has_prev;
+  guint lookahead_since_cut;
+  guint lookahead_avg_sad;
 
   guint got_packed_headers:1;
   guint got_rate_control_mask:1;
@@ -353,6 +409,16 @@ gst_vaapi_encoder_release_surface (GstVaapiEncoder * encoder,
   gst_vaapi_surface_proxy_unref (proxy);
 }
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_encoder_lookahead_is_scene_cut (GstVaapiEncoder * encoder,
+    GstVideoCodecFrame * frame);
+
+G_GNUC_INTERNAL
+guint
+gst_vaapi_encoder_lookahead_get_num_bframes (GstVaapiEncoder * encoder,
+    guint max_bframes);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_encoder_ensure_param_quality_level (GstVaapiEncoder * encoder,
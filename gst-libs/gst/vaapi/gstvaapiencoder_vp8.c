@@ -160,7 +160,8 @@ set_context_info (GstVaapiEncoder * base_encoder)
   if (!ensure_hw_profile (encoder))
     return GST_VAAPI_ENCODER_STATUS_ERROR_UNSUPPORTED_PROFILE;
 
-  base_encoder->num_ref_frames = 3;
+  base_encoder->num_ref_frames = 3 +
+      GST_VAAPI_ENCODER_ASYNC_SURFACES (base_encoder, 0);
 
   /* Only YUV 4:2:0 formats are supported for now. */
   /* Assumig 4 times compression ratio */
@@ -224,13 +224,13 @@ set_context_info (GstVaapiEncoder * base_encoder)
 {
   GstVaapiEncoderVP9 *encoder = GST_VAAPI_ENCODER_VP9 (base_encoder);
   GstVideoInfo *const vip = GST_VAAPI_ENCODER_VIDEO_INFO (encoder);
-  const guint DEFAULT_SURFACES_COUNT = 2;
+  const guint num_surfaces = GST_VAAPI_ENCODER_ASYNC_SURFACES (encoder, 2);
 
   /* FIXME: Maximum sizes for common headers (in bytes) */
 
   GST_VAAPI_ENCODER_CAST (encoder)->profile = encoder->profile;
 
-  base_encoder->num_ref_frames = 3 + DEFAULT_SURFACES_COUNT;
+  base_encoder->num_ref_frames = 3 + num_surfaces;
 
   /* Only YUV 4:2:0 formats are supported for now. */
   base_encoder->codedbuf_size = GST_ROUND_UP_16 (vip->width) *
@@ -24,6 +24,7 @@
 #include "gstvaapicompat.h"
 #include "gstvaapifilter.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapivalue.h"
 #include "gstvaapiminiobject.h"
 #include "gstvaapidisplay_priv.h"
@@ -56,6 +57,9 @@ struct _GstVaapiFilter
 
   GstVaapiDisplay *display;
   VADisplay va_display;
+  /* Protects the filter state, and serializes the VA calls on the
+     filter context, instead of the display-wide lock */
+  GRecMutex lock;
   VAConfigID va_config;
   VAContextID va_context;
   GPtrArray *operations;
@@ -98,6 +102,20 @@ GST_DEBUG_CATEGORY (gst_debug_vaapi_filter);
 G_DEFINE_TYPE_WITH_CODE (GstVaapiFilter, gst_vaapi_filter, GST_TYPE_OBJECT,
     _do_init);
 
+static inline void
+filter_lock (GstVaapiFilter * filter)
+{
+  g_rec_mutex_lock (&filter->lock);
+  GST_VAAPI_DISPLAY_VA_LOCK (filter->display);
+}
+
+static inline void
+filter_unlock (GstVaapiFilter * filter)
+{
+  GST_VAAPI_DISPLAY_VA_UNLOCK (filter->display);
+  g_rec_mutex_unlock (&filter->lock);
+}
+
 /* ------------------------------------------------------------------------- */
 /* --- VPP Types                                                         --- */
 /* ------------------------------------------------------------------------- */
@@ -228,9 +246,9 @@ vpp_get_filters (GstVaapiFilter * filter, guint * num_filters_ptr)
 {
   VAProcFilterType *filters;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   filters = vpp_get_filters_unlocked (filter, num_filters_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return filters;
 }
 
@@ -279,9 +297,9 @@ vpp_get_filter_caps (GstVaapiFilter * filter, VAProcFilterType type,
 {
   gpointer caps;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   caps = vpp_get_filter_caps_unlocked (filter, type, cap_size, num_caps_ptr);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return caps;
 }
 
@@ -308,9 +326,9 @@ vpp_get_pipeline_caps_unlocked (GstVaapiFilter * filter)
 static void
 vpp_get_pipeline_caps (GstVaapiFilter * filter)
 {
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   vpp_get_pipeline_caps_unlocked (filter);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -926,9 +944,9 @@ op_set_generic (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_generic_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return success;
 }
 
@@ -1031,9 +1049,9 @@ op_set_color_balance (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_color_balance_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return success;
 }
 
@@ -1080,9 +1098,9 @@ op_set_deinterlace (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_deinterlace_unlocked (filter, op_data, method, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return success;
 }
 
@@ -1113,9 +1131,9 @@ op_set_skintone_level (GstVaapiFilter * filter,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_skintone_level_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return success;
 }
 
@@ -1142,9 +1160,9 @@ op_set_skintone (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
 {
   gboolean success = FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_skintone_unlocked (filter, op_data, enhance);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
   return success;
 }
 #endif
@@ -1189,9 +1207,9 @@ op_set_hdr_tone_map (GstVaapiFilter * filter, GstVaapiFilterOpData * op_data,
     gboolean value)
 {
   gboolean success = FALSE;
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   success = op_set_hdr_tone_map_unlocked (filter, op_data, value);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
 
   return success;
 }
@@ -1269,6 +1287,7 @@ find_format (GstVaapiFilter * filter, GstVideoFormat format)
 static void
 gst_vaapi_filter_init (GstVaapiFilter * filter)
 {
+  g_rec_mutex_init (&filter->lock);
   filter->va_config = VA_INVALID_ID;
   filter->va_context = VA_INVALID_ID;
   filter->format = DEFAULT_FORMAT;
@@ -1284,17 +1303,20 @@ static gboolean
 gst_vaapi_filter_initialize (GstVaapiFilter * filter)
 {
   VAStatus va_status;
+  gint64 profile_start;
 
   if (!filter->display)
     return FALSE;
 
-  va_status = vaCreateConfig (filter->va_display, VAProfileNone,
-      VAEntrypointVideoProc, NULL, 0, &filter->va_config);
-  if (!vaapi_check_status (va_status, "vaCreateConfig() [VPP]"))
+  if (!gst_vaapi_display_acquire_config (filter->display, VAProfileNone,
+          VAEntrypointVideoProc, NULL, 0, &filter->va_config))
     return FALSE;
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaCreateContext (filter->va_display, filter->va_config, 0, 0, 0,
       NULL, 0, &filter->va_context);
+  gst_vaapi_profiler_end (filter->va_display, GST_VAAPI_PROFILER_CREATE_CONTEXT,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaCreateContext() [VPP]"))
     return FALSE;
 
@@ -1313,7 +1335,7 @@ gst_vaapi_filter_finalize (GObject * object)
   if (!filter->display)
     goto bail;
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  GST_VAAPI_DISPLAY_VA_LOCK (filter->display);
   if (filter->operations) {
     for (i = 0; i < filter->operations->len; i++) {
       GstVaapiFilterOpData *const op_data =
@@ -1330,10 +1352,10 @@ gst_vaapi_filter_finalize (GObject * object)
   }
 
   if (filter->va_config != VA_INVALID_ID) {
-    vaDestroyConfig (filter->va_display, filter->va_config);
+    gst_vaapi_display_release_config (filter->display, filter->va_config);
     filter->va_config = VA_INVALID_ID;
   }
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (filter->display);
   gst_vaapi_display_replace (&filter->display, NULL);
 
 bail:
@@ -1352,6 +1374,8 @@ bail:
     filter->attribs = NULL;
   }
 
+  g_rec_mutex_clear (&filter->lock);
+
   G_OBJECT_CLASS (gst_vaapi_filter_parent_class)->finalize (object);
 }
 
@@ -1675,6 +1699,7 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
   VAStatus va_status;
   VARectangle src_rect, dst_rect;
   guint va_mirror = 0, va_rotation = 0;
+  gint64 profile_start;
 
   if (!ensure_operations (filter))
     return GST_VAAPI_FILTER_STATUS_ERROR_ALLOCATION_FAILED;
@@ -1791,17 +1816,26 @@ gst_vaapi_filter_process_unlocked (GstVaapiFilter * filter,
 
   vaapi_unmap_buffer (filter->va_display, pipeline_param_buf_id, NULL);
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaBeginPicture (filter->va_display, filter->va_context,
       GST_VAAPI_SURFACE_ID (dst_surface));
+  gst_vaapi_profiler_end (filter->va_display, GST_VAAPI_PROFILER_BEGIN_PICTURE,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaBeginPicture()"))
     goto error;
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaRenderPicture (filter->va_display, filter->va_context,
       &pipeline_param_buf_id, 1);
+  gst_vaapi_profiler_end (filter->va_display, GST_VAAPI_PROFILER_RENDER_PICTURE,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaRenderPicture()"))
     goto error;
 
+  profile_start = gst_vaapi_profiler_begin ();
   va_status = vaEndPicture (filter->va_display, filter->va_context);
+  gst_vaapi_profiler_end (filter->va_display, GST_VAAPI_PROFILER_END_PICTURE,
+      profile_start);
   if (!vaapi_check_status (va_status, "vaEndPicture()"))
     goto error;
 
@@ -1831,10 +1865,53 @@ gst_vaapi_filter_process (GstVaapiFilter * filter,
   g_return_val_if_fail (dst_surface != NULL,
       GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   status = gst_vaapi_filter_process_unlocked (filter,
       src_surface, dst_surface, flags);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
+  return status;
+}
+
+/**
+ * gst_vaapi_filter_process_multi:
+ * @filter: a #GstVaapiFilter
+ * @src_surface: the source @GstVaapiSurface
+ * @dst_surfaces: the destination #GstVaapiSurface array
+ * @num_dst_surfaces: the number of elements in @dst_surfaces
+ * @flags: #GstVaapiSurfaceRenderFlags that apply to @src_surface
+ *
+ * Applies the operations currently defined in the @filter to
+ * @src_surface, once for each of the @dst_surfaces, e.g. to scale a
+ * single picture to several resolutions. All the pictures are
+ * submitted back-to-back with the display lock held only once.
+ *
+ * Processing stops at the first failure.
+ *
+ * Return value: a #GstVaapiFilterStatus
+ */
+GstVaapiFilterStatus
+gst_vaapi_filter_process_multi (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface ** dst_surfaces,
+    guint num_dst_surfaces, guint flags)
+{
+  GstVaapiFilterStatus status = GST_VAAPI_FILTER_STATUS_SUCCESS;
+  guint i;
+
+  g_return_val_if_fail (filter != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (src_surface != NULL,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+  g_return_val_if_fail (dst_surfaces != NULL || num_dst_surfaces == 0,
+      GST_VAAPI_FILTER_STATUS_ERROR_INVALID_PARAMETER);
+
+  filter_lock (filter);
+  for (i = 0; i < num_dst_surfaces; i++) {
+    status = gst_vaapi_filter_process_unlocked (filter,
+        src_surface, dst_surfaces[i], flags);
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+      break;
+  }
+  filter_unlock (filter);
   return status;
 }
 
@@ -2179,6 +2256,69 @@ gst_vaapi_filter_set_deinterlacing_references (GstVaapiFilter * filter,
   return TRUE;
 }
 
+/**
+ * gst_vaapi_filter_get_deinterlacing_references:
+ * @filter: a #GstVaapiFilter
+ * @num_forward_references_ptr: return location for the number of
+ *   forward references, or %NULL
+ * @num_backward_references_ptr: return location for the number of
+ *   backward references, or %NULL
+ *
+ * Queries the number of past (forward) and future (backward)
+ * reference surfaces the underlying driver needs for the currently
+ * enabled set of operations, e.g. the active deinterlacing method.
+ * Callers can use this information to size their surfaces history and
+ * to determine how many frames need to be delayed before processing.
+ *
+ * Return value: %TRUE on success, %FALSE otherwise.
+ */
+gboolean
+gst_vaapi_filter_get_deinterlacing_references (GstVaapiFilter * filter,
+    guint * num_forward_references_ptr, guint * num_backward_references_ptr)
+{
+  VABufferID filters[N_PROPERTIES];
+  VAProcPipelineCaps pipeline_caps = { 0, };
+  guint i, num_filters = 0;
+  VAStatus va_status;
+
+  g_return_val_if_fail (filter != NULL, FALSE);
+
+  filter_lock (filter);
+  if (!ensure_operations (filter))
+    goto error;
+
+  for (i = 0; i < filter->operations->len; i++) {
+    GstVaapiFilterOpData *const op_data =
+        g_ptr_array_index (filter->operations, i);
+    if (!op_data->is_enabled || op_data->va_buffer == VA_INVALID_ID)
+      continue;
+    filters[num_filters++] = op_data->va_buffer;
+  }
+
+  va_status = vaQueryVideoProcPipelineCaps (filter->va_display,
+      filter->va_context, filters, num_filters, &pipeline_caps);
+  if (!vaapi_check_status (va_status, "vaQueryVideoProcPipelineCaps()"))
+    goto error;
+  filter_unlock (filter);
+
+  GST_DEBUG_OBJECT (filter, "deinterlacing references: %u forward, "
+      "%u backward", pipeline_caps.num_forward_references,
+      pipeline_caps.num_backward_references);
+
+  if (num_forward_references_ptr)
+    *num_forward_references_ptr = pipeline_caps.num_forward_references;
+  if (num_backward_references_ptr)
+    *num_backward_references_ptr = pipeline_caps.num_backward_references;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    filter_unlock (filter);
+    return FALSE;
+  }
+}
+
 /**
  * gst_vaapi_filter_set_scaling:
  * @filter: a #GstVaapiFilter
@@ -2423,9 +2563,9 @@ gst_vaapi_filter_set_colorimetry (GstVaapiFilter * filter,
 
   g_return_val_if_fail (filter != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   result = gst_vaapi_filter_set_colorimetry_unlocked (filter, input, output);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
 
   return result;
 }
@@ -2518,10 +2658,10 @@ gst_vaapi_filter_set_hdr_tone_map_meta (GstVaapiFilter * filter,
   g_return_val_if_fail (minfo != NULL, FALSE);
   g_return_val_if_fail (linfo != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (filter->display);
+  filter_lock (filter);
   status =
       gst_vaapi_filter_set_hdr_tone_map_meta_unlocked (filter, minfo, linfo);
-  GST_VAAPI_DISPLAY_UNLOCK (filter->display);
+  filter_unlock (filter);
 
   return status;
 }
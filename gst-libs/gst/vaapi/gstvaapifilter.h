@@ -210,6 +210,11 @@ GstVaapiFilterStatus
 gst_vaapi_filter_process (GstVaapiFilter * filter,
     GstVaapiSurface * src_surface, GstVaapiSurface * dst_surface, guint flags);
 
+GstVaapiFilterStatus
+gst_vaapi_filter_process_multi (GstVaapiFilter * filter,
+    GstVaapiSurface * src_surface, GstVaapiSurface ** dst_surfaces,
+    guint num_dst_surfaces, guint flags);
+
 GArray *
 gst_vaapi_filter_get_formats (GstVaapiFilter * filter);
 
@@ -257,6 +262,10 @@ gst_vaapi_filter_set_deinterlacing_references (GstVaapiFilter * filter,
     GstVaapiSurface ** forward_references, guint num_forward_references,
     GstVaapiSurface ** backward_references, guint num_backward_references);
 
+gboolean
+gst_vaapi_filter_get_deinterlacing_references (GstVaapiFilter * filter,
+    guint * num_forward_references_ptr, guint * num_backward_references_ptr);
+
 gboolean
 gst_vaapi_filter_set_scaling (GstVaapiFilter * filter,
     GstVaapiScaleMethod method);
@@ -30,8 +30,11 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
+#include "gstvaapiutils_copy.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
+#include "gstvaapidisplay_priv.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -130,9 +133,9 @@ gst_vaapi_image_free (GstVaapiImage * image)
   GST_DEBUG ("image %" GST_VAAPI_ID_FORMAT, GST_VAAPI_ID_ARGS (image_id));
 
   if (image_id != VA_INVALID_ID) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroyImage (GST_VAAPI_DISPLAY_VADISPLAY (display), image_id);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroyImage()"))
       GST_WARNING ("failed to destroy image %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (image_id));
@@ -158,11 +161,11 @@ _gst_vaapi_image_create (GstVaapiImage * image, GstVideoFormat format)
   if (!va_format)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaCreateImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       (VAImageFormat *) va_format,
       image->width, image->height, &image->internal_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (status != VA_STATUS_SUCCESS ||
       image->internal_image.format.fourcc != va_format->fourcc)
     return FALSE;
@@ -580,6 +583,7 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   GstVaapiDisplay *display;
   VAStatus status;
   guint i;
+  gint64 profile_start;
 
   if (_gst_vaapi_image_is_mapped (image))
     goto map_success;
@@ -588,10 +592,13 @@ _gst_vaapi_image_map (GstVaapiImage * image, GstVaapiImageRaw * raw_image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaMapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf, (void **) &image->image_data);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_MAP_BUFFER, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return FALSE;
 
@@ -633,6 +640,7 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
 {
   GstVaapiDisplay *display;
   VAStatus status;
+  gint64 profile_start;
 
   if (!_gst_vaapi_image_is_mapped (image))
     return TRUE;
@@ -641,10 +649,13 @@ _gst_vaapi_image_unmap (GstVaapiImage * image)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaUnmapBuffer (GST_VAAPI_DISPLAY_VADISPLAY (display),
       image->image.buf);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_UNMAP_BUFFER, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return FALSE;
 
@@ -745,113 +756,183 @@ init_image_from_buffer (GstVaapiImageRaw * raw_image, GstBuffer * buffer)
   return vmeta ? init_image_from_video_meta (raw_image, vmeta) : FALSE;
 }
 
-/* Copy N lines of an image */
-static inline void
-memcpy_pic (guchar * dst,
-    guint dst_stride,
-    const guchar * src, guint src_stride, guint len, guint height)
+/* Copy images of the same format, plane by plane */
+static gboolean
+copy_image_planes (GstVaapiImageRaw * dst_image,
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect, guint flags)
 {
-  guint i;
+  const GstVideoFormatInfo *const finfo =
+      gst_video_format_get_info (dst_image->format);
+  guint i, c, x, y, width, height;
+
+  if (!finfo || GST_VIDEO_FORMAT_INFO_IS_TILED (finfo) ||
+      GST_VIDEO_FORMAT_INFO_HAS_PALETTE (finfo) ||
+      GST_VIDEO_FORMAT_INFO_N_PLANES (finfo) > G_N_ELEMENTS (dst_image->pixels))
+    return FALSE;
 
-  for (i = 0; i < height; i++) {
-    memcpy (dst, src, len);
-    dst += dst_stride;
-    src += src_stride;
+  for (i = 0; i < GST_VIDEO_FORMAT_INFO_N_PLANES (finfo); i++) {
+    /* Use the first component stored in that plane */
+    for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); c++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, c) == i)
+        break;
+    }
+    if (c == GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo) ||
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, c) == 0)
+      return FALSE;
+
+    x = (rect->x >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c)) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, c);
+    y = rect->y >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c);
+    width = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, c, rect->width) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, c);
+    height = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, c, rect->height);
+
+    gst_vaapi_copy_plane (dst_image->pixels[i] + y * dst_image->stride[i] + x,
+        dst_image->stride[i], src_image->pixels[i] + y * src_image->stride[i] +
+        x, src_image->stride[i], width, height, flags);
   }
+  return TRUE;
 }
 
-/* Copy NV12 images */
-static void
-copy_image_NV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+/* Returns the U and V plane indices of planar 4:2:0 formats */
+static gboolean
+get_uv_planes (GstVideoFormat format, guint * u_plane, guint * v_plane)
 {
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  /* Y plane */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
-
-  /* UV plane */
-  dst_stride = dst_image->stride[1];
-  dst = dst_image->pixels[1] + (rect->y / 2) * dst_stride + (rect->x & -2);
-  src_stride = src_image->stride[1];
-  src = src_image->pixels[1] + (rect->y / 2) * src_stride + (rect->x & -2);
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height / 2);
+  switch (format) {
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_I420_10LE:
+      *u_plane = 1;
+      *v_plane = 2;
+      break;
+    case GST_VIDEO_FORMAT_YV12:
+      *u_plane = 2;
+      *v_plane = 1;
+      break;
+    default:
+      return FALSE;
+  }
+  return TRUE;
 }
 
-/* Copy YV12 images */
-static void
-copy_image_YV12 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+/* Convert between semi-planar (NV12, P010) and planar 4:2:0 images.
+   10-bit planar samples are LSB-aligned whereas P010 ones are
+   MSB-aligned */
+static gboolean
+convert_image_420 (GstVaapiImageRaw * dst_image,
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect, guint flags)
 {
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-  guint i, x, y, w, h;
+  const gboolean to_semi_planar = (dst_image->format == GST_VIDEO_FORMAT_NV12
+      || dst_image->format == GST_VIDEO_FORMAT_P010_10LE);
+  GstVaapiImageRaw *const planar = to_semi_planar ? src_image : dst_image;
+  GstVaapiImageRaw *const semi_planar = to_semi_planar ? dst_image : src_image;
+  guint u, v, bpp, x, y, w, h;
+  gint shift;
+
+  if (!get_uv_planes (planar->format, &u, &v))
+    return FALSE;
+
+  if (semi_planar->format == GST_VIDEO_FORMAT_NV12 &&
+      planar->format != GST_VIDEO_FORMAT_I420_10LE) {
+    bpp = 1;
+    shift = 0;
+  } else if (semi_planar->format == GST_VIDEO_FORMAT_P010_10LE &&
+      planar->format == GST_VIDEO_FORMAT_I420_10LE) {
+    bpp = 2;
+    shift = to_semi_planar ? 6 : -6;
+  } else
+    return FALSE;
 
   /* Y plane */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width, rect->height);
+  x = rect->x * bpp;
+  y = rect->y;
+  if (bpp == 1)
+    gst_vaapi_copy_plane (dst_image->pixels[0] + y * dst_image->stride[0] + x,
+        dst_image->stride[0], src_image->pixels[0] + y * src_image->stride[0] +
+        x, src_image->stride[0], rect->width, rect->height, flags);
+  else
+    gst_vaapi_copy_plane_shift16 (dst_image->pixels[0] +
+        y * dst_image->stride[0] + x, dst_image->stride[0],
+        src_image->pixels[0] + y * src_image->stride[0] + x,
+        src_image->stride[0], rect->width, rect->height, shift, flags);
 
   /* U/V planes */
-  x = rect->x / 2;
+  x = (rect->x / 2) * bpp;
   y = rect->y / 2;
-  w = rect->width / 2;
-  h = rect->height / 2;
-  for (i = 1; i < dst_image->num_planes; i++) {
-    dst_stride = dst_image->stride[i];
-    dst = dst_image->pixels[i] + y * dst_stride + x;
-    src_stride = src_image->stride[i];
-    src = src_image->pixels[i] + y * src_stride + x;
-    memcpy_pic (dst, dst_stride, src, src_stride, w, h);
+  w = (rect->width + 1) / 2;
+  h = (rect->height + 1) / 2;
+  if (to_semi_planar) {
+    guint8 *const dst = dst_image->pixels[1] + y * dst_image->stride[1] + 2 * x;
+    const guint8 *const src_u = src_image->pixels[u] + y * src_image->stride[u]
+        + x;
+    const guint8 *const src_v = src_image->pixels[v] + y * src_image->stride[v]
+        + x;
+
+    if (bpp == 1)
+      gst_vaapi_copy_plane_interleave (dst, dst_image->stride[1],
+          src_u, src_image->stride[u], src_v, src_image->stride[v], w, h,
+          flags);
+    else
+      gst_vaapi_copy_plane_interleave16 (dst, dst_image->stride[1],
+          src_u, src_image->stride[u], src_v, src_image->stride[v], w, h,
+          shift, flags);
+  } else {
+    guint8 *const dst_u = dst_image->pixels[u] + y * dst_image->stride[u] + x;
+    guint8 *const dst_v = dst_image->pixels[v] + y * dst_image->stride[v] + x;
+    const guint8 *const src = src_image->pixels[1] + y * src_image->stride[1]
+        + 2 * x;
+
+    if (bpp == 1)
+      gst_vaapi_copy_plane_deinterleave (dst_u, dst_image->stride[u],
+          dst_v, dst_image->stride[v], src, src_image->stride[1], w, h, flags);
+    else
+      gst_vaapi_copy_plane_deinterleave16 (dst_u, dst_image->stride[u],
+          dst_v, dst_image->stride[v], src, src_image->stride[1], w, h,
+          shift, flags);
   }
+  return TRUE;
 }
 
-/* Copy YUY2 images */
-static void
-copy_image_YUY2 (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+/* Convert between I420 and YV12 images */
+static gboolean
+convert_image_planar (GstVaapiImageRaw * dst_image,
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect, guint flags)
 {
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  /* YUV 4:2:2, full vertical resolution */
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x * 2;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x * 2;
-  memcpy_pic (dst, dst_stride, src, src_stride, rect->width * 2, rect->height);
-}
+  guint src_u, src_v, dst_u, dst_v, x, y, w, h;
 
-/* Copy RGBA images */
-static void
-copy_image_RGBA (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
-{
-  guchar *dst, *src;
-  guint dst_stride, src_stride;
-
-  dst_stride = dst_image->stride[0];
-  dst = dst_image->pixels[0] + rect->y * dst_stride + rect->x;
-  src_stride = src_image->stride[0];
-  src = src_image->pixels[0] + rect->y * src_stride + rect->x;
-  memcpy_pic (dst, dst_stride, src, src_stride, 4 * rect->width, rect->height);
+  if (!get_uv_planes (src_image->format, &src_u, &src_v) ||
+      !get_uv_planes (dst_image->format, &dst_u, &dst_v) ||
+      src_image->format == GST_VIDEO_FORMAT_I420_10LE ||
+      dst_image->format == GST_VIDEO_FORMAT_I420_10LE)
+    return FALSE;
+
+  gst_vaapi_copy_plane (dst_image->pixels[0] + rect->y * dst_image->stride[0]
+      + rect->x, dst_image->stride[0], src_image->pixels[0] +
+      rect->y * src_image->stride[0] + rect->x, src_image->stride[0],
+      rect->width, rect->height, flags);
+
+  x = rect->x / 2;
+  y = rect->y / 2;
+  w = (rect->width + 1) / 2;
+  h = (rect->height + 1) / 2;
+  gst_vaapi_copy_plane (dst_image->pixels[dst_u] + y *
+      dst_image->stride[dst_u] + x, dst_image->stride[dst_u],
+      src_image->pixels[src_u] + y * src_image->stride[src_u] + x,
+      src_image->stride[src_u], w, h, flags);
+  gst_vaapi_copy_plane (dst_image->pixels[dst_v] + y *
+      dst_image->stride[dst_v] + x, dst_image->stride[dst_v],
+      src_image->pixels[src_v] + y * src_image->stride[src_v] + x,
+      src_image->stride[src_v], w, h, flags);
+  return TRUE;
 }
 
 static gboolean
 copy_image (GstVaapiImageRaw * dst_image,
-    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect)
+    GstVaapiImageRaw * src_image, const GstVaapiRectangle * rect, guint flags)
 {
   GstVaapiRectangle default_rect;
+  gboolean success;
 
-  if (dst_image->format != src_image->format ||
-      dst_image->width != src_image->width ||
+  if (dst_image->width != src_image->width ||
       dst_image->height != src_image->height)
     return FALSE;
 
@@ -869,29 +950,19 @@ copy_image (GstVaapiImageRaw * dst_image,
     rect = &default_rect;
   }
 
-  switch (dst_image->format) {
-    case GST_VIDEO_FORMAT_NV12:
-      copy_image_NV12 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_YV12:
-    case GST_VIDEO_FORMAT_I420:
-      copy_image_YV12 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-    case GST_VIDEO_FORMAT_UYVY:
-      copy_image_YUY2 (dst_image, src_image, rect);
-      break;
-    case GST_VIDEO_FORMAT_ARGB:
-    case GST_VIDEO_FORMAT_RGBA:
-    case GST_VIDEO_FORMAT_ABGR:
-    case GST_VIDEO_FORMAT_BGRA:
-      copy_image_RGBA (dst_image, src_image, rect);
-      break;
-    default:
-      GST_ERROR ("unsupported image format for copy");
-      return FALSE;
+  if (dst_image->format == src_image->format)
+    success = copy_image_planes (dst_image, src_image, rect, flags);
+  else if (dst_image->num_planes == src_image->num_planes)
+    success = convert_image_planar (dst_image, src_image, rect, flags);
+  else
+    success = convert_image_420 (dst_image, src_image, rect, flags);
+
+  if (!success) {
+    GST_ERROR ("unsupported image format for copy (%s -> %s)",
+        gst_video_format_to_string (src_image->format),
+        gst_video_format_to_string (dst_image->format));
   }
-  return TRUE;
+  return success;
 }
 
 /**
@@ -926,7 +997,8 @@ gst_vaapi_image_get_buffer (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &src_image))
     return FALSE;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect,
+      GST_VAAPI_COPY_FLAG_STREAMING_LOAD);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -958,7 +1030,8 @@ gst_vaapi_image_get_raw (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &src_image))
     return FALSE;
 
-  success = copy_image (dst_image, &src_image, rect);
+  success = copy_image (dst_image, &src_image, rect,
+      GST_VAAPI_COPY_FLAG_STREAMING_LOAD);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -998,7 +1071,7 @@ gst_vaapi_image_update_from_buffer (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &dst_image))
     return FALSE;
 
-  success = copy_image (&dst_image, &src_image, rect);
+  success = copy_image (&dst_image, &src_image, rect, 0);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -1031,7 +1104,7 @@ gst_vaapi_image_update_from_raw (GstVaapiImage * image,
   if (!_gst_vaapi_image_map (image, &dst_image))
     return FALSE;
 
-  success = copy_image (&dst_image, src_image, rect);
+  success = copy_image (&dst_image, src_image, rect, 0);
 
   if (!_gst_vaapi_image_unmap (image))
     return FALSE;
@@ -1063,7 +1136,8 @@ gst_vaapi_image_copy (GstVaapiImage * dst_image, GstVaapiImage * src_image)
   if (!_gst_vaapi_image_map (src_image, &src_image_raw))
     goto end;
 
-  success = copy_image (&dst_image_raw, &src_image_raw, NULL);
+  success = copy_image (&dst_image_raw, &src_image_raw, NULL,
+      GST_VAAPI_COPY_FLAG_STREAMING_LOAD);
 
 end:
   _gst_vaapi_image_unmap (src_image);
@@ -0,0 +1,340 @@
+/*
+ *  gstvaapiprofiler.c - VA API calls profiler
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The profiler records, for each VA display, the number of calls, the
+ * cumulative time and a latency histogram of the VA entrypoints the
+ * library spends time in. The call sites are shared by all the
+ * displays, hence the profilers are looked up by VADisplay. When no
+ * profiler is active, a call site only costs an atomic read.
+ *
+ * The VA calls are issued from many threads at once, so recording a
+ * call takes no lock: the profilers live in a list that only ever
+ * grows, a released profiler is kept around to be reused by the next
+ * acquired display, and the statistics are updated atomically.
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiprofiler.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+typedef struct _GstVaapiProfilerStats GstVaapiProfilerStats;
+
+/* All the fields are pointer-sized, to be updated with the
+   g_atomic_pointer_*() functions */
+struct _GstVaapiProfilerStats
+{
+  gsize count;
+  gsize total_time;
+  gsize max_time;
+  gsize histogram[GST_VAAPI_PROFILER_N_BUCKETS];
+};
+
+struct _GstVaapiProfiler
+{
+  GstVaapiProfiler *next;       /* immutable once published */
+  VADisplay va_display;         /* atomic, NULL if released */
+  guint ref_count;              /* protected by g_profilers_lock */
+  GstVaapiProfilerStats stats[GST_VAAPI_PROFILER_N_CALLS];
+};
+
+static const gchar *const g_call_names[GST_VAAPI_PROFILER_N_CALLS] = {
+  "vaCreateConfig",
+  "vaCreateContext",
+  "vaCreateSurfaces",
+  "vaCreateBuffer",
+  "vaMapBuffer",
+  "vaUnmapBuffer",
+  "vaDestroyBuffer",
+  "vaBeginPicture",
+  "vaRenderPicture",
+  "vaEndPicture",
+  "vaSyncSurface",
+  "vaDeriveImage",
+  "vaGetImage",
+  "vaPutImage",
+  "vaPutSurface",
+  "vaExportSurfaceHandle",
+};
+
+/* Serializes gst_vaapi_profiler_acquire() and
+   gst_vaapi_profiler_release(). The profilers are never freed */
+static GMutex g_profilers_lock;
+static GstVaapiProfiler *g_profilers;
+static gint g_num_profilers;
+
+static GstVaapiProfiler *
+lookup_profiler (VADisplay va_display)
+{
+  GstVaapiProfiler *profiler;
+
+  for (profiler = g_atomic_pointer_get (&g_profilers); profiler != NULL;
+      profiler = profiler->next) {
+    if (g_atomic_pointer_get (&profiler->va_display) == va_display)
+      return profiler;
+  }
+  return NULL;
+}
+
+static inline gsize
+get_field (gsize * field)
+{
+  return GPOINTER_TO_SIZE (g_atomic_pointer_get (field));
+}
+
+static void
+clear_stats (GstVaapiProfiler * profiler)
+{
+  gsize *const fields = (gsize *) profiler->stats;
+  guint i;
+
+  for (i = 0; i < sizeof (profiler->stats) / sizeof (gsize); i++)
+    g_atomic_pointer_set (&fields[i], 0);
+}
+
+/**
+ * gst_vaapi_profiler_acquire:
+ * @va_display: a #VADisplay
+ *
+ * Starts profiling the VA calls issued on @va_display. The profiler
+ * is shared by all the users of @va_display.
+ *
+ * Return value: the #GstVaapiProfiler of @va_display, to be released
+ *   with gst_vaapi_profiler_release()
+ */
+GstVaapiProfiler *
+gst_vaapi_profiler_acquire (VADisplay va_display)
+{
+  GstVaapiProfiler *profiler;
+
+  g_return_val_if_fail (va_display != NULL, NULL);
+
+  g_mutex_lock (&g_profilers_lock);
+  profiler = lookup_profiler (va_display);
+  if (profiler) {
+    profiler->ref_count++;
+    goto done;
+  }
+
+  /* Reuse a released profiler, or prepend a new one to the list */
+  profiler = lookup_profiler (NULL);
+  if (!profiler) {
+    profiler = g_new0 (GstVaapiProfiler, 1);
+    profiler->next = g_profilers;
+    g_atomic_pointer_set (&g_profilers, profiler);
+  }
+  clear_stats (profiler);
+  profiler->ref_count = 1;
+  g_atomic_pointer_set (&profiler->va_display, va_display);
+  g_atomic_int_inc (&g_num_profilers);
+
+done:
+  g_mutex_unlock (&g_profilers_lock);
+  return profiler;
+}
+
+/**
+ * gst_vaapi_profiler_release:
+ * @profiler: a #GstVaapiProfiler
+ *
+ * Releases @profiler. The VA calls are no longer profiled once the
+ * last user of the VA display released it.
+ */
+void
+gst_vaapi_profiler_release (GstVaapiProfiler * profiler)
+{
+  g_return_if_fail (profiler != NULL);
+
+  g_mutex_lock (&g_profilers_lock);
+  if (--profiler->ref_count == 0) {
+    /* The calls in flight may still record into the profiler, which
+       is why it is cleared when reused rather than freed here */
+    g_atomic_pointer_set (&profiler->va_display, NULL);
+    g_atomic_int_add (&g_num_profilers, -1);
+  }
+  g_mutex_unlock (&g_profilers_lock);
+}
+
+/**
+ * gst_vaapi_profiler_begin:
+ *
+ * Starts timing a VA call, to be recorded with gst_vaapi_profiler_end().
+ *
+ * Return value: the start time of the call, or zero if no VA display
+ *   is profiled
+ */
+gint64
+gst_vaapi_profiler_begin (void)
+{
+  if (G_LIKELY (g_atomic_int_get (&g_num_profilers) == 0))
+    return 0;
+  return g_get_monotonic_time ();
+}
+
+static guint
+get_bucket (gsize time)
+{
+  guint bucket = 0;
+
+  while (time > 0 && bucket < GST_VAAPI_PROFILER_N_BUCKETS - 1) {
+    time >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/**
+ * gst_vaapi_profiler_end:
+ * @va_display: the #VADisplay the call was issued on
+ * @call: the #GstVaapiProfilerCall
+ * @start_time: the value returned by gst_vaapi_profiler_begin()
+ *
+ * Records the VA call started at @start_time, if @va_display is
+ * profiled.
+ */
+void
+gst_vaapi_profiler_end (VADisplay va_display, GstVaapiProfilerCall call,
+    gint64 start_time)
+{
+  GstVaapiProfiler *profiler;
+  GstVaapiProfilerStats *stats;
+  gsize time, max_time;
+
+  if (G_LIKELY (start_time == 0))
+    return;
+
+  time = g_get_monotonic_time () - start_time;
+
+  profiler = va_display ? lookup_profiler (va_display) : NULL;
+  if (!profiler)
+    return;
+
+  stats = &profiler->stats[call];
+  g_atomic_pointer_add (&stats->count, 1);
+  g_atomic_pointer_add (&stats->total_time, time);
+  g_atomic_pointer_add (&stats->histogram[get_bucket (time)], 1);
+  do {
+    max_time = get_field (&stats->max_time);
+    if (time <= max_time)
+      break;
+  } while (!g_atomic_pointer_compare_and_exchange ((gpointer *) &
+          stats->max_time, GSIZE_TO_POINTER (max_time),
+          GSIZE_TO_POINTER (time)));
+}
+
+/**
+ * gst_vaapi_profiler_get_stats:
+ * @profiler: a #GstVaapiProfiler
+ * @call: the #GstVaapiProfilerCall
+ * @count_ptr: (out) (optional): return location for the number of calls
+ * @total_time_ptr: (out) (optional): return location for the
+ *   cumulative time of the calls, in microseconds
+ * @histogram: (out) (optional): return location for the latency
+ *   histogram, an array of %GST_VAAPI_PROFILER_N_BUCKETS elements
+ *
+ * Retrieves the statistics of @call.
+ *
+ * Return value: %TRUE on success
+ */
+gboolean
+gst_vaapi_profiler_get_stats (GstVaapiProfiler * profiler,
+    GstVaapiProfilerCall call, guint64 * count_ptr, guint64 * total_time_ptr,
+    guint64 * histogram)
+{
+  GstVaapiProfilerStats *stats;
+  guint i;
+
+  g_return_val_if_fail (profiler != NULL, FALSE);
+  g_return_val_if_fail (call < GST_VAAPI_PROFILER_N_CALLS, FALSE);
+
+  stats = &profiler->stats[call];
+  if (count_ptr)
+    *count_ptr = get_field (&stats->count);
+  if (total_time_ptr)
+    *total_time_ptr = get_field (&stats->total_time);
+  if (histogram) {
+    for (i = 0; i < GST_VAAPI_PROFILER_N_BUCKETS; i++)
+      histogram[i] = get_field (&stats->histogram[i]);
+  }
+  return TRUE;
+}
+
+/**
+ * gst_vaapi_profiler_reset:
+ * @profiler: a #GstVaapiProfiler
+ *
+ * Clears the statistics of all the VA calls.
+ */
+void
+gst_vaapi_profiler_reset (GstVaapiProfiler * profiler)
+{
+  g_return_if_fail (profiler != NULL);
+
+  clear_stats (profiler);
+}
+
+/**
+ * gst_vaapi_profiler_get_report:
+ * @profiler: a #GstVaapiProfiler
+ *
+ * Formats the statistics of the VA calls issued so far, one line per
+ * entrypoint. Each histogram bucket is printed as its lower bound in
+ * microseconds, followed by the number of calls.
+ *
+ * Return value: the newly allocated report, to be released with
+ *   g_free()
+ */
+gchar *
+gst_vaapi_profiler_get_report (GstVaapiProfiler * profiler)
+{
+  GString *report;
+  guint64 count, total_time, max_time;
+  guint64 histogram[GST_VAAPI_PROFILER_N_BUCKETS];
+  guint i, j;
+
+  g_return_val_if_fail (profiler != NULL, NULL);
+
+  report = g_string_new (NULL);
+  g_string_append_printf (report, "%-22s %10s %12s %10s %10s  %s\n",
+      "call", "count", "total (us)", "mean (us)", "max (us)", "histogram");
+
+  for (i = 0; i < GST_VAAPI_PROFILER_N_CALLS; i++) {
+    gst_vaapi_profiler_get_stats (profiler, i, &count, &total_time,
+        histogram);
+    if (count == 0)
+      continue;
+    max_time = get_field (&profiler->stats[i].max_time);
+
+    g_string_append_printf (report, "%-22s %10" G_GUINT64_FORMAT " %12"
+        G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " ",
+        g_call_names[i], count, total_time, total_time / count, max_time);
+    for (j = 0; j < GST_VAAPI_PROFILER_N_BUCKETS; j++) {
+      if (histogram[j] == 0)
+        continue;
+      g_string_append_printf (report, " %s%" G_GUINT64_FORMAT ":%"
+          G_GUINT64_FORMAT, j == 0 ? "<" : "", j == 0 ? 1 :
+          G_GUINT64_CONSTANT (1) << (j - 1), histogram[j]);
+    }
+    g_string_append_c (report, '\n');
+  }
+
+  return g_string_free (report, FALSE);
+}
@@ -0,0 +1,95 @@
+/*
+ *  gstvaapiprofiler.h - VA API calls profiler
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_PROFILER_H
+#define GST_VAAPI_PROFILER_H
+
+#include <glib.h>
+#include <va/va.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiProfilerCall:
+ *
+ * The profiled VA entrypoints.
+ */
+typedef enum
+{
+  GST_VAAPI_PROFILER_CREATE_CONFIG = 0,
+  GST_VAAPI_PROFILER_CREATE_CONTEXT,
+  GST_VAAPI_PROFILER_CREATE_SURFACES,
+  GST_VAAPI_PROFILER_CREATE_BUFFER,
+  GST_VAAPI_PROFILER_MAP_BUFFER,
+  GST_VAAPI_PROFILER_UNMAP_BUFFER,
+  GST_VAAPI_PROFILER_DESTROY_BUFFER,
+  GST_VAAPI_PROFILER_BEGIN_PICTURE,
+  GST_VAAPI_PROFILER_RENDER_PICTURE,
+  GST_VAAPI_PROFILER_END_PICTURE,
+  GST_VAAPI_PROFILER_SYNC_SURFACE,
+  GST_VAAPI_PROFILER_DERIVE_IMAGE,
+  GST_VAAPI_PROFILER_GET_IMAGE,
+  GST_VAAPI_PROFILER_PUT_IMAGE,
+  GST_VAAPI_PROFILER_PUT_SURFACE,
+  GST_VAAPI_PROFILER_EXPORT_SURFACE_HANDLE,
+
+  GST_VAAPI_PROFILER_N_CALLS
+} GstVaapiProfilerCall;
+
+/* Latency histogram buckets: bucket 0 counts the calls below 1 us,
+   bucket n the calls in [2^(n-1), 2^n) us, and the last one all the
+   calls above */
+#define GST_VAAPI_PROFILER_N_BUCKETS 24
+
+typedef struct _GstVaapiProfiler GstVaapiProfiler;
+
+G_GNUC_INTERNAL
+GstVaapiProfiler *
+gst_vaapi_profiler_acquire (VADisplay va_display);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_profiler_release (GstVaapiProfiler * profiler);
+
+G_GNUC_INTERNAL
+gint64
+gst_vaapi_profiler_begin (void);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_profiler_end (VADisplay va_display, GstVaapiProfilerCall call,
+    gint64 start_time);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_profiler_get_stats (GstVaapiProfiler * profiler,
+    GstVaapiProfilerCall call, guint64 * count_ptr, guint64 * total_time_ptr,
+    guint64 * histogram);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_profiler_reset (GstVaapiProfiler * profiler);
+
+G_GNUC_INTERNAL
+gchar *
+gst_vaapi_profiler_get_report (GstVaapiProfiler * profiler);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_PROFILER_H */
@@ -30,12 +30,15 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapisurface.h"
 #include "gstvaapisurface_priv.h"
+#include "gstvaapidisplay_priv.h"
 #include "gstvaapicontext.h"
 #include "gstvaapiimage.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapitrace.h"
 
 #define DEBUG 1
 #include "gstvaapidebug.h"
@@ -78,10 +81,10 @@ gst_vaapi_surface_free (GstVaapiSurface * surface)
   gst_vaapi_surface_destroy_subpictures (surface);
 
   if (surface_id != VA_INVALID_SURFACE) {
-    GST_VAAPI_DISPLAY_LOCK (display);
+    GST_VAAPI_DISPLAY_VA_LOCK (display);
     status = vaDestroySurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
         &surface_id, 1);
-    GST_VAAPI_DISPLAY_UNLOCK (display);
+    GST_VAAPI_DISPLAY_VA_UNLOCK (display);
     if (!vaapi_check_status (status, "vaDestroySurfaces()"))
       GST_WARNING ("failed to destroy surface %" GST_VAAPI_ID_FORMAT,
           GST_VAAPI_ID_ARGS (surface_id));
@@ -101,15 +104,19 @@ gst_vaapi_surface_init (GstVaapiSurface * surface,
   VASurfaceID surface_id;
   VAStatus status;
   guint va_chroma_format;
+  gint64 profile_start;
 
   va_chroma_format = from_GstVaapiChromaType (chroma_type);
   if (!va_chroma_format)
     goto error_unsupported_chroma_type;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       width, height, va_chroma_format, 1, &surface_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_CREATE_SURFACES, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -156,6 +163,7 @@ gst_vaapi_surface_init_full (GstVaapiSurface * surface,
   VASurfaceAttrib attribs[4], *attrib;
   VASurfaceAttribExternalBuffers extbuf = { 0, };
   gboolean extbuf_needed = FALSE;
+  gint64 profile_start;
 
   va_format = gst_vaapi_video_format_to_va_format (format);
   if (!va_format)
@@ -216,11 +224,14 @@ gst_vaapi_surface_init_full (GstVaapiSurface * surface,
     attrib++;
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, extbuf.width, extbuf.height, &surface_id, 1,
       attribs, attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_CREATE_SURFACES, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -254,6 +265,7 @@ gst_vaapi_surface_init_from_buffer_proxy (GstVaapiSurface * surface,
   VASurfaceAttribExternalBuffers extbuf = { 0, };
   unsigned long extbuf_handle;
   guint i, width, height;
+  gint64 profile_start;
 
   format = GST_VIDEO_INFO_FORMAT (vip);
   width = GST_VIDEO_INFO_WIDTH (vip);
@@ -301,11 +313,14 @@ gst_vaapi_surface_init_from_buffer_proxy (GstVaapiSurface * surface,
       from_GstVaapiBufferMemoryType (GST_VAAPI_BUFFER_PROXY_TYPE (proxy));
   attrib++;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateSurfaces (GST_VAAPI_DISPLAY_VADISPLAY (display),
       va_chroma_format, width, height, &surface_id, 1, attribs,
       attrib - attribs);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_CREATE_SURFACES, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaCreateSurfaces()"))
     return FALSE;
 
@@ -655,6 +670,7 @@ gst_vaapi_surface_derive_image (GstVaapiSurface * surface)
   VAImage va_image;
   VAStatus status;
   GstVaapiImage *image;
+  gint64 profile_start;
 
   g_return_val_if_fail (surface != NULL, NULL);
 
@@ -662,10 +678,13 @@ gst_vaapi_surface_derive_image (GstVaapiSurface * surface)
   va_image.image_id = VA_INVALID_ID;
   va_image.buf = VA_INVALID_ID;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaDeriveImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &va_image);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_DERIVE_IMAGE, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaDeriveImage()"))
     return NULL;
   if (va_image.image_id == VA_INVALID_ID || va_image.buf == VA_INVALID_ID)
@@ -694,6 +713,7 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   VAImageID image_id;
   VAStatus status;
   guint width, height;
+  gint64 profile_start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
   g_return_val_if_fail (image != NULL, FALSE);
@@ -712,10 +732,13 @@ gst_vaapi_surface_get_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaGetImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), 0, 0, width, height, image_id);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_GET_IMAGE, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaGetImage()"))
     return FALSE;
 
@@ -739,6 +762,7 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   VAImageID image_id;
   VAStatus status;
   guint width, height;
+  gint64 profile_start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
   g_return_val_if_fail (image != NULL, FALSE);
@@ -757,11 +781,14 @@ gst_vaapi_surface_put_image (GstVaapiSurface * surface, GstVaapiImage * image)
   if (image_id == VA_INVALID_ID)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaPutImage (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), image_id, 0, 0, width, height, 0, 0,
       width, height);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_PUT_IMAGE, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaPutImage()"))
     return FALSE;
 
@@ -857,14 +884,14 @@ _gst_vaapi_surface_associate_subpicture (GstVaapiSurface * surface,
     dst_rect_default.height = GST_VAAPI_SURFACE_HEIGHT (surface);
   }
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaAssociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SUBPICTURE_ID (subpicture), &surface_id, 1,
       src_rect->x, src_rect->y, src_rect->width, src_rect->height,
       dst_rect->x, dst_rect->y, dst_rect->width, dst_rect->height,
       from_GstVaapiSubpictureFlags (gst_vaapi_subpicture_get_flags
           (subpicture)));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaAssociateSubpicture()"))
     return FALSE;
 
@@ -922,10 +949,10 @@ _gst_vaapi_surface_deassociate_subpicture (GstVaapiSurface * surface,
   if (surface_id == VA_INVALID_SURFACE)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaDeassociateSubpicture (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SUBPICTURE_ID (subpicture), &surface_id, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaDeassociateSubpicture()"))
     return FALSE;
 
@@ -946,6 +973,8 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
 {
   GstVaapiDisplay *display;
   VAStatus status;
+  gint64 trace_start;
+  gint64 profile_start;
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
@@ -953,10 +982,16 @@ gst_vaapi_surface_sync (GstVaapiSurface * surface)
   if (!display)
     return FALSE;
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  trace_start = gst_vaapi_trace_begin ();
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaSyncSurface (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface));
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_SYNC_SURFACE, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  gst_vaapi_trace_end (trace_start, "sync", GST_VAAPI_TRACE_NO_FRAME,
+      GST_VAAPI_SURFACE_ID (surface));
   if (!vaapi_check_status (status, "vaSyncSurface()"))
     return FALSE;
 
@@ -983,10 +1018,10 @@ gst_vaapi_surface_query_status (GstVaapiSurface * surface,
 
   g_return_val_if_fail (surface != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   status = vaQuerySurfaceStatus (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), &surface_status);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaQuerySurfaceStatus()"))
     return FALSE;
 
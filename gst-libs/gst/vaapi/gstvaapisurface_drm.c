@@ -21,10 +21,131 @@
  */
 
 #include "sysdeps.h"
+#include <unistd.h>
+#include "gstvaapicompat.h"
+#include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapisurface_drm.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiimage_priv.h"
 #include "gstvaapibufferproxy_priv.h"
+#include "gstvaapidisplay_priv.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#if VA_CHECK_VERSION(1,1,0)
+
+static void
+close_exported_objects (const VADRMPRIMESurfaceDescriptor * desc)
+{
+  guint i;
+
+  for (i = 0; i < desc->num_objects; i++)
+    close (desc->objects[i].fd);
+}
+
+/* Exports @surface as a single dma_buf, with the layout the VA driver
+   actually allocated. Returns NULL if the driver cannot export it that
+   way, or if the surface is not known to be linear: the users of the
+   dma_buf expect the layout of the derived images. */
+static GstVaapiBufferProxy *
+gst_vaapi_surface_export_dma_buf (GstVaapiSurface * surface)
+{
+  GstVaapiDisplay *const display = GST_VAAPI_SURFACE_DISPLAY (surface);
+  const GstVideoFormat format = GST_VAAPI_SURFACE_FORMAT (surface);
+  VADRMPRIMESurfaceDescriptor desc;
+  guint64 modifier;
+  gsize offsets[GST_VIDEO_MAX_PLANES];
+  gint strides[GST_VIDEO_MAX_PLANES];
+  VAStatus status;
+  gint64 profile_start;
+  guint i, num_planes;
+  gsize size;
+
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
+  status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+      VA_EXPORT_SURFACE_COMPOSED_LAYERS | VA_EXPORT_SURFACE_READ_WRITE, &desc);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_EXPORT_SURFACE_HANDLE, profile_start);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
+  if (status != VA_STATUS_SUCCESS) {
+    GST_DEBUG ("vaExportSurfaceHandle() failed: %s", vaErrorStr (status));
+    return NULL;
+  }
+
+  /* The buffer proxy holds a single file descriptor */
+  if (desc.num_objects != 1 || desc.num_layers != 1)
+    goto error_unsupported_layout;
+
+  /* DRM_FORMAT_MOD_INVALID means an implicit, driver defined, layout
+     that may be tiled as well */
+  modifier = desc.objects[0].drm_format_modifier;
+  if (modifier != DRM_FORMAT_MOD_LINEAR)
+    goto error_unsupported_modifier;
+
+  /* A layout with more planes than the format, e.g. with compression
+     control surfaces, cannot be described by a GstVideoInfo */
+  num_planes = desc.layers[0].num_planes;
+  if (num_planes == 0 || num_planes > GST_VIDEO_MAX_PLANES)
+    goto error_unsupported_layout;
+  if (format != GST_VIDEO_FORMAT_UNKNOWN && format != GST_VIDEO_FORMAT_ENCODED
+      && num_planes != GST_VIDEO_FORMAT_INFO_N_PLANES
+      (gst_video_format_get_info (format)))
+    goto error_unsupported_layout;
+
+  for (i = 0; i < num_planes; i++) {
+    if (desc.layers[0].object_index[i] != 0)
+      goto error_unsupported_layout;
+    offsets[i] = desc.layers[0].offset[i];
+    strides[i] = desc.layers[0].pitch[i];
+  }
+
+  /* Some drivers do not report the size of the exported object */
+  size = desc.objects[0].size;
+  if (size == 0) {
+    off_t end = lseek (desc.objects[0].fd, 0, SEEK_END);
+    if (end <= 0)
+      goto error_unsupported_layout;
+    size = end;
+    lseek (desc.objects[0].fd, 0, SEEK_SET);
+  }
+
+  GST_DEBUG ("exported surface %" GST_VAAPI_ID_FORMAT " as dma_buf %d, "
+      "modifier 0x%" G_GINT64_MODIFIER "x", GST_VAAPI_ID_ARGS
+      (GST_VAAPI_SURFACE_ID (surface)), desc.objects[0].fd, modifier);
+
+  /* The proxy takes ownership of the file descriptor */
+  return gst_vaapi_buffer_proxy_new_from_export (GST_MINI_OBJECT_CAST
+      (surface), desc.objects[0].fd, size, modifier, num_planes, offsets,
+      strides);
+
+  /* ERRORS */
+error_unsupported_layout:
+  {
+    GST_DEBUG ("unsupported exported layout (%u objects, %u layers, "
+        "%u planes)", desc.num_objects, desc.num_layers,
+        desc.num_layers > 0 ? desc.layers[0].num_planes : 0);
+    close_exported_objects (&desc);
+    return NULL;
+  }
+error_unsupported_modifier:
+  {
+    GST_DEBUG ("unsupported exported modifier 0x%" G_GINT64_MODIFIER "x",
+        modifier);
+    close_exported_objects (&desc);
+    return NULL;
+  }
+}
+#else
+static GstVaapiBufferProxy *
+gst_vaapi_surface_export_dma_buf (GstVaapiSurface * surface)
+{
+  return NULL;
+}
+#endif
 
 static GstVaapiBufferProxy *
 gst_vaapi_surface_get_drm_buf_handle (GstVaapiSurface * surface, guint type)
@@ -80,8 +201,12 @@ gst_vaapi_surface_peek_dma_buf_handle (GstVaapiSurface * surface)
   if (surface->extbuf_proxy)
     return surface->extbuf_proxy;
 
-  buf_proxy = gst_vaapi_surface_get_drm_buf_handle (surface,
-      GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF);
+  /* Prefer the surface as allocated by the driver, which may be tiled
+     or compressed, over a linear derived image */
+  buf_proxy = gst_vaapi_surface_export_dma_buf (surface);
+  if (!buf_proxy)
+    buf_proxy = gst_vaapi_surface_get_drm_buf_handle (surface,
+        GST_VAAPI_BUFFER_MEMORY_TYPE_DMA_BUF);
 
   if (buf_proxy) {
     gst_vaapi_surface_set_buffer_proxy (surface, buf_proxy);
@@ -32,13 +32,6 @@
 #include "gstvaapisurface_drm.h"
 #include "gstvaapisurface_priv.h"
 
-#if USE_DRM
-#include <drm_fourcc.h>
-#else
-#define DRM_FORMAT_MOD_LINEAR 0ULL
-#define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
-#endif
-
 typedef struct
 {
   GstVaapiDisplayEGL *display;
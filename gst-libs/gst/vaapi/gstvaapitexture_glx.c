@@ -34,6 +34,7 @@
 #include "gstvaapisurface_priv.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_glx.h"
 #include "gstvaapidisplay_glx.h"
 #include "gstvaapidisplay_x11_priv.h"
@@ -350,6 +351,7 @@ gst_vaapi_texture_glx_put_surface_unlocked (GstVaapiTexture * texture,
   VAStatus status;
   GLContextState old_cs;
   gboolean success = FALSE;
+  gint64 profile_start;
 
   const GLfloat *txc, *tyc;
   static const GLfloat g_texcoords[2][2] = {
@@ -357,11 +359,14 @@ gst_vaapi_texture_glx_put_surface_unlocked (GstVaapiTexture * texture,
     {1.0f, 0.0f},
   };
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaPutSurface (GST_VAAPI_DISPLAY_VADISPLAY (GST_VAAPI_TEXTURE_DISPLAY
           (texture)), GST_VAAPI_SURFACE_ID (surface), texture_glx->pixo->pixmap,
       crop_rect->x, crop_rect->y, crop_rect->width, crop_rect->height, 0, 0,
       texture->width, texture->height, NULL, 0,
       from_GstVaapiSurfaceRenderFlags (flags));
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (GST_VAAPI_TEXTURE_DISPLAY
+          (texture)), GST_VAAPI_PROFILER_PUT_SURFACE, profile_start);
   if (!vaapi_check_status (status, "vaPutSurface() [TFP]"))
     return FALSE;
 
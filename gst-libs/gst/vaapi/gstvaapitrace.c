@@ -0,0 +1,248 @@
+/*
+ *  gstvaapitrace.c - Per-frame timeline tracing
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:gstvaapitrace
+ * @short_description: Per-frame timeline tracing
+ *
+ * The decoders, the encoders and the elements record the time spent
+ * by each frame in their stages as spans, tagged with the system frame
+ * number, the VA surface and the thread. The spans are kept in a ring
+ * buffer, so that a long running pipeline only keeps the most recent
+ * ones, and are written as Chrome trace events (JSON) when the process
+ * exits. The output can be loaded into chrome://tracing or Perfetto.
+ *
+ * Tracing is enabled by setting the GST_VAAPI_TRACE environment
+ * variable to the output file name. The size of the ring buffer, in
+ * spans, can be set with GST_VAAPI_TRACE_SIZE.
+ */
+
+#include "sysdeps.h"
+#include <unistd.h>
+#include "gstvaapitrace.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#define TRACE_FILE_ENV "GST_VAAPI_TRACE"
+#define TRACE_SIZE_ENV "GST_VAAPI_TRACE_SIZE"
+#define TRACE_DEFAULT_SIZE 65536
+#define TRACE_MAX_SIZE (1 << 24)
+
+typedef struct _GstVaapiTraceEvent GstVaapiTraceEvent;
+typedef struct _GstVaapiTrace GstVaapiTrace;
+
+struct _GstVaapiTraceEvent
+{
+  const gchar *name;
+  gint64 start_time;
+  gint64 duration;
+  gint frame_number;
+  guint surface_id;
+  guint thread_id;
+};
+
+struct _GstVaapiTrace
+{
+  gchar *filename;
+  GMutex lock;
+  GstVaapiTraceEvent *events;
+  guint size;
+  guint64 count;
+};
+
+static GstVaapiTrace *g_trace;
+static GPrivate g_trace_thread_id;
+static gint g_trace_num_threads;
+
+static void
+trace_dump_at_exit (void)
+{
+  gst_vaapi_trace_dump (NULL);
+}
+
+static GstVaapiTrace *
+get_trace (void)
+{
+  static gsize trace_init = 0;
+
+  if (g_once_init_enter (&trace_init)) {
+    const gchar *const filename = g_getenv (TRACE_FILE_ENV);
+    const gchar *size_str;
+    guint64 size = 0;
+
+    if (filename && *filename) {
+      size_str = g_getenv (TRACE_SIZE_ENV);
+      if (size_str)
+        size = g_ascii_strtoull (size_str, NULL, 10);
+      if (size == 0)
+        size = TRACE_DEFAULT_SIZE;
+
+      g_trace = g_new0 (GstVaapiTrace, 1);
+      g_trace->filename = g_strdup (filename);
+      g_mutex_init (&g_trace->lock);
+      g_trace->size = MIN (size, TRACE_MAX_SIZE);
+      g_trace->events = g_new0 (GstVaapiTraceEvent, g_trace->size);
+      atexit (trace_dump_at_exit);
+    }
+    g_once_init_leave (&trace_init, 1);
+  }
+  return g_trace;
+}
+
+/* Small, stable, thread identifiers read better than addresses in
+   the trace viewers */
+static guint
+get_thread_id (void)
+{
+  guint thread_id;
+
+  thread_id = GPOINTER_TO_UINT (g_private_get (&g_trace_thread_id));
+  if (!thread_id) {
+    thread_id = g_atomic_int_add (&g_trace_num_threads, 1) + 1;
+    g_private_set (&g_trace_thread_id, GUINT_TO_POINTER (thread_id));
+  }
+  return thread_id;
+}
+
+/**
+ * gst_vaapi_trace_is_enabled:
+ *
+ * Return value: %TRUE if the spans are recorded
+ */
+gboolean
+gst_vaapi_trace_is_enabled (void)
+{
+  return get_trace () != NULL;
+}
+
+/**
+ * gst_vaapi_trace_begin:
+ *
+ * Starts a span, to be recorded with gst_vaapi_trace_end().
+ *
+ * Return value: the start time of the span, or zero if tracing is
+ *   disabled
+ */
+gint64
+gst_vaapi_trace_begin (void)
+{
+  if (G_LIKELY (!get_trace ()))
+    return 0;
+  return g_get_monotonic_time ();
+}
+
+/**
+ * gst_vaapi_trace_end:
+ * @start_time: the value returned by gst_vaapi_trace_begin()
+ * @name: the span name, a static string
+ * @frame_number: the system frame number, or %GST_VAAPI_TRACE_NO_FRAME
+ * @surface_id: the VA surface, or %GST_VAAPI_TRACE_NO_SURFACE
+ *
+ * Records the span started at @start_time, for the calling thread.
+ * Once the ring buffer is full, the oldest span is dropped.
+ */
+void
+gst_vaapi_trace_end (gint64 start_time, const gchar * name,
+    gint frame_number, guint surface_id)
+{
+  GstVaapiTrace *const trace = g_trace;
+  GstVaapiTraceEvent *event;
+  gint64 end_time;
+
+  if (G_LIKELY (start_time == 0 || !trace))
+    return;
+
+  end_time = g_get_monotonic_time ();
+
+  g_mutex_lock (&trace->lock);
+  event = &trace->events[trace->count++ % trace->size];
+  event->name = name;
+  event->start_time = start_time;
+  event->duration = end_time - start_time;
+  event->frame_number = frame_number;
+  event->surface_id = surface_id;
+  event->thread_id = get_thread_id ();
+  g_mutex_unlock (&trace->lock);
+}
+
+static void
+append_event (GString * str, const GstVaapiTraceEvent * event, gint pid)
+{
+  g_string_append_printf (str, "{\"name\":\"%s\",\"cat\":\"vaapi\","
+      "\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%" G_GINT64_FORMAT
+      ",\"dur\":%" G_GINT64_FORMAT ",\"args\":{", event->name, pid,
+      event->thread_id, event->start_time, event->duration);
+  if (event->frame_number != GST_VAAPI_TRACE_NO_FRAME)
+    g_string_append_printf (str, "\"frame\":%d", event->frame_number);
+  if (event->surface_id != GST_VAAPI_TRACE_NO_SURFACE) {
+    g_string_append_printf (str, "%s\"surface\":\"0x%08x\"",
+        event->frame_number != GST_VAAPI_TRACE_NO_FRAME ? "," : "",
+        event->surface_id);
+  }
+  g_string_append (str, "}}");
+}
+
+/**
+ * gst_vaapi_trace_dump:
+ * @filename: the output file name, or %NULL for the one set in the
+ *   GST_VAAPI_TRACE environment variable
+ *
+ * Writes the recorded spans, oldest first, as a Chrome trace-event
+ * JSON file. This is done automatically when the process exits.
+ *
+ * Return value: %TRUE on success, %FALSE on error or if tracing is
+ *   disabled
+ */
+gboolean
+gst_vaapi_trace_dump (const gchar * filename)
+{
+  GstVaapiTrace *const trace = get_trace ();
+  GError *error = NULL;
+  GString *str;
+  guint64 i, first;
+  const gint pid = getpid ();
+  gboolean success;
+
+  if (!trace)
+    return FALSE;
+  if (!filename)
+    filename = trace->filename;
+
+  str = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  g_mutex_lock (&trace->lock);
+  first = trace->count > trace->size ? trace->count - trace->size : 0;
+  for (i = first; i < trace->count; i++) {
+    if (i > first)
+      g_string_append (str, ",\n");
+    append_event (str, &trace->events[i % trace->size], pid);
+  }
+  g_mutex_unlock (&trace->lock);
+
+  g_string_append (str, "\n]}\n");
+
+  success = g_file_set_contents (filename, str->str, str->len, &error);
+  if (!success) {
+    GST_WARNING ("failed to write trace to %s: %s", filename, error->message);
+    g_error_free (error);
+  }
+  g_string_free (str, TRUE);
+  return success;
+}
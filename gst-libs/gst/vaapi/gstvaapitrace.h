@@ -0,0 +1,56 @@
+/*
+ *  gstvaapitrace.h - Per-frame timeline tracing
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_TRACE_H
+#define GST_VAAPI_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GST_VAAPI_TRACE_NO_FRAME:
+ *
+ * Frame number of the spans which are not tied to a frame.
+ */
+#define GST_VAAPI_TRACE_NO_FRAME (-1)
+
+/**
+ * GST_VAAPI_TRACE_NO_SURFACE:
+ *
+ * Surface id of the spans which are not tied to a surface.
+ */
+#define GST_VAAPI_TRACE_NO_SURFACE (G_MAXUINT)
+
+gboolean
+gst_vaapi_trace_is_enabled (void);
+
+gint64
+gst_vaapi_trace_begin (void);
+
+void
+gst_vaapi_trace_end (gint64 start_time, const gchar * name,
+    gint frame_number, guint surface_id);
+
+gboolean
+gst_vaapi_trace_dump (const gchar * filename);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_TRACE_H */
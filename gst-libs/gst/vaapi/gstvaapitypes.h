@@ -137,6 +137,19 @@ typedef enum {
     GST_VAAPI_ROTATION_AUTOMATIC = 360,
 } GstVaapiRotation;
 
+/**
+ * GstVaapiPresentMode:
+ * @GST_VAAPI_PRESENT_MODE_FIFO: each frame is presented, rendering
+ *   waits for the previous frame to be presented.
+ * @GST_VAAPI_PRESENT_MODE_MAILBOX: rendering never waits for the
+ *   previous frame, a newer frame replaces the one not yet presented,
+ *   which is dropped.
+ */
+typedef enum {
+    GST_VAAPI_PRESENT_MODE_FIFO = 0,
+    GST_VAAPI_PRESENT_MODE_MAILBOX,
+} GstVaapiPresentMode;
+
 /**
  * GstVaapiRateControl:
  * @GST_VAAPI_RATECONTROL_NONE: No rate control performed by the
@@ -25,6 +25,7 @@
 #include "sysdeps.h"
 #include "gstvaapicompat.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapibufferproxy.h"
 #include "gstvaapifilter.h"
 #include "gstvaapisubpicture.h"
@@ -140,8 +141,11 @@ vaapi_map_buffer (VADisplay dpy, VABufferID buf_id)
 {
   VAStatus status;
   gpointer data = NULL;
+  gint64 profile_start;
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaMapBuffer (dpy, buf_id, &data);
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_MAP_BUFFER, profile_start);
   if (!vaapi_check_status (status, "vaMapBuffer()"))
     return NULL;
   return data;
@@ -152,11 +156,14 @@ void
 vaapi_unmap_buffer (VADisplay dpy, VABufferID buf_id, gpointer * pbuf)
 {
   VAStatus status;
+  gint64 profile_start;
 
   if (pbuf)
     *pbuf = NULL;
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaUnmapBuffer (dpy, buf_id);
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_UNMAP_BUFFER, profile_start);
   if (!vaapi_check_status (status, "vaUnmapBuffer()"))
     return;
 }
@@ -178,8 +185,11 @@ vaapi_create_n_elements_buffer (VADisplay dpy, VAContextID ctx, int type,
   VABufferID buf_id;
   VAStatus status;
   gpointer data = (gpointer) buf;
+  gint64 profile_start;
 
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaCreateBuffer (dpy, ctx, type, size, num_elements, data, &buf_id);
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_CREATE_BUFFER, profile_start);
   if (!vaapi_check_status (status, "vaCreateBuffer()"))
     return FALSE;
 
@@ -205,10 +215,15 @@ error:
 void
 vaapi_destroy_buffer (VADisplay dpy, VABufferID * buf_id_ptr)
 {
+  gint64 profile_start;
+
   if (!buf_id_ptr || *buf_id_ptr == VA_INVALID_ID)
     return;
 
+  profile_start = gst_vaapi_profiler_begin ();
   vaDestroyBuffer (dpy, *buf_id_ptr);
+  gst_vaapi_profiler_end (dpy, GST_VAAPI_PROFILER_DESTROY_BUFFER,
+      profile_start);
   *buf_id_ptr = VA_INVALID_ID;
 }
 
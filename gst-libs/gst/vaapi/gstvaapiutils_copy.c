@@ -0,0 +1,659 @@
+/*
+ *  gstvaapiutils_copy.c - Pixels copy and conversion kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "sysdeps.h"
+#include "gstvaapiutils_copy.h"
+
+#define DEBUG 1
+#include "gstvaapidebug.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define USE_X86_KERNELS 1
+# include <immintrin.h>
+# define TARGET_SSE4_1 __attribute__ ((target ("sse4.1")))
+# define TARGET_AVX2   __attribute__ ((target ("avx2")))
+#else
+# define USE_X86_KERNELS 0
+#endif
+
+/* Row kernels. Sizes are expressed in samples, i.e. bytes for 8-bit
+   kernels and 16-bit words for 16-bit kernels. @stream is set if the
+   source shall be read with non-temporal loads */
+typedef struct
+{
+  void (*copy) (guint8 * dst, const guint8 * src, guint n, gboolean stream);
+  void (*interleave) (guint8 * dst, const guint8 * u, const guint8 * v,
+      guint n, gboolean stream);
+  void (*deinterleave) (guint8 * u, guint8 * v, const guint8 * src,
+      guint n, gboolean stream);
+  void (*shift16) (guint16 * dst, const guint16 * src, guint n, gint shift,
+      gboolean stream);
+  void (*interleave16) (guint16 * dst, const guint16 * u, const guint16 * v,
+      guint n, gint shift, gboolean stream);
+  void (*deinterleave16) (guint16 * u, guint16 * v, const guint16 * src,
+      guint n, gint shift, gboolean stream);
+} GstVaapiCopyKernels;
+
+/* ------------------------------------------------------------------------- */
+/* --- Scalar kernels                                                    --- */
+/* ------------------------------------------------------------------------- */
+
+static inline guint16
+shift_sample (guint16 x, gint shift)
+{
+  return shift >= 0 ? (guint16) (x << shift) : (guint16) (x >> -shift);
+}
+
+static void
+copy_scalar (guint8 * dst, const guint8 * src, guint n, gboolean stream)
+{
+  memcpy (dst, src, n);
+}
+
+static void
+interleave_scalar (guint8 * dst, const guint8 * u, const guint8 * v, guint n,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    dst[2 * i] = u[i];
+    dst[2 * i + 1] = v[i];
+  }
+}
+
+static void
+deinterleave_scalar (guint8 * u, guint8 * v, const guint8 * src, guint n,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    u[i] = src[2 * i];
+    v[i] = src[2 * i + 1];
+  }
+}
+
+static void
+shift16_scalar (guint16 * dst, const guint16 * src, guint n, gint shift,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+    dst[i] = shift_sample (src[i], shift);
+}
+
+static void
+interleave16_scalar (guint16 * dst, const guint16 * u, const guint16 * v,
+    guint n, gint shift, gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    dst[2 * i] = shift_sample (u[i], shift);
+    dst[2 * i + 1] = shift_sample (v[i], shift);
+  }
+}
+
+static void
+deinterleave16_scalar (guint16 * u, guint16 * v, const guint16 * src, guint n,
+    gint shift, gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    u[i] = shift_sample (src[2 * i], shift);
+    v[i] = shift_sample (src[2 * i + 1], shift);
+  }
+}
+
+static const GstVaapiCopyKernels g_kernels_scalar = {
+  copy_scalar,
+  interleave_scalar,
+  deinterleave_scalar,
+  shift16_scalar,
+  interleave16_scalar,
+  deinterleave16_scalar,
+};
+
+#if USE_X86_KERNELS
+/* ------------------------------------------------------------------------- */
+/* --- SSE4.1 kernels                                                    --- */
+/* ------------------------------------------------------------------------- */
+
+/* MOVNTDQA needs 16-byte aligned addresses, the callers make sure the
+   source is aligned when @stream is set */
+TARGET_SSE4_1 static inline __m128i
+load_sse4_1 (const void *p, gboolean stream)
+{
+  return stream ? _mm_stream_load_si128 ((__m128i *) p) :
+      _mm_loadu_si128 ((const __m128i *) p);
+}
+
+TARGET_SSE4_1 static inline __m128i
+shift16_sse4_1 (__m128i x, gint shift)
+{
+  return shift >= 0 ? _mm_sll_epi16 (x, _mm_cvtsi32_si128 (shift)) :
+      _mm_srl_epi16 (x, _mm_cvtsi32_si128 (-shift));
+}
+
+TARGET_SSE4_1 static void
+copy_sse4_1 (guint8 * dst, const guint8 * src, guint n, gboolean stream)
+{
+  guint i = 0;
+
+  /* Regular loads are best handled by memcpy() */
+  if (!stream) {
+    memcpy (dst, src, n);
+    return;
+  }
+
+  for (; i + 64 <= n; i += 64) {
+    const __m128i x0 = load_sse4_1 (src + i, TRUE);
+    const __m128i x1 = load_sse4_1 (src + i + 16, TRUE);
+    const __m128i x2 = load_sse4_1 (src + i + 32, TRUE);
+    const __m128i x3 = load_sse4_1 (src + i + 48, TRUE);
+    _mm_storeu_si128 ((__m128i *) (dst + i), x0);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 16), x1);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 32), x2);
+    _mm_storeu_si128 ((__m128i *) (dst + i + 48), x3);
+  }
+  for (; i + 16 <= n; i += 16)
+    _mm_storeu_si128 ((__m128i *) (dst + i), load_sse4_1 (src + i, TRUE));
+  if (i < n)
+    memcpy (dst + i, src + i, n - i);
+}
+
+TARGET_SSE4_1 static void
+interleave_sse4_1 (guint8 * dst, const guint8 * u, const guint8 * v, guint n,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m128i x = load_sse4_1 (u + i, stream);
+    const __m128i y = load_sse4_1 (v + i, stream);
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * i), _mm_unpacklo_epi8 (x, y));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * i + 16),
+        _mm_unpackhi_epi8 (x, y));
+  }
+  interleave_scalar (dst + 2 * i, u + i, v + i, n - i, FALSE);
+}
+
+TARGET_SSE4_1 static void
+deinterleave_sse4_1 (guint8 * u, guint8 * v, const guint8 * src, guint n,
+    gboolean stream)
+{
+  const __m128i mask = _mm_set1_epi16 (0x00ff);
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m128i a = load_sse4_1 (src + 2 * i, stream);
+    const __m128i b = load_sse4_1 (src + 2 * i + 16, stream);
+    _mm_storeu_si128 ((__m128i *) (u + i),
+        _mm_packus_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask)));
+    _mm_storeu_si128 ((__m128i *) (v + i),
+        _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8)));
+  }
+  deinterleave_scalar (u + i, v + i, src + 2 * i, n - i, FALSE);
+}
+
+TARGET_SSE4_1 static void
+shift16_sse4_1_row (guint16 * dst, const guint16 * src, guint n, gint shift,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    const __m128i x = load_sse4_1 (src + i, stream);
+    _mm_storeu_si128 ((__m128i *) (dst + i), shift16_sse4_1 (x, shift));
+  }
+  shift16_scalar (dst + i, src + i, n - i, shift, FALSE);
+}
+
+TARGET_SSE4_1 static void
+interleave16_sse4_1 (guint16 * dst, const guint16 * u, const guint16 * v,
+    guint n, gint shift, gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    const __m128i x = shift16_sse4_1 (load_sse4_1 (u + i, stream), shift);
+    const __m128i y = shift16_sse4_1 (load_sse4_1 (v + i, stream), shift);
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * i), _mm_unpacklo_epi16 (x, y));
+    _mm_storeu_si128 ((__m128i *) (dst + 2 * i + 8),
+        _mm_unpackhi_epi16 (x, y));
+  }
+  interleave16_scalar (dst + 2 * i, u + i, v + i, n - i, shift, FALSE);
+}
+
+TARGET_SSE4_1 static void
+deinterleave16_sse4_1 (guint16 * u, guint16 * v, const guint16 * src, guint n,
+    gint shift, gboolean stream)
+{
+  const __m128i mask = _mm_set1_epi32 (0x0000ffff);
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    const __m128i a = load_sse4_1 (src + 2 * i, stream);
+    const __m128i b = load_sse4_1 (src + 2 * i + 8, stream);
+    const __m128i x =
+        _mm_packus_epi32 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask));
+    const __m128i y =
+        _mm_packus_epi32 (_mm_srli_epi32 (a, 16), _mm_srli_epi32 (b, 16));
+    _mm_storeu_si128 ((__m128i *) (u + i), shift16_sse4_1 (x, shift));
+    _mm_storeu_si128 ((__m128i *) (v + i), shift16_sse4_1 (y, shift));
+  }
+  deinterleave16_scalar (u + i, v + i, src + 2 * i, n - i, shift, FALSE);
+}
+
+static const GstVaapiCopyKernels g_kernels_sse4_1 = {
+  copy_sse4_1,
+  interleave_sse4_1,
+  deinterleave_sse4_1,
+  shift16_sse4_1_row,
+  interleave16_sse4_1,
+  deinterleave16_sse4_1,
+};
+
+/* ------------------------------------------------------------------------- */
+/* --- AVX2 kernels                                                      --- */
+/* ------------------------------------------------------------------------- */
+
+/* VMOVNTDQA needs 32-byte aligned addresses */
+TARGET_AVX2 static inline __m256i
+load_avx2 (const void *p, gboolean stream)
+{
+  return stream ? _mm256_stream_load_si256 ((__m256i *) p) :
+      _mm256_loadu_si256 ((const __m256i *) p);
+}
+
+TARGET_AVX2 static inline __m256i
+shift16_avx2 (__m256i x, gint shift)
+{
+  return shift >= 0 ? _mm256_sll_epi16 (x, _mm_cvtsi32_si128 (shift)) :
+      _mm256_srl_epi16 (x, _mm_cvtsi32_si128 (-shift));
+}
+
+TARGET_AVX2 static void
+copy_avx2 (guint8 * dst, const guint8 * src, guint n, gboolean stream)
+{
+  guint i = 0;
+
+  if (!stream) {
+    memcpy (dst, src, n);
+    return;
+  }
+
+  for (; i + 128 <= n; i += 128) {
+    const __m256i x0 = load_avx2 (src + i, TRUE);
+    const __m256i x1 = load_avx2 (src + i + 32, TRUE);
+    const __m256i x2 = load_avx2 (src + i + 64, TRUE);
+    const __m256i x3 = load_avx2 (src + i + 96, TRUE);
+    _mm256_storeu_si256 ((__m256i *) (dst + i), x0);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 32), x1);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 64), x2);
+    _mm256_storeu_si256 ((__m256i *) (dst + i + 96), x3);
+  }
+  for (; i + 32 <= n; i += 32)
+    _mm256_storeu_si256 ((__m256i *) (dst + i), load_avx2 (src + i, TRUE));
+  if (i < n)
+    memcpy (dst + i, src + i, n - i);
+}
+
+/* 256-bit unpack and pack instructions operate on each 128-bit lane,
+   the results are reordered with lane permutations */
+TARGET_AVX2 static void
+interleave_avx2 (guint8 * dst, const guint8 * u, const guint8 * v, guint n,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    const __m256i x = load_avx2 (u + i, stream);
+    const __m256i y = load_avx2 (v + i, stream);
+    const __m256i lo = _mm256_unpacklo_epi8 (x, y);
+    const __m256i hi = _mm256_unpackhi_epi8 (x, y);
+    _mm256_storeu_si256 ((__m256i *) (dst + 2 * i),
+        _mm256_permute2x128_si256 (lo, hi, 0x20));
+    _mm256_storeu_si256 ((__m256i *) (dst + 2 * i + 32),
+        _mm256_permute2x128_si256 (lo, hi, 0x31));
+  }
+  interleave_scalar (dst + 2 * i, u + i, v + i, n - i, FALSE);
+}
+
+TARGET_AVX2 static void
+deinterleave_avx2 (guint8 * u, guint8 * v, const guint8 * src, guint n,
+    gboolean stream)
+{
+  const __m256i mask = _mm256_set1_epi16 (0x00ff);
+  guint i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    const __m256i a = load_avx2 (src + 2 * i, stream);
+    const __m256i b = load_avx2 (src + 2 * i + 32, stream);
+    const __m256i x = _mm256_packus_epi16 (_mm256_and_si256 (a, mask),
+        _mm256_and_si256 (b, mask));
+    const __m256i y = _mm256_packus_epi16 (_mm256_srli_epi16 (a, 8),
+        _mm256_srli_epi16 (b, 8));
+    _mm256_storeu_si256 ((__m256i *) (u + i),
+        _mm256_permute4x64_epi64 (x, 0xd8));
+    _mm256_storeu_si256 ((__m256i *) (v + i),
+        _mm256_permute4x64_epi64 (y, 0xd8));
+  }
+  deinterleave_scalar (u + i, v + i, src + 2 * i, n - i, FALSE);
+}
+
+TARGET_AVX2 static void
+shift16_avx2_row (guint16 * dst, const guint16 * src, guint n, gint shift,
+    gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m256i x = load_avx2 (src + i, stream);
+    _mm256_storeu_si256 ((__m256i *) (dst + i), shift16_avx2 (x, shift));
+  }
+  shift16_scalar (dst + i, src + i, n - i, shift, FALSE);
+}
+
+TARGET_AVX2 static void
+interleave16_avx2 (guint16 * dst, const guint16 * u, const guint16 * v,
+    guint n, gint shift, gboolean stream)
+{
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m256i x = shift16_avx2 (load_avx2 (u + i, stream), shift);
+    const __m256i y = shift16_avx2 (load_avx2 (v + i, stream), shift);
+    const __m256i lo = _mm256_unpacklo_epi16 (x, y);
+    const __m256i hi = _mm256_unpackhi_epi16 (x, y);
+    _mm256_storeu_si256 ((__m256i *) (dst + 2 * i),
+        _mm256_permute2x128_si256 (lo, hi, 0x20));
+    _mm256_storeu_si256 ((__m256i *) (dst + 2 * i + 16),
+        _mm256_permute2x128_si256 (lo, hi, 0x31));
+  }
+  interleave16_scalar (dst + 2 * i, u + i, v + i, n - i, shift, FALSE);
+}
+
+TARGET_AVX2 static void
+deinterleave16_avx2 (guint16 * u, guint16 * v, const guint16 * src, guint n,
+    gint shift, gboolean stream)
+{
+  const __m256i mask = _mm256_set1_epi32 (0x0000ffff);
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m256i a = load_avx2 (src + 2 * i, stream);
+    const __m256i b = load_avx2 (src + 2 * i + 16, stream);
+    const __m256i x = _mm256_packus_epi32 (_mm256_and_si256 (a, mask),
+        _mm256_and_si256 (b, mask));
+    const __m256i y = _mm256_packus_epi32 (_mm256_srli_epi32 (a, 16),
+        _mm256_srli_epi32 (b, 16));
+    _mm256_storeu_si256 ((__m256i *) (u + i),
+        shift16_avx2 (_mm256_permute4x64_epi64 (x, 0xd8), shift));
+    _mm256_storeu_si256 ((__m256i *) (v + i),
+        shift16_avx2 (_mm256_permute4x64_epi64 (y, 0xd8), shift));
+  }
+  deinterleave16_scalar (u + i, v + i, src + 2 * i, n - i, shift, FALSE);
+}
+
+static const GstVaapiCopyKernels g_kernels_avx2 = {
+  copy_avx2,
+  interleave_avx2,
+  deinterleave_avx2,
+  shift16_avx2_row,
+  interleave16_avx2,
+  deinterleave16_avx2,
+};
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- CPU dispatch                                                      --- */
+/* ------------------------------------------------------------------------- */
+
+static const gchar *g_cpu_names[] = { "scalar", "sse4.1", "avx2" };
+
+static const GstVaapiCopyKernels *g_kernels;
+static GstVaapiCopyCpu g_cpu;
+static guint g_stream_alignment;
+
+static gboolean
+cpu_is_supported (GstVaapiCopyCpu cpu)
+{
+  switch (cpu) {
+    case GST_VAAPI_COPY_CPU_SCALAR:
+      return TRUE;
+#if USE_X86_KERNELS
+    case GST_VAAPI_COPY_CPU_SSE4_1:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("sse4.1");
+    case GST_VAAPI_COPY_CPU_AVX2:
+      __builtin_cpu_init ();
+      return __builtin_cpu_supports ("avx2");
+#endif
+    default:
+      return FALSE;
+  }
+}
+
+static void
+set_cpu (GstVaapiCopyCpu cpu)
+{
+  switch (cpu) {
+#if USE_X86_KERNELS
+    case GST_VAAPI_COPY_CPU_AVX2:
+      g_kernels = &g_kernels_avx2;
+      g_stream_alignment = 32;
+      break;
+    case GST_VAAPI_COPY_CPU_SSE4_1:
+      g_kernels = &g_kernels_sse4_1;
+      g_stream_alignment = 16;
+      break;
+#endif
+    default:
+      cpu = GST_VAAPI_COPY_CPU_SCALAR;
+      g_kernels = &g_kernels_scalar;
+      g_stream_alignment = 0;
+      break;
+  }
+  g_cpu = cpu;
+}
+
+static const GstVaapiCopyKernels *
+get_kernels (void)
+{
+  static gsize g_once = 0;
+
+  if (g_once_init_enter (&g_once)) {
+    const gchar *const env = g_getenv ("GST_VAAPI_COPY_CPU");
+    GstVaapiCopyCpu cpu = GST_VAAPI_COPY_CPU_AVX2;
+    guint i;
+
+    if (env) {
+      for (i = 0; i < G_N_ELEMENTS (g_cpu_names); i++) {
+        if (g_ascii_strcasecmp (env, g_cpu_names[i]) == 0)
+          cpu = i;
+      }
+    }
+    while (!cpu_is_supported (cpu))
+      cpu--;
+    set_cpu (cpu);
+
+    GST_INFO ("using %s pixels copy kernels", g_cpu_names[g_cpu]);
+    g_once_init_leave (&g_once, 1);
+  }
+  return g_kernels;
+}
+
+GstVaapiCopyCpu
+gst_vaapi_copy_get_cpu (void)
+{
+  get_kernels ();
+  return g_cpu;
+}
+
+gboolean
+gst_vaapi_copy_set_cpu (GstVaapiCopyCpu cpu)
+{
+  get_kernels ();
+  if (!cpu_is_supported (cpu))
+    return FALSE;
+  set_cpu (cpu);
+  return TRUE;
+}
+
+const gchar *
+gst_vaapi_copy_cpu_get_name (GstVaapiCopyCpu cpu)
+{
+  if (cpu >= G_N_ELEMENTS (g_cpu_names))
+    return NULL;
+  return g_cpu_names[cpu];
+}
+
+/* Non-temporal loads are only used if all source rows are suitably
+   aligned */
+static inline gboolean
+use_streaming_load (guint flags, const guint8 * src, guint src_stride)
+{
+  if (!(flags & GST_VAAPI_COPY_FLAG_STREAMING_LOAD) || !g_stream_alignment)
+    return FALSE;
+  return ((GPOINTER_TO_SIZE (src) | src_stride) &
+      (g_stream_alignment - 1)) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Plane operations                                                  --- */
+/* ------------------------------------------------------------------------- */
+
+void
+gst_vaapi_copy_plane (guint8 * dst, guint dst_stride, const guint8 * src,
+    guint src_stride, guint width, guint height, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src, src_stride);
+  guint i;
+
+  /* Copy the whole plane at once if there are no gaps between rows */
+  if (dst_stride == width && src_stride == width) {
+    k->copy (dst, src, width * height, stream);
+    return;
+  }
+
+  for (i = 0; i < height; i++) {
+    k->copy (dst, src, width, stream);
+    dst += dst_stride;
+    src += src_stride;
+  }
+}
+
+void
+gst_vaapi_copy_plane_interleave (guint8 * dst, guint dst_stride,
+    const guint8 * src_u, guint src_u_stride, const guint8 * src_v,
+    guint src_v_stride, guint width, guint height, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src_u, src_u_stride) &&
+      use_streaming_load (flags, src_v, src_v_stride);
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    k->interleave (dst, src_u, src_v, width, stream);
+    dst += dst_stride;
+    src_u += src_u_stride;
+    src_v += src_v_stride;
+  }
+}
+
+void
+gst_vaapi_copy_plane_deinterleave (guint8 * dst_u, guint dst_u_stride,
+    guint8 * dst_v, guint dst_v_stride, const guint8 * src, guint src_stride,
+    guint width, guint height, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src, src_stride);
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    k->deinterleave (dst_u, dst_v, src, width, stream);
+    dst_u += dst_u_stride;
+    dst_v += dst_v_stride;
+    src += src_stride;
+  }
+}
+
+void
+gst_vaapi_copy_plane_shift16 (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height,
+    gint shift, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src, src_stride);
+  guint i;
+
+  if (shift == 0) {
+    gst_vaapi_copy_plane (dst, dst_stride, src, src_stride, 2 * width, height,
+        flags);
+    return;
+  }
+
+  for (i = 0; i < height; i++) {
+    k->shift16 ((guint16 *) dst, (const guint16 *) src, width, shift, stream);
+    dst += dst_stride;
+    src += src_stride;
+  }
+}
+
+void
+gst_vaapi_copy_plane_interleave16 (guint8 * dst, guint dst_stride,
+    const guint8 * src_u, guint src_u_stride, const guint8 * src_v,
+    guint src_v_stride, guint width, guint height, gint shift, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src_u, src_u_stride) &&
+      use_streaming_load (flags, src_v, src_v_stride);
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    k->interleave16 ((guint16 *) dst, (const guint16 *) src_u,
+        (const guint16 *) src_v, width, shift, stream);
+    dst += dst_stride;
+    src_u += src_u_stride;
+    src_v += src_v_stride;
+  }
+}
+
+void
+gst_vaapi_copy_plane_deinterleave16 (guint8 * dst_u, guint dst_u_stride,
+    guint8 * dst_v, guint dst_v_stride, const guint8 * src, guint src_stride,
+    guint width, guint height, gint shift, guint flags)
+{
+  const GstVaapiCopyKernels *const k = get_kernels ();
+  const gboolean stream = use_streaming_load (flags, src, src_stride);
+  guint i;
+
+  for (i = 0; i < height; i++) {
+    k->deinterleave16 ((guint16 *) dst_u, (guint16 *) dst_v,
+        (const guint16 *) src, width, shift, stream);
+    dst_u += dst_u_stride;
+    dst_v += dst_v_stride;
+    src += src_stride;
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ *  gstvaapiutils_copy.h - Pixels copy and conversion kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_UTILS_COPY_H
+#define GST_VAAPI_UTILS_COPY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstVaapiCopyCpu:
+ * @GST_VAAPI_COPY_CPU_SCALAR: plain C kernels
+ * @GST_VAAPI_COPY_CPU_SSE4_1: SSE4.1 kernels
+ * @GST_VAAPI_COPY_CPU_AVX2: AVX2 kernels
+ *
+ * The instruction set used by the copy kernels.
+ */
+typedef enum
+{
+  GST_VAAPI_COPY_CPU_SCALAR = 0,
+  GST_VAAPI_COPY_CPU_SSE4_1,
+  GST_VAAPI_COPY_CPU_AVX2,
+} GstVaapiCopyCpu;
+
+/**
+ * GstVaapiCopyFlags:
+ * @GST_VAAPI_COPY_FLAG_STREAMING_LOAD: the source is an uncached or
+ *   write-combined mapping (e.g. a mapped VA image), read it with
+ *   non-temporal loads
+ *
+ * Hints for the copy kernels.
+ */
+typedef enum
+{
+  GST_VAAPI_COPY_FLAG_STREAMING_LOAD = 1 << 0,
+} GstVaapiCopyFlags;
+
+/* Returns the best instruction set supported by the CPU, unless
+   overridden by the GST_VAAPI_COPY_CPU environment variable */
+G_GNUC_INTERNAL
+GstVaapiCopyCpu
+gst_vaapi_copy_get_cpu (void);
+
+/* Selects the kernels to use, mostly for benchmarking. Returns FALSE
+   if the CPU does not support that instruction set */
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_copy_set_cpu (GstVaapiCopyCpu cpu);
+
+G_GNUC_INTERNAL
+const gchar *
+gst_vaapi_copy_cpu_get_name (GstVaapiCopyCpu cpu);
+
+/* Copies @height rows of @width bytes */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane (guint8 * dst, guint dst_stride, const guint8 * src,
+    guint src_stride, guint width, guint height, guint flags);
+
+/* Interleaves @width samples of two 8-bit planes into one (I420 -> NV12) */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane_interleave (guint8 * dst, guint dst_stride,
+    const guint8 * src_u, guint src_u_stride, const guint8 * src_v,
+    guint src_v_stride, guint width, guint height, guint flags);
+
+/* Splits @width pairs of 8-bit samples into two planes (NV12 -> I420) */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane_deinterleave (guint8 * dst_u, guint dst_u_stride,
+    guint8 * dst_v, guint dst_v_stride, const guint8 * src, guint src_stride,
+    guint width, guint height, guint flags);
+
+/* Copies @width 16-bit samples per row, shifted left by @shift bits if
+   positive or right if negative, e.g. 6 to convert from LSB-aligned
+   10-bit samples to P010 */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane_shift16 (guint8 * dst, guint dst_stride,
+    const guint8 * src, guint src_stride, guint width, guint height,
+    gint shift, guint flags);
+
+/* Same as gst_vaapi_copy_plane_interleave() for 16-bit samples, which
+   are shifted as in gst_vaapi_copy_plane_shift16() */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane_interleave16 (guint8 * dst, guint dst_stride,
+    const guint8 * src_u, guint src_u_stride, const guint8 * src_v,
+    guint src_v_stride, guint width, guint height, gint shift, guint flags);
+
+/* Same as gst_vaapi_copy_plane_deinterleave() for 16-bit samples,
+   which are shifted as in gst_vaapi_copy_plane_shift16() */
+G_GNUC_INTERNAL
+void
+gst_vaapi_copy_plane_deinterleave16 (guint8 * dst_u, guint dst_u_stride,
+    guint8 * dst_v, guint dst_v_stride, const guint8 * src, guint src_stride,
+    guint width, guint height, gint shift, guint flags);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_UTILS_COPY_H */
@@ -62,11 +62,11 @@ gst_vaapi_get_config_attribute (GstVaapiDisplay * display, VAProfile profile,
 
   g_return_val_if_fail (display != NULL, FALSE);
 
-  GST_VAAPI_DISPLAY_LOCK (display);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
   attrib.type = type;
   status = vaGetConfigAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       profile, entrypoint, &attrib, 1);
-  GST_VAAPI_DISPLAY_UNLOCK (display);
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
   if (!vaapi_check_status (status, "vaGetConfigAttributes()"))
     return FALSE;
   if (attrib.value == VA_ATTRIB_NOT_SUPPORTED)
@@ -77,17 +77,120 @@ gst_vaapi_get_config_attribute (GstVaapiDisplay * display, VAProfile profile,
   return TRUE;
 }
 
+/* Builds the capabilities cache entry name of the surface attributes
+   for @config, out of the profile, entrypoint and attributes it was
+   created with */
+static gchar *
+get_surface_attributes_cache_name (GstVaapiDisplay * display,
+    VAConfigID config)
+{
+  VADisplay const va_display = GST_VAAPI_DISPLAY_VADISPLAY (display);
+  VAConfigAttrib *config_attribs;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  GString *name;
+  gint i, num_config_attribs = 0;
+  VAStatus va_status;
+
+  if (!GST_VAAPI_DISPLAY_CACHE (display))
+    return NULL;
+
+  config_attribs =
+      g_new (VAConfigAttrib, vaMaxNumConfigAttributes (va_display));
+  va_status = vaQueryConfigAttributes (va_display, config, &profile,
+      &entrypoint, config_attribs, &num_config_attribs);
+  if (!vaapi_check_status (va_status, "vaQueryConfigAttributes()")) {
+    g_free (config_attribs);
+    return NULL;
+  }
+
+  name = g_string_new (NULL);
+  g_string_append_printf (name, "surface-attributes-%d-%d", profile,
+      entrypoint);
+  for (i = 0; i < num_config_attribs; i++) {
+    g_string_append_printf (name, "-%d:%x", config_attribs[i].type,
+        config_attribs[i].value);
+  }
+  g_free (config_attribs);
+  return g_string_free (name, FALSE);
+}
+
+/* VASurfaceAttrib fields, as recorded in the capabilities cache. Only
+   integer attributes are recorded */
+#define NUM_SURFACE_ATTRIB_VALUES 3
+
+static VASurfaceAttrib *
+lookup_surface_attributes (GstVaapiDisplay * display, const gchar * name,
+    guint * num_attribs)
+{
+  VASurfaceAttrib *surface_attribs;
+  gint *values;
+  guint i, num_values;
+
+  if (!gst_vaapi_display_cache_lookup (GST_VAAPI_DISPLAY_CACHE (display),
+          name, &values, &num_values))
+    return NULL;
+
+  *num_attribs = num_values / NUM_SURFACE_ATTRIB_VALUES;
+  surface_attribs = g_new0 (VASurfaceAttrib, MAX (*num_attribs, 1));
+  for (i = 0; i < *num_attribs; i++) {
+    VASurfaceAttrib *const attrib = &surface_attribs[i];
+    const gint *const v = &values[i * NUM_SURFACE_ATTRIB_VALUES];
+
+    attrib->type = v[0];
+    attrib->flags = v[1];
+    attrib->value.type = VAGenericValueTypeInteger;
+    attrib->value.value.i = v[2];
+  }
+  g_free (values);
+  return surface_attribs;
+}
+
+static void
+store_surface_attributes (GstVaapiDisplay * display, const gchar * name,
+    const VASurfaceAttrib * surface_attribs, guint num_attribs)
+{
+  gint *values;
+  guint i, n = 0;
+
+  values = g_new (gint, num_attribs * NUM_SURFACE_ATTRIB_VALUES);
+  for (i = 0; i < num_attribs; i++) {
+    const VASurfaceAttrib *const attrib = &surface_attribs[i];
+
+    if (attrib->value.type != VAGenericValueTypeInteger)
+      continue;
+    values[n++] = attrib->type;
+    values[n++] = attrib->flags;
+    values[n++] = attrib->value.value.i;
+  }
+  gst_vaapi_display_cache_store (GST_VAAPI_DISPLAY_CACHE (display), name,
+      values, n);
+  g_free (values);
+}
+
 static VASurfaceAttrib *
 get_surface_attributes (GstVaapiDisplay * display, VAConfigID config,
     guint * num_attribs)
 {
   VASurfaceAttrib *surface_attribs = NULL;
+  GstVaapiDisplayCacheSnapshot *snapshot = NULL;
   guint num_surface_attribs = 0;
+  gchar *cache_name = NULL;
   VAStatus va_status;
 
   if (config == VA_INVALID_ID)
     goto error;
 
+  GST_VAAPI_DISPLAY_LOCK (display);
+  cache_name = get_surface_attributes_cache_name (display, config);
+  if (cache_name) {
+    surface_attribs = lookup_surface_attributes (display, cache_name,
+        &num_surface_attribs);
+  }
+  GST_VAAPI_DISPLAY_UNLOCK (display);
+  if (surface_attribs)
+    goto done;
+
   GST_VAAPI_DISPLAY_LOCK (display);
   va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       config, NULL, &num_surface_attribs);
@@ -102,10 +205,19 @@ get_surface_attributes (GstVaapiDisplay * display, VAConfigID config,
   GST_VAAPI_DISPLAY_LOCK (display);
   va_status = vaQuerySurfaceAttributes (GST_VAAPI_DISPLAY_VADISPLAY (display),
       config, surface_attribs, &num_surface_attribs);
+  if (va_status == VA_STATUS_SUCCESS && cache_name) {
+    store_surface_attributes (display, cache_name, surface_attribs,
+        num_surface_attribs);
+    snapshot = gst_vaapi_display_cache_snapshot (GST_VAAPI_DISPLAY_CACHE
+        (display));
+  }
   GST_VAAPI_DISPLAY_UNLOCK (display);
+  gst_vaapi_display_cache_snapshot_save (snapshot);
   if (!vaapi_check_status (va_status, "vaQuerySurfaceAttributes()"))
     goto error;
 
+done:
+  g_free (cache_name);
   if (num_attribs)
     *num_attribs = num_surface_attribs;
   return surface_attribs;
@@ -117,6 +229,7 @@ error:
       *num_attribs = -1;
     if (surface_attribs)
       g_free (surface_attribs);
+    g_free (cache_name);
     return NULL;
   }
 }
@@ -127,6 +240,8 @@ error:
  * @config: a #VAConfigID
  *
  * Retrieves the possible surface attributes for the supplied config.
+ * The driver is only queried once for the configs acquired through
+ * gst_vaapi_display_acquire_config().
  *
  * Returns: (transfer full): returns a #GstVaapiConfigSurfaceAttributes
  **/
@@ -138,6 +253,11 @@ gst_vaapi_config_surface_attributes_get (GstVaapiDisplay * display,
   guint i, num_pixel_formats = 0, num_surface_attribs = 0;
   GstVaapiConfigSurfaceAttributes *attribs = NULL;
 
+  attribs = gst_vaapi_display_lookup_config_surface_attributes (display,
+      config);
+  if (attribs)
+    return attribs;
+
   surface_attribs =
       get_surface_attributes (display, config, &num_surface_attribs);
   if (!surface_attribs)
@@ -203,6 +323,7 @@ gst_vaapi_config_surface_attributes_get (GstVaapiDisplay * display,
   }
 
   g_free (surface_attribs);
+  gst_vaapi_display_store_config_surface_attributes (display, config, attribs);
   return attribs;
 
   /* ERRORS */
@@ -214,6 +335,24 @@ error:
   }
 }
 
+GstVaapiConfigSurfaceAttributes *
+gst_vaapi_config_surface_attributes_copy (const GstVaapiConfigSurfaceAttributes
+    * attribs)
+{
+  GstVaapiConfigSurfaceAttributes *copy;
+
+  g_return_val_if_fail (attribs != NULL, NULL);
+
+  copy = g_slice_dup (GstVaapiConfigSurfaceAttributes, attribs);
+  if (attribs->formats) {
+    copy->formats = g_array_sized_new (FALSE, FALSE, sizeof (GstVideoFormat),
+        attribs->formats->len);
+    g_array_append_vals (copy->formats, attribs->formats->data,
+        attribs->formats->len);
+  }
+  return copy;
+}
+
 void
 gst_vaapi_config_surface_attributes_free (GstVaapiConfigSurfaceAttributes *
     attribs)
@@ -63,6 +63,10 @@ G_GNUC_INTERNAL
 GstVaapiConfigSurfaceAttributes *
 gst_vaapi_config_surface_attributes_get (GstVaapiDisplay * display, VAConfigID config);
 
+G_GNUC_INTERNAL
+GstVaapiConfigSurfaceAttributes *
+gst_vaapi_config_surface_attributes_copy (const GstVaapiConfigSurfaceAttributes * attribs);
+
 G_GNUC_INTERNAL
 void
 gst_vaapi_config_surface_attributes_free (GstVaapiConfigSurfaceAttributes * attribs);
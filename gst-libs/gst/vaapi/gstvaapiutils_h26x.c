@@ -23,6 +23,7 @@
  *  Boston, MA 02110-1301 USA
  */
 
+#include "sysdeps.h"
 #include "gstvaapiutils_h26x_priv.h"
 
 /* Write an unsigned integer Exp-Golomb-coded syntax element. i.e. ue(v) */
@@ -60,11 +61,20 @@ bs_write_se (GstBitWriter * bs, gint32 value)
   return TRUE;
 }
 
+/* Whether any of the bytes of @x is zero */
+#define HAS_ZERO_BYTE(x) \
+  (((x) - G_GUINT64_CONSTANT (0x0101010101010101)) & ~(x) & \
+   G_GUINT64_CONSTANT (0x8080808080808080))
+
 /* Copy from src to dst, applying emulation prevention bytes.
  *
  * This is copied from libavcodec written by Mark Thompson
  * <sw@jkqxz.net> from
  * http://git.videolan.org/?p=ffmpeg.git;a=commit;h=2c62fcdf5d617791a653d7957d449f75569eede0
+ *
+ * Runs of 8 bytes without any zero byte, outside of a zero run, are
+ * copied as is, since no emulation prevention byte can be inserted
+ * there.
  */
 static gboolean
 gst_vaapi_utils_h26x_nal_unit_to_byte_stream (guint8 * dst, guint * dst_len,
@@ -72,8 +82,22 @@ gst_vaapi_utils_h26x_nal_unit_to_byte_stream (guint8 * dst, guint * dst_len,
 {
   guint dp = 0, sp;
   guint zero_run = 0;
+  guint64 word;
 
   for (sp = 0; sp < src_len; sp++) {
+    while (zero_run == 0 && src_len - sp >= sizeof (word)) {
+      memcpy (&word, src + sp, sizeof (word));
+      if (HAS_ZERO_BYTE (word))
+        break;
+      if (*dst_len - dp < sizeof (word))
+        goto fail;
+      memcpy (dst + dp, &word, sizeof (word));
+      dp += sizeof (word);
+      sp += sizeof (word);
+    }
+    if (sp == src_len)
+      break;
+
     if (dp >= *dst_len)
       goto fail;
     if (zero_run < 2) {
@@ -117,31 +141,104 @@ gboolean
 gst_vaapi_utils_h26x_write_nal_unit (GstBitWriter * bs, guint8 * nal,
     guint nal_size)
 {
-  guint8 *byte_stream = NULL;
+  guint8 scratch[256];
+  guint8 *byte_stream;
   guint byte_stream_len;
 
+  /* Parameter sets fit on the stack */
   byte_stream_len = nal_size + 10;
-  byte_stream = g_malloc (byte_stream_len);
-
-  if (!byte_stream)
-    return FALSE;
+  if (byte_stream_len <= sizeof (scratch))
+    byte_stream = scratch;
+  else
+    byte_stream = g_malloc (byte_stream_len);
 
   if (!gst_vaapi_utils_h26x_nal_unit_to_byte_stream (byte_stream,
-          &byte_stream_len, nal, nal_size)) {
-    g_free (byte_stream);
-    return FALSE;
-  }
+          &byte_stream_len, nal, nal_size))
+    goto error;
 
   WRITE_UINT32 (bs, byte_stream_len, 16);
-  gst_bit_writer_put_bytes (bs, byte_stream, byte_stream_len);
-  g_free (byte_stream);
+  if (!gst_bit_writer_put_bytes (bs, byte_stream, byte_stream_len))
+    goto bs_error;
 
+  if (byte_stream != scratch)
+    g_free (byte_stream);
   return TRUE;
 
 bs_error:
   {
     GST_ERROR ("failed to write codec-data");
-    g_free (byte_stream);
+    goto error;
+  }
+error:
+  {
+    if (byte_stream != scratch)
+      g_free (byte_stream);
     return FALSE;
   }
 }
+
+/**
+ * gst_vaapi_utils_h26x_packed_header_cache_lookup:
+ * @cache: a #GstVaapiH26xPackedHeaderCache
+ * @key: the parameters the header is generated from
+ * @key_size: the size of @key, in bytes
+ * @data_size: (out): return location for the size of the header, in
+ *   bytes
+ *
+ * Looks up the packed header generated last time from the same @key.
+ *
+ * Returns: the cached header, or %NULL if @key changed
+ **/
+const guint8 *
+gst_vaapi_utils_h26x_packed_header_cache_lookup (GstVaapiH26xPackedHeaderCache
+    * cache, gconstpointer key, gsize key_size, guint * data_size)
+{
+  if (!cache->data || cache->key_size != key_size
+      || memcmp (cache->key, key, key_size) != 0)
+    return NULL;
+
+  *data_size = cache->data_size;
+  return cache->data;
+}
+
+/**
+ * gst_vaapi_utils_h26x_packed_header_cache_store:
+ * @cache: a #GstVaapiH26xPackedHeaderCache
+ * @key: the parameters the header was generated from
+ * @key_size: the size of @key, in bytes
+ * @data: the packed header
+ * @data_size: the size of @data, in bytes
+ *
+ * Replaces the header held by @cache with @data, generated from @key.
+ *
+ * Returns: the cached copy of @data
+ **/
+const guint8 *
+gst_vaapi_utils_h26x_packed_header_cache_store (GstVaapiH26xPackedHeaderCache
+    * cache, gconstpointer key, gsize key_size, const guint8 * data,
+    guint data_size)
+{
+  gst_vaapi_utils_h26x_packed_header_cache_clear (cache);
+
+  cache->key = g_memdup2 (key, key_size);
+  cache->key_size = key_size;
+  cache->data = g_memdup2 (data, data_size);
+  cache->data_size = data_size;
+  return cache->data;
+}
+
+/**
+ * gst_vaapi_utils_h26x_packed_header_cache_clear:
+ * @cache: a #GstVaapiH26xPackedHeaderCache
+ *
+ * Releases the header held by @cache.
+ **/
+void
+gst_vaapi_utils_h26x_packed_header_cache_clear (GstVaapiH26xPackedHeaderCache
+    * cache)
+{
+  g_clear_pointer (&cache->key, g_free);
+  g_clear_pointer (&cache->data, g_free);
+  cache->key_size = 0;
+  cache->data_size = 0;
+}
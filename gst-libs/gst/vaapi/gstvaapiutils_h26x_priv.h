@@ -82,6 +82,36 @@ G_GNUC_INTERNAL
 gboolean
 gst_vaapi_utils_h26x_write_nal_unit (GstBitWriter * bs, guint8 * nal, guint nal_size);
 
+/* ------------------------------------------------------------------------- */
+/* --- Packed Headers Cache                                              --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct _GstVaapiH26xPackedHeaderCache GstVaapiH26xPackedHeaderCache;
+
+/* A packed parameter set, reused as long as the parameters it was
+ * generated from do not change */
+struct _GstVaapiH26xPackedHeaderCache
+{
+  gpointer key;
+  gsize key_size;
+  guint8 *data;
+  guint data_size;
+};
+
+G_GNUC_INTERNAL
+const guint8 *
+gst_vaapi_utils_h26x_packed_header_cache_lookup (GstVaapiH26xPackedHeaderCache * cache,
+    gconstpointer key, gsize key_size, guint * data_size);
+
+G_GNUC_INTERNAL
+const guint8 *
+gst_vaapi_utils_h26x_packed_header_cache_store (GstVaapiH26xPackedHeaderCache * cache,
+    gconstpointer key, gsize key_size, const guint8 * data, guint data_size);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_utils_h26x_packed_header_cache_clear (GstVaapiH26xPackedHeaderCache * cache);
+
 G_END_DECLS
 
 #endif /* GST_VAAPI_UTILS_H26X_PRIV_H */
@@ -132,6 +132,29 @@ gst_vaapi_rotation_get_type (void)
   return g_type;
 }
 
+/* --- GstVaapiPresentMode --- */
+
+GType
+gst_vaapi_present_mode_get_type (void)
+{
+  static gsize g_type = 0;
+
+  static const GEnumValue present_modes[] = {
+    {GST_VAAPI_PRESENT_MODE_FIFO,
+        "Present every frame, waiting for the previous one", "fifo"},
+    {GST_VAAPI_PRESENT_MODE_MAILBOX,
+        "Present the latest frame, dropping the pending one", "mailbox"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&g_type)) {
+    GType type = g_enum_register_static ("GstVaapiPresentMode", present_modes);
+    gst_type_mark_as_plugin_api (type, 0);
+    g_once_init_leave (&g_type, type);
+  }
+  return g_type;
+}
+
 /* --- GstVaapiRateControl --- */
 
 GType
@@ -68,6 +68,15 @@ G_BEGIN_DECLS
  */
 #define GST_VAAPI_TYPE_ROTATION gst_vaapi_rotation_get_type()
 
+/**
+ * GST_VAAPI_TYPE_PRESENT_MODE:
+ *
+ * A type that represents the window presentation mode.
+ *
+ * Return value: the #GType of GstVaapiPresentMode
+ */
+#define GST_VAAPI_TYPE_PRESENT_MODE gst_vaapi_present_mode_get_type()
+
 /**
  * GST_VAAPI_TYPE_RATE_CONTROL:
  *
@@ -89,6 +98,9 @@ gst_vaapi_render_mode_get_type(void) G_GNUC_CONST;
 GType
 gst_vaapi_rotation_get_type(void) G_GNUC_CONST;
 
+GType
+gst_vaapi_present_mode_get_type(void) G_GNUC_CONST;
+
 GType
 gst_vaapi_rate_control_get_type(void) G_GNUC_CONST;
 
@@ -49,26 +49,95 @@ gst_vaapi_video_pool_alloc_object (GstVaapiVideoPool * pool)
   return GST_VAAPI_VIDEO_POOL_GET_CLASS (pool)->alloc_object (pool);
 }
 
+/* Registers a new object into the pool, which takes ownership of it.
+   The slot is neither free nor used yet */
+static guint
+gst_vaapi_video_pool_add_slot_unlocked (GstVaapiVideoPool * pool,
+    gpointer object)
+{
+  const guint slot = pool->objects->len;
+
+  if (slot >= pool->free_size) {
+    const guint size = MAX (16, 2 * pool->free_size);
+    guint *const free_slots = g_new (guint, size);
+    guint i;
+
+    /* Linearize the ring buffer of free slots */
+    for (i = 0; i < pool->free_count; i++)
+      free_slots[i] =
+          pool->free_slots[(pool->free_head + i) % pool->free_size];
+    g_free (pool->free_slots);
+    pool->free_slots = free_slots;
+    pool->free_head = 0;
+
+    pool->used_slots = g_renew (guint8, pool->used_slots, size);
+    memset (pool->used_slots + pool->free_size, 0, size - pool->free_size);
+    pool->free_size = size;
+  }
+
+  g_ptr_array_add (pool->objects, object);
+  g_hash_table_insert (pool->object_slots, object, GUINT_TO_POINTER (slot + 1));
+  return slot;
+}
+
+/* Queues the slot at the tail of the free slots. There are at least
+   as many entries in the ring buffer as objects in the pool, so this
+   never overflows */
+static inline void
+gst_vaapi_video_pool_push_free_slot_unlocked (GstVaapiVideoPool * pool,
+    guint slot)
+{
+  pool->free_slots[(pool->free_head + pool->free_count) % pool->free_size] =
+      slot;
+  pool->free_count++;
+  pool->used_slots[slot] = FALSE;
+}
+
+/* Dequeues the slot at the head of the free slots */
+static inline gboolean
+gst_vaapi_video_pool_pop_free_slot_unlocked (GstVaapiVideoPool * pool,
+    guint * slot_ptr)
+{
+  guint slot;
+
+  if (!pool->free_count)
+    return FALSE;
+
+  slot = pool->free_slots[pool->free_head];
+  pool->free_head = (pool->free_head + 1) % pool->free_size;
+  pool->free_count--;
+  pool->used_slots[slot] = TRUE;
+  *slot_ptr = slot;
+  return TRUE;
+}
+
 void
 gst_vaapi_video_pool_init (GstVaapiVideoPool * pool, GstVaapiDisplay * display,
     GstVaapiVideoPoolObjectType object_type)
 {
   pool->object_type = object_type;
   pool->display = gst_object_ref (display);
-  pool->used_objects = NULL;
+  pool->objects =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_mini_object_unref);
+  pool->object_slots = g_hash_table_new (g_direct_hash, g_direct_equal);
+  pool->used_slots = NULL;
+  pool->free_slots = NULL;
+  pool->free_head = 0;
+  pool->free_count = 0;
+  pool->free_size = 0;
   pool->used_count = 0;
   pool->capacity = 0;
 
-  g_queue_init (&pool->free_objects);
   g_mutex_init (&pool->mutex);
 }
 
 void
 gst_vaapi_video_pool_finalize (GstVaapiVideoPool * pool)
 {
-  g_list_free_full (pool->used_objects, (GDestroyNotify) gst_mini_object_unref);
-  g_queue_foreach (&pool->free_objects, (GFunc) gst_mini_object_unref, NULL);
-  g_queue_clear (&pool->free_objects);
+  g_hash_table_unref (pool->object_slots);
+  g_ptr_array_unref (pool->objects);
+  g_free (pool->used_slots);
+  g_free (pool->free_slots);
   gst_vaapi_display_replace (&pool->display, NULL);
   g_mutex_clear (&pool->mutex);
 }
@@ -167,12 +236,14 @@ static gpointer
 gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
 {
   gpointer object;
+  guint slot;
 
   if (pool->capacity && pool->used_count >= pool->capacity)
     return NULL;
 
-  object = g_queue_pop_head (&pool->free_objects);
-  if (!object) {
+  if (gst_vaapi_video_pool_pop_free_slot_unlocked (pool, &slot))
+    object = g_ptr_array_index (pool->objects, slot);
+  else {
     g_mutex_unlock (&pool->mutex);
     object = gst_vaapi_video_pool_alloc_object (pool);
     g_mutex_lock (&pool->mutex);
@@ -185,10 +256,12 @@ gst_vaapi_video_pool_get_object_unlocked (GstVaapiVideoPool * pool)
       gst_mini_object_unref (object);
       return NULL;
     }
+
+    slot = gst_vaapi_video_pool_add_slot_unlocked (pool, object);
+    pool->used_slots[slot] = TRUE;
   }
 
   ++pool->used_count;
-  pool->used_objects = g_list_prepend (pool->used_objects, object);
   return gst_mini_object_ref (object);
 }
 
@@ -219,16 +292,15 @@ static void
 gst_vaapi_video_pool_put_object_unlocked (GstVaapiVideoPool * pool,
     gpointer object)
 {
-  GList *elem;
+  guint slot;
 
-  elem = g_list_find (pool->used_objects, object);
-  if (!elem)
+  slot = GPOINTER_TO_UINT (g_hash_table_lookup (pool->object_slots, object));
+  if (!slot || !pool->used_slots[--slot])
     return;
 
   gst_mini_object_unref (object);
   --pool->used_count;
-  pool->used_objects = g_list_delete_link (pool->used_objects, elem);
-  g_queue_push_tail (&pool->free_objects, object);
+  gst_vaapi_video_pool_push_free_slot_unlocked (pool, slot);
 }
 
 void
@@ -257,7 +329,15 @@ static inline gboolean
 gst_vaapi_video_pool_add_object_unlocked (GstVaapiVideoPool * pool,
     gpointer object)
 {
-  g_queue_push_tail (&pool->free_objects, gst_mini_object_ref (object));
+  guint slot;
+
+  /* The object is already owned by the pool */
+  if (g_hash_table_contains (pool->object_slots, object))
+    return TRUE;
+
+  slot = gst_vaapi_video_pool_add_slot_unlocked (pool,
+      gst_mini_object_ref (object));
+  gst_vaapi_video_pool_push_free_slot_unlocked (pool, slot);
   return TRUE;
 }
 
@@ -329,7 +409,7 @@ gst_vaapi_video_pool_get_size (GstVaapiVideoPool * pool)
   g_return_val_if_fail (pool != NULL, 0);
 
   g_mutex_lock (&pool->mutex);
-  size = g_queue_get_length (&pool->free_objects);
+  size = pool->free_count;
   g_mutex_unlock (&pool->mutex);
   return size;
 }
@@ -339,7 +419,7 @@ gst_vaapi_video_pool_reserve_unlocked (GstVaapiVideoPool * pool, guint n)
 {
   guint i, num_allocated;
 
-  num_allocated = g_queue_get_length (&pool->free_objects) + pool->used_count;
+  num_allocated = pool->objects->len;
   if (n <= num_allocated)
     return TRUE;
 
@@ -352,7 +432,8 @@ gst_vaapi_video_pool_reserve_unlocked (GstVaapiVideoPool * pool, guint n)
     g_mutex_lock (&pool->mutex);
     if (!object)
       return FALSE;
-    g_queue_push_tail (&pool->free_objects, object);
+    gst_vaapi_video_pool_push_free_slot_unlocked (pool,
+        gst_vaapi_video_pool_add_slot_unlocked (pool, object));
   }
   return TRUE;
 }
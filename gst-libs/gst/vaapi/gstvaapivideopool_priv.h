@@ -40,6 +40,11 @@ typedef struct _GstVaapiVideoPoolClass GstVaapiVideoPoolClass;
  * GstVaapiVideoPool:
  *
  * A pool of lazily allocated video objects. e.g. surfaces, images.
+ *
+ * Every object owned by the pool is assigned a slot index. Free
+ * slots are queued in a ring buffer and looked up by object through
+ * a hash table, so that getting or putting back an object is O(1)
+ * regardless of the pool size.
  */
 struct _GstVaapiVideoPool
 {
@@ -48,8 +53,13 @@ struct _GstVaapiVideoPool
 
   guint object_type;
   GstVaapiDisplay *display;
-  GQueue free_objects;
-  GList *used_objects;
+  GPtrArray *objects;           /* all objects owned by the pool */
+  GHashTable *object_slots;     /* object -> slot index + 1 */
+  guint8 *used_slots;           /* per-slot in-use flag */
+  guint *free_slots;            /* ring buffer of free slot indices */
+  guint free_head;
+  guint free_count;
+  guint free_size;
   guint used_count;
   guint capacity;
   GMutex mutex;
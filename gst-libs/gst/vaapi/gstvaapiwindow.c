@@ -662,6 +662,63 @@ gst_vaapi_window_reconfigure (GstVaapiWindow * window)
   gst_vaapi_window_ensure_size (window);
 }
 
+/**
+ * gst_vaapi_window_get_present_mode:
+ * @window: a #GstVaapiWindow
+ *
+ * Retrieves how the surfaces rendered into @window are presented.
+ *
+ * Return value: the #GstVaapiPresentMode of @window
+ */
+GstVaapiPresentMode
+gst_vaapi_window_get_present_mode (GstVaapiWindow * window)
+{
+  g_return_val_if_fail (GST_VAAPI_IS_WINDOW (window),
+      GST_VAAPI_PRESENT_MODE_FIFO);
+
+  return window->present_mode;
+}
+
+/**
+ * gst_vaapi_window_set_present_mode:
+ * @window: a #GstVaapiWindow
+ * @mode: the #GstVaapiPresentMode
+ *
+ * Selects how the surfaces rendered into @window are presented. With
+ * %GST_VAAPI_PRESENT_MODE_MAILBOX, gst_vaapi_window_put_surface() does
+ * not wait for the previous surface to be presented, which is dropped
+ * if it was not presented yet.
+ */
+void
+gst_vaapi_window_set_present_mode (GstVaapiWindow * window,
+    GstVaapiPresentMode mode)
+{
+  g_return_if_fail (GST_VAAPI_IS_WINDOW (window));
+
+  if (window->present_mode != mode)
+    GST_DEBUG ("present mode %d", mode);
+  window->present_mode = mode;
+}
+
+/**
+ * gst_vaapi_window_get_dropped_frames:
+ * @window: a #GstVaapiWindow
+ *
+ * Retrieves the number of surfaces rendered into @window which were
+ * replaced by a newer one before being presented, in
+ * %GST_VAAPI_PRESENT_MODE_MAILBOX mode. The X11 windows put every
+ * surface, so they never drop any.
+ *
+ * Return value: the number of dropped frames
+ */
+guint
+gst_vaapi_window_get_dropped_frames (GstVaapiWindow * window)
+{
+  g_return_val_if_fail (GST_VAAPI_IS_WINDOW (window), 0);
+
+  return g_atomic_int_get (&window->dropped_frames);
+}
+
 /**
  * gst_vaapi_window_unblock:
  * @window: a #GstVaapiWindow
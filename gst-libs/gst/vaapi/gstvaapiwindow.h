@@ -97,6 +97,16 @@ gst_vaapi_window_put_surface (GstVaapiWindow * window,
 void
 gst_vaapi_window_reconfigure (GstVaapiWindow * window);
 
+GstVaapiPresentMode
+gst_vaapi_window_get_present_mode (GstVaapiWindow * window);
+
+void
+gst_vaapi_window_set_present_mode (GstVaapiWindow * window,
+    GstVaapiPresentMode mode);
+
+guint
+gst_vaapi_window_get_dropped_frames (GstVaapiWindow * window);
+
 gboolean
 gst_vaapi_window_unblock (GstVaapiWindow * window);
 
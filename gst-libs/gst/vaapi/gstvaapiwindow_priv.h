@@ -81,6 +81,8 @@ struct _GstVaapiWindow
   guint use_foreign_window:1;
   guint is_fullscreen:1;
   guint check_geometry:1;
+  GstVaapiPresentMode present_mode;
+  guint dropped_frames;
 
   /* for conversion */
   GstVideoFormat surface_pool_format;
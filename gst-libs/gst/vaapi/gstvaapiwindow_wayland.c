@@ -34,6 +34,7 @@
 #include "gstvaapidisplay_wayland.h"
 #include "gstvaapidisplay_wayland_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapifilter.h"
 #include "gstvaapisurfacepool.h"
 
@@ -55,6 +56,7 @@ GST_DEBUG_CATEGORY_EXTERN (gst_debug_vaapi);
 typedef struct _GstVaapiWindowWaylandPrivate GstVaapiWindowWaylandPrivate;
 typedef struct _GstVaapiWindowWaylandClass GstVaapiWindowWaylandClass;
 typedef struct _FrameState FrameState;
+typedef struct _CachedBuffer CachedBuffer;
 
 struct _FrameState
 {
@@ -62,10 +64,27 @@ struct _FrameState
   GstVaapiSurface *surface;
   GstVaapiVideoPool *surface_pool;
   struct wl_buffer *buffer;
+  CachedBuffer *cached;
   struct wl_callback *callback;
   gboolean done;
 };
 
+/* A dmabuf wl_buffer kept alive across frames for a given VA surface,
+ * so that the surface is neither exported nor imported again by the
+ * compositor each time it is rendered */
+struct _CachedBuffer
+{
+  GstVaapiWindow *window;
+  GstVaapiSurface *surface;
+  GstVaapiID surface_id;
+  GstVideoFormat format;
+  guint width;
+  guint height;
+  struct wl_buffer *buffer;
+  FrameState *frame;            /* the frame the compositor holds it for */
+  gboolean orphaned;            /* to be destroyed once released */
+};
+
 static FrameState *
 frame_state_new (GstVaapiWindow * window)
 {
@@ -78,6 +97,7 @@ frame_state_new (GstVaapiWindow * window)
   frame->window = window;
   frame->surface = NULL;
   frame->surface_pool = NULL;
+  frame->cached = NULL;
   frame->callback = NULL;
   frame->done = FALSE;
   return frame;
@@ -104,6 +124,10 @@ struct _GstVaapiWindowWaylandPrivate
   gboolean dmabuf_broken;
   GMutex opaque_mutex;
   gint opaque_width, opaque_height;
+
+  /* GstVaapiSurface -> CachedBuffer */
+  GMutex buffers_lock;
+  GHashTable *buffers;
 };
 
 /**
@@ -140,10 +164,52 @@ enum
 
 static guint signals[N_SIGNALS];
 
+static void
+cached_buffer_free (CachedBuffer * cached)
+{
+  wl_buffer_destroy (cached->buffer);
+  g_slice_free (CachedBuffer, cached);
+}
+
+/* Drops @cached from the cache. The caller holds the buffers lock.
+ * Returns @cached if it can be freed right away, or NULL if the
+ * compositor still holds the buffer. */
+static CachedBuffer *
+cached_buffer_invalidate (CachedBuffer * cached)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (cached->window);
+
+  g_hash_table_remove (priv->buffers, cached->surface);
+  cached->surface = NULL;
+
+  if (cached->frame) {
+    cached->orphaned = TRUE;
+    return NULL;
+  }
+  return cached;
+}
+
+static void
+cached_buffer_surface_destroyed (gpointer data, GstMiniObject * surface)
+{
+  CachedBuffer *cached = data;
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (cached->window);
+
+  g_mutex_lock (&priv->buffers_lock);
+  cached = cached_buffer_invalidate (cached);
+  g_mutex_unlock (&priv->buffers_lock);
+
+  if (cached)
+    cached_buffer_free (cached);
+}
+
 static void
 frame_state_free (FrameState * frame)
 {
   GstVaapiWindowWaylandPrivate *priv;
+  CachedBuffer *cached = NULL;
 
   if (!frame)
     return;
@@ -159,7 +225,17 @@ frame_state_free (FrameState * frame)
   gst_vaapi_video_pool_replace (&frame->surface_pool, NULL);
 
   g_clear_pointer (&frame->callback, wl_callback_destroy);
-  wl_buffer_destroy (frame->buffer);
+  if (frame->cached) {
+    g_mutex_lock (&priv->buffers_lock);
+    frame->cached->frame = NULL;
+    if (frame->cached->orphaned)
+      cached = frame->cached;
+    g_mutex_unlock (&priv->buffers_lock);
+    if (cached)
+      cached_buffer_free (cached);
+  } else {
+    wl_buffer_destroy (frame->buffer);
+  }
   g_slice_free (FrameState, frame);
 }
 
@@ -313,6 +389,77 @@ error:
   }
 }
 
+/* Dispatches the pending events without waiting for any */
+static gboolean
+gst_vaapi_window_wayland_dispatch (GstVaapiWindow * window)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+  struct wl_display *const wl_display =
+      GST_VAAPI_WINDOW_NATIVE_DISPLAY (window);
+  gint ret;
+
+  if (priv->sync_failed)
+    return FALSE;
+
+  if (priv->pollfd.fd < 0) {
+    priv->pollfd.fd = wl_display_get_fd (wl_display);
+    gst_poll_add_fd (priv->poll, &priv->pollfd);
+    gst_poll_fd_ctl_read (priv->poll, &priv->pollfd, TRUE);
+  }
+
+  while (wl_display_prepare_read_queue (wl_display, priv->event_queue) < 0) {
+    if (wl_display_dispatch_queue_pending (wl_display, priv->event_queue) < 0)
+      goto error;
+  }
+
+  if (wl_display_flush (wl_display) < 0 && errno != EAGAIN) {
+    wl_display_cancel_read (wl_display);
+    goto error;
+  }
+
+  ret = gst_poll_wait (priv->poll, 0);
+  if (ret > 0) {
+    if (wl_display_read_events (wl_display) < 0)
+      goto error;
+  } else {
+    wl_display_cancel_read (wl_display);
+    if (ret < 0 && errno == EBUSY)      /* flushing */
+      return FALSE;
+  }
+
+  if (wl_display_dispatch_queue_pending (wl_display, priv->event_queue) < 0)
+    goto error;
+  return TRUE;
+
+  /* ERRORS */
+error:
+  {
+    priv->sync_failed = TRUE;
+    GST_ERROR ("Error on dispatching events: %s", g_strerror (errno));
+    return FALSE;
+  }
+}
+
+/* Drops the last frame if the compositor did not present it yet, so
+ * that the next frame replaces it instead of waiting for it */
+static void
+gst_vaapi_window_wayland_drop_pending_frame (GstVaapiWindow * window)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+  FrameState *const frame = g_atomic_pointer_get (&priv->last_frame);
+
+  if (!frame)
+    return;
+
+  if (g_atomic_pointer_compare_and_exchange (&priv->last_frame, frame, NULL)) {
+    g_atomic_int_dec_and_test (&priv->num_frames_pending);
+    g_atomic_int_inc (&window->dropped_frames);
+    GST_LOG ("replacing a frame not presented yet");
+  }
+}
+
 static void
 handle_ping (void *data, struct wl_shell_surface *wl_shell_surface,
     uint32_t serial)
@@ -492,6 +639,9 @@ gst_vaapi_window_wayland_finalize (GObject * object)
       GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
   struct wl_display *const wl_display =
       GST_VAAPI_WINDOW_NATIVE_DISPLAY (window);
+  GHashTableIter iter;
+  CachedBuffer *cached;
+  GSList *stale = NULL;
 
   /* Make sure that the last wl buffer's callback could be called */
   GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
@@ -510,6 +660,24 @@ gst_vaapi_window_wayland_finalize (GObject * object)
   while (priv->frames)
     frame_state_free ((FrameState *) priv->frames->data);
 
+  /* Detach all the cached buffers from the cache and from their
+     surfaces at once, so that a surface destroyed meanwhile cannot
+     find any of them, then release them */
+  g_mutex_lock (&priv->buffers_lock);
+  g_hash_table_iter_init (&iter, priv->buffers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & cached)) {
+    g_hash_table_iter_steal (&iter);
+    gst_mini_object_weak_unref (GST_MINI_OBJECT_CAST (cached->surface),
+        cached_buffer_surface_destroyed, cached);
+    cached->surface = NULL;
+    stale = g_slist_prepend (stale, cached);
+  }
+  g_clear_pointer (&priv->buffers, g_hash_table_unref);
+  g_mutex_unlock (&priv->buffers_lock);
+  g_mutex_clear (&priv->buffers_lock);
+
+  g_slist_free_full (stale, (GDestroyNotify) cached_buffer_free);
+
   g_clear_pointer (&priv->xdg_surface, xdg_surface_destroy);
   g_clear_pointer (&priv->wl_shell_surface, wl_shell_surface_destroy);
   g_clear_pointer (&priv->video_subsurface, wl_subsurface_destroy);
@@ -599,6 +767,94 @@ static const struct wl_buffer_listener frame_buffer_listener = {
   frame_release_callback
 };
 
+static void
+cached_buffer_release_callback (void *data, struct wl_buffer *wl_buffer)
+{
+  CachedBuffer *const cached = data;
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (cached->window);
+  FrameState *frame;
+
+  g_mutex_lock (&priv->buffers_lock);
+  frame = cached->frame;
+  g_mutex_unlock (&priv->buffers_lock);
+
+  if (frame)
+    frame_release_callback (frame, wl_buffer);
+}
+
+static const struct wl_buffer_listener cached_buffer_listener = {
+  cached_buffer_release_callback
+};
+
+/* Looks up the wl_buffer created the last time @surface was rendered.
+ * Returns NULL if there is none, if it does not match the current
+ * rendering parameters anymore, or if the compositor still holds it */
+static CachedBuffer *
+cached_buffer_lookup (GstVaapiWindow * window, GstVaapiSurface * surface)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+  CachedBuffer *cached, *stale = NULL;
+
+  g_mutex_lock (&priv->buffers_lock);
+  cached = g_hash_table_lookup (priv->buffers, surface);
+  if (cached && (cached->surface_id != GST_VAAPI_SURFACE_ID (surface)
+          || cached->format != gst_vaapi_surface_get_format (surface)
+          || cached->width != window->width
+          || cached->height != window->height)) {
+    gst_mini_object_weak_unref (GST_MINI_OBJECT_CAST (surface),
+        cached_buffer_surface_destroyed, cached);
+    stale = cached_buffer_invalidate (cached);
+    cached = NULL;
+  }
+  if (cached && cached->frame)
+    cached = NULL;
+  g_mutex_unlock (&priv->buffers_lock);
+
+  if (stale)
+    cached_buffer_free (stale);
+  return cached;
+}
+
+/* Keeps @buffer around for the next time @surface is rendered. Returns
+ * NULL if @surface already has a cached buffer, still in use by the
+ * compositor, in which case @buffer is only used for this frame */
+static CachedBuffer *
+cached_buffer_insert (GstVaapiWindow * window, GstVaapiSurface * surface,
+    struct wl_buffer *buffer)
+{
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+  CachedBuffer *cached = NULL;
+
+  g_mutex_lock (&priv->buffers_lock);
+  if (g_hash_table_contains (priv->buffers, surface))
+    goto bail;
+
+  cached = g_slice_new (CachedBuffer);
+  cached->window = window;
+  cached->surface = surface;
+  cached->surface_id = GST_VAAPI_SURFACE_ID (surface);
+  cached->format = gst_vaapi_surface_get_format (surface);
+  cached->width = window->width;
+  cached->height = window->height;
+  cached->buffer = buffer;
+  cached->frame = NULL;
+  cached->orphaned = FALSE;
+
+  wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
+  wl_buffer_add_listener (buffer, &cached_buffer_listener, cached);
+
+  g_hash_table_insert (priv->buffers, surface, cached);
+  gst_mini_object_weak_ref (GST_MINI_OBJECT_CAST (surface),
+      cached_buffer_surface_destroyed, cached);
+
+bail:
+  g_mutex_unlock (&priv->buffers_lock);
+  return cached;
+}
+
 typedef enum
 {
   GST_VAAPI_DMABUF_SUCCESS,
@@ -610,8 +866,6 @@ typedef enum
 
 } GstVaapiDmabufStatus;
 
-#define DRM_FORMAT_MOD_INVALID 0xffffffffffffff
-
 static GstVaapiDmabufStatus
 dmabuf_format_supported (GstVaapiDisplayWaylandPrivate * const priv_display,
     guint format, guint64 modifier)
@@ -705,6 +959,7 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
   VAStatus status;
   GstVaapiDmabufStatus ret;
   guint format, i, j, plane = 0;
+  gint64 profile_start;
 
   if (!priv_display->dmabuf)
     return GST_VAAPI_DMABUF_NOT_SUPPORTED;
@@ -712,16 +967,23 @@ dmabuf_buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface * surface,
   if ((va_flags & (VA_TOP_FIELD | VA_BOTTOM_FIELD)) != VA_FRAME_PICTURE)
     return GST_VAAPI_DMABUF_BAD_FLAGS;
 
-  GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
+  GST_VAAPI_DISPLAY_VA_LOCK (display);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
       GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
       VA_EXPORT_SURFACE_SEPARATE_LAYERS | VA_EXPORT_SURFACE_READ_ONLY, &desc);
+  gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+      GST_VAAPI_PROFILER_EXPORT_SURFACE_HANDLE, profile_start);
   /* Try again with composed layers, in case the format is supported there */
-  if (status == VA_STATUS_ERROR_INVALID_SURFACE)
+  if (status == VA_STATUS_ERROR_INVALID_SURFACE) {
+    profile_start = gst_vaapi_profiler_begin ();
     status = vaExportSurfaceHandle (GST_VAAPI_DISPLAY_VADISPLAY (display),
         GST_VAAPI_SURFACE_ID (surface), VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
         VA_EXPORT_SURFACE_COMPOSED_LAYERS | VA_EXPORT_SURFACE_READ_ONLY, &desc);
-  GST_VAAPI_WINDOW_UNLOCK_DISPLAY (window);
+    gst_vaapi_profiler_end (GST_VAAPI_DISPLAY_VADISPLAY (display),
+        GST_VAAPI_PROFILER_EXPORT_SURFACE_HANDLE, profile_start);
+  }
+  GST_VAAPI_DISPLAY_VA_UNLOCK (display);
 
   if (!vaapi_check_status (status, "vaExportSurfaceHandle()")) {
     if (status == VA_STATUS_ERROR_UNIMPLEMENTED)
@@ -772,7 +1034,7 @@ out:
 static gboolean
 buffer_from_surface (GstVaapiWindow * window, GstVaapiSurface ** surf,
     const GstVaapiRectangle * src_rect, const GstVaapiRectangle * dst_rect,
-    guint flags, struct wl_buffer **buffer)
+    guint flags, struct wl_buffer **buffer, CachedBuffer ** cached)
 {
   GstVaapiDisplay *const display = GST_VAAPI_WINDOW_DISPLAY (window);
   GstVaapiWindowWaylandPrivate *const priv =
@@ -816,10 +1078,21 @@ again:
       va_flags = VA_FRAME_PICTURE;
     }
   }
+  *cached = NULL;
+  if (!priv->dmabuf_broken && va_flags == VA_FRAME_PICTURE) {
+    *cached = cached_buffer_lookup (window, surface);
+    if (*cached) {
+      GST_LOG ("reusing wl_buffer of surface %" GST_VAAPI_ID_FORMAT,
+          GST_VAAPI_ID_ARGS (GST_VAAPI_SURFACE_ID (surface)));
+      *buffer = (*cached)->buffer;
+      goto out;
+    }
+  }
   if (!priv->dmabuf_broken) {
     ret = dmabuf_buffer_from_surface (window, surface, va_flags, buffer);
     switch (ret) {
       case GST_VAAPI_DMABUF_SUCCESS:
+        *cached = cached_buffer_insert (window, surface, *buffer);
         goto out;
       case GST_VAAPI_DMABUF_BAD_FLAGS:
         /* FIXME: how should this be handed? */
@@ -903,9 +1176,10 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
   struct wl_display *const wl_display =
       GST_VAAPI_WINDOW_NATIVE_DISPLAY (window);
   struct wl_buffer *buffer;
+  CachedBuffer *cached;
   FrameState *frame;
   guint width, height;
-  gboolean ret;
+  gboolean ret, ready;
 
   /* Skip rendering without valid window size. This can happen with a foreign
      window if the render rectangle is not yet set. */
@@ -931,7 +1205,7 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
     priv->need_vpp = TRUE;
 
   ret = buffer_from_surface (window, &surface, src_rect, dst_rect, flags,
-      &buffer);
+      &buffer, &cached);
   if (!ret)
     return FALSE;
 
@@ -941,12 +1215,23 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
     height = window->height;
   }
 
-  /* Wait for the previous frame to complete redraw */
-  if (!gst_vaapi_window_wayland_sync (window)) {
+  /* Wait for the previous frame to complete redraw, unless the new
+     frame is to replace it. The initial configure has to be acked
+     before anything is attached though */
+  if (window->present_mode == GST_VAAPI_PRESENT_MODE_MAILBOX
+      && !g_atomic_int_get (&priv->configure_pending)) {
+    ready = gst_vaapi_window_wayland_dispatch (window);
+    if (ready)
+      gst_vaapi_window_wayland_drop_pending_frame (window);
+  } else {
+    ready = gst_vaapi_window_wayland_sync (window);
+  }
+  if (!ready) {
     /* Release vpp surface if exists */
     if (priv->need_vpp && window->has_vpp)
       gst_vaapi_video_pool_put_object (window->surface_pool, surface);
-    wl_buffer_destroy (buffer);
+    if (!cached)
+      wl_buffer_destroy (buffer);
     return !priv->sync_failed;
   }
 
@@ -978,8 +1263,15 @@ gst_vaapi_window_wayland_render (GstVaapiWindow * window,
   }
   g_mutex_unlock (&priv->opaque_mutex);
 
-  wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
-  wl_buffer_add_listener (buffer, &frame_buffer_listener, frame);
+  if (cached) {
+    g_mutex_lock (&priv->buffers_lock);
+    cached->frame = frame;
+    g_mutex_unlock (&priv->buffers_lock);
+    frame->cached = cached;
+  } else {
+    wl_proxy_set_queue ((struct wl_proxy *) buffer, priv->event_queue);
+    wl_buffer_add_listener (buffer, &frame_buffer_listener, frame);
+  }
 
   frame->buffer = buffer;
   frame->callback = wl_surface_frame (priv->surface);
@@ -1040,6 +1332,11 @@ gst_vaapi_window_wayland_class_init (GstVaapiWindowWaylandClass * klass)
 static void
 gst_vaapi_window_wayland_init (GstVaapiWindowWayland * window)
 {
+  GstVaapiWindowWaylandPrivate *const priv =
+      GST_VAAPI_WINDOW_WAYLAND_GET_PRIVATE (window);
+
+  g_mutex_init (&priv->buffers_lock);
+  priv->buffers = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 /**
@@ -36,6 +36,7 @@
 #include "gstvaapidisplay_x11_priv.h"
 #include "gstvaapisurface_priv.h"
 #include "gstvaapiutils.h"
+#include "gstvaapiprofiler.h"
 #include "gstvaapiutils_x11.h"
 
 GST_DEBUG_CATEGORY_EXTERN (gst_debug_vaapi_window);
@@ -285,6 +286,15 @@ gst_vaapi_window_x11_finalize (GObject * object)
   GstVaapiWindow *window = GST_VAAPI_WINDOW (object);
   Display *const dpy = GST_VAAPI_WINDOW_NATIVE_DISPLAY (window);
   const Window xid = GST_VAAPI_WINDOW_ID (window);
+  GstVaapiWindowX11Private *const priv =
+      GST_VAAPI_WINDOW_X11_GET_PRIVATE (window);
+
+  if (priv->pending_surface) {
+    gst_vaapi_video_pool_put_object (priv->pending_surface_pool,
+        priv->pending_surface);
+    priv->pending_surface = NULL;
+  }
+  gst_vaapi_video_pool_replace (&priv->pending_surface_pool, NULL);
 
   if (xid) {
     if (!window->use_foreign_window) {
@@ -400,8 +410,10 @@ gst_vaapi_window_x11_put_surface (GstVaapiWindow * window,
     const GstVaapiRectangle * dst_rect, guint flags)
 {
   VAStatus status;
+  gint64 profile_start;
 
   GST_VAAPI_WINDOW_LOCK_DISPLAY (window);
+  profile_start = gst_vaapi_profiler_begin ();
   status = vaPutSurface (GST_VAAPI_WINDOW_VADISPLAY (window),
       surface_id,
       GST_VAAPI_WINDOW_ID (window),
@@ -414,12 +426,38 @@ gst_vaapi_window_x11_put_surface (GstVaapiWindow * window,
       dst_rect->width,
       dst_rect->height, NULL, 0, from_GstVaapiSurfaceRenderFlags (flags)
       );
+  gst_vaapi_profiler_end (GST_VAAPI_WINDOW_VADISPLAY (window),
+      GST_VAAPI_PROFILER_PUT_SURFACE, profile_start);
 
   GST_VAAPI_WINDOW_UNLOCK_DISPLAY (window);
 
   return status;
 }
 
+/* Releases the VPP surface put by the previous frame in mailbox mode.
+ * It was already handed to vaPutSurface(), which presents it once it
+ * is rendered, hence it is never counted as a dropped frame: no frame
+ * is replaced before being rendered on X11 */
+static void
+gst_vaapi_window_x11_release_pending_surface (GstVaapiWindow * window)
+{
+  GstVaapiWindowX11Private *const priv =
+      GST_VAAPI_WINDOW_X11_GET_PRIVATE (window);
+  GstVaapiSurfaceStatus status;
+
+  if (!priv->pending_surface)
+    return;
+
+  if (gst_vaapi_surface_query_status (priv->pending_surface, &status)
+      && (status & GST_VAAPI_SURFACE_STATUS_RENDERING))
+    GST_LOG ("releasing a frame still being rendered");
+
+  gst_vaapi_video_pool_put_object (priv->pending_surface_pool,
+      priv->pending_surface);
+  priv->pending_surface = NULL;
+  gst_vaapi_video_pool_replace (&priv->pending_surface_pool, NULL);
+}
+
 static gboolean
 gst_vaapi_window_x11_render (GstVaapiWindow * window,
     GstVaapiSurface * surface,
@@ -436,6 +474,8 @@ gst_vaapi_window_x11_render (GstVaapiWindow * window,
   if (surface_id == VA_INVALID_ID)
     return FALSE;
 
+  gst_vaapi_window_x11_release_pending_surface (window);
+
   if (window->has_vpp && priv->need_vpp)
     goto conversion;
 
@@ -470,6 +510,15 @@ conversion:
 
       ret = vaapi_check_status (status, "vaPutSurface()");
 
+      /* In mailbox mode, keep the VPP surface out of the pool until
+         the next frame instead of waiting for it to be presented */
+      if (ret && window->present_mode == GST_VAAPI_PRESENT_MODE_MAILBOX) {
+        priv->pending_surface = vpp_surface;
+        gst_vaapi_video_pool_replace (&priv->pending_surface_pool,
+            window->surface_pool);
+        return ret;
+      }
+
       if (!gst_vaapi_surface_sync (vpp_surface)) {
         GST_WARNING ("failed to render surface");
         ret = FALSE;
@@ -50,6 +50,9 @@ struct _GstVaapiWindowX11Private
   guint is_mapped:1;
   guint fullscreen_on_map:1;
   gboolean need_vpp;
+  /* The VPP surface last put, in mailbox mode, and its pool */
+  GstVaapiSurface *pending_surface;
+  GstVaapiVideoPool *pending_surface_pool;
 };
 
 /**
@@ -25,6 +25,7 @@
 #include "gstcompat.h"
 #include <gst/vaapi/gstvaapidisplay.h>
 #include <gst/vaapi/gstvaapiprofilecaps.h>
+#include <gst/vaapi/gstvaapitrace.h>
 
 #include "gstvaapidecode.h"
 #include "gstvaapidecode_props.h"
@@ -437,8 +438,12 @@ gst_vaapidecode_update_src_caps (GstVaapiDecode * decode)
   /* For parsing/preparation purposes we'd need at least 1 frame
    * latency in general, with perfectly known unit boundaries (NALU,
    * AU), and up to 2 frames when we need to wait for the second frame
-   * start to determine the first frame is complete */
-  latency = gst_util_uint64_scale (2 * GST_SECOND, fps_d, fps_n);
+   * start to determine the first frame is complete. Low latency
+   * receivers are expected to feed whole frames of streams without
+   * reordering, otherwise frames are held in the DPB for longer than
+   * reported here, as documented for the low-latency property */
+  latency = gst_util_uint64_scale (decode->low_latency ? GST_SECOND :
+      2 * GST_SECOND, fps_d, fps_n);
   gst_video_decoder_set_latency (vdec, latency, latency);
 
   return TRUE;
@@ -579,10 +584,14 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
   GstVaapiVideoBufferPoolAcquireParams vaapi_params = { {0,}, };
   guint flags, out_flags = 0;
   gboolean alloc_renegotiate, caps_renegotiate;
+  const gint64 trace_start = gst_vaapi_trace_begin ();
+  const gint frame_number = out_frame->system_frame_number;
+  guint surface_id = GST_VAAPI_TRACE_NO_SURFACE;
 
   if (!GST_VIDEO_CODEC_FRAME_IS_DECODE_ONLY (out_frame)) {
     proxy = gst_video_codec_frame_get_user_data (out_frame);
     surface = GST_VAAPI_SURFACE_PROXY_SURFACE (proxy);
+    surface_id = gst_vaapi_surface_get_id (surface);
     crop_rect = gst_vaapi_surface_proxy_get_crop_rect (proxy);
 
     /* in theory, we are not supposed to check the surface resolution
@@ -600,9 +609,21 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
     if (gst_pad_needs_reconfigure (GST_VIDEO_DECODER_SRC_PAD (vdec))
         || alloc_renegotiate || caps_renegotiate || decode->do_renego) {
 
+      gint64 start = 0;
+
+      if (alloc_renegotiate || caps_renegotiate)
+        start = g_get_monotonic_time ();
+
       g_atomic_int_set (&decode->do_renego, FALSE);
       if (!gst_vaapidecode_negotiate (decode))
         return GST_FLOW_ERROR;
+
+      if (start > 0) {
+        GST_INFO_OBJECT (decode, "renegotiation to %ux%u (%s) took %"
+            G_GINT64_FORMAT " us", decode->display_width,
+            decode->display_height, alloc_renegotiate ? "new surfaces" :
+            "crop only", g_get_monotonic_time () - start);
+      }
     }
 
     if (is_src_allocator_dmabuf (decode)) {
@@ -675,6 +696,7 @@ gst_vaapidecode_push_decoded_frame (GstVideoDecoder * vdec,
   }
 
   ret = gst_video_decoder_finish_frame (vdec, out_frame);
+  gst_vaapi_trace_end (trace_start, "push", frame_number, surface_id);
   if (ret != GST_FLOW_OK)
     goto error_commit_buffer;
   return GST_FLOW_OK;
@@ -940,8 +962,6 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
         }
 
         if (priv) {
-          gst_vaapi_decoder_h264_set_low_latency (GST_VAAPI_DECODER_H264
-              (decode->decoder), priv->is_low_latency);
           gst_vaapi_decoder_h264_set_base_only (GST_VAAPI_DECODER_H264
               (decode->decoder), priv->base_only);
         }
@@ -998,6 +1018,9 @@ gst_vaapidecode_create (GstVaapiDecode * decode, GstCaps * caps)
 
   gst_vaapi_decoder_set_codec_state_changed_func (decode->decoder,
       gst_vaapi_decoder_state_changed, decode);
+  gst_vaapi_decoder_set_surface_reservation (decode->decoder,
+      decode->reserve_surfaces, decode->max_width, decode->max_height);
+  gst_vaapi_decoder_set_low_latency (decode->decoder, decode->low_latency);
 
   return TRUE;
 }
@@ -1562,6 +1585,7 @@ gst_vaapidecode_class_init (GstVaapiDecodeClass * klass)
   g_free (longname);
   g_free (description);
 
+  gst_vaapi_decode_install_properties (object_class, map->codec);
   if (map->install_properties)
     map->install_properties (object_class);
 
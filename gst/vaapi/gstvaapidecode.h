@@ -54,6 +54,11 @@ struct _GstVaapiDecode {
     GstVideoCodecState *input_state;
 
     gboolean            do_renego;
+
+    gboolean            reserve_surfaces;
+    guint               max_width;
+    guint               max_height;
+    gboolean            low_latency;
 };
 
 struct _GstVaapiDecodeClass {
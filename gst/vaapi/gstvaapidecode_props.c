@@ -28,12 +28,135 @@
 
 enum
 {
-  GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY = 1,
-  GST_VAAPI_DECODER_H264_PROP_BASE_ONLY,
+  GST_VAAPI_DECODER_H264_PROP_BASE_ONLY = GST_VAAPI_DECODE_N_PROPERTIES,
 };
 
 static gint h264_private_offset;
 
+void
+gst_vaapi_decode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case GST_VAAPI_DECODE_PROP_RESERVE_SURFACES:
+      g_value_set_boolean (value, decode->reserve_surfaces);
+      break;
+    case GST_VAAPI_DECODE_PROP_MAX_WIDTH:
+      g_value_set_uint (value, decode->max_width);
+      break;
+    case GST_VAAPI_DECODE_PROP_MAX_HEIGHT:
+      g_value_set_uint (value, decode->max_height);
+      break;
+    case GST_VAAPI_DECODE_PROP_LOW_LATENCY:
+      g_value_set_boolean (value, decode->low_latency);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaapi_decode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiDecode *const decode = GST_VAAPIDECODE (object);
+
+  switch (prop_id) {
+    case GST_VAAPI_DECODE_PROP_RESERVE_SURFACES:
+      decode->reserve_surfaces = g_value_get_boolean (value);
+      break;
+    case GST_VAAPI_DECODE_PROP_MAX_WIDTH:
+      decode->max_width = g_value_get_uint (value);
+      break;
+    case GST_VAAPI_DECODE_PROP_MAX_HEIGHT:
+      decode->max_height = g_value_get_uint (value);
+      break;
+    case GST_VAAPI_DECODE_PROP_LOW_LATENCY:
+      decode->low_latency = g_value_get_boolean (value);
+      if (decode->decoder)
+        gst_vaapi_decoder_set_low_latency (decode->decoder,
+            decode->low_latency);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* Codecs whose decoders may hold back decoded frames */
+static gboolean
+codec_has_low_latency_mode (GstVaapiCodec codec)
+{
+  switch (codec) {
+    case GST_VAAPI_CODEC_H264:
+    case GST_VAAPI_CODEC_H265:
+    case GST_VAAPI_CODEC_VP9:
+    case GST_VAAPI_CODEC_AV1:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+void
+gst_vaapi_decode_install_properties (GObjectClass * klass, GstVaapiCodec codec)
+{
+  klass->get_property = gst_vaapi_decode_get_property;
+  klass->set_property = gst_vaapi_decode_set_property;
+
+  /**
+   * GstVaapiDecode:reserve-surfaces:
+   *
+   * Allocates the surfaces for the largest resolution seen, or for
+   * #GstVaapiDecode:max-width x #GstVaapiDecode:max-height, and keeps
+   * them, as well as the VA context, when the stream switches to a
+   * smaller resolution. This avoids stalls on adaptive streams, at
+   * the expense of memory. It applies to the next stream.
+   */
+  g_object_class_install_property (klass,
+      GST_VAAPI_DECODE_PROP_RESERVE_SURFACES,
+      g_param_spec_boolean ("reserve-surfaces", "Reserve surfaces",
+          "Keep the surfaces across downward resolution switches", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (klass, GST_VAAPI_DECODE_PROP_MAX_WIDTH,
+      g_param_spec_uint ("max-width", "Maximum width",
+          "Width to reserve surfaces for (0: the largest seen)", 0, G_MAXINT,
+          0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (klass, GST_VAAPI_DECODE_PROP_MAX_HEIGHT,
+      g_param_spec_uint ("max-height", "Maximum height",
+          "Height to reserve surfaces for (0: the largest seen)", 0, G_MAXINT,
+          0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  if (!codec_has_low_latency_mode (codec))
+    return;
+
+  /**
+   * GstVaapiDecode:low-latency:
+   *
+   * Pushes the decoded frames as soon as they can be displayed in
+   * order, rather than when the reordering rules of the codec require
+   * them to leave the DPB. This is meant for frame-in/frame-out
+   * receivers, such as real-time communication and game streaming.
+   *
+   * The latency is then reported as one frame. Streams whose picture
+   * order counts are not contiguous, e.g. with B-frames, still fall
+   * back to the DPB bumping process, and hold frames for longer than
+   * the reported latency.
+   */
+  g_object_class_install_property (klass, GST_VAAPI_DECODE_PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency", "Force low latency mode",
+          "When enabled, frames will be pushed as soon as they are available. "
+          "It might violate the codec spec. The reported latency is one "
+          "frame, frames that cannot be output in order are still held up to "
+          "the DPB size.", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT));
+}
+
 static void
 gst_vaapi_decode_h264_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -43,14 +166,11 @@ gst_vaapi_decode_h264_get_property (GObject * object, guint prop_id,
   priv = gst_vaapi_decode_h264_get_instance_private (object);
 
   switch (prop_id) {
-    case GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY:
-      g_value_set_boolean (value, priv->is_low_latency);
-      break;
     case GST_VAAPI_DECODER_H264_PROP_BASE_ONLY:
       g_value_set_boolean (value, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      gst_vaapi_decode_get_property (object, prop_id, value, pspec);
       break;
   }
 }
@@ -65,12 +185,6 @@ gst_vaapi_decode_h264_set_property (GObject * object, guint prop_id,
   priv = gst_vaapi_decode_h264_get_instance_private (object);
 
   switch (prop_id) {
-    case GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY:
-      priv->is_low_latency = g_value_get_boolean (value);
-      decoder = GST_VAAPI_DECODER_H264 (GST_VAAPIDECODE (object)->decoder);
-      if (decoder)
-        gst_vaapi_decoder_h264_set_low_latency (decoder, priv->is_low_latency);
-      break;
     case GST_VAAPI_DECODER_H264_PROP_BASE_ONLY:
       priv->base_only = g_value_get_boolean (value);
       decoder = GST_VAAPI_DECODER_H264 (GST_VAAPIDECODE (object)->decoder);
@@ -78,7 +192,7 @@ gst_vaapi_decode_h264_set_property (GObject * object, guint prop_id,
         gst_vaapi_decoder_h264_set_base_only (decoder, priv->base_only);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      gst_vaapi_decode_set_property (object, prop_id, value, pspec);
       break;
   }
 }
@@ -92,13 +206,6 @@ gst_vaapi_decode_h264_install_properties (GObjectClass * klass)
   klass->get_property = gst_vaapi_decode_h264_get_property;
   klass->set_property = gst_vaapi_decode_h264_set_property;
 
-  g_object_class_install_property (klass,
-      GST_VAAPI_DECODER_H264_PROP_FORCE_LOW_LATENCY,
-      g_param_spec_boolean ("low-latency", "Force low latency mode",
-          "When enabled, frames will be pushed as soon as they are available. "
-          "It might violate the H.264 spec.", FALSE,
-          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT));
-
   g_object_class_install_property (klass, GST_VAAPI_DECODER_H264_PROP_BASE_ONLY,
       g_param_spec_boolean ("base-only", "Decode base view only",
           "Drop any NAL unit not defined in Annex.A", FALSE,
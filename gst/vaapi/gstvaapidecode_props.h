@@ -25,17 +25,40 @@
 #define GST_VAAPI_DECODE_PROPS_H
 
 #include "gstcompat.h"
+#include <gst/vaapi/gstvaapiprofile.h>
 
 G_BEGIN_DECLS
 
+/* Properties shared by all the decoders. Codec specific properties
+   are numbered from GST_VAAPI_DECODE_N_PROPERTIES */
+enum
+{
+  GST_VAAPI_DECODE_PROP_RESERVE_SURFACES = 1,
+  GST_VAAPI_DECODE_PROP_MAX_WIDTH,
+  GST_VAAPI_DECODE_PROP_MAX_HEIGHT,
+  GST_VAAPI_DECODE_PROP_LOW_LATENCY,
+  GST_VAAPI_DECODE_N_PROPERTIES
+};
+
 typedef struct _GstVaapiDecodeH264Private GstVaapiDecodeH264Private;
 
 struct _GstVaapiDecodeH264Private
 {
-  gboolean is_low_latency;
   gboolean base_only;
 };
 
+void
+gst_vaapi_decode_install_properties (GObjectClass * klass,
+    GstVaapiCodec codec);
+
+void
+gst_vaapi_decode_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+
+void
+gst_vaapi_decode_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
 void
 gst_vaapi_decode_h264_install_properties (GObjectClass * klass);
 
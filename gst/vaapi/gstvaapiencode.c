@@ -25,6 +25,7 @@
 #include <gst/vaapi/gstvaapivalue.h>
 #include <gst/vaapi/gstvaapidisplay.h>
 #include <gst/vaapi/gstvaapiprofilecaps.h>
+#include <gst/vaapi/gstvaapitrace.h>
 #include "gstvaapiencode.h"
 #include "gstvaapipluginutil.h"
 #include "gstvaapivideometa.h"
@@ -167,14 +168,29 @@ prop_value_lookup_entry (GPtrArray * prop_values, guint prop_id)
 
 static GstFlowReturn
 gst_vaapiencode_default_alloc_buffer (GstVaapiEncode * encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** outbuf_ptr)
+    GstVaapiCodedBufferProxy * proxy, GstBuffer ** outbuf_ptr)
 {
+  GstVaapiCodedBuffer *coded_buf;
   GstBuffer *buf;
   gint32 buf_size;
 
-  g_return_val_if_fail (coded_buf != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (proxy != NULL, GST_FLOW_ERROR);
   g_return_val_if_fail (outbuf_ptr != NULL, GST_FLOW_ERROR);
 
+  /* Hand the coded buffer segments over downstream, the coded buffer
+     returns to the pool once the output buffer is released. Exported
+     segments are read-only, they are copied if they get rewritten */
+  if (encode->zero_copy_output && !encode->need_writable_output) {
+    buf = gst_vaapi_encoder_export_coded_buffer (encode->encoder, proxy);
+    if (buf && gst_buffer_get_size (buf) > 0) {
+      *outbuf_ptr = buf;
+      return GST_FLOW_OK;
+    }
+    GST_DEBUG_OBJECT (encode, "failed to export coded buffer, copying it");
+    gst_buffer_replace (&buf, NULL);
+  }
+
+  coded_buf = GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (proxy);
   buf_size = gst_vaapi_coded_buffer_get_size (coded_buf);
   if (buf_size <= 0)
     goto error_invalid_buffer;
@@ -244,7 +260,7 @@ ensure_output_state (GstVaapiEncode * encode)
 }
 
 static GstFlowReturn
-gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
+gst_vaapiencode_push_frame (GstVaapiEncode * encode, guint64 timeout)
 {
   GstVideoEncoder *const venc = GST_VIDEO_ENCODER_CAST (encode);
   GstVaapiEncodeClass *const klass = GST_VAAPIENCODE_GET_CLASS (encode);
@@ -253,6 +269,7 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
   GstVaapiEncoderStatus status;
   GstBuffer *out_buffer;
   GstFlowReturn ret;
+  gint64 trace_start;
 
   status = gst_vaapi_encoder_get_buffer_with_timeout (encode->encoder,
       &codedbuf_proxy, timeout);
@@ -275,8 +292,10 @@ gst_vaapiencode_push_frame (GstVaapiEncode * encode, gint64 timeout)
 
   /* Allocate and copy buffer into system memory */
   out_buffer = NULL;
-  ret = klass->alloc_buffer (encode,
-      GST_VAAPI_CODED_BUFFER_PROXY_BUFFER (codedbuf_proxy), &out_buffer);
+  trace_start = gst_vaapi_trace_begin ();
+  ret = klass->alloc_buffer (encode, codedbuf_proxy, &out_buffer);
+  gst_vaapi_trace_end (trace_start, "coded_copy",
+      out_frame->system_frame_number, GST_VAAPI_TRACE_NO_SURFACE);
 
   gst_vaapi_coded_buffer_proxy_replace (&codedbuf_proxy, NULL);
   if (ret != GST_FLOW_OK)
@@ -315,13 +334,15 @@ error_output_state:
   }
 }
 
+/* Pushes coded frames as soon as they are complete. The wait is
+   interrupted by gst_vaapi_encoder_set_flushing() when the task is
+   about to be stopped */
 static void
 gst_vaapiencode_buffer_loop (GstVaapiEncode * encode)
 {
   GstFlowReturn ret;
-  const gint64 timeout = 50000; /* microseconds */
 
-  ret = gst_vaapiencode_push_frame (encode, timeout);
+  ret = gst_vaapiencode_push_frame (encode, G_MAXUINT64);
   if (ret == GST_FLOW_OK || ret == GST_VAAPI_ENCODE_FLOW_TIMEOUT)
     return;
 
@@ -557,6 +578,26 @@ set_codec_state (GstVaapiEncode * encode, GstVideoCodecState * state)
   return TRUE;
 }
 
+/* Frames held by the encoder lookahead delay the output */
+static void
+gst_vaapiencode_update_latency (GstVaapiEncode * encode)
+{
+  const GstVideoInfo *const vip = &encode->input_state->info;
+  GstClockTime latency;
+  guint num_frames;
+
+  num_frames = gst_vaapi_encoder_get_lookahead_depth (encode->encoder);
+  if (num_frames == 0 || GST_VIDEO_INFO_FPS_N (vip) <= 0)
+    return;
+
+  latency = gst_util_uint64_scale (num_frames * GST_SECOND,
+      GST_VIDEO_INFO_FPS_D (vip), GST_VIDEO_INFO_FPS_N (vip));
+  GST_INFO_OBJECT (encode, "lookahead of %u frames adds %" GST_TIME_FORMAT
+      " of latency", num_frames, GST_TIME_ARGS (latency));
+  gst_video_encoder_set_latency (GST_VIDEO_ENCODER_CAST (encode), latency,
+      latency);
+}
+
 static gboolean
 gst_vaapiencode_set_format (GstVideoEncoder * venc, GstVideoCodecState * state)
 {
@@ -585,6 +626,8 @@ gst_vaapiencode_set_format (GstVideoEncoder * venc, GstVideoCodecState * state)
   encode->input_state = gst_video_codec_state_ref (state);
   encode->input_state_changed = TRUE;
 
+  gst_vaapiencode_update_latency (encode);
+
   /* Store some tags */
   {
     GstTagList *tags = gst_tag_list_new_empty ();
@@ -627,10 +670,12 @@ gst_vaapiencode_handle_frame (GstVideoEncoder * venc,
   GstTaskState task_state;
 
   task_state = gst_pad_get_task_state (srcpad);
-  if (task_state == GST_TASK_STOPPED || task_state == GST_TASK_PAUSED)
+  if (task_state == GST_TASK_STOPPED || task_state == GST_TASK_PAUSED) {
+    gst_vaapi_encoder_set_flushing (encode->encoder, FALSE);
     if (!gst_pad_start_task (srcpad,
             (GstTaskFunction) gst_vaapiencode_buffer_loop, encode, NULL))
       goto error_task_failed;
+  }
 
   buf = NULL;
   ret = gst_vaapi_plugin_base_get_input_buffer (GST_VAAPI_PLUGIN_BASE (encode),
@@ -698,6 +743,17 @@ error_encode_frame:
   }
 }
 
+static void
+gst_vaapiencode_log_in_flight_stats (GstVaapiEncode * encode)
+{
+  guint peak;
+  gdouble average;
+
+  gst_vaapi_encoder_get_in_flight_stats (encode->encoder, &peak, &average);
+  GST_INFO_OBJECT (encode, "frames in flight: peak %u, average %.2f", peak,
+      average);
+}
+
 static GstFlowReturn
 gst_vaapiencode_finish (GstVideoEncoder * venc)
 {
@@ -716,6 +772,7 @@ gst_vaapiencode_finish (GstVideoEncoder * venc)
 
   status = gst_vaapi_encoder_flush (encode->encoder);
 
+  gst_vaapi_encoder_set_flushing (encode->encoder, TRUE);
   gst_pad_stop_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
 
   GST_VIDEO_ENCODER_STREAM_LOCK (encode);
@@ -723,6 +780,8 @@ gst_vaapiencode_finish (GstVideoEncoder * venc)
   while (status == GST_VAAPI_ENCODER_STATUS_SUCCESS && ret == GST_FLOW_OK)
     ret = gst_vaapiencode_push_frame (encode, 0);
 
+  gst_vaapiencode_log_in_flight_stats (encode);
+
   if (ret == GST_VAAPI_ENCODE_FLOW_TIMEOUT)
     ret = GST_FLOW_OK;
   return ret;
@@ -736,6 +795,8 @@ gst_vaapiencode_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (encode->encoder)
+        gst_vaapi_encoder_set_flushing (encode->encoder, TRUE);
       gst_pad_stop_task (GST_VAAPI_PLUGIN_BASE_SRC_PAD (encode));
 
       status = gst_vaapi_encoder_flush (encode->encoder);
@@ -764,9 +825,29 @@ static gboolean
 gst_vaapiencode_propose_allocation (GstVideoEncoder * venc, GstQuery * query)
 {
   GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (venc);
+  GstVaapiEncode *const encode = GST_VAAPIENCODE_CAST (venc);
+  GstBufferPool *pool;
+  guint i, size, min, max, depth;
 
   if (!gst_vaapi_plugin_base_propose_allocation (plugin, query))
     return FALSE;
+
+  /* The lookahead window holds that many more input buffers before
+     any of them can be encoded and released */
+  depth = encode->encoder ?
+      gst_vaapi_encoder_get_lookahead_depth (encode->encoder) : 0;
+  if (depth == 0)
+    return TRUE;
+
+  for (i = 0; i < gst_query_get_n_allocation_pools (query); i++) {
+    gst_query_parse_nth_allocation_pool (query, i, &pool, &size, &min, &max);
+    min += depth;
+    if (max != 0)
+      max = MAX (max + depth, min);
+    gst_query_set_nth_allocation_pool (query, i, pool, size, min, max);
+    if (pool)
+      gst_object_unref (pool);
+  }
   return TRUE;
 }
 
@@ -784,9 +865,13 @@ gst_vaapiencode_sink_event (GstVideoEncoder * venc, GstEvent * event)
 
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_START:
+      if (encode->encoder)
+        gst_vaapi_encoder_set_flushing (encode->encoder, TRUE);
       gst_pad_pause_task (srcpad);
       break;
     case GST_EVENT_FLUSH_STOP:
+      if (encode->encoder)
+        gst_vaapi_encoder_set_flushing (encode->encoder, FALSE);
       ret = gst_pad_start_task (srcpad,
           (GstTaskFunction) gst_vaapiencode_buffer_loop, encode, NULL);
       break;
@@ -848,6 +933,9 @@ gst_vaapiencode_init (GstVaapiEncode * encode)
 
   gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (encode), GST_CAT_DEFAULT);
   gst_pad_use_fixed_caps (GST_VAAPI_PLUGIN_BASE_SRC_PAD (plugin));
+
+  encode->zero_copy_output =
+      (g_getenv ("GST_VAAPI_ENCODE_ZERO_COPY") != NULL);
 }
 
 static void
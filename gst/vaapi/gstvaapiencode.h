@@ -174,6 +174,10 @@ struct _GstVaapiEncode
   GstVideoCodecState *output_state;
   GPtrArray *prop_values;
   GstCaps *allowed_sinkpad_caps;
+  /* output coded buffers without copying them */
+  gboolean zero_copy_output;
+  /* set by the subclass if alloc_buffer() rewrites the output buffers */
+  gboolean need_writable_output;
 };
 
 struct _GstVaapiEncodeClass
@@ -187,7 +191,7 @@ struct _GstVaapiEncodeClass
   GstVaapiEncoder *   (*alloc_encoder)  (GstVaapiEncode * encode,
                                          GstVaapiDisplay * display);
   GstFlowReturn       (*alloc_buffer)   (GstVaapiEncode * encode,
-                                         GstVaapiCodedBuffer * coded_buf,
+                                         GstVaapiCodedBufferProxy * proxy,
                                          GstBuffer ** outbuf_ptr);
   /* Get all possible profiles based on allowed caps */
   GArray *            (*get_allowed_profiles)  (GstVaapiEncode * encode,
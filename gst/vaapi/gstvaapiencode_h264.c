@@ -310,6 +310,7 @@ gst_vaapiencode_h264_set_config (GstVaapiEncode * base_encode)
   gst_caps_unref (template_caps);
 
   base_encode->need_codec_data = encode->is_avc;
+  base_encode->need_writable_output = encode->is_avc;
 
   return ret;
 
@@ -501,7 +502,7 @@ error:
 
 static GstFlowReturn
 gst_vaapiencode_h264_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
+    GstVaapiCodedBufferProxy * proxy, GstBuffer ** out_buffer_ptr)
 {
   GstVaapiEncodeH264 *const encode = GST_VAAPIENCODE_H264_CAST (base_encode);
   GstVaapiEncoderH264 *const encoder =
@@ -512,7 +513,7 @@ gst_vaapiencode_h264_alloc_buffer (GstVaapiEncode * base_encode,
 
   ret =
       GST_VAAPIENCODE_CLASS (gst_vaapiencode_h264_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
+      (base_encode, proxy, out_buffer_ptr);
   if (ret != GST_FLOW_OK)
     return ret;
 
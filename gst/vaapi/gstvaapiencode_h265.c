@@ -193,6 +193,7 @@ gst_vaapiencode_h265_get_caps (GstVaapiEncode * base_encode)
       encode->is_hvc ? "hvc1" : "byte-stream", NULL);
 
   base_encode->need_codec_data = encode->is_hvc;
+  base_encode->need_writable_output = encode->is_hvc;
 
   gst_vaapi_encoder_h265_get_profile_tier_level (encoder,
       &profile, &tier, &level);
@@ -317,7 +318,7 @@ error:
 
 static GstFlowReturn
 gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
-    GstVaapiCodedBuffer * coded_buf, GstBuffer ** out_buffer_ptr)
+    GstVaapiCodedBufferProxy * proxy, GstBuffer ** out_buffer_ptr)
 {
   GstVaapiEncodeH265 *const encode = GST_VAAPIENCODE_H265_CAST (base_encode);
   GstVaapiEncoderH265 *const encoder =
@@ -328,7 +329,7 @@ gst_vaapiencode_h265_alloc_buffer (GstVaapiEncode * base_encode,
 
   ret =
       GST_VAAPIENCODE_CLASS (gst_vaapiencode_h265_parent_class)->alloc_buffer
-      (base_encode, coded_buf, out_buffer_ptr);
+      (base_encode, proxy, out_buffer_ptr);
   if (ret != GST_FLOW_OK)
     return ret;
 
@@ -363,6 +363,8 @@ gst_vaapi_plugin_base_close (GstVaapiPluginBase * plugin)
 
   gst_caps_replace (&plugin->allowed_raw_caps, NULL);
 
+  g_clear_pointer (&plugin->readback, gst_vaapi_readback_free);
+
   if (plugin->sinkpriv)
     gst_vaapi_pad_private_reset (plugin->sinkpriv);
   if (plugin->srcpriv)
@@ -965,22 +967,21 @@ gst_vaapi_plugin_base_propose_allocation (GstVaapiPluginBase * plugin,
 }
 
 /**
- * gst_vaapi_plugin_base_decide_allocation:
+ * gst_vaapi_plugin_base_pad_decide_allocation:
  * @plugin: a #GstVaapiPluginBase
+ * @srcpad: the src pad to decide the allocation on
  * @query: the allocation query to parse
- * @feature: the desired #GstVaapiCapsFeature, or zero to find the
- *   preferred one
  *
- * Decides allocation parameters for the downstream elements on the base
- * plugin static srcpad.
+ * Decides allocation parameters for the downstream elements on the
+ * requested srcpad.
  *
  * Returns: %TRUE if successful, %FALSE otherwise.
  */
 gboolean
-gst_vaapi_plugin_base_decide_allocation (GstVaapiPluginBase * plugin,
-    GstQuery * query)
+gst_vaapi_plugin_base_pad_decide_allocation (GstVaapiPluginBase * plugin,
+    GstPad * srcpad, GstQuery * query)
 {
-  GstVaapiPadPrivate *srcpriv = GST_VAAPI_PAD_PRIVATE (plugin->srcpad);
+  GstVaapiPadPrivate *srcpriv = GST_VAAPI_PAD_PRIVATE (srcpad);
   GstCaps *caps = NULL;
   GstBufferPool *pool;
   GstVideoInfo vi;
@@ -1017,7 +1018,7 @@ gst_vaapi_plugin_base_decide_allocation (GstVaapiPluginBase * plugin,
       if (gst_structure_get (params, "gst.gl.GstGLContext", GST_TYPE_GL_CONTEXT,
               &gl_context, NULL) && gl_context) {
         gst_vaapi_plugin_base_set_gl_context (plugin, gl_context);
-        gst_vaapi_plugin_base_set_srcpad_can_dmabuf (plugin, gl_context);
+        gst_vaapi_plugin_base_pad_set_can_dmabuf (plugin, srcpad, gl_context);
         gst_object_unref (gl_context);
       }
     }
@@ -1095,7 +1096,7 @@ gst_vaapi_plugin_base_decide_allocation (GstVaapiPluginBase * plugin,
   }
 
   if (!pool) {
-    if (!ensure_srcpad_allocator (plugin, plugin->srcpad, &vi, caps))
+    if (!ensure_srcpad_allocator (plugin, srcpad, &vi, caps))
       goto error;
     size = GST_VIDEO_INFO_SIZE (&vi);   /* size might be updated by
                                          * allocator */
@@ -1156,6 +1157,24 @@ error:
   }
 }
 
+/**
+ * gst_vaapi_plugin_base_decide_allocation:
+ * @plugin: a #GstVaapiPluginBase
+ * @query: the allocation query to parse
+ *
+ * Decides allocation parameters for the downstream elements on the base
+ * plugin static srcpad.
+ *
+ * Returns: %TRUE if successful, %FALSE otherwise.
+ */
+gboolean
+gst_vaapi_plugin_base_decide_allocation (GstVaapiPluginBase * plugin,
+    GstQuery * query)
+{
+  return gst_vaapi_plugin_base_pad_decide_allocation (plugin, plugin->srcpad,
+      query);
+}
+
 /**
  * gst_vaapi_plugin_base_pad_get_input_buffer:
  * @plugin: a #GstVaapiPluginBase
@@ -1518,21 +1537,22 @@ gst_vaapi_plugin_base_get_allowed_sinkpad_raw_caps (GstVaapiPluginBase * plugin)
 }
 
 /**
- * gst_vaapi_plugin_base_set_srcpad_can_dmabuf:
+ * gst_vaapi_plugin_base_pad_set_can_dmabuf:
  * @plugin: a #GstVaapiPluginBase
+ * @srcpad: a #GstPad
  * @object: the GL context from gst-gl
  *
  * This function will determine if @object supports dmabuf
- * importing on the base plugin static srcpad.
+ * importing on the requested srcpad.
  *
  * Please note that the context @object should come from downstream.
  **/
 void
-gst_vaapi_plugin_base_set_srcpad_can_dmabuf (GstVaapiPluginBase * plugin,
-    GstObject * object)
+gst_vaapi_plugin_base_pad_set_can_dmabuf (GstVaapiPluginBase * plugin,
+    GstPad * srcpad, GstObject * object)
 {
 #if USE_EGL && USE_GST_GL_HELPERS
-  GstVaapiPadPrivate *srcpriv = GST_VAAPI_PAD_PRIVATE (plugin->srcpad);
+  GstVaapiPadPrivate *srcpriv = GST_VAAPI_PAD_PRIVATE (srcpad);
   GstGLContext *const gl_context = GST_GL_CONTEXT (object);
 
   srcpriv->can_dmabuf =
@@ -1542,6 +1562,23 @@ gst_vaapi_plugin_base_set_srcpad_can_dmabuf (GstVaapiPluginBase * plugin,
 #endif
 }
 
+/**
+ * gst_vaapi_plugin_base_set_srcpad_can_dmabuf:
+ * @plugin: a #GstVaapiPluginBase
+ * @object: the GL context from gst-gl
+ *
+ * This function will determine if @object supports dmabuf
+ * importing on the base plugin static srcpad.
+ *
+ * Please note that the context @object should come from downstream.
+ **/
+void
+gst_vaapi_plugin_base_set_srcpad_can_dmabuf (GstVaapiPluginBase * plugin,
+    GstObject * object)
+{
+  gst_vaapi_plugin_base_pad_set_can_dmabuf (plugin, plugin->srcpad, object);
+}
+
 static void
 _init_performance_debug (void)
 {
@@ -1565,6 +1602,10 @@ _init_performance_debug (void)
  * support GstVideoMeta, and since VA memory may have custom strides a
  * frame copy is required.
  *
+ * The copy goes through a #GstVaapiReadback engine, which uses
+ * streaming loads and a few worker threads to read the uncached VA
+ * mapping.
+ *
  * Returns: %FALSE if the copy failed, otherwise %TRUE. Also returns
  *          %TRUE if it is not required to do the copy
  **/
@@ -1574,7 +1615,6 @@ gst_vaapi_plugin_copy_va_buffer (GstVaapiPluginBase * plugin,
 {
   GstVaapiPadPrivate *srcpriv = GST_VAAPI_PAD_PRIVATE (plugin->srcpad);
   GstVideoMeta *vmeta;
-  GstVideoFrame src_frame, dst_frame;
   gboolean success;
 
   if (!plugin->copy_output_frame)
@@ -1588,15 +1628,10 @@ gst_vaapi_plugin_copy_va_buffer (GstVaapiPluginBase * plugin,
   _init_performance_debug ();
   GST_CAT_INFO (CAT_PERFORMANCE, "copying VA buffer to system memory buffer");
 
-  if (!gst_video_frame_map (&src_frame, &srcpriv->info, inbuf, GST_MAP_READ))
-    return FALSE;
-  if (!gst_video_frame_map (&dst_frame, &srcpriv->info, outbuf, GST_MAP_WRITE)) {
-    gst_video_frame_unmap (&src_frame);
-    return FALSE;
-  }
-  success = gst_video_frame_copy (&dst_frame, &src_frame);
-  gst_video_frame_unmap (&dst_frame);
-  gst_video_frame_unmap (&src_frame);
+  if (!plugin->readback)
+    plugin->readback = gst_vaapi_readback_new ();
+  success = gst_vaapi_readback_copy_buffer (plugin->readback, &srcpriv->info,
+      inbuf, outbuf);
 
   if (success) {
     gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_TIMESTAMPS
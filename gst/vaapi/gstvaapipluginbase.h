@@ -30,6 +30,7 @@
 #include <gst/video/gstvideoencoder.h>
 #include <gst/video/gstvideosink.h>
 #include <gst/vaapi/gstvaapidisplay.h>
+#include "gstvaapireadback.h"
 
 G_BEGIN_DECLS
 
@@ -184,6 +185,7 @@ struct _GstVaapiPluginBase
 
   gboolean enable_direct_rendering;
   gboolean copy_output_frame;
+  GstVaapiReadback *readback;
 };
 
 struct _GstVaapiPluginBaseClass
@@ -268,6 +270,11 @@ gboolean
 gst_vaapi_plugin_base_pad_propose_allocation (GstVaapiPluginBase * plugin,
     GstPad * sinkpad, GstQuery * query);
 
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_plugin_base_pad_decide_allocation (GstVaapiPluginBase * plugin,
+    GstPad * srcpad, GstQuery * query);
+
 G_GNUC_INTERNAL
 gboolean
 gst_vaapi_plugin_base_decide_allocation (GstVaapiPluginBase * plugin,
@@ -301,6 +308,11 @@ G_GNUC_INTERNAL
 GstCaps *
 gst_vaapi_plugin_base_get_allowed_sinkpad_raw_caps (GstVaapiPluginBase * plugin);
 
+G_GNUC_INTERNAL
+void
+gst_vaapi_plugin_base_pad_set_can_dmabuf (GstVaapiPluginBase * plugin,
+    GstPad * srcpad, GstObject * object);
+
 G_GNUC_INTERNAL
 void
 gst_vaapi_plugin_base_set_srcpad_can_dmabuf (GstVaapiPluginBase * plugin,
@@ -194,15 +194,26 @@ ds_reset (GstVaapiDeinterlaceState * ds)
     gst_buffer_replace (&ds->buffers[i], NULL);
   ds->buffers_index = 0;
   ds->num_surfaces = 0;
+  ds->num_future_surfaces = 0;
   ds->deint = FALSE;
   ds->tff = FALSE;
 }
 
 static void
-ds_add_buffer (GstVaapiDeinterlaceState * ds, GstBuffer * buf)
+ds_clear_pending (GstVaapiDeinterlaceState * ds)
 {
-  gst_buffer_replace (&ds->buffers[ds->buffers_index], buf);
-  ds->buffers_index = (ds->buffers_index + 1) % G_N_ELEMENTS (ds->buffers);
+  while (ds->num_pending > 0)
+    gst_buffer_replace (&ds->pending[--ds->num_pending], NULL);
+}
+
+static void
+ds_clear (GstVaapiDeinterlaceState * ds)
+{
+  ds_reset (ds);
+  ds_clear_pending (ds);
+  ds->refs_method = GST_VAAPI_DEINTERLACE_METHOD_NONE;
+  ds->num_forward_refs = GST_VAAPI_DEINTERLACE_MAX_REFERENCES;
+  ds->num_backward_refs = 0;
 }
 
 static inline GstBuffer *
@@ -216,6 +227,50 @@ ds_get_buffer (GstVaapiDeinterlaceState * ds, guint index)
   return ds->buffers[n % G_N_ELEMENTS (ds->buffers)];
 }
 
+static void
+ds_add_buffer (GstVaapiDeinterlaceState * ds, GstBuffer * buf)
+{
+  guint i;
+
+  gst_buffer_replace (&ds->buffers[ds->buffers_index], buf);
+  ds->buffers_index = (ds->buffers_index + 1) % G_N_ELEMENTS (ds->buffers);
+
+  /* Don't hold more upstream surfaces than the driver needs */
+  for (i = ds->num_forward_refs; i < G_N_ELEMENTS (ds->buffers); i++) {
+    const guint n = ds->buffers_index + G_N_ELEMENTS (ds->buffers) - i - 1;
+    gst_buffer_replace (&ds->buffers[n % G_N_ELEMENTS (ds->buffers)], NULL);
+  }
+}
+
+static GstBuffer *
+ds_pop_pending (GstVaapiDeinterlaceState * ds)
+{
+  GstBuffer *buf;
+
+  if (ds->num_pending == 0)
+    return NULL;
+
+  buf = ds->pending[0];
+  ds->num_pending--;
+  memmove (&ds->pending[0], &ds->pending[1],
+      ds->num_pending * sizeof (ds->pending[0]));
+  ds->pending[ds->num_pending] = NULL;
+  return buf;
+}
+
+/* Queues @buf, and returns the oldest pending buffer once all its
+   future references are available, or NULL otherwise */
+static GstBuffer *
+ds_push_pending (GstVaapiDeinterlaceState * ds, GstBuffer * buf)
+{
+  g_assert (ds->num_pending < G_N_ELEMENTS (ds->pending));
+
+  ds->pending[ds->num_pending++] = buf;
+  if (ds->num_pending <= ds->num_backward_refs)
+    return NULL;
+  return ds_pop_pending (ds);
+}
+
 static void
 ds_set_surfaces (GstVaapiDeinterlaceState * ds)
 {
@@ -223,7 +278,7 @@ ds_set_surfaces (GstVaapiDeinterlaceState * ds)
   guint i;
 
   ds->num_surfaces = 0;
-  for (i = 0; i < G_N_ELEMENTS (ds->buffers); i++) {
+  for (i = 0; i < MIN (ds->num_forward_refs, G_N_ELEMENTS (ds->buffers)); i++) {
     GstBuffer *const buf = ds_get_buffer (ds, i);
     if (!buf)
       break;
@@ -231,6 +286,15 @@ ds_set_surfaces (GstVaapiDeinterlaceState * ds)
     meta = gst_buffer_get_vaapi_video_meta (buf);
     ds->surfaces[ds->num_surfaces++] = gst_vaapi_video_meta_get_surface (meta);
   }
+
+  /* Buffers still pending after the one being processed are its
+     future references */
+  ds->num_future_surfaces = 0;
+  for (i = 0; i < MIN (ds->num_pending, ds->num_backward_refs); i++) {
+    meta = gst_buffer_get_vaapi_video_meta (ds->pending[i]);
+    ds->future_surfaces[ds->num_future_surfaces++] =
+        gst_vaapi_video_meta_get_surface (meta);
+  }
 }
 
 static GstVaapiFilterOpInfo *
@@ -330,7 +394,7 @@ gst_vaapipostproc_destroy_filter (GstVaapiPostproc * postproc)
 static void
 gst_vaapipostproc_destroy (GstVaapiPostproc * postproc)
 {
-  ds_reset (&postproc->deinterlace_state);
+  ds_clear (&postproc->deinterlace_state);
   gst_vaapipostproc_destroy_filter (postproc);
 
   gst_caps_replace (&postproc->allowed_sinkpad_caps, NULL);
@@ -343,7 +407,7 @@ gst_vaapipostproc_start (GstBaseTransform * trans)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
 
-  ds_reset (&postproc->deinterlace_state);
+  ds_clear (&postproc->deinterlace_state);
   if (!gst_vaapi_plugin_base_open (GST_VAAPI_PLUGIN_BASE (postproc)))
     return FALSE;
   g_mutex_lock (&postproc->postproc_lock);
@@ -359,7 +423,7 @@ gst_vaapipostproc_stop (GstBaseTransform * trans)
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
 
   g_mutex_lock (&postproc->postproc_lock);
-  ds_reset (&postproc->deinterlace_state);
+  ds_clear (&postproc->deinterlace_state);
   gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (postproc));
 
   postproc->field_duration = GST_CLOCK_TIME_NONE;
@@ -846,6 +910,85 @@ rotate_crop_meta (GstVaapiPostproc * const postproc, const GstVideoMeta * vmeta,
   }
 }
 
+/* Checks whether @buf does not immediately follow @prev_buf, in which
+   case neither can be used as a reference for the other one */
+static gboolean
+is_discont_buffer (GstVaapiPostproc * postproc, GstBuffer * prev_buf,
+    GstBuffer * buf)
+{
+  GstClockTime prev_pts, pts;
+  GstClockTimeDiff pts_diff;
+
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))
+    return TRUE;
+  if (!GST_BUFFER_FLAG_IS_SET (prev_buf, GST_VIDEO_BUFFER_FLAG_TFF) !=
+      !GST_BUFFER_FLAG_IS_SET (buf, GST_VIDEO_BUFFER_FLAG_TFF))
+    return TRUE;
+
+  prev_pts = GST_BUFFER_TIMESTAMP (prev_buf);
+  pts = GST_BUFFER_TIMESTAMP (buf);
+  if (!GST_CLOCK_TIME_IS_VALID (prev_pts) || !GST_CLOCK_TIME_IS_VALID (pts)
+      || prev_pts == pts)
+    return FALSE;
+
+  /* Consecutive frames are two fields apart, allow for rounding errors */
+  pts_diff = GST_CLOCK_DIFF (prev_pts, pts);
+  return pts_diff < 0 || (postproc->field_duration > 0 &&
+      pts_diff >= postproc->field_duration * 3 - 1);
+}
+
+/* Sizes the deinterlacing history after the number of references the
+   driver needs for the current deinterlacing method */
+static void
+update_deinterlace_references (GstVaapiPostproc * postproc)
+{
+  GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
+  guint num_forward_refs, num_backward_refs;
+
+  if (ds->refs_method == postproc->deinterlace_method)
+    return;
+
+  if (!gst_vaapi_filter_get_deinterlacing_references (postproc->filter,
+          &num_forward_refs, &num_backward_refs)) {
+    num_forward_refs = GST_VAAPI_DEINTERLACE_MAX_REFERENCES;
+    num_backward_refs = 0;
+  }
+
+  /* Past references have priority over future ones, which delay the
+     output */
+  num_forward_refs = MIN (num_forward_refs,
+      GST_VAAPI_DEINTERLACE_MAX_REFERENCES);
+  num_backward_refs = MIN (num_backward_refs,
+      GST_VAAPI_DEINTERLACE_MAX_REFERENCES - num_forward_refs);
+
+  GST_INFO_OBJECT (postproc, "deinterlace-method %u uses %u past and %u "
+      "future references", postproc->deinterlace_method, num_forward_refs,
+      num_backward_refs);
+
+  ds->refs_method = postproc->deinterlace_method;
+  ds->num_forward_refs = num_forward_refs;
+  if (ds->num_backward_refs != num_backward_refs) {
+    ds->num_backward_refs = num_backward_refs;
+    gst_element_post_message (GST_ELEMENT_CAST (postproc),
+        gst_message_new_latency (GST_OBJECT_CAST (postproc)));
+  }
+}
+
+/* Checks whether @buf needs to wait for its future references */
+static gboolean
+should_delay_buffer (GstVaapiPostproc * postproc, GstBuffer * buf)
+{
+  GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
+
+  if (!postproc->has_vpp ||
+      !(postproc->flags & GST_VAAPI_POSTPROC_FLAG_DEINTERLACE))
+    return FALSE;
+  if (ds->num_backward_refs == 0 ||
+      ds->refs_method != postproc->deinterlace_method)
+    return FALSE;
+  return should_deinterlace_buffer (postproc, buf);
+}
+
 static GstFlowReturn
 gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     GstBuffer * outbuf)
@@ -903,16 +1046,11 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
 
   deint_method = postproc->deinterlace_method;
   deint_refs = deint_method_is_advanced (deint_method);
-  if (deint_refs && 0) {
+  if (deint_refs) {
     GstBuffer *const prev_buf = ds_get_buffer (ds, 0);
-    GstClockTime prev_pts, pts = GST_BUFFER_TIMESTAMP (inbuf);
     /* Reset deinterlacing state when there is a discontinuity */
-    if (prev_buf && (prev_pts = GST_BUFFER_TIMESTAMP (prev_buf)) != pts) {
-      const GstClockTimeDiff pts_diff = GST_CLOCK_DIFF (prev_pts, pts);
-      if (pts_diff < 0 || (postproc->field_duration > 0 &&
-              pts_diff >= postproc->field_duration * 3 - 1))
-        ds_reset (ds);
-    }
+    if (prev_buf && is_discont_buffer (postproc, prev_buf, inbuf))
+      ds_reset (ds);
   }
 
   ds->deint = deint;
@@ -956,9 +1094,11 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
       }
 
       if (deint_refs) {
+        update_deinterlace_references (postproc);
         ds_set_surfaces (ds);
         if (!gst_vaapi_filter_set_deinterlacing_references (postproc->filter,
-                ds->surfaces, ds->num_surfaces, NULL, 0))
+                ds->surfaces, ds->num_surfaces, ds->future_surfaces,
+                ds->num_future_surfaces))
           goto error_op_deinterlace;
       }
     } else if (deint_changed) {
@@ -1018,7 +1158,8 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
 
     if (deint_refs
         && !gst_vaapi_filter_set_deinterlacing_references (postproc->filter,
-            ds->surfaces, ds->num_surfaces, NULL, 0))
+            ds->surfaces, ds->num_surfaces, ds->future_surfaces,
+            ds->num_future_surfaces))
       goto error_op_deinterlace;
   } else if (deint_changed
       && !gst_vaapi_filter_set_deinterlacing (postproc->filter, deint_method,
@@ -1038,7 +1179,7 @@ gst_vaapipostproc_process_vpp (GstBaseTransform * trans, GstBuffer * inbuf,
     GST_BUFFER_TIMESTAMP (outbuf) = timestamp + postproc->field_duration;
     GST_BUFFER_DURATION (outbuf) = postproc->field_duration;
     if (discont) {
-      GST_BUFFER_FLAG_SET (fieldbuf, GST_BUFFER_FLAG_DISCONT);
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
       discont = FALSE;
     }
   }
@@ -1534,24 +1675,18 @@ gst_vaapipostproc_transform_meta (GstBaseTransform * trans, GstBuffer * outbuf,
 }
 
 static GstFlowReturn
-gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+gst_vaapipostproc_transform_frame (GstBaseTransform * trans, GstBuffer * buf,
     GstBuffer * outbuf)
 {
   GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
   GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (postproc);
-  GstBuffer *buf, *sys_buf = NULL;
+  GstBuffer *sys_buf = NULL;
   GstFlowReturn ret;
 
-  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, inbuf, &buf);
-  if (ret != GST_FLOW_OK)
-    return GST_FLOW_ERROR;
-
   if (GST_VAAPI_PLUGIN_BASE_COPY_OUTPUT_FRAME (trans)) {
     GstBuffer *va_buf = create_output_buffer (postproc);
-    if (!va_buf) {
-      ret = GST_FLOW_ERROR;
-      goto done;
-    }
+    if (!va_buf)
+      return GST_FLOW_ERROR;
     sys_buf = outbuf;
     outbuf = va_buf;
   }
@@ -1578,19 +1713,90 @@ gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   ret = gst_vaapipostproc_passthrough (trans, buf, outbuf);
 
 done:
-  gst_buffer_unref (buf);
-
   if (sys_buf) {
     if (!gst_vaapi_plugin_copy_va_buffer (plugin, outbuf, sys_buf))
-      return GST_FLOW_ERROR;
+      ret = GST_FLOW_ERROR;
 
     gst_buffer_unref (outbuf);
-    outbuf = sys_buf;
   }
 
   return ret;
 }
 
+/* Processes and pushes the frames still waiting for their future
+   references, with whatever references are available */
+static GstFlowReturn
+gst_vaapipostproc_drain (GstVaapiPostproc * postproc)
+{
+  GstBaseTransform *const trans = GST_BASE_TRANSFORM (postproc);
+  GstBaseTransformClass *const klass = GST_BASE_TRANSFORM_GET_CLASS (trans);
+  GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
+  GstBuffer *buf, *outbuf;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (ds->num_pending > 0)
+    GST_DEBUG_OBJECT (postproc, "draining %u pending frames",
+        ds->num_pending);
+
+  while ((buf = ds_pop_pending (ds)) != NULL) {
+    outbuf = NULL;
+    ret = klass->prepare_output_buffer (trans, buf, &outbuf);
+    if (ret == GST_FLOW_OK)
+      ret = gst_vaapipostproc_transform_frame (trans, buf, outbuf);
+    gst_buffer_unref (buf);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_replace (&outbuf, NULL);
+      break;
+    }
+
+    ret = gst_pad_push (trans->srcpad, outbuf);
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  ds_clear_pending (ds);
+  return ret;
+}
+
+static GstFlowReturn
+gst_vaapipostproc_transform (GstBaseTransform * trans, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (postproc);
+  GstVaapiDeinterlaceState *const ds = &postproc->deinterlace_state;
+  GstBuffer *buf;
+  gboolean delay;
+  GstFlowReturn ret;
+
+  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, inbuf, &buf);
+  if (ret != GST_FLOW_OK)
+    return GST_FLOW_ERROR;
+
+  /* Frames waiting for their future references cannot use this one
+     as a reference, so process them first */
+  delay = should_delay_buffer (postproc, buf);
+  if (ds->num_pending > 0 && (!delay || is_discont_buffer (postproc,
+              ds->pending[ds->num_pending - 1], buf))) {
+    ret = gst_vaapipostproc_drain (postproc);
+    if (ret != GST_FLOW_OK)
+      goto done;
+  }
+
+  if (delay) {
+    GstBuffer *const cur_buf = ds_push_pending (ds, buf);
+    if (!cur_buf)
+      return GST_BASE_TRANSFORM_FLOW_DROPPED;
+    buf = cur_buf;
+  }
+
+  ret = gst_vaapipostproc_transform_frame (trans, buf, outbuf);
+
+done:
+  gst_buffer_unref (buf);
+  return ret;
+}
+
 static gboolean
 ensure_buffer_pool (GstVaapiPostproc * postproc, GstVideoInfo * vi)
 {
@@ -1770,6 +1976,36 @@ done:
   return ret;
 }
 
+/* Adds the frames held back as future deinterlacing references to the
+   upstream latency */
+static gboolean
+gst_vaapipostproc_query_latency (GstBaseTransform * trans, GstQuery * query)
+{
+  GstVaapiPostproc *const postproc = GST_VAAPIPOSTPROC (trans);
+  const guint num_frames = postproc->deinterlace_state.num_backward_refs;
+  GstClockTime min_latency, max_latency, latency;
+  gboolean live;
+
+  if (!GST_BASE_TRANSFORM_CLASS (gst_vaapipostproc_parent_class)->query (trans,
+          GST_PAD_SRC, query))
+    return FALSE;
+
+  if (num_frames == 0 || !postproc->field_duration ||
+      !GST_CLOCK_TIME_IS_VALID (postproc->field_duration))
+    return TRUE;
+
+  gst_query_parse_latency (query, &live, &min_latency, &max_latency);
+  latency = num_frames * 2 * postproc->field_duration;
+  min_latency += latency;
+  if (GST_CLOCK_TIME_IS_VALID (max_latency))
+    max_latency += latency;
+  gst_query_set_latency (query, live, min_latency, max_latency);
+
+  GST_DEBUG_OBJECT (postproc, "added %" GST_TIME_FORMAT " of latency for %u "
+      "future references", GST_TIME_ARGS (latency), num_frames);
+  return TRUE;
+}
+
 static gboolean
 gst_vaapipostproc_query (GstBaseTransform * trans,
     GstPadDirection direction, GstQuery * query)
@@ -1785,6 +2021,9 @@ gst_vaapipostproc_query (GstBaseTransform * trans,
     }
   }
 
+  if (GST_QUERY_TYPE (query) == GST_QUERY_LATENCY && direction == GST_PAD_SRC)
+    return gst_vaapipostproc_query_latency (trans, query);
+
   return
       GST_BASE_TRANSFORM_CLASS (gst_vaapipostproc_parent_class)->query (trans,
       direction, query);
@@ -2017,6 +2256,14 @@ gst_vaapipostproc_sink_event (GstBaseTransform * trans, GstEvent * event)
         }
       }
       break;
+    case GST_EVENT_EOS:
+    case GST_EVENT_CAPS:
+      gst_vaapipostproc_drain (postproc);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      ds_clear_pending (&postproc->deinterlace_state);
+      ds_reset (&postproc->deinterlace_state);
+      break;
     default:
       break;
   }
@@ -77,7 +77,8 @@ typedef enum
  * GST_VAAPI_DEINTERLACE_MAX_REFERENCES:
  *
  * This represents the maximum number of VA surfaces we could keep as
- * references for advanced deinterlacing.
+ * references for advanced deinterlacing, past and future references
+ * combined.
  *
  * Note: if the upstream element is vaapidecode, then the maximum
  * number of allowed surfaces used as references shall be less than
@@ -136,6 +137,14 @@ typedef enum
  * @buffers_index: next free slot in the history buffer
  * @surfaces: array of surfaces used as references
  * @num_surfaces: number of active surfaces in that array
+ * @pending: queue of buffers waiting for their future references, oldest
+ *   first
+ * @num_pending: number of buffers in the pending queue
+ * @future_surfaces: array of surfaces used as future references
+ * @num_future_surfaces: number of active surfaces in that array
+ * @refs_method: deinterlacing method the reference counts were queried for
+ * @num_forward_refs: number of past references required by the driver
+ * @num_backward_refs: number of future references required by the driver
  * @deint: flag: previous buffers were interlaced?
  * @tff: flag: previous buffers were organized as top-field-first?
  *
@@ -147,6 +156,13 @@ struct _GstVaapiDeinterlaceState
   guint buffers_index;
   GstVaapiSurface *surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
   guint num_surfaces;
+  GstBuffer *pending[GST_VAAPI_DEINTERLACE_MAX_REFERENCES + 1];
+  guint num_pending;
+  GstVaapiSurface *future_surfaces[GST_VAAPI_DEINTERLACE_MAX_REFERENCES];
+  guint num_future_surfaces;
+  GstVaapiDeinterlaceMethod refs_method;
+  guint num_forward_refs;
+  guint num_backward_refs;
   guint deint:1;
   guint tff:1;
 };
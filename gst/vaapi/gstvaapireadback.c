@@ -0,0 +1,364 @@
+/*
+ *  gstvaapireadback.c - VA surfaces readback to system memory
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Mapped VA surfaces are usually uncached or write-combined memory,
+ * where regular loads are very slow. Rows are read with streaming
+ * loads into a small bounce buffer that stays in the L1 cache, then
+ * copied from there to the destination buffer. Large planes are split
+ * into stripes processed in parallel by a few worker threads, shared
+ * by all the readback engines of the process.
+ */
+
+#include "gstcompat.h"
+#include <gst/vaapi/gstvaapiutils_copy.h>
+#include "gstvaapireadback.h"
+
+GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
+
+/* Size of the per-thread bounce buffer, small enough to fit in L1 */
+#define BOUNCE_BUFFER_SIZE      (16 * 1024)
+
+/* Maximum number of threads copying a frame, including the caller */
+#define MAX_THREADS             4
+
+/* Planes smaller than this are not split across threads */
+#define MIN_STRIPE_SIZE         (256 * 1024)
+
+#define MAX_JOBS                (GST_VIDEO_MAX_PLANES * MAX_THREADS)
+
+typedef struct
+{
+  const guint8 *src;
+  guint src_stride;
+  guint8 *dst;
+  guint dst_stride;
+  guint width;
+  guint height;
+} ReadbackJob;
+
+typedef struct
+{
+  ReadbackJob jobs[MAX_JOBS];
+  guint num_jobs;
+  gint next_job;
+  guint num_helpers;
+  gboolean use_bounce_buffer;
+  GMutex mutex;
+  GCond cond;
+} ReadbackTask;
+
+struct _GstVaapiReadback
+{
+  GThreadPool *workers;         /* shared, see get_workers() */
+  guint num_threads;
+  guint64 total_bytes;
+  GstClockTime total_time;
+};
+
+static GPrivate g_bounce_buffer = G_PRIVATE_INIT (g_free);
+
+static guint8 *
+get_bounce_buffer (void)
+{
+  guint8 *buf = g_private_get (&g_bounce_buffer);
+
+  if (!buf) {
+    buf = g_malloc (BOUNCE_BUFFER_SIZE + 64);
+    g_private_set (&g_bounce_buffer, buf);
+  }
+  return (guint8 *) GST_ROUND_UP_64 (GPOINTER_TO_SIZE (buf));
+}
+
+static void
+run_job (const ReadbackJob * job, gboolean use_bounce_buffer)
+{
+  guint8 *bounce;
+  guint x, y, w, h, bounce_stride, chunk_width, chunk_height;
+
+  if (!use_bounce_buffer) {
+    gst_vaapi_copy_plane (job->dst, job->dst_stride, job->src,
+        job->src_stride, job->width, job->height,
+        GST_VAAPI_COPY_FLAG_STREAMING_LOAD);
+    return;
+  }
+
+  /* Copy blocks of at most BOUNCE_BUFFER_SIZE bytes, keeping the
+     source alignment of each block so streaming loads apply */
+  bounce = get_bounce_buffer ();
+  chunk_width = MIN (job->width, BOUNCE_BUFFER_SIZE);
+  for (x = 0; x < job->width; x += chunk_width) {
+    w = MIN (chunk_width, job->width - x);
+    bounce_stride = GST_ROUND_UP_64 (w);
+    chunk_height = BOUNCE_BUFFER_SIZE / bounce_stride;
+    for (y = 0; y < job->height; y += chunk_height) {
+      h = MIN (chunk_height, job->height - y);
+      gst_vaapi_copy_plane (bounce, bounce_stride,
+          job->src + y * job->src_stride + x, job->src_stride, w, h,
+          GST_VAAPI_COPY_FLAG_STREAMING_LOAD);
+      gst_vaapi_copy_plane (job->dst + y * job->dst_stride + x,
+          job->dst_stride, bounce, bounce_stride, w, h, 0);
+    }
+  }
+}
+
+static void
+run_task (ReadbackTask * task)
+{
+  guint i;
+
+  while ((i = g_atomic_int_add (&task->next_job, 1)) < task->num_jobs)
+    run_job (&task->jobs[i], task->use_bounce_buffer);
+}
+
+static void
+worker_func (gpointer data, gpointer user_data)
+{
+  ReadbackTask *const task = data;
+
+  run_task (task);
+
+  g_mutex_lock (&task->mutex);
+  task->num_helpers--;
+  g_cond_signal (&task->cond);
+  g_mutex_unlock (&task->mutex);
+}
+
+/* Returns the worker threads pool shared by all the readback engines,
+   so that the number of copy threads stays bounded however many
+   elements read frames back. The pool is never freed */
+static GThreadPool *
+get_workers (void)
+{
+  static gsize g_workers = 0;
+
+  if (g_once_init_enter (&g_workers)) {
+    const guint num_threads = CLAMP (g_get_num_processors (), 1, MAX_THREADS);
+    GThreadPool *workers = NULL;
+
+    if (num_threads > 1)
+      workers = g_thread_pool_new (worker_func, NULL, num_threads - 1,
+          FALSE, NULL);
+    g_once_init_leave (&g_workers, GPOINTER_TO_SIZE (workers) | 1);
+  }
+  return GSIZE_TO_POINTER (g_workers & ~(gsize) 1);
+}
+
+/* Splits each plane into stripes, returns the number of bytes to copy */
+static gsize
+setup_task (GstVaapiReadback * readback, ReadbackTask * task,
+    GstVideoFrame * dst_frame, GstVideoFrame * src_frame)
+{
+  const GstVideoFormatInfo *const finfo = src_frame->info.finfo;
+  guint p, c, s, num_stripes, width, height, rows, y;
+  gsize size = 0;
+
+  task->num_jobs = 0;
+  for (p = 0; p < GST_VIDEO_FRAME_N_PLANES (src_frame); p++) {
+    for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (src_frame); c++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, c) == p)
+        break;
+    }
+    if (c == GST_VIDEO_FRAME_N_COMPONENTS (src_frame) ||
+        GST_VIDEO_FRAME_COMP_PSTRIDE (src_frame, c) == 0)
+      return 0;
+
+    width = GST_VIDEO_FRAME_COMP_WIDTH (src_frame, c) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (src_frame, c);
+    height = GST_VIDEO_FRAME_COMP_HEIGHT (src_frame, c);
+    if (width > GST_VIDEO_FRAME_PLANE_STRIDE (dst_frame, p) ||
+        width > GST_VIDEO_FRAME_PLANE_STRIDE (src_frame, p))
+      return 0;
+
+    num_stripes = CLAMP ((gsize) width * height / MIN_STRIPE_SIZE, 1,
+        readback->num_threads);
+    rows = (height + num_stripes - 1) / num_stripes;
+    for (s = 0, y = 0; s < num_stripes && y < height; s++, y += rows) {
+      ReadbackJob *const job = &task->jobs[task->num_jobs++];
+
+      job->src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src_frame, p);
+      job->src = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA (src_frame, p) +
+          (gsize) y * job->src_stride;
+      job->dst_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dst_frame, p);
+      job->dst = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (dst_frame, p) +
+          (gsize) y * job->dst_stride;
+      job->width = width;
+      job->height = MIN (rows, height - y);
+    }
+    size += (gsize) width * height;
+  }
+  return size;
+}
+
+/* Returns the number of bytes copied, or zero if the frame layout is
+   not supported */
+static gsize
+copy_frame (GstVaapiReadback * readback, GstVideoFrame * dst_frame,
+    GstVideoFrame * src_frame)
+{
+  ReadbackTask task;
+  gsize size;
+  guint i;
+
+  if (GST_VIDEO_FRAME_FORMAT (dst_frame) != GST_VIDEO_FRAME_FORMAT (src_frame)
+      || GST_VIDEO_FORMAT_INFO_IS_TILED (src_frame->info.finfo)
+      || GST_VIDEO_FORMAT_INFO_HAS_PALETTE (src_frame->info.finfo))
+    return 0;
+
+  size = setup_task (readback, &task, dst_frame, src_frame);
+  if (!size)
+    return 0;
+
+  /* Without streaming loads, the bounce buffer is only overhead */
+  task.use_bounce_buffer =
+      gst_vaapi_copy_get_cpu () != GST_VAAPI_COPY_CPU_SCALAR;
+  task.next_job = 0;
+  task.num_helpers = 0;
+
+  if (task.num_jobs == GST_VIDEO_FRAME_N_PLANES (src_frame) ||
+      !readback->workers) {
+    run_task (&task);
+    return size;
+  }
+
+  g_mutex_init (&task.mutex);
+  g_cond_init (&task.cond);
+
+  /* The caller processes jobs as well */
+  g_mutex_lock (&task.mutex);
+  for (i = 0; i < MIN (task.num_jobs, readback->num_threads) - 1; i++) {
+    if (!g_thread_pool_push (readback->workers, &task, NULL))
+      break;
+    task.num_helpers++;
+  }
+  g_mutex_unlock (&task.mutex);
+
+  run_task (&task);
+
+  g_mutex_lock (&task.mutex);
+  while (task.num_helpers > 0)
+    g_cond_wait (&task.cond, &task.mutex);
+  g_mutex_unlock (&task.mutex);
+
+  g_cond_clear (&task.cond);
+  g_mutex_clear (&task.mutex);
+  return size;
+}
+
+/**
+ * gst_vaapi_readback_new:
+ *
+ * Creates a readback engine, used to copy VA buffers into system
+ * memory buffers. Worker threads are shared by all the readback
+ * engines.
+ *
+ * Returns: a newly allocated #GstVaapiReadback
+ **/
+GstVaapiReadback *
+gst_vaapi_readback_new (void)
+{
+  GstVaapiReadback *readback;
+
+#ifndef GST_DISABLE_GST_DEBUG
+  GST_DEBUG_CATEGORY_GET (CAT_PERFORMANCE, "GST_PERFORMANCE");
+#endif
+
+  readback = g_new0 (GstVaapiReadback, 1);
+  readback->workers = get_workers ();
+  readback->num_threads = readback->workers ?
+      g_thread_pool_get_max_threads (readback->workers) + 1 : 1;
+  return readback;
+}
+
+/**
+ * gst_vaapi_readback_free:
+ * @readback: a #GstVaapiReadback
+ *
+ * Frees @readback.
+ **/
+void
+gst_vaapi_readback_free (GstVaapiReadback * readback)
+{
+  if (!readback)
+    return;
+
+  GST_CAT_INFO (CAT_PERFORMANCE, "read back %" G_GUINT64_FORMAT " bytes in %"
+      GST_TIME_FORMAT, readback->total_bytes,
+      GST_TIME_ARGS (readback->total_time));
+  g_free (readback);
+}
+
+/**
+ * gst_vaapi_readback_copy_buffer:
+ * @readback: a #GstVaapiReadback
+ * @info: the #GstVideoInfo of both buffers
+ * @inbuf: a #GstBuffer with VA memory type
+ * @outbuf: a #GstBuffer with system allocated memory
+ *
+ * Copies the pixels of @inbuf into @outbuf. The VA buffer is mapped
+ * only for the duration of the copy itself. Formats that can't be
+ * split into planes of rows are copied with gst_video_frame_copy().
+ *
+ * Returns: %TRUE if successful, %FALSE otherwise.
+ **/
+gboolean
+gst_vaapi_readback_copy_buffer (GstVaapiReadback * readback,
+    GstVideoInfo * info, GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  GstVideoFrame src_frame, dst_frame;
+  GstClockTime start_time, map_time, copy_time;
+  gsize size;
+  gboolean success = TRUE;
+
+  g_return_val_if_fail (readback != NULL, FALSE);
+
+  if (!gst_video_frame_map (&dst_frame, info, outbuf, GST_MAP_WRITE))
+    return FALSE;
+
+  start_time = gst_util_get_timestamp ();
+  if (!gst_video_frame_map (&src_frame, info, inbuf, GST_MAP_READ)) {
+    gst_video_frame_unmap (&dst_frame);
+    return FALSE;
+  }
+  map_time = gst_util_get_timestamp ();
+
+  size = copy_frame (readback, &dst_frame, &src_frame);
+  if (!size) {
+    success = gst_video_frame_copy (&dst_frame, &src_frame);
+    size = GST_VIDEO_INFO_SIZE (info);
+  }
+  gst_video_frame_unmap (&src_frame);
+  copy_time = gst_util_get_timestamp ();
+  gst_video_frame_unmap (&dst_frame);
+
+  if (!success)
+    return FALSE;
+
+  readback->total_bytes += size;
+  readback->total_time += copy_time - start_time;
+
+  GST_CAT_INFO (CAT_PERFORMANCE, "read back %" G_GSIZE_FORMAT " bytes in %"
+      GST_TIME_FORMAT " (map %" GST_TIME_FORMAT ", %.2f GB/s), %"
+      G_GUINT64_FORMAT " bytes in %" GST_TIME_FORMAT " so far", size,
+      GST_TIME_ARGS (copy_time - start_time),
+      GST_TIME_ARGS (map_time - start_time),
+      (gdouble) size / MAX (copy_time - map_time, 1), readback->total_bytes,
+      GST_TIME_ARGS (readback->total_time));
+  return TRUE;
+}
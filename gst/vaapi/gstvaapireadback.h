@@ -0,0 +1,44 @@
+/*
+ *  gstvaapireadback.h - VA surfaces readback to system memory
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef GST_VAAPI_READBACK_H
+#define GST_VAAPI_READBACK_H
+
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVaapiReadback GstVaapiReadback;
+
+G_GNUC_INTERNAL
+GstVaapiReadback *
+gst_vaapi_readback_new (void);
+
+G_GNUC_INTERNAL
+void
+gst_vaapi_readback_free (GstVaapiReadback * readback);
+
+G_GNUC_INTERNAL
+gboolean
+gst_vaapi_readback_copy_buffer (GstVaapiReadback * readback,
+    GstVideoInfo * info, GstBuffer * inbuf, GstBuffer * outbuf);
+
+G_END_DECLS
+
+#endif /* GST_VAAPI_READBACK_H */
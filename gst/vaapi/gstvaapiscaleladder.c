@@ -0,0 +1,1060 @@
+/*
+ *  gstvaapiscaleladder.c - VA-API multi-resolution scaler
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/**
+ * SECTION:element-vaapiscaleladder
+ * @title: vaapiscaleladder
+ * @short_description: A VA-API based multi-resolution scaler
+ *
+ * vaapiscaleladder scales every input frame to several resolutions at
+ * once, one per requested source pad, e.g. to produce the renditions
+ * of an adaptive bitrate ladder. Unlike a tee followed by one
+ * vaapipostproc per branch, a single VA video processing pipeline is
+ * used, and all the scaling operations of a frame are submitted
+ * back-to-back. Source pads with the same output size share their
+ * pool of VA surfaces.
+ *
+ * The size of each rendition is set with the width and height
+ * properties of its source pad. When only one of them is set, the
+ * other one is derived from the input aspect ratio. Output is always
+ * in VA surfaces.
+ *
+ * ## Example launch line
+ *
+ * |[
+ *   gst-launch-1.0 filesrc location=big_buck_bunny.mp4 ! qtdemux \
+ *     ! vaapidecodebin ! vaapiscaleladder name=ladder \
+ *       ladder.src_0::height=720 ladder.src_1::height=480 \
+ *     ladder.src_0 ! queue ! vaapih264enc ! fakesink \
+ *     ladder.src_1 ! queue ! vaapih264enc ! fakesink
+ * ]|
+ */
+
+#include "gstcompat.h"
+#include <stdio.h>
+
+#include "gstvaapiscaleladder.h"
+#include "gstvaapipluginutil.h"
+#include "gstvaapivideobuffer.h"
+#include "gstvaapivideobufferpool.h"
+#include "gstvaapivideomemory.h"
+#include "gstvaapivideometa.h"
+
+#define GST_PLUGIN_NAME "vaapiscaleladder"
+#define GST_PLUGIN_DESC "A VA-API based multi-resolution scaler"
+
+GST_DEBUG_CATEGORY_STATIC (gst_debug_vaapi_scale_ladder);
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT gst_debug_vaapi_scale_ladder
+#else
+#define GST_CAT_DEFAULT NULL
+#endif
+
+/* Default templates */
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_sink_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS ";"
+  GST_VIDEO_CAPS_MAKE (GST_VAAPI_FORMATS_ALL);
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static const char gst_vaapi_scale_ladder_src_caps_str[] =
+  GST_VAAPI_MAKE_SURFACE_CAPS;
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_sink_factory =
+  GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_sink_caps_str));
+/* *INDENT-ON* */
+
+/* *INDENT-OFF* */
+static GstStaticPadTemplate gst_vaapi_scale_ladder_src_factory =
+  GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (gst_vaapi_scale_ladder_src_caps_str));
+/* *INDENT-ON* */
+
+#define DEFAULT_SCALE_METHOD  GST_VAAPI_SCALE_METHOD_DEFAULT
+#define DEFAULT_PAD_WIDTH     0
+#define DEFAULT_PAD_HEIGHT    0
+
+enum
+{
+  PROP_0,
+  PROP_SCALE_METHOD,
+};
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_WIDTH,
+  PROP_PAD_HEIGHT,
+};
+
+G_DEFINE_TYPE (GstVaapiScaleLadderSrcPad, gst_vaapi_scale_ladder_src_pad,
+    GST_TYPE_PAD);
+
+static void
+gst_vaapi_scale_ladder_src_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadderSrcPad *const pad =
+      GST_VAAPI_SCALE_LADDER_SRC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      GST_OBJECT_LOCK (pad);
+      g_value_set_uint (value, pad->width);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    case PROP_PAD_HEIGHT:
+      GST_OBJECT_LOCK (pad);
+      g_value_set_uint (value, pad->height);
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadderSrcPad *const pad =
+      GST_VAAPI_SCALE_LADDER_SRC_PAD (object);
+
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      GST_OBJECT_LOCK (pad);
+      pad->width = g_value_get_uint (value);
+      pad->need_reconfigure = TRUE;
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    case PROP_PAD_HEIGHT:
+      GST_OBJECT_LOCK (pad);
+      pad->height = g_value_get_uint (value);
+      pad->need_reconfigure = TRUE;
+      GST_OBJECT_UNLOCK (pad);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_finalize (GObject * object)
+{
+  GstVaapiScaleLadderSrcPad *const pad =
+      GST_VAAPI_SCALE_LADDER_SRC_PAD (object);
+
+  gst_vaapi_video_pool_replace (&pad->surface_pool, NULL);
+  gst_vaapi_pad_private_finalize (pad->priv);
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_src_pad_parent_class)->finalize
+      (object);
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_class_init (GstVaapiScaleLadderSrcPadClass *
+    klass)
+{
+  GObjectClass *const gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gst_vaapi_scale_ladder_src_pad_finalize;
+  gobject_class->set_property = gst_vaapi_scale_ladder_src_pad_set_property;
+  gobject_class->get_property = gst_vaapi_scale_ladder_src_pad_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_WIDTH,
+      g_param_spec_uint ("width", "Width",
+          "Output video width (0: derived from the input)",
+          0, G_MAXINT, DEFAULT_PAD_WIDTH,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PAD_HEIGHT,
+      g_param_spec_uint ("height", "Height",
+          "Output video height (0: derived from the input)",
+          0, G_MAXINT, DEFAULT_PAD_HEIGHT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_vaapi_scale_ladder_src_pad_init (GstVaapiScaleLadderSrcPad * pad)
+{
+  pad->width = DEFAULT_PAD_WIDTH;
+  pad->height = DEFAULT_PAD_HEIGHT;
+  pad->need_reconfigure = TRUE;
+  gst_video_info_init (&pad->surface_pool_info);
+  pad->priv = gst_vaapi_pad_private_new ();
+}
+
+static void
+gst_vaapi_scale_ladder_child_proxy_init (gpointer g_iface,
+    gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (GstVaapiScaleLadder, gst_vaapi_scale_ladder,
+    GST_TYPE_ELEMENT, GST_VAAPI_PLUGIN_BASE_INIT_INTERFACES
+    G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_vaapi_scale_ladder_child_proxy_init));
+
+GST_VAAPI_PLUGIN_BASE_DEFINE_SET_CONTEXT (gst_vaapi_scale_ladder_parent_class);
+
+/* Computes the output size of @pad, keeping the input aspect ratio
+   for the dimensions that were not requested */
+static void
+get_output_size (GstVaapiScaleLadderSrcPad * pad, const GstVideoInfo * in_vi,
+    guint * width_ptr, guint * height_ptr)
+{
+  const guint in_width = GST_VIDEO_INFO_WIDTH (in_vi);
+  const guint in_height = GST_VIDEO_INFO_HEIGHT (in_vi);
+  guint width, height;
+
+  GST_OBJECT_LOCK (pad);
+  width = pad->width;
+  height = pad->height;
+  GST_OBJECT_UNLOCK (pad);
+
+  if (width == 0 && height == 0) {
+    width = in_width;
+    height = in_height;
+  } else if (height == 0) {
+    height = GST_ROUND_UP_2 (gst_util_uint64_scale_int (width, in_height,
+            in_width));
+  } else if (width == 0) {
+    width = GST_ROUND_UP_2 (gst_util_uint64_scale_int (height, in_width,
+            in_height));
+  }
+
+  *width_ptr = width;
+  *height_ptr = height;
+}
+
+static GstCaps *
+get_src_pad_caps (GstVaapiScaleLadder * ladder, GstVaapiScaleLadderSrcPad * pad)
+{
+  const GstVideoInfo *const in_vi =
+      GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder);
+  GstVideoInfo vi;
+  GstCaps *caps;
+  guint width, height;
+
+  get_output_size (pad, in_vi, &width, &height);
+
+  vi = *in_vi;
+  gst_video_info_change_format (&vi, GST_VIDEO_INFO_FORMAT (in_vi), width,
+      height);
+  GST_VIDEO_INFO_COLORIMETRY (&vi) = GST_VIDEO_INFO_COLORIMETRY (in_vi);
+  GST_VIDEO_INFO_CHROMA_SITE (&vi) = GST_VIDEO_INFO_CHROMA_SITE (in_vi);
+
+  caps = gst_video_info_to_caps (&vi);
+  if (caps) {
+    gst_caps_set_features (caps, 0,
+        gst_caps_features_new (GST_CAPS_FEATURE_MEMORY_VAAPI_SURFACE, NULL));
+  }
+  return caps;
+}
+
+/* Shares the surfaces pool of another pad with the same output size,
+   or creates a new one */
+static gboolean
+ensure_surface_pool (GstVaapiScaleLadder * ladder,
+    GstVaapiScaleLadderSrcPad * pad)
+{
+  GstVideoInfo *const vi = &pad->priv->info;
+  GstVaapiVideoPool *pool = NULL;
+  GList *l;
+
+  if (pad->surface_pool
+      && !gst_video_info_changed (&pad->surface_pool_info, vi))
+    return TRUE;
+
+  GST_OBJECT_LOCK (ladder);
+  for (l = GST_ELEMENT (ladder)->srcpads; l; l = l->next) {
+    GstVaapiScaleLadderSrcPad *const other = l->data;
+
+    if (other != pad && other->surface_pool
+        && !gst_video_info_changed (&other->surface_pool_info, vi)) {
+      pool = gst_vaapi_video_pool_ref (other->surface_pool);
+      break;
+    }
+  }
+  GST_OBJECT_UNLOCK (ladder);
+
+  if (pool) {
+    GST_DEBUG_OBJECT (pad, "sharing surfaces pool for %dx%d",
+        GST_VIDEO_INFO_WIDTH (vi), GST_VIDEO_INFO_HEIGHT (vi));
+  } else {
+    pool = gst_vaapi_surface_pool_new_full (GST_VAAPI_PLUGIN_BASE_DISPLAY
+        (ladder), vi, 0);
+    if (!pool)
+      return FALSE;
+  }
+
+  pad->surface_pool_info = *vi;
+  gst_vaapi_video_pool_replace (&pad->surface_pool, pool);
+  gst_vaapi_video_pool_unref (pool);
+  return TRUE;
+}
+
+/* Negotiates the output caps and allocation of @pad, if needed */
+static gboolean
+ensure_src_pad (GstVaapiScaleLadder * ladder, GstVaapiScaleLadderSrcPad * pad)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstCaps *caps;
+  GstQuery *query;
+  gboolean need_reconfigure, success;
+
+  need_reconfigure = gst_pad_check_reconfigure (GST_PAD (pad));
+  GST_OBJECT_LOCK (pad);
+  need_reconfigure |= pad->need_reconfigure;
+  pad->need_reconfigure = FALSE;
+  GST_OBJECT_UNLOCK (pad);
+
+  if (!need_reconfigure && pad->priv->buffer_pool && pad->surface_pool)
+    return TRUE;
+
+  caps = get_src_pad_caps (ladder, pad);
+  if (!caps)
+    goto error_invalid_caps;
+
+  GST_DEBUG_OBJECT (pad, "output caps %" GST_PTR_FORMAT, caps);
+  if (!gst_pad_push_event (GST_PAD (pad), gst_event_new_caps (caps)))
+    goto error_set_caps;
+
+  if (!gst_vaapi_plugin_base_pad_set_caps (plugin, NULL, NULL, GST_PAD (pad),
+          caps))
+    goto error_set_caps;
+
+  /* All the output surfaces come from that pool, including those of
+     the first buffers the buffer pool allocates */
+  if (!ensure_surface_pool (ladder, pad))
+    goto error_create_pool;
+
+  query = gst_query_new_allocation (caps, TRUE);
+  if (!gst_pad_peer_query (GST_PAD (pad), query))
+    GST_DEBUG_OBJECT (pad, "peer allocation query failed");
+  success = gst_vaapi_plugin_base_pad_decide_allocation (plugin, GST_PAD (pad),
+      query);
+  gst_query_unref (query);
+  if (!success)
+    goto error_decide_allocation;
+
+  gst_caps_unref (caps);
+  return TRUE;
+
+  /* ERRORS */
+error_invalid_caps:
+  {
+    GST_ERROR_OBJECT (pad, "failed to build output caps");
+    gst_pad_mark_reconfigure (GST_PAD (pad));
+    return FALSE;
+  }
+error_set_caps:
+  {
+    GST_WARNING_OBJECT (pad, "failed to set caps %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    gst_pad_mark_reconfigure (GST_PAD (pad));
+    return FALSE;
+  }
+error_decide_allocation:
+  {
+    GST_ERROR_OBJECT (pad, "failed to decide allocation");
+    gst_caps_unref (caps);
+    gst_pad_mark_reconfigure (GST_PAD (pad));
+    return FALSE;
+  }
+error_create_pool:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create surfaces pool");
+    gst_caps_unref (caps);
+    gst_pad_mark_reconfigure (GST_PAD (pad));
+    return FALSE;
+  }
+}
+
+/* Acquires an output buffer for a surface of the shared surfaces pool
+   of @pad. The surface is passed to the buffer pool, so that buffers
+   are never backed by surfaces of the allocator, e.g. dmabuf ones */
+static GstBuffer *
+create_output_buffer (GstVaapiScaleLadder * ladder,
+    GstVaapiScaleLadderSrcPad * pad)
+{
+  GstBufferPool *const pool = pad->priv->buffer_pool;
+  GstVaapiVideoBufferPoolAcquireParams params = { {0,}, };
+  GstVaapiVideoMeta *meta;
+  GstVaapiSurfaceProxy *proxy;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+
+  g_return_val_if_fail (pool != NULL, NULL);
+
+  if (!gst_buffer_pool_is_active (pool) &&
+      !gst_buffer_pool_set_active (pool, TRUE))
+    goto error_activate_pool;
+
+  proxy = gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL
+      (pad->surface_pool));
+  if (!proxy)
+    goto error_create_proxy;
+
+  outbuf = NULL;
+  params.proxy = proxy;
+  ret = gst_buffer_pool_acquire_buffer (pool, &outbuf,
+      (GstBufferPoolAcquireParams *) & params);
+  if (ret != GST_FLOW_OK || !outbuf)
+    goto error_create_buffer;
+
+  meta = gst_buffer_get_vaapi_video_meta (outbuf);
+  if (!meta)
+    goto error_create_meta;
+
+  /* Recycled buffers that are not dmabuf ones have no surface yet */
+  if (gst_vaapi_video_meta_get_surface_proxy (meta) != proxy)
+    gst_vaapi_video_meta_set_surface_proxy (meta, proxy);
+  gst_vaapi_surface_proxy_unref (proxy);
+  return outbuf;
+
+  /* ERRORS */
+error_activate_pool:
+  {
+    GST_ERROR_OBJECT (pad, "failed to activate output video buffer pool");
+    return NULL;
+  }
+error_create_proxy:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create surface proxy from pool");
+    return NULL;
+  }
+error_create_buffer:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create output video buffer");
+    gst_vaapi_surface_proxy_unref (proxy);
+    return NULL;
+  }
+error_create_meta:
+  {
+    GST_ERROR_OBJECT (pad, "failed to create new output buffer meta");
+    gst_vaapi_surface_proxy_unref (proxy);
+    gst_buffer_unref (outbuf);
+    return NULL;
+  }
+}
+
+static GstFlowReturn
+update_flow (GstVaapiScaleLadder * ladder, GstPad * pad, GstFlowReturn ret)
+{
+  GST_OBJECT_LOCK (ladder);
+  ret = gst_flow_combiner_update_pad_flow (ladder->flow_combiner, pad, ret);
+  GST_OBJECT_UNLOCK (ladder);
+  return ret;
+}
+
+static GstFlowReturn
+gst_vaapi_scale_ladder_chain (GstPad * sinkpad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstVaapiVideoMeta *inbuf_meta;
+  GstVaapiFilterStatus status;
+  GPtrArray *pads, *outbufs, *surfaces;
+  GstBuffer *inbuf = NULL;
+  GstFlowReturn ret, pad_ret;
+  GList *l;
+  guint i, flags;
+
+  ret = gst_vaapi_plugin_base_get_input_buffer (plugin, buffer, &inbuf);
+  gst_buffer_unref (buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  inbuf_meta = gst_buffer_get_vaapi_video_meta (inbuf);
+  if (!inbuf_meta)
+    goto error_invalid_buffer;
+
+  pads = g_ptr_array_new_with_free_func (gst_object_unref);
+  outbufs = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  surfaces = g_ptr_array_new ();
+
+  GST_OBJECT_LOCK (ladder);
+  for (l = GST_ELEMENT (ladder)->srcpads; l; l = l->next)
+    g_ptr_array_add (pads, gst_object_ref (l->data));
+  GST_OBJECT_UNLOCK (ladder);
+
+  /* Acquire one output surface per linked src pad */
+  ret = GST_FLOW_OK;
+  for (i = 0; i < pads->len;) {
+    GstVaapiScaleLadderSrcPad *const pad = g_ptr_array_index (pads, i);
+    GstBuffer *outbuf;
+
+    if (!gst_pad_is_linked (GST_PAD (pad))) {
+      ret = update_flow (ladder, GST_PAD (pad), GST_FLOW_NOT_LINKED);
+      g_ptr_array_remove_index (pads, i);
+      continue;
+    }
+
+    if (!ensure_src_pad (ladder, pad)) {
+      ret = update_flow (ladder, GST_PAD (pad), GST_FLOW_NOT_NEGOTIATED);
+      g_ptr_array_remove_index (pads, i);
+      continue;
+    }
+
+    outbuf = create_output_buffer (ladder, pad);
+    if (!outbuf)
+      goto error_create_buffer;
+
+    g_ptr_array_add (outbufs, outbuf);
+    g_ptr_array_add (surfaces,
+        gst_vaapi_video_meta_get_surface (gst_buffer_get_vaapi_video_meta
+            (outbuf)));
+    i++;
+  }
+
+  if (pads->len == 0)
+    goto done;
+
+  /* Submit all the renditions at once */
+  flags = gst_vaapi_video_meta_get_render_flags (inbuf_meta) &
+      ~GST_VAAPI_PICTURE_STRUCTURE_MASK;
+  gst_vaapi_filter_set_scaling (ladder->filter, ladder->scale_method);
+  gst_vaapi_filter_set_cropping_rectangle (ladder->filter,
+      gst_vaapi_video_meta_get_render_rect (inbuf_meta));
+  status = gst_vaapi_filter_process_multi (ladder->filter,
+      gst_vaapi_video_meta_get_surface (inbuf_meta),
+      (GstVaapiSurface **) surfaces->pdata, surfaces->len, flags);
+  if (status != GST_VAAPI_FILTER_STATUS_SUCCESS)
+    goto error_process_vpp;
+
+  for (i = 0; i < pads->len; i++) {
+    GstPad *const pad = g_ptr_array_index (pads, i);
+    GstBuffer *const outbuf = g_ptr_array_index (outbufs, i);
+
+    gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_FLAGS |
+        GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+    pad_ret = gst_pad_push (pad, gst_buffer_ref (outbuf));
+    ret = update_flow (ladder, pad, pad_ret);
+  }
+
+done:
+  g_ptr_array_unref (surfaces);
+  g_ptr_array_unref (outbufs);
+  g_ptr_array_unref (pads);
+  gst_buffer_unref (inbuf);
+  return ret;
+
+  /* ERRORS */
+error_invalid_buffer:
+  {
+    GST_ERROR_OBJECT (ladder, "failed to validate source buffer");
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_ERROR;
+  }
+error_create_buffer:
+  {
+    GST_ELEMENT_ERROR (ladder, RESOURCE, FAILED,
+        ("Failed to allocate output buffer"), (NULL));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+error_process_vpp:
+  {
+    GST_ELEMENT_ERROR (ladder, STREAM, FAILED,
+        ("Failed to scale video frame"), ("filter status %d", status));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+}
+
+static gboolean
+gst_vaapi_scale_ladder_set_caps (GstVaapiScaleLadder * ladder, GstCaps * caps)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+  GstVideoInfo *vi;
+  GList *l;
+
+  if (!gst_vaapi_plugin_base_set_caps (plugin, caps, NULL))
+    return FALSE;
+
+  vi = GST_VAAPI_PLUGIN_BASE_SINK_PAD_INFO (ladder);
+  if (!gst_vaapi_filter_set_colorimetry (ladder->filter,
+          &GST_VIDEO_INFO_COLORIMETRY (vi), &GST_VIDEO_INFO_COLORIMETRY (vi)))
+    return FALSE;
+
+  /* The output caps of all the src pads derive from the input caps */
+  GST_OBJECT_LOCK (ladder);
+  for (l = GST_ELEMENT (ladder)->srcpads; l; l = l->next) {
+    GstVaapiScaleLadderSrcPad *const pad = l->data;
+
+    GST_OBJECT_LOCK (pad);
+    pad->need_reconfigure = TRUE;
+    GST_OBJECT_UNLOCK (pad);
+  }
+  GST_OBJECT_UNLOCK (ladder);
+  return TRUE;
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:{
+      GstCaps *caps;
+      gboolean ret;
+
+      gst_event_parse_caps (event, &caps);
+      ret = gst_vaapi_scale_ladder_set_caps (ladder, caps);
+      gst_event_unref (event);
+      return ret;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      GST_OBJECT_LOCK (ladder);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      GST_OBJECT_UNLOCK (ladder);
+      break;
+    default:
+      break;
+  }
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+        GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+            GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+        return TRUE;
+      }
+      break;
+    case GST_QUERY_ALLOCATION:
+      return gst_vaapi_plugin_base_propose_allocation (GST_VAAPI_PLUGIN_BASE
+          (ladder), query);
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *const tmp = caps;
+        caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      break;
+  }
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CONTEXT:
+      if (gst_vaapi_handle_context_query (GST_ELEMENT (ladder), query)) {
+        GST_DEBUG_OBJECT (ladder, "sharing display %" GST_PTR_FORMAT,
+            GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+        return TRUE;
+      }
+      break;
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps = NULL;
+
+      gst_query_parse_caps (query, &filter);
+      if (GST_VAAPI_PLUGIN_BASE_SINK_PAD_CAPS (ladder))
+        caps = get_src_pad_caps (ladder, GST_VAAPI_SCALE_LADDER_SRC_PAD (pad));
+      if (!caps)
+        caps = gst_pad_get_pad_template_caps (pad);
+      if (filter) {
+        GstCaps *const tmp = caps;
+        caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+    default:
+      break;
+  }
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static gboolean
+forward_sticky_events (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  GstPad *const srcpad = user_data;
+
+  /* Output caps are computed for each src pad in ensure_src_pad() */
+  if (GST_EVENT_TYPE (*event) != GST_EVENT_CAPS)
+    gst_pad_store_sticky_event (srcpad, *event);
+  return TRUE;
+}
+
+static GstPad *
+gst_vaapi_scale_ladder_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstPad *const sinkpad = GST_VAAPI_PLUGIN_BASE_SINK_PAD (ladder);
+  GstPad *pad;
+  gchar *name;
+  guint index;
+
+  GST_OBJECT_LOCK (ladder);
+  if (req_name && sscanf (req_name, "src_%u", &index) == 1) {
+    if (index >= ladder->next_pad_index)
+      ladder->next_pad_index = index + 1;
+  } else {
+    index = ladder->next_pad_index++;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+
+  name = g_strdup_printf ("src_%u", index);
+  pad = g_object_new (GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD, "name", name,
+      "direction", templ->direction, "template", templ, NULL);
+  g_free (name);
+
+  gst_pad_set_query_function (pad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_src_query));
+
+  if (GST_PAD_IS_ACTIVE (sinkpad)) {
+    gst_pad_set_active (pad, TRUE);
+    gst_pad_sticky_events_foreach (sinkpad, forward_sticky_events, pad);
+  }
+
+  if (!gst_element_add_pad (element, pad)) {
+    GST_DEBUG_OBJECT (element, "could not add pad");
+    gst_object_unref (pad);
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_add_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_child_proxy_child_added (GST_CHILD_PROXY (element), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+  return pad;
+}
+
+static void
+gst_vaapi_scale_ladder_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (ladder), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_remove_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+static gboolean
+gst_vaapi_scale_ladder_start (GstVaapiScaleLadder * ladder)
+{
+  GstVaapiPluginBase *const plugin = GST_VAAPI_PLUGIN_BASE (ladder);
+
+  if (!gst_vaapi_plugin_base_open (plugin))
+    return FALSE;
+
+  if (!gst_vaapi_plugin_base_ensure_display (plugin))
+    return FALSE;
+
+  ladder->filter =
+      gst_vaapi_filter_new (GST_VAAPI_PLUGIN_BASE_DISPLAY (ladder));
+  if (!ladder->filter)
+    return FALSE;
+
+  gst_flow_combiner_reset (ladder->flow_combiner);
+  return TRUE;
+}
+
+static gboolean
+_reset_srcpad_private (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  GstVaapiScaleLadderSrcPad *const srcpad =
+      GST_VAAPI_SCALE_LADDER_SRC_PAD (pad);
+
+  gst_vaapi_pad_private_reset (srcpad->priv);
+  gst_vaapi_video_pool_replace (&srcpad->surface_pool, NULL);
+  srcpad->need_reconfigure = TRUE;
+  return TRUE;
+}
+
+static void
+gst_vaapi_scale_ladder_stop (GstVaapiScaleLadder * ladder)
+{
+  gst_element_foreach_src_pad (GST_ELEMENT (ladder), _reset_srcpad_private,
+      NULL);
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+  gst_vaapi_plugin_base_close (GST_VAAPI_PLUGIN_BASE (ladder));
+}
+
+static GstStateChangeReturn
+gst_vaapi_scale_ladder_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_vaapi_scale_ladder_start (ladder))
+        goto error_start;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaapi_scale_ladder_parent_class)->change_state
+      (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_vaapi_scale_ladder_stop (ladder);
+      break;
+    default:
+      break;
+  }
+  return ret;
+
+  /* ERRORS */
+error_start:
+  {
+    GST_ELEMENT_ERROR (ladder, LIBRARY, INIT,
+        ("Failed to create video processing filter"), (NULL));
+    gst_vaapi_scale_ladder_stop (ladder);
+    return GST_STATE_CHANGE_FAILURE;
+  }
+}
+
+static GstVaapiPadPrivate *
+gst_vaapi_scale_ladder_get_vaapi_pad_private (GstVaapiPluginBase * plugin,
+    GstPad * pad)
+{
+  if (GST_IS_VAAPI_SCALE_LADDER_SRC_PAD (pad))
+    return GST_VAAPI_SCALE_LADDER_SRC_PAD (pad)->priv;
+
+  g_assert (GST_VAAPI_PLUGIN_BASE_SINK_PAD (plugin) == pad);
+  return GST_VAAPI_PLUGIN_BASE_SINK_PAD_PRIVATE (plugin);
+}
+
+static void
+gst_vaapi_scale_ladder_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      ladder->scale_method = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  switch (prop_id) {
+    case PROP_SCALE_METHOD:
+      g_value_set_enum (value, ladder->scale_method);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_vaapi_scale_ladder_finalize (GObject * object)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (object);
+
+  gst_vaapi_filter_replace (&ladder->filter, NULL);
+  gst_flow_combiner_free (ladder->flow_combiner);
+  gst_vaapi_plugin_base_finalize (GST_VAAPI_PLUGIN_BASE (ladder));
+
+  G_OBJECT_CLASS (gst_vaapi_scale_ladder_parent_class)->finalize (object);
+}
+
+static void
+gst_vaapi_scale_ladder_class_init (GstVaapiScaleLadderClass * klass)
+{
+  GObjectClass *const object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *const element_class = GST_ELEMENT_CLASS (klass);
+  GstVaapiPluginBaseClass *const plugin_class =
+      GST_VAAPI_PLUGIN_BASE_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_debug_vaapi_scale_ladder,
+      GST_PLUGIN_NAME, 0, GST_PLUGIN_DESC);
+
+  gst_vaapi_plugin_base_class_init (plugin_class);
+  plugin_class->get_vaapi_pad_private =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_get_vaapi_pad_private);
+
+  object_class->finalize = gst_vaapi_scale_ladder_finalize;
+  object_class->set_property = gst_vaapi_scale_ladder_set_property;
+  object_class->get_property = gst_vaapi_scale_ladder_get_property;
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_change_state);
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_release_pad);
+  element_class->set_context = GST_DEBUG_FUNCPTR (gst_vaapi_base_set_context);
+
+  /**
+   * GstVaapiScaleLadder:scale-method:
+   *
+   * The scaling method used for all the renditions, expressed as an
+   * enum value. See #GstVaapiScaleMethod.
+   */
+  g_object_class_install_property (object_class, PROP_SCALE_METHOD,
+      g_param_spec_enum ("scale-method", "Scale Method", "Scaling mode",
+          GST_VAAPI_TYPE_SCALE_METHOD, DEFAULT_SCALE_METHOD,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaapi_scale_ladder_sink_factory);
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &gst_vaapi_scale_ladder_src_factory,
+      GST_TYPE_VAAPI_SCALE_LADDER_SRC_PAD);
+
+  gst_element_class_set_static_metadata (element_class,
+      "VA-API multi-resolution scaler",
+      "Filter/Converter/Scaler/Video/Hardware",
+      GST_PLUGIN_DESC,
+      "The GStreamer developers <gstreamer-devel@lists.freedesktop.org>");
+}
+
+static void
+gst_vaapi_scale_ladder_init (GstVaapiScaleLadder * ladder)
+{
+  GstPad *sinkpad;
+
+  sinkpad = gst_pad_new_from_static_template
+      (&gst_vaapi_scale_ladder_sink_factory, "sink");
+  gst_pad_set_chain_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_chain));
+  gst_pad_set_event_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_event));
+  gst_pad_set_query_function (sinkpad,
+      GST_DEBUG_FUNCPTR (gst_vaapi_scale_ladder_sink_query));
+  gst_element_add_pad (GST_ELEMENT (ladder), sinkpad);
+
+  /* after the sink pad creation, so that the base plugin picks it */
+  gst_vaapi_plugin_base_init (GST_VAAPI_PLUGIN_BASE (ladder), GST_CAT_DEFAULT);
+
+  ladder->scale_method = DEFAULT_SCALE_METHOD;
+  ladder->flow_combiner = gst_flow_combiner_new ();
+}
+
+/* GstChildProxy implementation */
+static GObject *
+gst_vaapi_scale_ladder_child_proxy_get_child_by_index (GstChildProxy *
+    child_proxy, guint index)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (child_proxy);
+  GObject *obj = NULL;
+
+  GST_OBJECT_LOCK (ladder);
+  obj = g_list_nth_data (GST_ELEMENT_CAST (ladder)->srcpads, index);
+  if (obj)
+    gst_object_ref (obj);
+  GST_OBJECT_UNLOCK (ladder);
+
+  return obj;
+}
+
+static guint
+gst_vaapi_scale_ladder_child_proxy_get_children_count (GstChildProxy *
+    child_proxy)
+{
+  GstVaapiScaleLadder *const ladder = GST_VAAPI_SCALE_LADDER (child_proxy);
+  guint count;
+
+  GST_OBJECT_LOCK (ladder);
+  count = GST_ELEMENT_CAST (ladder)->numsrcpads;
+  GST_OBJECT_UNLOCK (ladder);
+
+  return count;
+}
+
+static void
+gst_vaapi_scale_ladder_child_proxy_init (gpointer g_iface, gpointer iface_data)
+{
+  GstChildProxyInterface *const iface = g_iface;
+
+  iface->get_child_by_index =
+      gst_vaapi_scale_ladder_child_proxy_get_child_by_index;
+  iface->get_children_count =
+      gst_vaapi_scale_ladder_child_proxy_get_children_count;
+}
+
+gboolean
+gst_vaapiscaleladder_register (GstPlugin * plugin, GstVaapiDisplay * display)
+{
+  GstVaapiFilter *filter;
+
+  filter = gst_vaapi_filter_new (display);
+  if (!filter)
+    return FALSE;
+  gst_vaapi_filter_replace (&filter, NULL);
+
+  return gst_element_register (plugin, "vaapiscaleladder", GST_RANK_NONE,
+      GST_TYPE_VAAPI_SCALE_LADDER);
+}
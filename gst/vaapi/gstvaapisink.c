@@ -135,6 +135,8 @@ enum
   PROP_BRIGHTNESS,
   PROP_CONTRAST,
   PROP_SIGNAL_HANDOFFS,
+  PROP_PRESENT_MODE,
+  PROP_DROPPED_FRAMES,
 
   N_PROPERTIES
 };
@@ -142,6 +144,7 @@ enum
 #define DEFAULT_DISPLAY_TYPE            GST_VAAPI_DISPLAY_TYPE_ANY
 #define DEFAULT_ROTATION                GST_VAAPI_ROTATION_0
 #define DEFAULT_SIGNAL_HANDOFFS         FALSE
+#define DEFAULT_PRESENT_MODE            GST_VAAPI_PRESENT_MODE_FIFO
 
 static GParamSpec *g_properties[N_PROPERTIES] = { NULL, };
 
@@ -169,8 +172,12 @@ static inline gboolean
 gst_vaapisink_render_surface (GstVaapiSink * sink, GstVaapiSurface * surface,
     const GstVaapiRectangle * surface_rect, guint flags)
 {
-  return sink->window && gst_vaapi_window_put_surface (sink->window, surface,
-      surface_rect, &sink->display_rect, flags);
+  if (!sink->window)
+    return FALSE;
+
+  gst_vaapi_window_set_present_mode (sink->window, sink->present_mode);
+  return gst_vaapi_window_put_surface (sink->window, surface, surface_rect,
+      &sink->display_rect, flags);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -1662,6 +1669,9 @@ gst_vaapisink_set_property (GObject * object,
     case PROP_SIGNAL_HANDOFFS:
       sink->signal_handoffs = g_value_get_boolean (value);
       break;
+    case PROP_PRESENT_MODE:
+      sink->present_mode = g_value_get_enum (value);
+      break;
     case PROP_HUE:
     case PROP_SATURATION:
     case PROP_BRIGHTNESS:
@@ -1703,6 +1713,13 @@ gst_vaapisink_get_property (GObject * object,
     case PROP_SIGNAL_HANDOFFS:
       g_value_set_boolean (value, sink->signal_handoffs);
       break;
+    case PROP_PRESENT_MODE:
+      g_value_set_enum (value, sink->present_mode);
+      break;
+    case PROP_DROPPED_FRAMES:
+      g_value_set_uint (value, sink->window ?
+          gst_vaapi_window_get_dropped_frames (sink->window) : 0);
+      break;
     case PROP_HUE:
     case PROP_SATURATION:
     case PROP_BRIGHTNESS:
@@ -1952,6 +1969,34 @@ gst_vaapisink_class_init (GstVaapiSinkClass * klass)
       "The display contrast value", 0.0, 2.0, 1.0,
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT);
 
+  /**
+   * GstVaapiSink:present-mode:
+   *
+   * How frames are presented. In mailbox mode, rendering a frame does
+   * not wait for the previous one to be presented: a newer frame
+   * replaces the one not presented yet. This bounds the latency to a
+   * single frame when the display is slower than the stream, e.g. for
+   * live monitoring.
+   */
+  g_properties[PROP_PRESENT_MODE] =
+      g_param_spec_enum ("present-mode",
+      "Present mode",
+      "How frames are presented",
+      GST_VAAPI_TYPE_PRESENT_MODE, DEFAULT_PRESENT_MODE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstVaapiSink:dropped-frames:
+   *
+   * The number of frames replaced before being presented, in mailbox
+   * mode.
+   */
+  g_properties[PROP_DROPPED_FRAMES] =
+      g_param_spec_uint ("dropped-frames",
+      "Dropped frames",
+      "Number of frames replaced before being presented",
+      0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPERTIES, g_properties);
 
   /**
@@ -1985,6 +2030,7 @@ gst_vaapisink_init (GstVaapiSink * sink)
   sink->rotation_tag = DEFAULT_ROTATION;
   sink->keep_aspect = TRUE;
   sink->signal_handoffs = DEFAULT_SIGNAL_HANDOFFS;
+  sink->present_mode = DEFAULT_PRESENT_MODE;
   gst_video_info_init (&sink->video_info);
 
   for (i = 0; i < G_N_ELEMENTS (sink->cb_values); i++)
@@ -96,6 +96,7 @@ struct _GstVaapiSink
   GstVaapiRotation rotation_req;
   GstVaapiRotation rotation_tag;
   GstVaapiRotation rotation_prop;
+  GstVaapiPresentMode present_mode;
   guint color_standard;
   gint32 view_id;
   GThread *event_thread;
@@ -22,6 +22,7 @@
 
 #include "gstcompat.h"
 #include <unistd.h>
+#include <gst/vaapi/gstvaapicompat.h>
 #include <gst/vaapi/gstvaapisurface_drm.h>
 #include <gst/vaapi/gstvaapisurfacepool.h>
 #include <gst/vaapi/gstvaapiimagepool.h>
@@ -1153,6 +1154,71 @@ error_create_dmabuf_memory:
 /* --- GstVaapiDmaBufAllocator                                          --- */
 /* ------------------------------------------------------------------------ */
 
+/* Whether the surface was exported with a layout the CPU can access
+ * through a plain mmap() of the dma_buf. An implicit modifier may
+ * stand for a tiled layout, hence does not qualify */
+static gboolean
+is_linear_dma_buf (GstVaapiBufferProxy * dmabuf_proxy)
+{
+  guint64 modifier;
+
+  if (!dmabuf_proxy)
+    return FALSE;
+
+  modifier = gst_vaapi_buffer_proxy_get_modifier (dmabuf_proxy);
+  return modifier == DRM_FORMAT_MOD_LINEAR;
+}
+
+/* Updates @vip with the layout the VA driver reported when exporting
+ * @surface as a dma_buf. Returns FALSE if the surface was not exported
+ * with vaExportSurfaceHandle(), hence its layout is unknown. */
+static gboolean
+gst_video_info_update_from_dma_buf (GstVideoInfo * vip,
+    GstVaapiSurface * surface)
+{
+  GstVaapiBufferProxy *dmabuf_proxy;
+  gsize offsets[GST_VIDEO_MAX_PLANES];
+  gint strides[GST_VIDEO_MAX_PLANES];
+  guint i;
+
+  dmabuf_proxy = gst_vaapi_surface_peek_dma_buf_handle (surface);
+  if (!dmabuf_proxy)
+    return FALSE;
+
+  /* The planes the video info cannot describe, e.g. the compression
+   * control surfaces, would be silently dropped */
+  if (!is_linear_dma_buf (dmabuf_proxy) ||
+      gst_vaapi_buffer_proxy_get_num_planes (dmabuf_proxy) !=
+      GST_VIDEO_INFO_N_PLANES (vip))
+    goto error_unknown_layout;
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip); i++) {
+    if (!gst_vaapi_buffer_proxy_get_plane_layout (dmabuf_proxy, i,
+            &offsets[i], &strides[i]))
+      goto error_unknown_layout;
+  }
+
+  for (i = 0; i < GST_VIDEO_INFO_N_PLANES (vip); i++) {
+    GST_VIDEO_INFO_PLANE_OFFSET (vip, i) = offsets[i];
+    GST_VIDEO_INFO_PLANE_STRIDE (vip, i) = strides[i];
+  }
+  GST_VIDEO_INFO_SIZE (vip) = gst_vaapi_buffer_proxy_get_size (dmabuf_proxy);
+
+  GST_INFO ("exported dma_buf layout: size %" G_GSIZE_FORMAT ", modifier 0x%"
+      G_GINT64_MODIFIER "x", GST_VIDEO_INFO_SIZE (vip),
+      gst_vaapi_buffer_proxy_get_modifier (dmabuf_proxy));
+  return TRUE;
+
+  /* ERRORS */
+error_unknown_layout:
+  {
+    /* Drop the derived image held by the proxy, so that the surface
+     * can be derived again to retrieve its layout */
+    gst_vaapi_buffer_proxy_release_data (dmabuf_proxy);
+    return FALSE;
+  }
+}
+
 G_DEFINE_TYPE (GstVaapiDmaBufAllocator,
     gst_vaapi_dmabuf_allocator, GST_TYPE_DMABUF_ALLOCATOR);
 
@@ -1196,7 +1262,8 @@ gst_vaapi_dmabuf_allocator_new (GstVaapiDisplay * display,
       surface_alloc_flags);
   if (!surface)
     goto error_no_surface;
-  if (!gst_video_info_update_from_surface (&surface_info, surface))
+  if (!gst_video_info_update_from_dma_buf (&surface_info, surface)
+      && !gst_video_info_update_from_surface (&surface_info, surface))
     goto fail;
   gst_mini_object_replace ((GstMiniObject **) & surface, NULL);
 
@@ -1448,6 +1515,12 @@ gst_vaapi_dmabuf_can_map (GstVaapiDisplay * display, GstAllocator * allocator)
   if (!mem)
     goto bail;
 
+  /* A tiled or compressed dma_buf maps fine, but its content is not
+   * laid out as the video info describes */
+  if (!is_linear_dma_buf (gst_vaapi_surface_peek_dma_buf_handle
+          (gst_vaapi_video_meta_get_surface (meta))))
+    goto bail;
+
   if (!gst_memory_map (mem, &info, GST_MAP_READWRITE) || info.size == 0)
     goto bail;
 
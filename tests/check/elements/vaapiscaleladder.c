@@ -0,0 +1,217 @@
+/*
+ *  vaapiscaleladder.c - GStreamer unit test for the vaapiscaleladder element
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define INPUT_WIDTH  320
+#define INPUT_HEIGHT 240
+
+typedef struct
+{
+  guint width;
+  guint height;
+  guint expect_width;
+  guint expect_height;
+} LadderTestRendition;
+
+typedef struct
+{
+  GstPad *srcpad;
+  GstElement *sink;
+  const LadderTestRendition *rendition;
+  GstCaps *allocation_caps;
+  guint num_buffers;
+} LadderTestBranch;
+
+static const LadderTestRendition g_renditions[] = {
+  {0, 120, 160, 120},
+  {0, 120, 160, 120},           /* same size as src_0, shares its surfaces */
+  {64, 0, 64, 48},
+  {100, 50, 100, 50},
+};
+
+GST_START_TEST (test_make)
+{
+  GstElement *ladder;
+
+  ladder = gst_element_factory_make ("vaapiscaleladder", "ladder");
+  fail_unless (ladder != NULL, "Failed to create vaapiscaleladder element");
+
+  gst_object_unref (ladder);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+cb_sink_query (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  LadderTestBranch *const branch = data;
+  GstQuery *const query = GST_PAD_PROBE_INFO_QUERY (info);
+  GstCaps *caps;
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_ALLOCATION) {
+    gst_query_parse_allocation (query, &caps, NULL);
+    if (caps)
+      gst_caps_replace (&branch->allocation_caps, caps);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+cb_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer data)
+{
+  LadderTestBranch *const branch = data;
+
+  g_atomic_int_inc (&branch->num_buffers);
+}
+
+static void
+check_branch_caps (LadderTestBranch * branch, GstCaps * caps)
+{
+  GstCapsFeatures *features;
+  GstVideoInfo vi;
+
+  fail_unless (caps != NULL);
+  fail_unless (gst_caps_is_fixed (caps));
+
+  features = gst_caps_get_features (caps, 0);
+  fail_unless (gst_caps_features_contains (features, "memory:VASurface"));
+
+  fail_unless (gst_video_info_from_caps (&vi, caps));
+  GST_LOG ("%ux%u, expected %ux%u", GST_VIDEO_INFO_WIDTH (&vi),
+      GST_VIDEO_INFO_HEIGHT (&vi), branch->rendition->expect_width,
+      branch->rendition->expect_height);
+  fail_unless_equals_int (GST_VIDEO_INFO_WIDTH (&vi),
+      branch->rendition->expect_width);
+  fail_unless_equals_int (GST_VIDEO_INFO_HEIGHT (&vi),
+      branch->rendition->expect_height);
+}
+
+GST_START_TEST (test_src_caps_and_allocation)
+{
+  LadderTestBranch branches[G_N_ELEMENTS (g_renditions)];
+  GstElement *pipeline, *source, *filter, *ladder;
+  GstStateChangeReturn ret;
+  GstMessage *msg;
+  GstBus *bus;
+  GstCaps *caps;
+  GstPad *pad;
+  guint i;
+
+  pipeline = gst_pipeline_new ("pipeline");
+  source = gst_element_factory_make ("videotestsrc", "src");
+  fail_unless (source != NULL, "Failed to create videotestsrc element");
+  g_object_set (source, "num-buffers", 4, NULL);
+  filter = gst_element_factory_make ("capsfilter", "filter");
+  fail_unless (filter != NULL, "Failed to create caps filter element");
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "NV12",
+      "width", G_TYPE_INT, INPUT_WIDTH, "height", G_TYPE_INT, INPUT_HEIGHT,
+      NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  ladder = gst_element_factory_make ("vaapiscaleladder", "ladder");
+  fail_unless (ladder != NULL, "Failed to create vaapiscaleladder element");
+
+  gst_bin_add_many (GST_BIN (pipeline), source, filter, ladder, NULL);
+  fail_unless (gst_element_link_many (source, filter, ladder, NULL));
+
+  memset (branches, 0, sizeof (branches));
+  for (i = 0; i < G_N_ELEMENTS (branches); i++) {
+    LadderTestBranch *const branch = &branches[i];
+
+    branch->rendition = &g_renditions[i];
+    branch->srcpad = gst_element_request_pad_simple (ladder, "src_%u");
+    fail_unless (branch->srcpad != NULL, "Failed to request a src pad");
+    g_object_set (branch->srcpad, "width", branch->rendition->width,
+        "height", branch->rendition->height, NULL);
+
+    branch->sink = gst_element_factory_make ("fakesink", NULL);
+    fail_unless (branch->sink != NULL, "Failed to create fakesink element");
+    g_object_set (branch->sink, "signal-handoffs", TRUE, "sync", FALSE,
+        NULL);
+    g_signal_connect (branch->sink, "handoff", G_CALLBACK (cb_handoff),
+        branch);
+    gst_bin_add (GST_BIN (pipeline), branch->sink);
+
+    pad = gst_element_get_static_pad (branch->sink, "sink");
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM,
+        (GstPadProbeCallback) cb_sink_query, branch, NULL);
+    fail_unless_equals_int (gst_pad_link (branch->srcpad, pad),
+        GST_PAD_LINK_OK);
+    gst_object_unref (pad);
+  }
+
+  ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  fail_unless (ret != GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS,
+      "Pipeline error before EOS");
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  for (i = 0; i < G_N_ELEMENTS (branches); i++) {
+    LadderTestBranch *const branch = &branches[i];
+
+    /* The output caps are pushed before the allocation is decided */
+    caps = gst_pad_get_current_caps (branch->srcpad);
+    check_branch_caps (branch, caps);
+    fail_unless (branch->allocation_caps != NULL,
+        "No allocation query on src_%u", i);
+    fail_unless (gst_caps_is_equal (caps, branch->allocation_caps));
+    gst_caps_unref (caps);
+
+    fail_unless (g_atomic_int_get (&branch->num_buffers) > 0,
+        "No buffer output on src_%u", i);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  for (i = 0; i < G_N_ELEMENTS (branches); i++) {
+    gst_element_release_request_pad (ladder, branches[i].srcpad);
+    gst_object_unref (branches[i].srcpad);
+    gst_caps_replace (&branches[i].allocation_caps, NULL);
+  }
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static Suite *
+vaapiscaleladder_suite (void)
+{
+  Suite *s = suite_create ("vaapiscaleladder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_make);
+  tcase_add_test (tc_chain, test_src_caps_and_allocation);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapiscaleladder);
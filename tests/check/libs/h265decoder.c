@@ -0,0 +1,418 @@
+/*
+ *  h265decoder.c - GStreamer unit test for the H.265 decoder output order
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Decodes a small H.265 stream generated on the fly through the stub
+ * VA driver, which does not process any data, and checks the order in
+ * which the pictures are output. Only the parameter sets and the slice
+ * headers are meaningful: the slice data is never looked at.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbitwriter.h>
+#include <gst/vaapi/gstvaapidecoder_h265.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include <gst/vaapi/gstvaapidisplay_drm.h>
+
+/* The stub driver ignores the DRM device it is given */
+#define STUB_DRIVER_NAME "stub"
+#define STUB_DEVICE_PATH "/dev/null"
+
+#define NAL_TRAIL_R     1
+#define NAL_RADL_N      6
+#define NAL_CRA         21
+#define NAL_VPS         32
+#define NAL_SPS         33
+#define NAL_PPS         34
+#define NAL_AUD         35
+
+#define MAX_DEC_PIC_BUFFERING_MINUS1    3
+#define MAX_NUM_REORDER_PICS            2
+#define LOG2_MAX_POC_LSB                8
+
+typedef struct
+{
+  guint8 nal_type;
+  gint poc;
+} TestPicture;
+
+/* In decoding order: a CRA picture starting the stream, its two RADL
+   leading pictures, which are output before it, then two trailing
+   pictures. All of them are intra coded and reference nothing */
+static const TestPicture g_leading_pictures[] = {
+  {NAL_CRA, 3},
+  {NAL_RADL_N, 1},
+  {NAL_RADL_N, 2},
+  {NAL_TRAIL_R, 4},
+  {NAL_TRAIL_R, 5},
+};
+
+static inline void
+put_u (GstBitWriter * bw, guint32 value, guint nbits)
+{
+  gst_bit_writer_put_bits_uint32 (bw, value, nbits);
+}
+
+static void
+put_ue (GstBitWriter * bw, guint32 value)
+{
+  guint n = g_bit_storage (value + 1);
+
+  if (n > 1)
+    put_u (bw, 0, n - 1);
+  put_u (bw, value + 1, n);
+}
+
+static void
+put_se (GstBitWriter * bw, gint32 value)
+{
+  put_ue (bw, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+static void
+put_trailing_bits (GstBitWriter * bw)
+{
+  put_u (bw, 1, 1);
+  gst_bit_writer_align_bytes (bw, 0);
+}
+
+/* Main profile, level 2, no sub-layers */
+static void
+put_profile_tier_level (GstBitWriter * bw)
+{
+  put_u (bw, 0, 2);             /* general_profile_space */
+  put_u (bw, 0, 1);             /* general_tier_flag */
+  put_u (bw, 1, 5);             /* general_profile_idc */
+  put_u (bw, 0x60000000, 32);   /* general_profile_compatibility_flag */
+  put_u (bw, 1, 1);             /* progressive_source_flag */
+  put_u (bw, 0, 1);             /* interlaced_source_flag */
+  put_u (bw, 0, 1);             /* non_packed_constraint_flag */
+  put_u (bw, 1, 1);             /* frame_only_constraint_flag */
+  put_u (bw, 0, 32);            /* reserved_zero_43bits */
+  put_u (bw, 0, 11);
+  put_u (bw, 0, 1);             /* general_inbld_flag */
+  put_u (bw, 60, 8);            /* general_level_idc */
+}
+
+static void
+put_aud (GstBitWriter * bw)
+{
+  put_u (bw, 0, 3);             /* pic_type (I) */
+}
+
+static void
+put_vps (GstBitWriter * bw)
+{
+  put_u (bw, 0, 4);             /* vps_video_parameter_set_id */
+  put_u (bw, 1, 1);             /* vps_base_layer_internal_flag */
+  put_u (bw, 1, 1);             /* vps_base_layer_available_flag */
+  put_u (bw, 0, 6);             /* vps_max_layers_minus1 */
+  put_u (bw, 0, 3);             /* vps_max_sub_layers_minus1 */
+  put_u (bw, 1, 1);             /* vps_temporal_id_nesting_flag */
+  put_u (bw, 0xffff, 16);       /* vps_reserved_0xffff_16bits */
+  put_profile_tier_level (bw);
+  put_u (bw, 1, 1);             /* sub_layer_ordering_info */
+  put_ue (bw, MAX_DEC_PIC_BUFFERING_MINUS1);
+  put_ue (bw, MAX_NUM_REORDER_PICS);
+  put_ue (bw, 0);               /* vps_max_latency_increase_plus1 */
+  put_u (bw, 0, 6);             /* vps_max_layer_id */
+  put_ue (bw, 0);               /* vps_num_layer_sets_minus1 */
+  put_u (bw, 0, 1);             /* vps_timing_info_present */
+  put_u (bw, 0, 1);             /* vps_extension_flag */
+}
+
+/* 64x64 4:2:0, 16x16 CTBs, no tools */
+static void
+put_sps (GstBitWriter * bw)
+{
+  put_u (bw, 0, 4);             /* sps_video_parameter_set_id */
+  put_u (bw, 0, 3);             /* sps_max_sub_layers_minus1 */
+  put_u (bw, 1, 1);             /* sps_temporal_id_nesting_flag */
+  put_profile_tier_level (bw);
+  put_ue (bw, 0);               /* sps_seq_parameter_set_id */
+  put_ue (bw, 1);               /* chroma_format_idc */
+  put_ue (bw, 64);              /* pic_width_in_luma_samples */
+  put_ue (bw, 64);              /* pic_height_in_luma_samples */
+  put_u (bw, 0, 1);             /* conformance_window_flag */
+  put_ue (bw, 0);               /* bit_depth_luma_minus8 */
+  put_ue (bw, 0);               /* bit_depth_chroma_minus8 */
+  put_ue (bw, LOG2_MAX_POC_LSB - 4);
+  put_u (bw, 1, 1);             /* sub_layer_ordering_info */
+  put_ue (bw, MAX_DEC_PIC_BUFFERING_MINUS1);
+  put_ue (bw, MAX_NUM_REORDER_PICS);
+  put_ue (bw, 0);               /* sps_max_latency_increase_plus1 */
+  put_ue (bw, 0);               /* log2_min_luma_coding_block_size_minus3 */
+  put_ue (bw, 1);               /* log2_diff_max_min_luma_coding_block_size */
+  put_ue (bw, 0);               /* log2_min_luma_transform_block_size_minus2 */
+  put_ue (bw, 2);               /* log2_diff_max_min_luma_transform_size */
+  put_ue (bw, 0);               /* max_transform_hierarchy_depth_inter */
+  put_ue (bw, 0);               /* max_transform_hierarchy_depth_intra */
+  put_u (bw, 0, 1);             /* scaling_list_enabled_flag */
+  put_u (bw, 0, 1);             /* amp_enabled_flag */
+  put_u (bw, 0, 1);             /* sample_adaptive_offset */
+  put_u (bw, 0, 1);             /* pcm_enabled_flag */
+  put_ue (bw, 0);               /* num_short_term_ref_pic_sets */
+  put_u (bw, 0, 1);             /* long_term_ref_pics_present */
+  put_u (bw, 0, 1);             /* sps_temporal_mvp_enabled */
+  put_u (bw, 0, 1);             /* strong_intra_smoothing */
+  put_u (bw, 0, 1);             /* vui_parameters_present */
+  put_u (bw, 0, 1);             /* sps_extension_present */
+}
+
+static void
+put_pps (GstBitWriter * bw)
+{
+  put_ue (bw, 0);               /* pps_pic_parameter_set_id */
+  put_ue (bw, 0);               /* pps_seq_parameter_set_id */
+  put_u (bw, 0, 1);             /* dependent_slice_segments */
+  put_u (bw, 0, 1);             /* output_flag_present_flag */
+  put_u (bw, 0, 3);             /* num_extra_slice_header_bits */
+  put_u (bw, 0, 1);             /* sign_data_hiding_enabled */
+  put_u (bw, 0, 1);             /* cabac_init_present_flag */
+  put_ue (bw, 0);               /* num_ref_idx_l0_default_active_minus1 */
+  put_ue (bw, 0);               /* num_ref_idx_l1_default_active_minus1 */
+  put_se (bw, 0);               /* init_qp_minus26 */
+  put_u (bw, 0, 1);             /* constrained_intra_pred */
+  put_u (bw, 0, 1);             /* transform_skip_enabled */
+  put_u (bw, 0, 1);             /* cu_qp_delta_enabled_flag */
+  put_se (bw, 0);               /* pps_cb_qp_offset */
+  put_se (bw, 0);               /* pps_cr_qp_offset */
+  put_u (bw, 0, 1);             /* slice_chroma_qp_offsets */
+  put_u (bw, 0, 1);             /* weighted_pred_flag */
+  put_u (bw, 0, 1);             /* weighted_bipred_flag */
+  put_u (bw, 0, 1);             /* transquant_bypass_enabled */
+  put_u (bw, 0, 1);             /* tiles_enabled_flag */
+  put_u (bw, 0, 1);             /* entropy_coding_sync */
+  put_u (bw, 0, 1);             /* loop_filter_across_slices */
+  put_u (bw, 0, 1);             /* deblocking_filter_control */
+  put_u (bw, 0, 1);             /* pps_scaling_list_data */
+  put_u (bw, 0, 1);             /* lists_modification_present */
+  put_ue (bw, 0);               /* log2_parallel_merge_level_minus2 */
+  put_u (bw, 0, 1);             /* slice_header_extension */
+  put_u (bw, 0, 1);             /* pps_extension_present */
+}
+
+/* A single intra slice with an empty short-term RPS */
+static void
+put_slice (GstBitWriter * bw, const TestPicture * picture)
+{
+  guint i;
+
+  put_u (bw, 1, 1);             /* first_slice_segment_in_pic */
+  if (picture->nal_type >= 16 && picture->nal_type <= 23)
+    put_u (bw, 0, 1);           /* no_output_of_prior_pics */
+  put_ue (bw, 0);               /* slice_pic_parameter_set_id */
+  put_ue (bw, 2);               /* slice_type (I) */
+  put_u (bw, picture->poc, LOG2_MAX_POC_LSB);  /* slice_pic_order_cnt_lsb */
+  put_u (bw, 0, 1);             /* short_term_ref_pic_set_sps */
+  put_ue (bw, 0);               /* num_negative_pics */
+  put_ue (bw, 0);               /* num_positive_pics */
+  put_se (bw, 0);               /* slice_qp_delta */
+  put_trailing_bits (bw);       /* byte_alignment () */
+
+  /* slice_segment_data () */
+  for (i = 0; i < 16; i++)
+    put_u (bw, 0xa5, 8);
+}
+
+/* Appends the NAL unit written by @bw with a start code, inserting the
+   emulation prevention bytes, and resets @bw */
+static void
+append_nal (GByteArray * stream, guint8 nal_type, GstBitWriter * bw)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  static const guint8 emulation_prevention_byte = 0x03;
+  const guint8 *rbsp;
+  guint8 header[2];
+  guint i, size, num_zeros = 0;
+
+  /* forbidden_zero_bit, nal_unit_type, nuh_layer_id, and
+     nuh_temporal_id_plus1 */
+  header[0] = nal_type << 1;
+  header[1] = 1;
+  g_byte_array_append (stream, start_code, sizeof (start_code));
+  g_byte_array_append (stream, header, sizeof (header));
+
+  rbsp = gst_bit_writer_get_data (bw);
+  size = gst_bit_writer_get_size (bw) / 8;
+  for (i = 0; i < size; i++) {
+    if (num_zeros == 2 && rbsp[i] <= 0x03) {
+      g_byte_array_append (stream, &emulation_prevention_byte, 1);
+      num_zeros = 0;
+    }
+    g_byte_array_append (stream, &rbsp[i], 1);
+    num_zeros = rbsp[i] == 0 ? num_zeros + 1 : 0;
+  }
+  gst_bit_writer_reset (bw);
+}
+
+/* Returns the access unit of @picture, with the parameter sets in
+   front of it if @with_headers is set. The timestamp holds the POC.
+
+   The access unit delimiter makes the decoder read the timestamp of
+   the frame while the rest of the buffer is still queued */
+static GstBuffer *
+create_access_unit (const TestPicture * picture, gboolean with_headers)
+{
+  GByteArray *const stream = g_byte_array_new ();
+  GstBitWriter bw;
+  GstBuffer *buffer;
+  gsize size;
+
+  gst_bit_writer_init (&bw);
+  put_aud (&bw);
+  put_trailing_bits (&bw);
+  append_nal (stream, NAL_AUD, &bw);
+
+  if (with_headers) {
+    gst_bit_writer_init (&bw);
+    put_vps (&bw);
+    put_trailing_bits (&bw);
+    append_nal (stream, NAL_VPS, &bw);
+
+    gst_bit_writer_init (&bw);
+    put_sps (&bw);
+    put_trailing_bits (&bw);
+    append_nal (stream, NAL_SPS, &bw);
+
+    gst_bit_writer_init (&bw);
+    put_pps (&bw);
+    put_trailing_bits (&bw);
+    append_nal (stream, NAL_PPS, &bw);
+  }
+
+  gst_bit_writer_init (&bw);
+  put_slice (&bw, picture);
+  append_nal (stream, picture->nal_type, &bw);
+
+  size = stream->len;
+  buffer = gst_buffer_new_wrapped (g_byte_array_free (stream, FALSE), size);
+  GST_BUFFER_PTS (buffer) = picture->poc * GST_MSECOND;
+  return buffer;
+}
+
+static GstVaapiDisplay *
+stub_display_new (void)
+{
+  g_setenv ("LIBVA_DRIVER_NAME", STUB_DRIVER_NAME, TRUE);
+  g_setenv ("LIBVA_DRIVERS_PATH", STUB_DRIVER_DIR, TRUE);
+  return gst_vaapi_display_drm_new (STUB_DEVICE_PATH);
+}
+
+/* Collects the POC of the pictures output so far */
+static GstVaapiDecoderStatus
+get_output_pocs (GstVaapiDecoder * decoder, GArray * pocs)
+{
+  GstVaapiSurfaceProxy *proxy;
+  GstVaapiDecoderStatus status;
+  gint poc;
+
+  while ((status = gst_vaapi_decoder_get_surface (decoder, &proxy)) ==
+      GST_VAAPI_DECODER_STATUS_SUCCESS) {
+    poc = GST_VAAPI_SURFACE_PROXY_TIMESTAMP (proxy) / GST_MSECOND;
+    g_array_append_val (pocs, poc);
+    gst_vaapi_surface_proxy_unref (proxy);
+  }
+  return status;
+}
+
+static void
+check_leading_pictures_order (gboolean low_latency)
+{
+  GstVaapiDisplay *display;
+  GstVaapiDecoder *decoder;
+  GstVaapiDecoderStatus status;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  GArray *pocs;
+  guint i, num_output_early;
+
+  display = stub_display_new ();
+  fail_unless (display != NULL, "Failed to open the stub VA driver");
+
+  caps = gst_caps_new_simple ("video/x-h265",
+      "stream-format", G_TYPE_STRING, "byte-stream", NULL);
+  decoder = gst_vaapi_decoder_h265_new (display, caps);
+  gst_caps_unref (caps);
+  fail_unless (decoder != NULL, "Failed to create the H.265 decoder");
+  gst_vaapi_decoder_set_low_latency (decoder, low_latency);
+
+  for (i = 0; i < G_N_ELEMENTS (g_leading_pictures); i++) {
+    buffer = create_access_unit (&g_leading_pictures[i], i == 0);
+    fail_unless (gst_vaapi_decoder_put_buffer (decoder, buffer));
+    gst_buffer_unref (buffer);
+  }
+  fail_unless (gst_vaapi_decoder_put_buffer (decoder, NULL));
+
+  pocs = g_array_new (FALSE, FALSE, sizeof (gint));
+  status = get_output_pocs (decoder, pocs);
+  fail_unless_equals_int (status, GST_VAAPI_DECODER_STATUS_END_OF_STREAM);
+  num_output_early = pocs->len;
+
+  fail_unless_equals_int (gst_vaapi_decoder_flush (decoder),
+      GST_VAAPI_DECODER_STATUS_SUCCESS);
+  get_output_pocs (decoder, pocs);
+
+  fail_unless_equals_int (pocs->len, G_N_ELEMENTS (g_leading_pictures));
+  for (i = 0; i < pocs->len; i++)
+    fail_unless_equals_int (g_array_index (pocs, gint, i), i + 1);
+
+  /* Once the first trailing picture is decoded, the CRA picture and its
+     leading pictures no longer wait for the DPB to fill up */
+  if (low_latency)
+    fail_unless (num_output_early >= 4, "Only %u pictures output before the "
+        "end of the stream", num_output_early);
+
+  g_array_unref (pocs);
+  gst_object_unref (decoder);
+  gst_object_unref (display);
+}
+
+GST_START_TEST (test_leading_pictures)
+{
+  check_leading_pictures_order (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_leading_pictures_low_latency)
+{
+  check_leading_pictures_order (TRUE);
+}
+
+GST_END_TEST;
+
+static Suite *
+h265decoder_suite (void)
+{
+  Suite *s = suite_create ("h265decoder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_leading_pictures);
+  tcase_add_test (tc_chain, test_leading_pictures_low_latency);
+
+  return s;
+}
+
+GST_CHECK_MAIN (h265decoder);
@@ -0,0 +1,195 @@
+/*
+ *  h26xutils.c - GStreamer unit test for the H.264/H.265 utilities
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks the emulation prevention applied when writing NAL units,
+ * which skips 8 bytes at a time over runs without any zero byte,
+ * against a plain byte-wise implementation.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/vaapi/gstvaapiutils_h26x_priv.h>
+
+/* gst_vaapi_utils_h26x_write_nal_unit() leaves room for that many
+   emulation prevention bytes */
+#define MAX_EMULATION_PREVENTION_BYTES 10
+
+#define MAX_NAL_SIZE    512
+
+/* Byte-wise emulation prevention, returns the size of @dst */
+static guint
+reference_to_byte_stream (guint8 * dst, const guint8 * src, guint src_len)
+{
+  guint dp = 0, sp, zero_run = 0;
+
+  for (sp = 0; sp < src_len; sp++) {
+    if (zero_run < 2) {
+      if (src[sp] == 0)
+        ++zero_run;
+      else
+        zero_run = 0;
+    } else {
+      if ((src[sp] & ~3) == 0)
+        dst[dp++] = 3;
+      zero_run = src[sp] == 0;
+    }
+    dst[dp++] = src[sp];
+  }
+  return dp;
+}
+
+static void
+check_nal_unit (const guint8 * nal, guint nal_size)
+{
+  guint8 expected[2 * MAX_NAL_SIZE];
+  guint8 nal_copy[MAX_NAL_SIZE];
+  guint expected_size, size;
+  GstBitWriter bw;
+  const guint8 *data;
+  gboolean success;
+
+  fail_unless (nal_size <= MAX_NAL_SIZE);
+  expected_size = reference_to_byte_stream (expected, nal, nal_size);
+
+  /* The NAL unit is not const in the API */
+  memcpy (nal_copy, nal, nal_size);
+
+  gst_bit_writer_init (&bw);
+  success = gst_vaapi_utils_h26x_write_nal_unit (&bw, nal_copy, nal_size);
+  if (expected_size > nal_size + MAX_EMULATION_PREVENTION_BYTES) {
+    fail_if (success, "%u bytes NAL unit overflowed", nal_size);
+    gst_bit_writer_reset (&bw);
+    return;
+  }
+  fail_unless (success, "failed to write %u bytes NAL unit", nal_size);
+
+  /* The byte stream is prefixed with its 16-bit size */
+  fail_unless_equals_int (gst_bit_writer_get_size (&bw),
+      (2 + expected_size) * 8);
+  data = gst_bit_writer_get_data (&bw);
+  size = GST_READ_UINT16_BE (data);
+  fail_unless_equals_int (size, expected_size);
+  fail_unless (memcmp (data + 2, expected, expected_size) == 0,
+      "byte stream mismatch for %u bytes NAL unit", nal_size);
+  gst_bit_writer_reset (&bw);
+}
+
+/* A zero run followed by each of the bytes that need to be escaped,
+   at all the offsets of a few 8-byte words */
+GST_START_TEST (test_zero_run_across_words)
+{
+  guint8 nal[32];
+  guint offset, value, run;
+
+  for (run = 2; run <= 3; run++) {
+    for (value = 0; value <= 4; value++) {
+      for (offset = 0; offset + run + 1 <= sizeof (nal); offset++) {
+        memset (nal, 0x55, sizeof (nal));
+        memset (nal + offset, 0x00, run);
+        nal[offset + run] = value;
+        check_nal_unit (nal, sizeof (nal));
+      }
+    }
+  }
+}
+
+GST_END_TEST;
+
+/* NAL units ending with a zero run, of all sizes around a word */
+GST_START_TEST (test_trailing_zeros)
+{
+  guint8 nal[24];
+  guint size, run;
+
+  for (run = 1; run <= 3; run++) {
+    for (size = run; size <= sizeof (nal); size++) {
+      memset (nal, 0xaa, size);
+      memset (nal + size - run, 0x00, run);
+      check_nal_unit (nal, size);
+    }
+  }
+}
+
+GST_END_TEST;
+
+/* The NAL unit is not necessarily aligned in memory */
+GST_START_TEST (test_unaligned_start)
+{
+  guint8 buffer[64 + 8];
+  guint offset, i;
+
+  for (i = 0; i < sizeof (buffer); i++)
+    buffer[i] = (i % 11 == 3 || i % 11 == 4) ? 0x00 : 0x01 + i % 3;
+
+  for (offset = 0; offset < 8; offset++) {
+    check_nal_unit (buffer + offset, 64);
+    check_nal_unit (buffer + offset, 61);
+  }
+}
+
+GST_END_TEST;
+
+/* Random NAL units with many zero bytes, on both sides of the size
+   that fits in the stack scratch buffer */
+GST_START_TEST (test_random)
+{
+  static const guint8 values[] = { 0x00, 0x00, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x80, 0xff
+  };
+  guint8 nal[MAX_NAL_SIZE];
+  GRand *rand;
+  guint i, j, size;
+
+  rand = g_rand_new_with_seed (0x26);
+  for (i = 0; i < 2000; i++) {
+    size = g_rand_int_range (rand, 1, MAX_NAL_SIZE + 1);
+    for (j = 0; j < size; j++) {
+      /* Mostly long runs without any zero byte */
+      if (g_rand_int_range (rand, 0, 16) == 0)
+        nal[j] = values[g_rand_int_range (rand, 0, G_N_ELEMENTS (values))];
+      else
+        nal[j] = g_rand_int_range (rand, 1, 256);
+    }
+    check_nal_unit (nal, size);
+  }
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+static Suite *
+h26xutils_suite (void)
+{
+  Suite *s = suite_create ("h26xutils");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_zero_run_across_words);
+  tcase_add_test (tc_chain, test_trailing_zeros);
+  tcase_add_test (tc_chain, test_unaligned_start);
+  tcase_add_test (tc_chain, test_random);
+
+  return s;
+}
+
+GST_CHECK_MAIN (h26xutils);
@@ -0,0 +1,250 @@
+/*
+ *  vaapiprofiler.c - GStreamer unit test for the VA calls profiler
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The profiler only uses the VADisplay as a lookup key, so most tests
+ * do not need any VA driver: the displays are fake pointers. The
+ * display test issues real VA calls, through the stub driver.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/vaapi/gstvaapiprofiler.h>
+#if USE_DRM
+# include <gst/vaapi/gstvaapidisplay_drm.h>
+# include <gst/vaapi/gstvaapisurface.h>
+
+/* The stub driver ignores the DRM device it is given */
+# define STUB_DRIVER_NAME "stub"
+# define STUB_DEVICE_PATH "/dev/null"
+#endif
+
+#define N_THREADS       4
+#define N_CALLS         10000
+#define N_SYNCS         1000
+
+static guint8 g_display_a;
+static guint8 g_display_b;
+
+#define DISPLAY_A ((VADisplay) &g_display_a)
+#define DISPLAY_B ((VADisplay) &g_display_b)
+
+static guint64
+get_count (GstVaapiProfiler * profiler, GstVaapiProfilerCall call)
+{
+  guint64 count = 0;
+
+  fail_unless (gst_vaapi_profiler_get_stats (profiler, call, &count, NULL,
+          NULL));
+  return count;
+}
+
+static gpointer
+record_calls (gpointer data)
+{
+  VADisplay const va_display = data;
+  guint i;
+
+  for (i = 0; i < N_CALLS; i++) {
+    const gint64 start_time = gst_vaapi_profiler_begin ();
+
+    gst_vaapi_profiler_end (va_display, i % 2 ?
+        GST_VAAPI_PROFILER_MAP_BUFFER : GST_VAAPI_PROFILER_UNMAP_BUFFER,
+        start_time);
+  }
+  return NULL;
+}
+
+GST_START_TEST (test_concurrent_calls)
+{
+  GstVaapiProfiler *profiler;
+  GThread *threads[N_THREADS];
+  guint64 histogram[GST_VAAPI_PROFILER_N_BUCKETS];
+  guint64 count, sum;
+  guint i;
+
+  profiler = gst_vaapi_profiler_acquire (DISPLAY_A);
+  fail_unless (profiler != NULL);
+
+  for (i = 0; i < N_THREADS; i++) {
+    threads[i] = g_thread_new ("record", record_calls,
+        i % 2 ? DISPLAY_B : DISPLAY_A);
+  }
+  for (i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* Only the calls issued on the profiled display are recorded */
+  fail_unless (gst_vaapi_profiler_get_stats (profiler,
+          GST_VAAPI_PROFILER_MAP_BUFFER, &count, NULL, histogram));
+  fail_unless_equals_uint64 (count, N_THREADS / 2 * N_CALLS / 2);
+  for (i = 0, sum = 0; i < GST_VAAPI_PROFILER_N_BUCKETS; i++)
+    sum += histogram[i];
+  fail_unless_equals_uint64 (sum, count);
+  fail_unless_equals_uint64 (get_count (profiler,
+          GST_VAAPI_PROFILER_UNMAP_BUFFER), N_THREADS / 2 * N_CALLS / 2);
+  fail_unless_equals_uint64 (get_count (profiler,
+          GST_VAAPI_PROFILER_SYNC_SURFACE), 0);
+
+  gst_vaapi_profiler_reset (profiler);
+  fail_unless_equals_uint64 (get_count (profiler,
+          GST_VAAPI_PROFILER_MAP_BUFFER), 0);
+
+  gst_vaapi_profiler_release (profiler);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_acquire_release)
+{
+  GstVaapiProfiler *profiler_a, *profiler_b, *profiler;
+  gchar *report;
+
+  /* No profiler: the calls are not even timed */
+  fail_unless_equals_int64 (gst_vaapi_profiler_begin (), 0);
+
+  profiler_a = gst_vaapi_profiler_acquire (DISPLAY_A);
+  profiler = gst_vaapi_profiler_acquire (DISPLAY_A);
+  fail_unless (profiler == profiler_a);
+  fail_if (gst_vaapi_profiler_begin () == 0);
+
+  record_calls (DISPLAY_A);
+  gst_vaapi_profiler_release (profiler);
+  fail_unless_equals_uint64 (get_count (profiler_a,
+          GST_VAAPI_PROFILER_MAP_BUFFER), N_CALLS / 2);
+
+  report = gst_vaapi_profiler_get_report (profiler_a);
+  fail_unless (strstr (report, "vaMapBuffer") != NULL);
+  fail_unless (strstr (report, "vaSyncSurface") == NULL);
+  g_free (report);
+
+  /* A released profiler is reused, without the previous statistics */
+  gst_vaapi_profiler_release (profiler_a);
+  fail_unless_equals_int64 (gst_vaapi_profiler_begin (), 0);
+
+  profiler_b = gst_vaapi_profiler_acquire (DISPLAY_B);
+  fail_unless (profiler_b != NULL);
+  fail_unless_equals_uint64 (get_count (profiler_b,
+          GST_VAAPI_PROFILER_MAP_BUFFER), 0);
+
+  record_calls (DISPLAY_A);
+  fail_unless_equals_uint64 (get_count (profiler_b,
+          GST_VAAPI_PROFILER_MAP_BUFFER), 0);
+  record_calls (DISPLAY_B);
+  fail_unless_equals_uint64 (get_count (profiler_b,
+          GST_VAAPI_PROFILER_MAP_BUFFER), N_CALLS / 2);
+
+  gst_vaapi_profiler_release (profiler_b);
+}
+
+GST_END_TEST;
+
+#if USE_DRM
+static gpointer
+sync_surface (gpointer data)
+{
+  GstVaapiDisplay *const display = data;
+  GstVaapiSurface *surface;
+  guint i;
+
+  surface = gst_vaapi_surface_new (display, GST_VAAPI_CHROMA_TYPE_YUV420,
+      64, 64);
+  fail_unless (surface != NULL);
+  for (i = 0; i < N_SYNCS; i++)
+    fail_unless (gst_vaapi_surface_sync (surface));
+  gst_vaapi_surface_unref (surface);
+  return NULL;
+}
+
+/* Parses the number of calls of @call_name out of the report */
+static guint64
+get_report_count (const gchar * report, const gchar * call_name)
+{
+  gchar **lines;
+  gchar name[32];
+  guint64 value, count = 0;
+  guint i;
+
+  lines = g_strsplit (report, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    if (sscanf (lines[i], "%31s %" G_GUINT64_FORMAT, name, &value) == 2 &&
+        strcmp (name, call_name) == 0)
+      count = value;
+  }
+  g_strfreev (lines);
+  return count;
+}
+
+GST_START_TEST (test_display_calls)
+{
+  GstVaapiDisplay *display;
+  GThread *threads[N_THREADS];
+  gchar *report;
+  guint i;
+
+  g_setenv ("LIBVA_DRIVER_NAME", STUB_DRIVER_NAME, TRUE);
+  g_setenv ("LIBVA_DRIVERS_PATH", STUB_DRIVER_DIR, TRUE);
+  display = gst_vaapi_display_drm_new (STUB_DEVICE_PATH);
+  fail_unless (display != NULL);
+
+  fail_unless (gst_vaapi_display_get_va_profile_report (display) == NULL);
+  gst_vaapi_display_set_va_profiling (display, TRUE);
+  fail_unless (gst_vaapi_display_get_va_profiling (display));
+
+  for (i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("sync", sync_surface, display);
+  for (i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  report = gst_vaapi_display_get_va_profile_report (display);
+  fail_unless (report != NULL);
+  fail_unless_equals_uint64 (get_report_count (report, "vaCreateSurfaces"),
+      N_THREADS);
+  fail_unless_equals_uint64 (get_report_count (report, "vaSyncSurface"),
+      N_THREADS * N_SYNCS);
+  fail_unless_equals_uint64 (get_report_count (report, "vaEndPicture"), 0);
+  g_free (report);
+
+  gst_vaapi_display_set_va_profiling (display, FALSE);
+  fail_unless (gst_vaapi_display_get_va_profile_report (display) == NULL);
+  gst_object_unref (display);
+}
+
+GST_END_TEST;
+#endif
+
+static Suite *
+vaapiprofiler_suite (void)
+{
+  Suite *s = suite_create ("vaapiprofiler");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_concurrent_calls);
+  tcase_add_test (tc_chain, test_acquire_release);
+#if USE_DRM
+  tcase_add_test (tc_chain, test_display_calls);
+#endif
+
+  return s;
+}
+
+GST_CHECK_MAIN (vaapiprofiler);
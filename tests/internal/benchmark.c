@@ -0,0 +1,701 @@
+/*
+ *  benchmark.c - Multi-stream decode, encode and VPP benchmark
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs concurrent streams through GstVaapiDecoder, GstVaapiEncoder or
+ * GstVaapiFilter, all sharing the same display, and reports the frame
+ * rate, the CPU time per frame of each stream and of each kind of
+ * thread, the latency percentiles, the VA objects allocated and the
+ * display lock contention.
+ *
+ * With --stub, the VA calls are handled by the stub driver built along
+ * with this program, which does not process any data: the figures then
+ * only account for the CPU overhead of the library, and the benchmark
+ * runs on machines without any GPU.
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <time.h>
+#include <sys/resource.h>
+#include <gst/vaapi/gstvaapidecoder.h>
+#include <gst/vaapi/gstvaapifilter.h>
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include <gst/vaapi/gstvaapisurfaceproxy.h>
+#include <gst/vaapi/gstvaapiprofiler.h>
+#if USE_ENCODERS
+# include <gst/vaapi/gstvaapiencoder_h264.h>
+# include <gst/vaapi/gstvaapiencoder_mpeg2.h>
+# include <gst/vaapi/gstvaapicodedbufferproxy.h>
+#endif
+#if USE_DRM
+# include <gst/vaapi/gstvaapidisplay_drm.h>
+#endif
+#include "decoder.h"
+#include "output.h"
+
+/* The stub driver ignores the DRM device it is given */
+#define STUB_DRIVER_NAME "stub"
+#define STUB_DEVICE_PATH "/dev/null"
+
+static gchar *g_workload_str;
+static gchar *g_codec_str;
+static gint g_num_streams = 4;
+static gint g_num_frames = 300;
+static gint g_width = 1280;
+static gint g_height = 720;
+static gboolean g_use_stub = FALSE;
+
+static GOptionEntry g_options[] = {
+  {"workload", 'w',
+        0,
+        G_OPTION_ARG_STRING, &g_workload_str,
+      "workload to run (decode, encode, vpp)", NULL},
+  {"codec", 'c',
+        0,
+        G_OPTION_ARG_STRING, &g_codec_str,
+      "codec to decode (jpeg, mpeg2, mpeg4, h264, vc1) or to encode "
+        "(mpeg2, h264)", NULL},
+  {"streams", 'n',
+        0,
+        G_OPTION_ARG_INT, &g_num_streams,
+      "number of concurrent streams", NULL},
+  {"frames", 0,
+        0,
+        G_OPTION_ARG_INT, &g_num_frames,
+      "number of frames per stream", NULL},
+  {"width", 0,
+        0,
+        G_OPTION_ARG_INT, &g_width,
+      "width of the encoded or processed frames", NULL},
+  {"height", 0,
+        0,
+        G_OPTION_ARG_INT, &g_height,
+      "height of the encoded or processed frames", NULL},
+  {"stub", 0,
+        0,
+        G_OPTION_ARG_NONE, &g_use_stub,
+      "use the stub VA driver", NULL},
+  {NULL,}
+};
+
+typedef struct _Stream Stream;
+typedef gboolean (*StreamRunFunc) (Stream * stream);
+
+struct _Stream
+{
+  GstVaapiDisplay *display;
+  GThread *thread;
+  StreamRunFunc run;
+  GArray *latencies;            /* gint64, in microseconds */
+  guint num_frames;
+  gint64 cpu_time;              /* of all the threads of the stream */
+  gint64 wall_time;
+  gboolean success;
+  volatile gint finished;
+};
+
+static gint64
+get_thread_cpu_time (void)
+{
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+    return 0;
+  return ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static gint64
+get_process_cpu_time (void)
+{
+  struct rusage ru;
+
+  if (getrusage (RUSAGE_SELF, &ru) < 0)
+    return 0;
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * G_USEC_PER_SEC +
+      ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/* Only called from a single thread per stream, i.e. the output thread
+   of the encoder streams */
+static void
+stream_add_frame (Stream * stream, gint64 latency)
+{
+  g_array_append_val (stream->latencies, latency);
+  stream->num_frames++;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Decode                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* Loops over the sample clip of the codec. The latency of a frame is
+   the time spent in gst_vaapi_decoder_get_surface(), which parses and
+   decodes the units up to the next output frame */
+static gboolean
+run_decode (Stream * stream)
+{
+  GstVaapiDecoder *decoder;
+  GstVaapiDecoderStatus status;
+  GstVaapiSurfaceProxy *proxy;
+  gboolean success = TRUE;
+  gint64 start;
+
+  decoder = decoder_new (stream->display, g_codec_str);
+  if (!decoder)
+    return FALSE;
+
+  while (stream->num_frames < g_num_frames) {
+    start = g_get_monotonic_time ();
+    status = gst_vaapi_decoder_get_surface (decoder, &proxy);
+    if (status == GST_VAAPI_DECODER_STATUS_ERROR_NO_DATA) {
+      if (!decoder_put_clip (decoder)) {
+        success = FALSE;
+        break;
+      }
+      continue;
+    }
+    if (status != GST_VAAPI_DECODER_STATUS_SUCCESS) {
+      GST_ERROR ("failed to decode frame (decoder status %d)", status);
+      success = FALSE;
+      break;
+    }
+    stream_add_frame (stream, g_get_monotonic_time () - start);
+    gst_vaapi_surface_proxy_unref (proxy);
+  }
+
+  gst_object_unref (decoder);
+  return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Encode                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+#if USE_ENCODERS
+typedef struct
+{
+  Stream *stream;
+  GstVaapiEncoder *encoder;
+  gint64 *submit_times;         /* indexed by system frame number */
+  volatile gint input_stopped;
+  gint64 output_cpu_time;
+  gboolean success;
+} EncodeState;
+
+static GstVaapiEncoder *
+encoder_new (GstVaapiDisplay * display)
+{
+  if (!g_strcmp0 (g_codec_str, "mpeg2"))
+    return gst_vaapi_encoder_mpeg2_new (display);
+  if (!g_codec_str || !g_strcmp0 (g_codec_str, "h264"))
+    return gst_vaapi_encoder_h264_new (display);
+  GST_ERROR ("unsupported encoder %s", g_codec_str);
+  return NULL;
+}
+
+static gboolean
+encoder_set_format (GstVaapiEncoder * encoder)
+{
+  GstVideoCodecState *state;
+  GstVaapiEncoderStatus status;
+
+  state = g_slice_new0 (GstVideoCodecState);
+  state->ref_count = 1;
+  gst_video_info_set_format (&state->info, GST_VIDEO_FORMAT_ENCODED, g_width,
+      g_height);
+  state->info.fps_n = 30;
+  state->info.fps_d = 1;
+
+  status = gst_vaapi_encoder_set_codec_state (encoder, state);
+  g_slice_free (GstVideoCodecState, state);
+  return status == GST_VAAPI_ENCODER_STATUS_SUCCESS;
+}
+
+/* The latency of a frame is the time from its submission to the
+   delivery of its coded buffer */
+static gpointer
+encode_output_thread (gpointer data)
+{
+  EncodeState *const state = data;
+  GstVaapiCodedBufferProxy *proxy;
+  GstVaapiEncoderStatus status;
+  GstVideoCodecFrame *frame;
+  const gint64 cpu_start = get_thread_cpu_time ();
+
+  while (state->stream->num_frames < g_num_frames) {
+    status = gst_vaapi_encoder_get_buffer_with_timeout (state->encoder,
+        &proxy, 50000);
+    if (status > GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+      if (g_atomic_int_get (&state->input_stopped))
+        break;
+      continue;
+    }
+    if (status < GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+      GST_ERROR ("failed to get coded buffer (encoder status %d)", status);
+      state->success = FALSE;
+      break;
+    }
+
+    frame = gst_vaapi_coded_buffer_proxy_get_user_data (proxy);
+    stream_add_frame (state->stream, g_get_monotonic_time () -
+        state->submit_times[frame->system_frame_number]);
+    gst_vaapi_coded_buffer_proxy_unref (proxy);
+  }
+  state->output_cpu_time = get_thread_cpu_time () - cpu_start;
+  return NULL;
+}
+
+static gboolean
+run_encode (Stream * stream)
+{
+  EncodeState state = { stream, };
+  GstVaapiVideoPool *pool = NULL;
+  GstVaapiSurfaceProxy *proxy;
+  GstVideoCodecFrame *frame;
+  GstVaapiEncoderStatus status;
+  GThread *output_thread;
+  GstVideoInfo vi;
+  guint i;
+
+  state.encoder = encoder_new (stream->display);
+  if (!state.encoder)
+    return FALSE;
+  if (!encoder_set_format (state.encoder)) {
+    GST_ERROR ("failed to set encoder format");
+    goto error;
+  }
+
+  gst_video_info_set_format (&vi, GST_VIDEO_FORMAT_NV12, g_width, g_height);
+  pool = gst_vaapi_surface_pool_new_full (stream->display, &vi, 0);
+  if (!pool)
+    goto error;
+
+  state.submit_times = g_new0 (gint64, g_num_frames);
+  state.success = TRUE;
+  output_thread = g_thread_new ("output", encode_output_thread, &state);
+
+  for (i = 0; i < g_num_frames; i++) {
+    proxy =
+        gst_vaapi_surface_proxy_new_from_pool (GST_VAAPI_SURFACE_POOL (pool));
+    if (!proxy) {
+      GST_ERROR ("failed to get surface from pool");
+      state.success = FALSE;
+      break;
+    }
+
+    frame = g_slice_new0 (GstVideoCodecFrame);
+    frame->ref_count = 1;
+    frame->system_frame_number = i;
+    gst_video_codec_frame_set_user_data (frame, proxy,
+        (GDestroyNotify) gst_vaapi_surface_proxy_unref);
+
+    state.submit_times[i] = g_get_monotonic_time ();
+    status = gst_vaapi_encoder_put_frame (state.encoder, frame);
+    gst_video_codec_frame_unref (frame);
+    if (status != GST_VAAPI_ENCODER_STATUS_SUCCESS) {
+      GST_ERROR ("failed to encode frame (encoder status %d)", status);
+      state.success = FALSE;
+      break;
+    }
+  }
+
+  gst_vaapi_encoder_flush (state.encoder);
+  g_atomic_int_set (&state.input_stopped, TRUE);
+  g_thread_join (output_thread);
+  stream->cpu_time += state.output_cpu_time;
+
+  g_free (state.submit_times);
+  gst_vaapi_video_pool_replace (&pool, NULL);
+  gst_object_unref (state.encoder);
+  return state.success;
+
+  /* ERRORS */
+error:
+  {
+    gst_vaapi_video_pool_replace (&pool, NULL);
+    gst_object_unref (state.encoder);
+    return FALSE;
+  }
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* --- VPP                                                               --- */
+/* ------------------------------------------------------------------------- */
+
+/* Downscales the frames by two. The latency of a frame includes the
+   synchronization of the target surface */
+static gboolean
+run_vpp (Stream * stream)
+{
+  GstVaapiFilter *filter;
+  GstVaapiSurface *src_surface = NULL, *dst_surface = NULL;
+  GstVaapiFilterStatus status;
+  gboolean success = FALSE;
+  gint64 start;
+
+  filter = gst_vaapi_filter_new (stream->display);
+  if (!filter)
+    return FALSE;
+  if (!gst_vaapi_filter_set_format (filter, GST_VIDEO_FORMAT_NV12))
+    goto end;
+
+  src_surface = gst_vaapi_surface_new (stream->display,
+      GST_VAAPI_CHROMA_TYPE_YUV420, g_width, g_height);
+  dst_surface = gst_vaapi_surface_new (stream->display,
+      GST_VAAPI_CHROMA_TYPE_YUV420, g_width / 2, g_height / 2);
+  if (!src_surface || !dst_surface)
+    goto end;
+
+  while (stream->num_frames < g_num_frames) {
+    start = g_get_monotonic_time ();
+    status = gst_vaapi_filter_process (filter, src_surface, dst_surface, 0);
+    if (status != GST_VAAPI_FILTER_STATUS_SUCCESS) {
+      GST_ERROR ("failed to process frame (filter status %d)", status);
+      goto end;
+    }
+    if (!gst_vaapi_surface_sync (dst_surface))
+      goto end;
+    stream_add_frame (stream, g_get_monotonic_time () - start);
+  }
+  success = TRUE;
+
+end:
+  if (dst_surface)
+    gst_vaapi_surface_unref (dst_surface);
+  if (src_surface)
+    gst_vaapi_surface_unref (src_surface);
+  gst_object_unref (filter);
+  return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Threads                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+  gchar *name;
+  gint64 cpu_time;              /* last sampled, in microseconds */
+} ThreadSample;
+
+static void
+thread_sample_free (gpointer data)
+{
+  ThreadSample *const sample = data;
+
+  g_free (sample->name);
+  g_free (sample);
+}
+
+static gchar *
+read_task_file (const gchar * tid, const gchar * name)
+{
+  gchar *path, *contents = NULL;
+
+  path = g_build_filename ("/proc/self/task", tid, name, NULL);
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    contents = NULL;
+  g_free (path);
+  return contents;
+}
+
+/* Records the CPU time of all the threads of the process, including
+   the ones the library spawns (e.g. the encoder sync threads), keyed
+   by thread id. A thread is sampled until it exits, so the CPU time
+   it spent after the last sample is not accounted */
+static void
+sample_threads (GHashTable * samples)
+{
+  const gchar *tid;
+  gchar *comm, *schedstat;
+  ThreadSample *sample;
+  GDir *dir;
+
+  dir = g_dir_open ("/proc/self/task", 0, NULL);
+  if (!dir)
+    return;
+
+  while ((tid = g_dir_read_name (dir))) {
+    comm = read_task_file (tid, "comm");
+    schedstat = read_task_file (tid, "schedstat");
+    if (comm && schedstat) {
+      sample = g_hash_table_lookup (samples, tid);
+      if (!sample) {
+        sample = g_new0 (ThreadSample, 1);
+        sample->name = g_strdup (g_strstrip (comm));
+        g_hash_table_insert (samples, g_strdup (tid), sample);
+      }
+      /* The first field is the time spent on the CPU, in nanoseconds */
+      sample->cpu_time = g_ascii_strtoull (schedstat, NULL, 10) / 1000;
+    }
+    g_free (schedstat);
+    g_free (comm);
+  }
+  g_dir_close (dir);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Report                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* The run function adds the CPU time of the threads it spawns, e.g.
+   the output thread of the encoder streams, to the stream CPU time.
+   The threads spawned by the library itself cannot be told apart per
+   stream, see sample_threads() */
+static gpointer
+stream_thread (gpointer data)
+{
+  Stream *const stream = data;
+  gint64 wall_start, cpu_start;
+
+  wall_start = g_get_monotonic_time ();
+  cpu_start = get_thread_cpu_time ();
+  stream->success = stream->run (stream);
+  stream->cpu_time += get_thread_cpu_time () - cpu_start;
+  stream->wall_time = g_get_monotonic_time () - wall_start;
+  g_atomic_int_set (&stream->finished, TRUE);
+  return NULL;
+}
+
+static gint
+compare_latencies (gconstpointer a, gconstpointer b)
+{
+  const gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static gint64
+get_percentile (GArray * latencies, guint percentile)
+{
+  if (latencies->len == 0)
+    return 0;
+  return g_array_index (latencies, gint64,
+      (latencies->len - 1) * percentile / 100);
+}
+
+static guint64
+get_call_count (GstVaapiProfiler * profiler, GstVaapiProfilerCall call)
+{
+  guint64 count = 0;
+
+  gst_vaapi_profiler_get_stats (profiler, call, &count, NULL, NULL);
+  return count;
+}
+
+/* Sums the CPU time of the threads sharing the same name */
+static void
+print_thread_report (GHashTable * samples, guint num_frames)
+{
+  GHashTable *totals;
+  GHashTableIter iter;
+  ThreadSample *sample, *total;
+
+  totals = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+  g_hash_table_iter_init (&iter, samples);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & sample)) {
+    total = g_hash_table_lookup (totals, sample->name);
+    if (!total) {
+      total = g_new0 (ThreadSample, 1);
+      total->name = sample->name;
+      g_hash_table_insert (totals, total->name, total);
+    }
+    total->cpu_time += sample->cpu_time;
+  }
+
+  g_print ("\n%-16s %16s\n", "thread", "cpu/frame (us)");
+  g_hash_table_iter_init (&iter, totals);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & total))
+    g_print ("%-16s %16.1f\n", total->name,
+        (gdouble) total->cpu_time / num_frames);
+  g_hash_table_unref (totals);
+}
+
+static void
+print_report (Stream * streams, gint64 wall_time, gint64 cpu_time,
+    GHashTable * thread_samples, GstVaapiProfiler * profiler,
+    guint64 lock_count, guint64 lock_contended)
+{
+  GArray *latencies;
+  gint64 streams_cpu_time = 0;
+  guint i, num_frames = 0;
+
+  latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  g_print ("%-8s %8s %10s %16s\n", "stream", "frames", "fps",
+      "cpu/frame (us)");
+  for (i = 0; i < g_num_streams; i++) {
+    Stream *const stream = &streams[i];
+
+    g_print ("%-8u %8u %10.1f %16.1f%s\n", i, stream->num_frames,
+        stream->wall_time > 0 ? stream->num_frames * 1e6 /
+        stream->wall_time : 0.0, stream->num_frames > 0 ?
+        (gdouble) stream->cpu_time / stream->num_frames : 0.0,
+        stream->success ? "" : " (failed)");
+    g_array_append_vals (latencies, stream->latencies->data,
+        stream->latencies->len);
+    num_frames += stream->num_frames;
+    streams_cpu_time += stream->cpu_time;
+  }
+  if (num_frames == 0)
+    goto end;
+
+  g_array_sort (latencies, compare_latencies);
+
+  g_print ("\n");
+  g_print ("Frames         : %u in %.3f s, %.1f fps\n", num_frames,
+      wall_time / 1e6, num_frames * 1e6 / wall_time);
+  g_print ("CPU time       : %.1f us/frame (all threads), %.1f us/frame "
+      "(stream threads)\n", (gdouble) cpu_time / num_frames,
+      (gdouble) streams_cpu_time / num_frames);
+  g_print ("Latency        : p50 %" G_GINT64_FORMAT " us, p99 %"
+      G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us\n",
+      get_percentile (latencies, 50), get_percentile (latencies, 99),
+      get_percentile (latencies, 100));
+  g_print ("VA allocations : %.2f buffers/frame, %" G_GUINT64_FORMAT
+      " surfaces, %" G_GUINT64_FORMAT " contexts\n",
+      (gdouble) get_call_count (profiler,
+          GST_VAAPI_PROFILER_CREATE_BUFFER) / num_frames,
+      get_call_count (profiler, GST_VAAPI_PROFILER_CREATE_SURFACES),
+      get_call_count (profiler, GST_VAAPI_PROFILER_CREATE_CONTEXT));
+  g_print ("Display lock   : %.2f acquisitions/frame, %" G_GUINT64_FORMAT
+      " contended\n", (gdouble) lock_count / num_frames, lock_contended);
+
+  print_thread_report (thread_samples, num_frames);
+
+end:
+  g_array_free (latencies, TRUE);
+}
+
+static GstVaapiDisplay *
+create_display (void)
+{
+  if (!g_use_stub)
+    return video_output_create_display (NULL);
+
+#if USE_DRM
+  g_setenv ("LIBVA_DRIVER_NAME", STUB_DRIVER_NAME, TRUE);
+  g_setenv ("LIBVA_DRIVERS_PATH", STUB_DRIVER_DIR, TRUE);
+  return gst_vaapi_display_drm_new (STUB_DEVICE_PATH);
+#else
+  g_printerr ("the stub driver requires DRM support\n");
+  return NULL;
+#endif
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiDisplay *display;
+  GstVaapiProfiler *profiler;
+  StreamRunFunc run;
+  Stream *streams;
+  GHashTable *thread_samples;
+  guint64 lock_count, lock_contended, lock_count0, lock_contended0;
+  gint64 wall_start, cpu_start, wall_time, cpu_time;
+  gboolean success = TRUE;
+  guint i;
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  if (g_num_streams <= 0 || g_num_frames <= 0 || g_width <= 1 ||
+      g_height <= 1)
+    g_error ("invalid number of streams, frames or frame size");
+
+  if (!g_workload_str || !g_strcmp0 (g_workload_str, "decode"))
+    run = run_decode;
+#if USE_ENCODERS
+  else if (!g_strcmp0 (g_workload_str, "encode"))
+    run = run_encode;
+#endif
+  else if (!g_strcmp0 (g_workload_str, "vpp"))
+    run = run_vpp;
+  else
+    g_error ("unsupported workload `%s'", g_workload_str);
+
+  display = create_display ();
+  if (!display)
+    g_error ("could not create VA display");
+
+  gst_vaapi_display_set_va_profiling (display, TRUE);
+  profiler = gst_vaapi_profiler_acquire (gst_vaapi_display_get_display
+      (display));
+  gst_vaapi_profiler_reset (profiler);
+  gst_vaapi_display_get_lock_stats (display, &lock_count0, &lock_contended0);
+
+  g_print ("Workload: %s, %d streams of %d frames%s\n\n",
+      g_workload_str ? g_workload_str : "decode", g_num_streams,
+      g_num_frames, g_use_stub ? ", stub driver" : "");
+
+  streams = g_new0 (Stream, g_num_streams);
+  thread_samples = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      thread_sample_free);
+  wall_start = g_get_monotonic_time ();
+  cpu_start = get_process_cpu_time ();
+  for (i = 0; i < g_num_streams; i++) {
+    Stream *const stream = &streams[i];
+
+    stream->display = display;
+    stream->run = run;
+    stream->latencies = g_array_sized_new (FALSE, FALSE, sizeof (gint64),
+        g_num_frames);
+    stream->thread = g_thread_new ("stream", stream_thread, stream);
+  }
+
+  /* Sample the threads until all the streams are done, so that the
+     threads the library spawns are accounted before they exit */
+  for (i = 0; i < g_num_streams; i++) {
+    while (!g_atomic_int_get (&streams[i].finished)) {
+      sample_threads (thread_samples);
+      g_usleep (10000);
+    }
+  }
+  sample_threads (thread_samples);
+  for (i = 0; i < g_num_streams; i++)
+    g_thread_join (streams[i].thread);
+  cpu_time = get_process_cpu_time () - cpu_start;
+  wall_time = g_get_monotonic_time () - wall_start;
+
+  gst_vaapi_display_get_lock_stats (display, &lock_count, &lock_contended);
+  print_report (streams, wall_time, cpu_time, thread_samples, profiler,
+      lock_count - lock_count0, lock_contended - lock_contended0);
+
+  {
+    gchar *const report = gst_vaapi_display_get_va_profile_report (display);
+    g_print ("\n%s", report);
+    g_free (report);
+  }
+
+  for (i = 0; i < g_num_streams; i++) {
+    success &= streams[i].success;
+    g_array_free (streams[i].latencies, TRUE);
+  }
+  g_free (streams);
+  g_hash_table_unref (thread_samples);
+
+  gst_vaapi_profiler_release (profiler);
+  gst_object_unref (display);
+  g_free (g_workload_str);
+  g_free (g_codec_str);
+  video_output_exit ();
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
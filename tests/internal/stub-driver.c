@@ -0,0 +1,1350 @@
+/*
+ *  stub-driver.c - VA driver that does not process any data
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The stub driver implements the VA objects (configs, contexts,
+ * surfaces, buffers and images) the library creates, but never decodes,
+ * encodes or processes anything: pictures complete as soon as they are
+ * submitted, image transfers do not touch the pixels, and coded buffers
+ * hold a few dummy bytes. It lets the library run, and its CPU cost be
+ * measured, on machines without any GPU. It is loaded by libva as the
+ * "stub" driver, e.g. with LIBVA_DRIVER_NAME=stub and LIBVA_DRIVERS_PATH
+ * set to the directory of stub_drv_video.so.
+ *
+ * The library issues VA calls from many threads at once, and the stub
+ * driver must not be the one serializing them, or it would hide the
+ * contention of the library itself. The objects are reference counted
+ * and spread over several tables with their own reader/writer lock,
+ * and the mutable state of an object is protected by its own lock.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <va/va_backend.h>
+#include <va/va_backend_vpp.h>
+
+#define STUB_DRIVER_EXPORT __attribute__ ((visibility ("default")))
+
+#define STUB_DRIVER_INIT_FUNC_(major, minor) \
+  __vaDriverInit_##major##_##minor
+#define STUB_DRIVER_INIT_FUNC(major, minor) \
+  STUB_DRIVER_INIT_FUNC_(major, minor)
+
+/* libva looks the driver entry point up by the VA API version */
+#define stub_driver_init \
+  STUB_DRIVER_INIT_FUNC (VA_MAJOR_VERSION, VA_MINOR_VERSION)
+
+#define ROUND_UP(x, n) (((x) + (n) - 1) & ~((n) - 1))
+
+#define STUB_VENDOR "GStreamer VA-API stub driver"
+
+/* Size of the dummy payload of the coded buffers */
+#define STUB_CODED_DATA_SIZE 64
+
+#define STUB_MAX_WIDTH  8192
+#define STUB_MAX_HEIGHT 8192
+
+/* Number of object tables, a power of two */
+#define STUB_N_TABLES   16
+
+typedef enum
+{
+  STUB_OBJECT_CONFIG = 1,
+  STUB_OBJECT_CONTEXT,
+  STUB_OBJECT_SURFACE,
+  STUB_OBJECT_BUFFER,
+  STUB_OBJECT_IMAGE,
+  STUB_OBJECT_SUBPICTURE,
+} StubObjectType;
+
+typedef struct
+{
+  StubObjectType type;
+  gint ref_count;
+  GMutex lock;                  /* protects the mutable fields */
+} StubObject;
+
+typedef struct
+{
+  StubObject base;
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+  guint rt_format;
+} StubConfig;
+
+typedef struct
+{
+  StubObject base;
+  VAConfigID config_id;
+  VASurfaceID render_target;    /* protected by the object lock */
+} StubContext;
+
+typedef struct
+{
+  StubObject base;
+  guint width;
+  guint height;
+  guint fourcc;
+  guint8 *data;                 /* allocated on vaDeriveImage(), under
+                                   the object lock */
+  gsize data_size;
+} StubSurface;
+
+typedef struct
+{
+  StubObject base;
+  VABufferType type;
+  guint size;
+  guint num_elements;           /* protected by the object lock */
+  guint max_num_elements;
+  guint8 *data;
+  gboolean is_foreign;          /* data is owned by a surface */
+} StubBuffer;
+
+typedef struct
+{
+  StubObject base;
+  VAImage image;
+} StubImage;
+
+typedef struct
+{
+  StubObject base;
+  VAImageID image_id;
+} StubSubpicture;
+
+typedef struct
+{
+  GRWLock lock;
+  GHashTable *objects;
+} StubObjectTable;
+
+typedef struct
+{
+  StubObjectTable tables[STUB_N_TABLES];
+  gint next_id;                 /* atomic */
+} StubDriver;
+
+typedef struct
+{
+  VAProfile profile;
+  VAEntrypoint entrypoint;
+} StubCodec;
+
+static const StubCodec g_codecs[] = {
+  {VAProfileMPEG2Simple, VAEntrypointVLD},
+  {VAProfileMPEG2Simple, VAEntrypointEncSlice},
+  {VAProfileMPEG2Main, VAEntrypointVLD},
+  {VAProfileMPEG2Main, VAEntrypointEncSlice},
+  {VAProfileMPEG4Simple, VAEntrypointVLD},
+  {VAProfileMPEG4AdvancedSimple, VAEntrypointVLD},
+  {VAProfileMPEG4Main, VAEntrypointVLD},
+  {VAProfileH264ConstrainedBaseline, VAEntrypointVLD},
+  {VAProfileH264ConstrainedBaseline, VAEntrypointEncSlice},
+  {VAProfileH264Main, VAEntrypointVLD},
+  {VAProfileH264Main, VAEntrypointEncSlice},
+  {VAProfileH264High, VAEntrypointVLD},
+  {VAProfileH264High, VAEntrypointEncSlice},
+  {VAProfileVC1Simple, VAEntrypointVLD},
+  {VAProfileVC1Main, VAEntrypointVLD},
+  {VAProfileVC1Advanced, VAEntrypointVLD},
+  {VAProfileJPEGBaseline, VAEntrypointVLD},
+  {VAProfileJPEGBaseline, VAEntrypointEncPicture},
+  {VAProfileHEVCMain, VAEntrypointVLD},
+  {VAProfileHEVCMain, VAEntrypointEncSlice},
+  {VAProfileNone, VAEntrypointVideoProc},
+};
+
+static const VAImageFormat g_image_formats[] = {
+  {VA_FOURCC_NV12, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_I420, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_YV12, VA_LSB_FIRST, 12,},
+  {VA_FOURCC_YUY2, VA_LSB_FIRST, 16,},
+  {VA_FOURCC_BGRA, VA_LSB_FIRST, 32, 32,
+      0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000},
+  {VA_FOURCC_BGRX, VA_LSB_FIRST, 32, 24,
+      0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000},
+  {VA_FOURCC_RGBA, VA_LSB_FIRST, 32, 32,
+      0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000},
+  {VA_FOURCC_RGBX, VA_LSB_FIRST, 32, 24,
+      0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000},
+};
+
+static const VAImageFormat g_subpicture_formats[] = {
+  {VA_FOURCC_BGRA, VA_LSB_FIRST, 32, 32,
+      0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000},
+};
+
+static VAProcColorStandardType g_color_standards[] = {
+  VAProcColorStandardBT601,
+  VAProcColorStandardBT709,
+};
+
+#define STUB_DRIVER(ctx) ((StubDriver *) (ctx)->pDriverData)
+
+/* ------------------------------------------------------------------------- */
+/* --- Objects                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+static void
+stub_object_unref (gpointer data)
+{
+  StubObject *const object = data;
+
+  if (!g_atomic_int_dec_and_test (&object->ref_count))
+    return;
+
+  switch (object->type) {
+    case STUB_OBJECT_SURFACE:
+      g_free (((StubSurface *) object)->data);
+      break;
+    case STUB_OBJECT_BUFFER:{
+      StubBuffer *const buffer = (StubBuffer *) object;
+      if (!buffer->is_foreign)
+        g_free (buffer->data);
+      break;
+    }
+    default:
+      break;
+  }
+  g_mutex_clear (&object->lock);
+  g_free (object);
+}
+
+static inline StubObjectTable *
+stub_object_table (StubDriver * drv, VAGenericID id)
+{
+  return &drv->tables[id & (STUB_N_TABLES - 1)];
+}
+
+/* Returns the new object, which remains valid until the caller returns
+   its id, since no other thread can destroy it before */
+static gpointer
+stub_object_new (StubDriver * drv, StubObjectType type, gsize size,
+    VAGenericID * id_ptr)
+{
+  StubObject *const object = g_malloc0 (size);
+  StubObjectTable *table;
+
+  object->type = type;
+  object->ref_count = 1;
+  g_mutex_init (&object->lock);
+  *id_ptr = g_atomic_int_add (&drv->next_id, 1);
+
+  table = stub_object_table (drv, *id_ptr);
+  g_rw_lock_writer_lock (&table->lock);
+  g_hash_table_insert (table->objects, GUINT_TO_POINTER (*id_ptr), object);
+  g_rw_lock_writer_unlock (&table->lock);
+  return object;
+}
+
+/* Returns a new reference to the object, to be released with
+   stub_object_unref() */
+static gpointer
+stub_object_lookup (StubDriver * drv, VAGenericID id, StubObjectType type)
+{
+  StubObjectTable *const table = stub_object_table (drv, id);
+  StubObject *object;
+
+  g_rw_lock_reader_lock (&table->lock);
+  object = g_hash_table_lookup (table->objects, GUINT_TO_POINTER (id));
+  if (object && object->type == type)
+    g_atomic_int_inc (&object->ref_count);
+  else
+    object = NULL;
+  g_rw_lock_reader_unlock (&table->lock);
+  return object;
+}
+
+static gboolean
+stub_object_exists (StubDriver * drv, VAGenericID id, StubObjectType type)
+{
+  StubObject *const object = stub_object_lookup (drv, id, type);
+
+  if (!object)
+    return FALSE;
+  stub_object_unref (object);
+  return TRUE;
+}
+
+static gboolean
+stub_object_destroy (StubDriver * drv, VAGenericID id, StubObjectType type)
+{
+  StubObjectTable *const table = stub_object_table (drv, id);
+  StubObject *object;
+  gboolean success = FALSE;
+
+  g_rw_lock_writer_lock (&table->lock);
+  object = g_hash_table_lookup (table->objects, GUINT_TO_POINTER (id));
+  if (object && object->type == type)
+    success = g_hash_table_remove (table->objects, GUINT_TO_POINTER (id));
+  g_rw_lock_writer_unlock (&table->lock);
+  return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Configs                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+static gboolean
+is_supported_profile (VAProfile profile)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_codecs); i++) {
+    if (g_codecs[i].profile == profile)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+is_supported_codec (VAProfile profile, VAEntrypoint entrypoint)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (g_codecs); i++) {
+    if (g_codecs[i].profile == profile &&
+        g_codecs[i].entrypoint == entrypoint)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+is_encoder (VAEntrypoint entrypoint)
+{
+  return entrypoint == VAEntrypointEncSlice ||
+      entrypoint == VAEntrypointEncPicture;
+}
+
+static guint
+get_config_attrib (VAProfile profile, VAEntrypoint entrypoint,
+    VAConfigAttribType type)
+{
+  switch (type) {
+    case VAConfigAttribRTFormat:
+      if (entrypoint == VAEntrypointVideoProc)
+        return VA_RT_FORMAT_YUV420 | VA_RT_FORMAT_RGB32;
+      return VA_RT_FORMAT_YUV420;
+    case VAConfigAttribRateControl:
+      if (is_encoder (entrypoint))
+        return VA_RC_CQP | VA_RC_CBR | VA_RC_VBR;
+      break;
+    case VAConfigAttribEncPackedHeaders:
+      if (is_encoder (entrypoint))
+        return VA_ENC_PACKED_HEADER_SEQUENCE | VA_ENC_PACKED_HEADER_PICTURE |
+            VA_ENC_PACKED_HEADER_SLICE | VA_ENC_PACKED_HEADER_MISC |
+            VA_ENC_PACKED_HEADER_RAW_DATA;
+      break;
+    case VAConfigAttribEncMaxRefFrames:
+      if (is_encoder (entrypoint))
+        return 4 | (1 << 16);
+      break;
+    case VAConfigAttribEncMaxSlices:
+      if (is_encoder (entrypoint))
+        return 1;
+      break;
+    default:
+      break;
+  }
+  return VA_ATTRIB_NOT_SUPPORTED;
+}
+
+static VAStatus
+stub_QueryConfigProfiles (VADriverContextP ctx, VAProfile * profiles,
+    int *num_profiles)
+{
+  guint i, j, n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (g_codecs); i++) {
+    for (j = 0; j < n; j++) {
+      if (profiles[j] == g_codecs[i].profile)
+        break;
+    }
+    if (j == n)
+      profiles[n++] = g_codecs[i].profile;
+  }
+  *num_profiles = n;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryConfigEntrypoints (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint * entrypoints, int *num_entrypoints)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (g_codecs); i++) {
+    if (g_codecs[i].profile == profile)
+      entrypoints[n++] = g_codecs[i].entrypoint;
+  }
+  *num_entrypoints = n;
+  return n > 0 ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+}
+
+static VAStatus
+stub_GetConfigAttributes (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs)
+{
+  gint i;
+
+  if (!is_supported_profile (profile))
+    return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+  if (!is_supported_codec (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+  for (i = 0; i < num_attribs; i++)
+    attribs[i].value = get_config_attrib (profile, entrypoint, attribs[i].type);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateConfig (VADriverContextP ctx, VAProfile profile,
+    VAEntrypoint entrypoint, VAConfigAttrib * attribs, int num_attribs,
+    VAConfigID * config_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubConfig *config;
+  guint rt_format = VA_RT_FORMAT_YUV420;
+  gint i;
+
+  if (!is_supported_profile (profile))
+    return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+  if (!is_supported_codec (profile, entrypoint))
+    return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+  for (i = 0; i < num_attribs; i++) {
+    if (attribs[i].type == VAConfigAttribRTFormat)
+      rt_format = attribs[i].value;
+  }
+
+  config = stub_object_new (drv, STUB_OBJECT_CONFIG, sizeof (*config),
+      config_id);
+  config->profile = profile;
+  config->entrypoint = entrypoint;
+  config->rt_format = rt_format;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyConfig (VADriverContextP ctx, VAConfigID config_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_destroy (drv, config_id, STUB_OBJECT_CONFIG))
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryConfigAttributes (VADriverContextP ctx, VAConfigID config_id,
+    VAProfile * profile, VAEntrypoint * entrypoint, VAConfigAttrib * attribs,
+    int *num_attribs)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubConfig *config;
+
+  config = stub_object_lookup (drv, config_id, STUB_OBJECT_CONFIG);
+  if (!config)
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+
+  *profile = config->profile;
+  *entrypoint = config->entrypoint;
+  attribs[0].type = VAConfigAttribRTFormat;
+  attribs[0].value = config->rt_format;
+  *num_attribs = 1;
+  stub_object_unref (config);
+  return VA_STATUS_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Surfaces                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static const guint g_surface_formats[] = {
+  VA_FOURCC_NV12, VA_FOURCC_I420, VA_FOURCC_YV12, VA_FOURCC_BGRA,
+  VA_FOURCC_BGRX, VA_FOURCC_RGBA, VA_FOURCC_RGBX,
+};
+
+static void
+set_surface_attrib (VASurfaceAttrib * attrib, VASurfaceAttribType type,
+    guint flags, gint value)
+{
+  attrib->type = type;
+  attrib->flags = flags;
+  attrib->value.type = VAGenericValueTypeInteger;
+  attrib->value.value.i = value;
+}
+
+static VAStatus
+stub_QuerySurfaceAttributes (VADriverContextP ctx, VAConfigID config_id,
+    VASurfaceAttrib * attribs, unsigned int *num_attribs)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubConfig *config;
+  guint i, num_formats, n = 0;
+
+  config = stub_object_lookup (drv, config_id, STUB_OBJECT_CONFIG);
+  if (!config)
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+  num_formats = config->entrypoint == VAEntrypointVideoProc ?
+      G_N_ELEMENTS (g_surface_formats) : 1;
+  stub_object_unref (config);
+
+  /* The pixel formats, then the memory type and the size limits */
+  if (!attribs) {
+    *num_attribs = num_formats + 5;
+    return VA_STATUS_SUCCESS;
+  }
+  if (*num_attribs < num_formats + 5) {
+    *num_attribs = num_formats + 5;
+    return VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+  }
+
+  for (i = 0; i < num_formats; i++)
+    set_surface_attrib (&attribs[n++], VASurfaceAttribPixelFormat,
+        VA_SURFACE_ATTRIB_GETTABLE | VA_SURFACE_ATTRIB_SETTABLE,
+        g_surface_formats[i]);
+  set_surface_attrib (&attribs[n++], VASurfaceAttribMemoryType,
+      VA_SURFACE_ATTRIB_GETTABLE | VA_SURFACE_ATTRIB_SETTABLE,
+      VA_SURFACE_ATTRIB_MEM_TYPE_VA);
+  set_surface_attrib (&attribs[n++], VASurfaceAttribMinWidth,
+      VA_SURFACE_ATTRIB_GETTABLE, 1);
+  set_surface_attrib (&attribs[n++], VASurfaceAttribMinHeight,
+      VA_SURFACE_ATTRIB_GETTABLE, 1);
+  set_surface_attrib (&attribs[n++], VASurfaceAttribMaxWidth,
+      VA_SURFACE_ATTRIB_GETTABLE, STUB_MAX_WIDTH);
+  set_surface_attrib (&attribs[n++], VASurfaceAttribMaxHeight,
+      VA_SURFACE_ATTRIB_GETTABLE, STUB_MAX_HEIGHT);
+  *num_attribs = n;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateSurfaces2 (VADriverContextP ctx, unsigned int format,
+    unsigned int width, unsigned int height, VASurfaceID * surfaces,
+    unsigned int num_surfaces, VASurfaceAttrib * attribs,
+    unsigned int num_attribs)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubSurface *surface;
+  guint i, fourcc;
+
+  if (width == 0 || height == 0 || width > STUB_MAX_WIDTH ||
+      height > STUB_MAX_HEIGHT)
+    return VA_STATUS_ERROR_RESOLUTION_NOT_SUPPORTED;
+
+  switch (format) {
+    case VA_RT_FORMAT_YUV420:
+      fourcc = VA_FOURCC_NV12;
+      break;
+    case VA_RT_FORMAT_RGB32:
+      fourcc = VA_FOURCC_BGRA;
+      break;
+    default:
+      return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+  }
+
+  for (i = 0; i < num_attribs; i++) {
+    if (!(attribs[i].flags & VA_SURFACE_ATTRIB_SETTABLE))
+      continue;
+    switch (attribs[i].type) {
+      case VASurfaceAttribPixelFormat:
+        fourcc = attribs[i].value.value.i;
+        break;
+      case VASurfaceAttribMemoryType:
+        if (attribs[i].value.value.i != VA_SURFACE_ATTRIB_MEM_TYPE_VA)
+          return VA_STATUS_ERROR_UNSUPPORTED_MEMORY_TYPE;
+        break;
+      default:
+        break;
+    }
+  }
+
+  for (i = 0; i < num_surfaces; i++) {
+    surface = stub_object_new (drv, STUB_OBJECT_SURFACE, sizeof (*surface),
+        &surfaces[i]);
+    surface->width = width;
+    surface->height = height;
+    surface->fourcc = fourcc;
+  }
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateSurfaces (VADriverContextP ctx, int width, int height, int format,
+    int num_surfaces, VASurfaceID * surfaces)
+{
+  return stub_CreateSurfaces2 (ctx, format, width, height, surfaces,
+      num_surfaces, NULL, 0);
+}
+
+static VAStatus
+stub_DestroySurfaces (VADriverContextP ctx, VASurfaceID * surfaces,
+    int num_surfaces)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  gboolean success = TRUE;
+  gint i;
+
+  for (i = 0; i < num_surfaces; i++)
+    success &= stub_object_destroy (drv, surfaces[i], STUB_OBJECT_SURFACE);
+  return success ? VA_STATUS_SUCCESS : VA_STATUS_ERROR_INVALID_SURFACE;
+}
+
+static VAStatus
+stub_check_surface (VADriverContextP ctx, VASurfaceID surface_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_exists (drv, surface_id, STUB_OBJECT_SURFACE))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  return VA_STATUS_SUCCESS;
+}
+
+/* Pictures complete as soon as they are submitted */
+static VAStatus
+stub_SyncSurface (VADriverContextP ctx, VASurfaceID surface_id)
+{
+  return stub_check_surface (ctx, surface_id);
+}
+
+static VAStatus
+stub_QuerySurfaceStatus (VADriverContextP ctx, VASurfaceID surface_id,
+    VASurfaceStatus * status)
+{
+  *status = VASurfaceReady;
+  return stub_check_surface (ctx, surface_id);
+}
+
+static VAStatus
+stub_QuerySurfaceError (VADriverContextP ctx, VASurfaceID surface_id,
+    VAStatus error_status, void **error_info)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+stub_PutSurface (VADriverContextP ctx, VASurfaceID surface_id, void *draw,
+    short srcx, short srcy, unsigned short srcw, unsigned short srch,
+    short destx, short desty, unsigned short destw, unsigned short desth,
+    VARectangle * cliprects, unsigned int num_cliprects, unsigned int flags)
+{
+  return stub_check_surface (ctx, surface_id);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Contexts                                                          --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+stub_CreateContext (VADriverContextP ctx, VAConfigID config_id,
+    int picture_width, int picture_height, int flag,
+    VASurfaceID * render_targets, int num_render_targets,
+    VAContextID * context_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubContext *context;
+
+  if (!stub_object_exists (drv, config_id, STUB_OBJECT_CONFIG))
+    return VA_STATUS_ERROR_INVALID_CONFIG;
+
+  context = stub_object_new (drv, STUB_OBJECT_CONTEXT, sizeof (*context),
+      context_id);
+  context->config_id = config_id;
+  context->render_target = VA_INVALID_SURFACE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyContext (VADriverContextP ctx, VAContextID context_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_destroy (drv, context_id, STUB_OBJECT_CONTEXT))
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_BeginPicture (VADriverContextP ctx, VAContextID context_id,
+    VASurfaceID surface_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubContext *context;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  context = stub_object_lookup (drv, context_id, STUB_OBJECT_CONTEXT);
+  if (!context)
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+  if (stub_object_exists (drv, surface_id, STUB_OBJECT_SURFACE)) {
+    g_mutex_lock (&context->base.lock);
+    context->render_target = surface_id;
+    g_mutex_unlock (&context->base.lock);
+  } else {
+    status = VA_STATUS_ERROR_INVALID_SURFACE;
+  }
+  stub_object_unref (context);
+  return status;
+}
+
+static VAStatus
+stub_RenderPicture (VADriverContextP ctx, VAContextID context_id,
+    VABufferID * buffers, int num_buffers)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubContext *context;
+  VAStatus status = VA_STATUS_SUCCESS;
+  gint i;
+
+  context = stub_object_lookup (drv, context_id, STUB_OBJECT_CONTEXT);
+  if (!context)
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+  g_mutex_lock (&context->base.lock);
+  if (context->render_target == VA_INVALID_SURFACE)
+    status = VA_STATUS_ERROR_INVALID_CONTEXT;
+  g_mutex_unlock (&context->base.lock);
+  stub_object_unref (context);
+
+  for (i = 0; i < num_buffers && status == VA_STATUS_SUCCESS; i++) {
+    if (!stub_object_exists (drv, buffers[i], STUB_OBJECT_BUFFER))
+      status = VA_STATUS_ERROR_INVALID_BUFFER;
+  }
+  return status;
+}
+
+static VAStatus
+stub_EndPicture (VADriverContextP ctx, VAContextID context_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubContext *context;
+
+  context = stub_object_lookup (drv, context_id, STUB_OBJECT_CONTEXT);
+  if (!context)
+    return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+  g_mutex_lock (&context->base.lock);
+  context->render_target = VA_INVALID_SURFACE;
+  g_mutex_unlock (&context->base.lock);
+  stub_object_unref (context);
+  return VA_STATUS_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Buffers                                                           --- */
+/* ------------------------------------------------------------------------- */
+
+static StubBuffer *
+stub_buffer_new (StubDriver * drv, VABufferType type, guint size,
+    guint num_elements, VABufferID * buf_id)
+{
+  StubBuffer *const buffer = stub_object_new (drv, STUB_OBJECT_BUFFER,
+      sizeof (*buffer), buf_id);
+  gsize data_size = (gsize) size * num_elements;
+
+  buffer->type = type;
+  buffer->size = size;
+  buffer->num_elements = num_elements;
+  buffer->max_num_elements = num_elements;
+
+  /* The coded buffers hold a single segment, followed by its data */
+  if (type == VAEncCodedBufferType)
+    data_size += sizeof (VACodedBufferSegment);
+  buffer->data = g_malloc0 (MAX (data_size, 1));
+  return buffer;
+}
+
+static VAStatus
+stub_CreateBuffer (VADriverContextP ctx, VAContextID context_id,
+    VABufferType type, unsigned int size, unsigned int num_elements,
+    void *data, VABufferID * buf_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubBuffer *buffer;
+
+  buffer = stub_buffer_new (drv, type, size, num_elements, buf_id);
+  if (data && type != VAEncCodedBufferType)
+    memcpy (buffer->data, data, (gsize) size * num_elements);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_BufferSetNumElements (VADriverContextP ctx, VABufferID buf_id,
+    unsigned int num_elements)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubBuffer *buffer;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  buffer = stub_object_lookup (drv, buf_id, STUB_OBJECT_BUFFER);
+  if (!buffer)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+
+  if (num_elements > buffer->max_num_elements)
+    status = VA_STATUS_ERROR_INVALID_PARAMETER;
+  else {
+    g_mutex_lock (&buffer->base.lock);
+    buffer->num_elements = num_elements;
+    g_mutex_unlock (&buffer->base.lock);
+  }
+  stub_object_unref (buffer);
+  return status;
+}
+
+static VAStatus
+stub_MapBuffer (VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubBuffer *buffer;
+
+  buffer = stub_object_lookup (drv, buf_id, STUB_OBJECT_BUFFER);
+  if (!buffer)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+
+  g_mutex_lock (&buffer->base.lock);
+  if (buffer->type == VAEncCodedBufferType) {
+    VACodedBufferSegment *const segment = (VACodedBufferSegment *) buffer->data;
+    const gsize size = (gsize) buffer->size * buffer->num_elements;
+
+    memset (segment, 0, sizeof (*segment));
+    segment->size = MIN (size, STUB_CODED_DATA_SIZE);
+    segment->buf = buffer->data + sizeof (*segment);
+  }
+  *pbuf = buffer->data;
+  g_mutex_unlock (&buffer->base.lock);
+  stub_object_unref (buffer);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_UnmapBuffer (VADriverContextP ctx, VABufferID buf_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_exists (drv, buf_id, STUB_OBJECT_BUFFER))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyBuffer (VADriverContextP ctx, VABufferID buf_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_destroy (drv, buf_id, STUB_OBJECT_BUFFER))
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_BufferInfo (VADriverContextP ctx, VABufferID buf_id, VABufferType * type,
+    unsigned int *size, unsigned int *num_elements)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubBuffer *buffer;
+
+  buffer = stub_object_lookup (drv, buf_id, STUB_OBJECT_BUFFER);
+  if (!buffer)
+    return VA_STATUS_ERROR_INVALID_BUFFER;
+
+  g_mutex_lock (&buffer->base.lock);
+  *type = buffer->type;
+  *size = buffer->size;
+  *num_elements = buffer->num_elements;
+  g_mutex_unlock (&buffer->base.lock);
+  stub_object_unref (buffer);
+  return VA_STATUS_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Images                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+/* Fills in the planes of @image, from its format and size */
+static gboolean
+stub_image_init (VAImage * image, guint pitch, guint height)
+{
+  const guint width = image->width;
+  const guint luma_size = pitch * height;
+
+  switch (image->format.fourcc) {
+    case VA_FOURCC_NV12:
+      image->num_planes = 2;
+      image->pitches[0] = pitch;
+      image->pitches[1] = pitch;
+      image->offsets[0] = 0;
+      image->offsets[1] = luma_size;
+      image->data_size = luma_size + pitch * ((height + 1) / 2);
+      break;
+    case VA_FOURCC_I420:
+    case VA_FOURCC_YV12:
+      image->num_planes = 3;
+      image->pitches[0] = pitch;
+      image->pitches[1] = pitch / 2;
+      image->pitches[2] = pitch / 2;
+      image->offsets[0] = 0;
+      image->offsets[1] = luma_size;
+      image->offsets[2] = luma_size + (pitch / 2) * ((height + 1) / 2);
+      image->data_size = image->offsets[2] + (pitch / 2) * ((height + 1) / 2);
+      break;
+    case VA_FOURCC_YUY2:
+      image->num_planes = 1;
+      image->pitches[0] = pitch * 2;
+      image->offsets[0] = 0;
+      image->data_size = pitch * 2 * height;
+      break;
+    case VA_FOURCC_BGRA:
+    case VA_FOURCC_BGRX:
+    case VA_FOURCC_RGBA:
+    case VA_FOURCC_RGBX:
+      image->num_planes = 1;
+      image->pitches[0] = pitch * 4;
+      image->offsets[0] = 0;
+      image->data_size = pitch * 4 * height;
+      break;
+    default:
+      return FALSE;
+  }
+  return width > 0 && height > 0;
+}
+
+static VAStatus
+stub_QueryImageFormats (VADriverContextP ctx, VAImageFormat * formats,
+    int *num_formats)
+{
+  memcpy (formats, g_image_formats, sizeof (g_image_formats));
+  *num_formats = G_N_ELEMENTS (g_image_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateImage (VADriverContextP ctx, VAImageFormat * format, int width,
+    int height, VAImage * out_image)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubImage *image;
+  VAImage va_image;
+
+  memset (&va_image, 0, sizeof (va_image));
+  va_image.format = *format;
+  va_image.width = width;
+  va_image.height = height;
+  if (!stub_image_init (&va_image, ROUND_UP (width, 16),
+          ROUND_UP (height, 2)))
+    return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+
+  stub_buffer_new (drv, VAImageBufferType, va_image.data_size, 1,
+      &va_image.buf);
+  image = stub_object_new (drv, STUB_OBJECT_IMAGE, sizeof (*image),
+      &va_image.image_id);
+  image->image = va_image;
+
+  *out_image = va_image;
+  return VA_STATUS_SUCCESS;
+}
+
+/* Only NV12 surfaces can be derived. Their pixels are allocated on
+   the first call */
+static VAStatus
+stub_DeriveImage (VADriverContextP ctx, VASurfaceID surface_id,
+    VAImage * out_image)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubSurface *surface;
+  StubBuffer *buffer;
+  StubImage *image;
+  VAImage va_image;
+  guint8 *data;
+  gsize data_size;
+
+  surface = stub_object_lookup (drv, surface_id, STUB_OBJECT_SURFACE);
+  if (!surface)
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (surface->fourcc != VA_FOURCC_NV12) {
+    stub_object_unref (surface);
+    return VA_STATUS_ERROR_OPERATION_FAILED;
+  }
+
+  memset (&va_image, 0, sizeof (va_image));
+  va_image.format = g_image_formats[0];
+  va_image.width = surface->width;
+  va_image.height = surface->height;
+  stub_image_init (&va_image, ROUND_UP (surface->width, 16),
+      ROUND_UP (surface->height, 16));
+
+  g_mutex_lock (&surface->base.lock);
+  if (!surface->data) {
+    surface->data_size = va_image.data_size;
+    surface->data = g_malloc0 (surface->data_size);
+  }
+  data = surface->data;
+  data_size = surface->data_size;
+  g_mutex_unlock (&surface->base.lock);
+
+  /* The derived image does not keep the surface alive, as with the
+     real drivers */
+  buffer = stub_object_new (drv, STUB_OBJECT_BUFFER, sizeof (*buffer),
+      &va_image.buf);
+  buffer->type = VAImageBufferType;
+  buffer->size = data_size;
+  buffer->num_elements = 1;
+  buffer->max_num_elements = 1;
+  buffer->data = data;
+  buffer->is_foreign = TRUE;
+  stub_object_unref (surface);
+
+  image = stub_object_new (drv, STUB_OBJECT_IMAGE, sizeof (*image),
+      &va_image.image_id);
+  image->image = va_image;
+  *out_image = va_image;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroyImage (VADriverContextP ctx, VAImageID image_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubImage *image;
+  VABufferID buf_id;
+
+  image = stub_object_lookup (drv, image_id, STUB_OBJECT_IMAGE);
+  if (!image)
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  buf_id = image->image.buf;
+  stub_object_unref (image);
+
+  if (!stub_object_destroy (drv, image_id, STUB_OBJECT_IMAGE))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  stub_object_destroy (drv, buf_id, STUB_OBJECT_BUFFER);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SetImagePalette (VADriverContextP ctx, VAImageID image_id,
+    unsigned char *palette)
+{
+  return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+static VAStatus
+stub_check_surface_and_image (VADriverContextP ctx, VASurfaceID surface_id,
+    VAImageID image_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_exists (drv, surface_id, STUB_OBJECT_SURFACE))
+    return VA_STATUS_ERROR_INVALID_SURFACE;
+  if (!stub_object_exists (drv, image_id, STUB_OBJECT_IMAGE))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+  return VA_STATUS_SUCCESS;
+}
+
+/* Image transfers do not copy any pixels */
+static VAStatus
+stub_GetImage (VADriverContextP ctx, VASurfaceID surface_id, int x, int y,
+    unsigned int width, unsigned int height, VAImageID image_id)
+{
+  return stub_check_surface_and_image (ctx, surface_id, image_id);
+}
+
+static VAStatus
+stub_PutImage (VADriverContextP ctx, VASurfaceID surface_id,
+    VAImageID image_id, int src_x, int src_y, unsigned int src_width,
+    unsigned int src_height, int dest_x, int dest_y, unsigned int dest_width,
+    unsigned int dest_height)
+{
+  return stub_check_surface_and_image (ctx, surface_id, image_id);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Subpictures                                                       --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+stub_QuerySubpictureFormats (VADriverContextP ctx, VAImageFormat * formats,
+    unsigned int *flags, unsigned int *num_formats)
+{
+  memcpy (formats, g_subpicture_formats, sizeof (g_subpicture_formats));
+  if (flags)
+    memset (flags, 0, G_N_ELEMENTS (g_subpicture_formats) * sizeof (*flags));
+  *num_formats = G_N_ELEMENTS (g_subpicture_formats);
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_CreateSubpicture (VADriverContextP ctx, VAImageID image_id,
+    VASubpictureID * subpicture_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubSubpicture *subpicture;
+
+  if (!stub_object_exists (drv, image_id, STUB_OBJECT_IMAGE))
+    return VA_STATUS_ERROR_INVALID_IMAGE;
+
+  subpicture = stub_object_new (drv, STUB_OBJECT_SUBPICTURE,
+      sizeof (*subpicture), subpicture_id);
+  subpicture->image_id = image_id;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_DestroySubpicture (VADriverContextP ctx, VASubpictureID subpicture_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_destroy (drv, subpicture_id, STUB_OBJECT_SUBPICTURE))
+    return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_check_subpicture (VADriverContextP ctx, VASubpictureID subpicture_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+
+  if (!stub_object_exists (drv, subpicture_id, STUB_OBJECT_SUBPICTURE))
+    return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_SetSubpictureImage (VADriverContextP ctx, VASubpictureID subpicture_id,
+    VAImageID image_id)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  StubSubpicture *subpicture;
+  VAStatus status = VA_STATUS_SUCCESS;
+
+  subpicture = stub_object_lookup (drv, subpicture_id, STUB_OBJECT_SUBPICTURE);
+  if (!subpicture)
+    return VA_STATUS_ERROR_INVALID_SUBPICTURE;
+
+  if (stub_object_exists (drv, image_id, STUB_OBJECT_IMAGE)) {
+    g_mutex_lock (&subpicture->base.lock);
+    subpicture->image_id = image_id;
+    g_mutex_unlock (&subpicture->base.lock);
+  } else {
+    status = VA_STATUS_ERROR_INVALID_IMAGE;
+  }
+  stub_object_unref (subpicture);
+  return status;
+}
+
+static VAStatus
+stub_SetSubpictureChromakey (VADriverContextP ctx,
+    VASubpictureID subpicture_id, unsigned int chromakey_min,
+    unsigned int chromakey_max, unsigned int chromakey_mask)
+{
+  return stub_check_subpicture (ctx, subpicture_id);
+}
+
+static VAStatus
+stub_SetSubpictureGlobalAlpha (VADriverContextP ctx,
+    VASubpictureID subpicture_id, float global_alpha)
+{
+  return stub_check_subpicture (ctx, subpicture_id);
+}
+
+static VAStatus
+stub_AssociateSubpicture (VADriverContextP ctx, VASubpictureID subpicture_id,
+    VASurfaceID * surfaces, int num_surfaces, short src_x, short src_y,
+    unsigned short src_width, unsigned short src_height, short dest_x,
+    short dest_y, unsigned short dest_width, unsigned short dest_height,
+    unsigned int flags)
+{
+  return stub_check_subpicture (ctx, subpicture_id);
+}
+
+static VAStatus
+stub_DeassociateSubpicture (VADriverContextP ctx,
+    VASubpictureID subpicture_id, VASurfaceID * surfaces, int num_surfaces)
+{
+  return stub_check_subpicture (ctx, subpicture_id);
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Display attributes                                                --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+stub_QueryDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attribs, int *num_attribs)
+{
+  *num_attribs = 0;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_GetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attribs, int num_attribs)
+{
+  return VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+}
+
+static VAStatus
+stub_SetDisplayAttributes (VADriverContextP ctx,
+    VADisplayAttribute * attribs, int num_attribs)
+{
+  return VA_STATUS_ERROR_ATTR_NOT_SUPPORTED;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Video processing                                                  --- */
+/* ------------------------------------------------------------------------- */
+
+/* Only scaling and color conversion are supported */
+static VAStatus
+stub_QueryVideoProcFilters (VADriverContextP ctx, VAContextID context_id,
+    VAProcFilterType * filters, unsigned int *num_filters)
+{
+  *num_filters = 0;
+  return VA_STATUS_SUCCESS;
+}
+
+static VAStatus
+stub_QueryVideoProcFilterCaps (VADriverContextP ctx, VAContextID context_id,
+    VAProcFilterType type, void *filter_caps, unsigned int *num_filter_caps)
+{
+  *num_filter_caps = 0;
+  return VA_STATUS_ERROR_UNSUPPORTED_FILTER;
+}
+
+static VAStatus
+stub_QueryVideoProcPipelineCaps (VADriverContextP ctx,
+    VAContextID context_id, VABufferID * filters, unsigned int num_filters,
+    VAProcPipelineCaps * pipeline_caps)
+{
+  pipeline_caps->pipeline_flags = 0;
+  pipeline_caps->filter_flags = 0;
+  pipeline_caps->num_forward_references = 0;
+  pipeline_caps->num_backward_references = 0;
+  pipeline_caps->input_color_standards = g_color_standards;
+  pipeline_caps->num_input_color_standards = G_N_ELEMENTS (g_color_standards);
+  pipeline_caps->output_color_standards = g_color_standards;
+  pipeline_caps->num_output_color_standards = G_N_ELEMENTS (g_color_standards);
+  pipeline_caps->rotation_flags = 1 << VA_ROTATION_NONE;
+  pipeline_caps->blend_flags = 0;
+#if VA_CHECK_VERSION(1,1,0)
+  pipeline_caps->mirror_flags = 0;
+  pipeline_caps->num_additional_outputs = 0;
+#endif
+  return VA_STATUS_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* --- Driver                                                            --- */
+/* ------------------------------------------------------------------------- */
+
+static VAStatus
+stub_Terminate (VADriverContextP ctx)
+{
+  StubDriver *const drv = STUB_DRIVER (ctx);
+  guint i;
+
+  for (i = 0; i < STUB_N_TABLES; i++) {
+    g_hash_table_unref (drv->tables[i].objects);
+    g_rw_lock_clear (&drv->tables[i].lock);
+  }
+  g_free (drv);
+  ctx->pDriverData = NULL;
+  return VA_STATUS_SUCCESS;
+}
+
+STUB_DRIVER_EXPORT VAStatus stub_driver_init (VADriverContextP ctx);
+
+VAStatus
+stub_driver_init (VADriverContextP ctx)
+{
+  struct VADriverVTable *const vtable = ctx->vtable;
+  struct VADriverVTableVPP *const vtable_vpp = ctx->vtable_vpp;
+  StubDriver *drv;
+  guint i;
+
+  drv = g_new0 (StubDriver, 1);
+  for (i = 0; i < STUB_N_TABLES; i++) {
+    g_rw_lock_init (&drv->tables[i].lock);
+    drv->tables[i].objects = g_hash_table_new_full (NULL, NULL, NULL,
+        stub_object_unref);
+  }
+  drv->next_id = 1;
+
+  ctx->pDriverData = drv;
+  ctx->max_profiles = G_N_ELEMENTS (g_codecs);
+  ctx->max_entrypoints = G_N_ELEMENTS (g_codecs);
+  ctx->max_attributes = 1;
+  ctx->max_image_formats = G_N_ELEMENTS (g_image_formats);
+  ctx->max_subpic_formats = G_N_ELEMENTS (g_subpicture_formats);
+  ctx->max_display_attributes = 1;
+  ctx->str_vendor = STUB_VENDOR;
+
+  vtable->vaTerminate = stub_Terminate;
+  vtable->vaQueryConfigProfiles = stub_QueryConfigProfiles;
+  vtable->vaQueryConfigEntrypoints = stub_QueryConfigEntrypoints;
+  vtable->vaGetConfigAttributes = stub_GetConfigAttributes;
+  vtable->vaCreateConfig = stub_CreateConfig;
+  vtable->vaDestroyConfig = stub_DestroyConfig;
+  vtable->vaQueryConfigAttributes = stub_QueryConfigAttributes;
+  vtable->vaCreateSurfaces = stub_CreateSurfaces;
+  vtable->vaDestroySurfaces = stub_DestroySurfaces;
+  vtable->vaCreateContext = stub_CreateContext;
+  vtable->vaDestroyContext = stub_DestroyContext;
+  vtable->vaCreateBuffer = stub_CreateBuffer;
+  vtable->vaBufferSetNumElements = stub_BufferSetNumElements;
+  vtable->vaMapBuffer = stub_MapBuffer;
+  vtable->vaUnmapBuffer = stub_UnmapBuffer;
+  vtable->vaDestroyBuffer = stub_DestroyBuffer;
+  vtable->vaBeginPicture = stub_BeginPicture;
+  vtable->vaRenderPicture = stub_RenderPicture;
+  vtable->vaEndPicture = stub_EndPicture;
+  vtable->vaSyncSurface = stub_SyncSurface;
+  vtable->vaQuerySurfaceStatus = stub_QuerySurfaceStatus;
+  vtable->vaQuerySurfaceError = stub_QuerySurfaceError;
+  vtable->vaPutSurface = stub_PutSurface;
+  vtable->vaQueryImageFormats = stub_QueryImageFormats;
+  vtable->vaCreateImage = stub_CreateImage;
+  vtable->vaDeriveImage = stub_DeriveImage;
+  vtable->vaDestroyImage = stub_DestroyImage;
+  vtable->vaSetImagePalette = stub_SetImagePalette;
+  vtable->vaGetImage = stub_GetImage;
+  vtable->vaPutImage = stub_PutImage;
+  vtable->vaQuerySubpictureFormats = stub_QuerySubpictureFormats;
+  vtable->vaCreateSubpicture = stub_CreateSubpicture;
+  vtable->vaDestroySubpicture = stub_DestroySubpicture;
+  vtable->vaSetSubpictureImage = stub_SetSubpictureImage;
+  vtable->vaSetSubpictureChromakey = stub_SetSubpictureChromakey;
+  vtable->vaSetSubpictureGlobalAlpha = stub_SetSubpictureGlobalAlpha;
+  vtable->vaAssociateSubpicture = stub_AssociateSubpicture;
+  vtable->vaDeassociateSubpicture = stub_DeassociateSubpicture;
+  vtable->vaQueryDisplayAttributes = stub_QueryDisplayAttributes;
+  vtable->vaGetDisplayAttributes = stub_GetDisplayAttributes;
+  vtable->vaSetDisplayAttributes = stub_SetDisplayAttributes;
+  vtable->vaBufferInfo = stub_BufferInfo;
+  vtable->vaCreateSurfaces2 = stub_CreateSurfaces2;
+  vtable->vaQuerySurfaceAttributes = stub_QuerySurfaceAttributes;
+
+  vtable_vpp->version = VA_DRIVER_VTABLE_VPP_VERSION;
+  vtable_vpp->vaQueryVideoProcFilters = stub_QueryVideoProcFilters;
+  vtable_vpp->vaQueryVideoProcFilterCaps = stub_QueryVideoProcFilterCaps;
+  vtable_vpp->vaQueryVideoProcPipelineCaps = stub_QueryVideoProcPipelineCaps;
+
+  return VA_STATUS_SUCCESS;
+}
@@ -0,0 +1,237 @@
+/*
+ *  test-copy.c - Benchmark pixels copy and conversion kernels
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include "gst/vaapi/sysdeps.h"
+#include <string.h>
+#include <gst/vaapi/gstvaapiutils_copy.h>
+
+static gint g_width = 1920;
+static gint g_height = 1080;
+static gint g_num_iterations = 100;
+
+static GOptionEntry g_options[] = {
+  {"width", 'w',
+        0,
+        G_OPTION_ARG_INT, &g_width,
+      "frame width", NULL},
+  {"height", 'h',
+        0,
+        G_OPTION_ARG_INT, &g_height,
+      "frame height", NULL},
+  {"iterations", 'n',
+        0,
+        G_OPTION_ARG_INT, &g_num_iterations,
+      "number of copies per kernel", NULL},
+  {NULL,}
+};
+
+/* Pitches are aligned like VA images so that streaming loads apply */
+#define STRIDE_ALIGN 64
+
+typedef enum
+{
+  KERNEL_COPY = 1,
+  KERNEL_SHIFT16,
+  KERNEL_INTERLEAVE,
+  KERNEL_INTERLEAVE16,
+  KERNEL_DEINTERLEAVE,
+  KERNEL_DEINTERLEAVE16,
+} KernelType;
+
+typedef struct
+{
+  const gchar *name;
+  KernelType type;
+  guint width_num;              /* row width in bytes, as a multiple of... */
+  guint width_den;              /* ...the frame width divided by this */
+  guint height_num;
+  guint height_den;
+  gint shift;
+} TestCase;
+
+/* Each case processes one plane of the named format */
+static const TestCase g_test_cases[] = {
+  {"NV12 (Y)", KERNEL_COPY, 1, 1, 1, 1, 0},
+  {"NV12 (UV)", KERNEL_COPY, 1, 1, 1, 2, 0},
+  {"P010 (Y)", KERNEL_COPY, 2, 1, 1, 1, 0},
+  {"P010 (UV)", KERNEL_COPY, 2, 1, 1, 2, 0},
+  {"Y210", KERNEL_COPY, 4, 1, 1, 1, 0},
+  {"Y410", KERNEL_COPY, 4, 1, 1, 1, 0},
+  {"I420 -> NV12 (UV)", KERNEL_INTERLEAVE, 1, 2, 1, 2, 0},
+  {"NV12 -> I420 (UV)", KERNEL_DEINTERLEAVE, 1, 2, 1, 2, 0},
+  {"I420_10 -> P010 (Y)", KERNEL_SHIFT16, 1, 1, 1, 1, 6},
+  {"I420_10 -> P010 (UV)", KERNEL_INTERLEAVE16, 1, 2, 1, 2, 6},
+  {"P010 -> I420_10 (Y)", KERNEL_SHIFT16, 1, 1, 1, 1, -6},
+  {"P010 -> I420_10 (UV)", KERNEL_DEINTERLEAVE16, 1, 2, 1, 2, -6},
+};
+
+static void
+run_kernel (const TestCase * tc, guint8 * dst, guint8 * src, guint stride,
+    guint width, guint height, guint flags)
+{
+  /* The second half of the buffers holds the other chroma plane */
+  const gsize offset = (gsize) stride * height;
+
+  switch (tc->type) {
+    case KERNEL_COPY:
+      gst_vaapi_copy_plane (dst, stride, src, stride, width, height, flags);
+      break;
+    case KERNEL_SHIFT16:
+      gst_vaapi_copy_plane_shift16 (dst, stride, src, stride, width, height,
+          tc->shift, flags);
+      break;
+    case KERNEL_INTERLEAVE:
+      gst_vaapi_copy_plane_interleave (dst, stride, src, stride,
+          src + offset, stride, width, height, flags);
+      break;
+    case KERNEL_INTERLEAVE16:
+      gst_vaapi_copy_plane_interleave16 (dst, stride, src, stride,
+          src + offset, stride, width, height, tc->shift, flags);
+      break;
+    case KERNEL_DEINTERLEAVE:
+      gst_vaapi_copy_plane_deinterleave (dst, stride, dst + offset, stride,
+          src, stride, width, height, flags);
+      break;
+    case KERNEL_DEINTERLEAVE16:
+      gst_vaapi_copy_plane_deinterleave16 (dst, stride, dst + offset, stride,
+          src, stride, width, height, tc->shift, flags);
+      break;
+  }
+}
+
+/* Returns the number of bytes read and written by one kernel run */
+static guint64
+get_kernel_bytes (const TestCase * tc, guint width, guint height)
+{
+  switch (tc->type) {
+    case KERNEL_SHIFT16:
+    case KERNEL_INTERLEAVE:
+    case KERNEL_DEINTERLEAVE:
+      return (guint64) 4 * width * height;
+    case KERNEL_INTERLEAVE16:
+    case KERNEL_DEINTERLEAVE16:
+      return (guint64) 8 * width * height;
+    default:
+      break;
+  }
+  return (guint64) 2 * width * height;
+}
+
+/* Kernels are checked against the scalar ones */
+static gboolean
+check_kernel (const TestCase * tc, guint8 * src, guint8 * dst,
+    guint8 * ref, gsize size, guint stride, guint width, guint height,
+    guint flags)
+{
+  GstVaapiCopyCpu cpu = gst_vaapi_copy_get_cpu ();
+  gboolean success;
+
+  memset (dst, 0, size);
+  memset (ref, 0, size);
+  run_kernel (tc, dst, src, stride, width, height, flags);
+  gst_vaapi_copy_set_cpu (GST_VAAPI_COPY_CPU_SCALAR);
+  run_kernel (tc, ref, src, stride, width, height, 0);
+  gst_vaapi_copy_set_cpu (cpu);
+
+  success = memcmp (dst, ref, size) == 0;
+  if (!success)
+    g_printerr ("%s: %s kernel mismatch\n", tc->name,
+        gst_vaapi_copy_cpu_get_name (cpu));
+  return success;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *error = NULL;
+  guint8 *src, *dst, *ref;
+  gsize size;
+  guint stride, i, k, flags;
+  gint cpu, n;
+  gint64 start_time, elapsed;
+  gboolean success = TRUE;
+
+  ctx = g_option_context_new ("- test options");
+  g_option_context_add_main_entries (ctx, g_options, GETTEXT_PACKAGE);
+  if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+    g_printerr ("option parsing failed: %s\n", error->message);
+    g_error_free (error);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (g_width < 2 || g_height < 2 || g_num_iterations < 1)
+    g_error ("invalid benchmark parameters");
+
+  /* Large enough for two planes of the widest format (4 bytes/pixel) */
+  stride = GST_ROUND_UP_N (4 * g_width, STRIDE_ALIGN);
+  size = (gsize) 2 *stride * g_height;
+  src = g_malloc (size + STRIDE_ALIGN);
+  dst = g_malloc (size + STRIDE_ALIGN);
+  ref = g_malloc (size + STRIDE_ALIGN);
+
+  {
+    guint8 *const s = (guint8 *) GST_ROUND_UP_N ((guintptr) src, STRIDE_ALIGN);
+    for (i = 0; i < size; i++)
+      s[i] = g_random_int () & 0xff;
+  }
+
+  g_print ("%dx%d, %d iterations\n", g_width, g_height, g_num_iterations);
+  for (cpu = GST_VAAPI_COPY_CPU_SCALAR; cpu <= GST_VAAPI_COPY_CPU_AVX2; cpu++) {
+    if (!gst_vaapi_copy_set_cpu (cpu))
+      continue;
+
+    for (i = 0; i < G_N_ELEMENTS (g_test_cases); i++) {
+      const TestCase *const tc = &g_test_cases[i];
+      const guint width = g_width * tc->width_num / tc->width_den;
+      const guint height = g_height * tc->height_num / tc->height_den;
+      guint8 *const s = (guint8 *) GST_ROUND_UP_N ((guintptr) src,
+          STRIDE_ALIGN);
+      guint8 *const d = (guint8 *) GST_ROUND_UP_N ((guintptr) dst,
+          STRIDE_ALIGN);
+      guint8 *const r = (guint8 *) GST_ROUND_UP_N ((guintptr) ref,
+          STRIDE_ALIGN);
+
+      for (k = 0; k < 2; k++) {
+        flags = k ? GST_VAAPI_COPY_FLAG_STREAMING_LOAD : 0;
+
+        if (!check_kernel (tc, s, d, r, size, stride, width, height, flags))
+          success = FALSE;
+
+        start_time = g_get_monotonic_time ();
+        for (n = 0; n < g_num_iterations; n++)
+          run_kernel (tc, d, s, stride, width, height, flags);
+        elapsed = MAX (g_get_monotonic_time () - start_time, 1);
+
+        g_print ("%-8s %-22s %-9s %8.2f GB/s\n",
+            gst_vaapi_copy_cpu_get_name (cpu), tc->name,
+            k ? "streaming" : "regular",
+            (gdouble) get_kernel_bytes (tc, width, height) *
+            g_num_iterations / (elapsed * 1000.0));
+      }
+    }
+  }
+
+  g_free (src);
+  g_free (dst);
+  g_free (ref);
+  return success ? 0 : 1;
+}
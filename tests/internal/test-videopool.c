@@ -0,0 +1,145 @@
+/*
+ *  test-videopool.c - Benchmark GstVaapiVideoPool get/put operations
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <gst/vaapi/gstvaapisurface.h>
+#include <gst/vaapi/gstvaapisurfacepool.h>
+#include "output.h"
+
+static gint g_num_threads = 4;
+static gint g_num_iterations = 100000;
+static gint g_num_held = 8;
+
+static GOptionEntry g_options[] = {
+  {"threads", 't',
+        0,
+        G_OPTION_ARG_INT, &g_num_threads,
+      "number of threads getting and putting objects", NULL},
+  {"iterations", 'n',
+        0,
+        G_OPTION_ARG_INT, &g_num_iterations,
+      "number of get/put cycles per thread", NULL},
+  {"held", 'd',
+        0,
+        G_OPTION_ARG_INT, &g_num_held,
+      "number of objects held by each thread (DPB depth)", NULL},
+  {NULL,}
+};
+
+typedef struct
+{
+  GstVaapiVideoPool *pool;
+  guint64 num_ops;
+  guint64 num_failures;
+} ThreadData;
+
+static gpointer
+worker (gpointer user_data)
+{
+  ThreadData *const td = user_data;
+  gpointer *const held = g_new0 (gpointer, g_num_held);
+  gint i, j;
+
+  for (i = 0; i < g_num_iterations; i++) {
+    /* Release the oldest object, like a decoder does with its DPB */
+    j = i % g_num_held;
+    if (held[j]) {
+      gst_vaapi_video_pool_put_object (td->pool, held[j]);
+      td->num_ops++;
+    }
+    held[j] = gst_vaapi_video_pool_get_object (td->pool);
+    if (held[j])
+      td->num_ops++;
+    else
+      td->num_failures++;
+  }
+
+  for (j = 0; j < g_num_held; j++) {
+    if (held[j])
+      gst_vaapi_video_pool_put_object (td->pool, held[j]);
+  }
+  g_free (held);
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstVaapiDisplay *display;
+  GstVaapiVideoPool *pool;
+  GThread **threads;
+  ThreadData *td;
+  guint64 num_ops = 0, num_failures = 0;
+  gint64 start_time, elapsed;
+  guint capacity;
+  gint i;
+
+  static const guint width = 320;
+  static const guint height = 240;
+
+  if (!video_output_init (&argc, argv, g_options))
+    g_error ("failed to initialize video output subsystem");
+
+  if (g_num_threads < 1 || g_num_held < 1 || g_num_iterations < 1)
+    g_error ("invalid benchmark parameters");
+
+  display = video_output_create_display (NULL);
+  if (!display)
+    g_error ("could not create Gst/VA display");
+
+  pool = gst_vaapi_surface_pool_new (display, GST_VIDEO_FORMAT_ENCODED,
+      width, height, 0);
+  if (!pool)
+    g_error ("could not create Gst/VA surface pool");
+
+  /* Pre-allocate all surfaces so that only get/put are measured */
+  capacity = g_num_threads * g_num_held;
+  gst_vaapi_video_pool_set_capacity (pool, capacity);
+  if (!gst_vaapi_video_pool_reserve (pool, capacity))
+    g_error ("could not reserve %u surfaces", capacity);
+
+  threads = g_new (GThread *, g_num_threads);
+  td = g_new0 (ThreadData, g_num_threads);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < g_num_threads; i++) {
+    td[i].pool = pool;
+    threads[i] = g_thread_new ("videopool", worker, &td[i]);
+  }
+  for (i = 0; i < g_num_threads; i++) {
+    g_thread_join (threads[i]);
+    num_ops += td[i].num_ops;
+    num_failures += td[i].num_failures;
+  }
+  elapsed = g_get_monotonic_time () - start_time;
+
+  g_print ("%d threads, %u surfaces: %" G_GUINT64_FORMAT " operations in "
+      "%.3f ms (%.1f ns/op), %" G_GUINT64_FORMAT " failed gets\n",
+      g_num_threads, capacity, num_ops, elapsed / 1000.0,
+      num_ops ? (elapsed * 1000.0) / num_ops : 0.0, num_failures);
+
+  if (gst_vaapi_video_pool_get_size (pool) != capacity)
+    g_error ("surfaces leaked from the pool");
+
+  g_free (td);
+  g_free (threads);
+  gst_vaapi_video_pool_unref (pool);
+  gst_object_unref (display);
+  video_output_exit ();
+  return 0;
+}